@@ -0,0 +1,118 @@
+/*
+ * Dual ADC test.
+ *
+ * Samples a voltage and a current signal at exactly the same instant
+ * using ADC1 and ADC2 in regular simultaneous mode, 20,000 times a
+ * second, and prints the mean of each and the mean of their product
+ * (i.e. real power, in raw ADC units) once a second.
+ *
+ * To test:
+ *
+ *     - Connect the voltage signal to pin 52 and the current signal
+ *       to pin 53 (0 to 3.3V)
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define VOLTAGE_PIN 52
+#define CURRENT_PIN 53
+#define SAMPLE_US   50    // 20 kHz
+#define HALF        500   // samples per callback, i.e. 25 ms
+
+const uint8 voltagePin[] = {VOLTAGE_PIN};
+const uint8 currentPin[] = {CURRENT_PIN};
+
+HardwareADC adc(1);
+HardwareTimer timer(3);
+uint32 samples[2 * HALF];
+
+volatile uint32 voltageSum = 0;
+volatile uint32 currentSum = 0;
+volatile uint64 powerSum = 0;
+volatile uint32 sampleCount = 0;
+
+void streamHandler(uint32 *data, uint32 count) {
+    uint32 v = 0, i = 0;
+    uint64 p = 0;
+    for (uint32 n = 0; n < count; n++) {
+        uint32 voltage = data[n] & 0xFFFF; // ADC1
+        uint32 current = data[n] >> 16;    // ADC2
+        v += voltage;
+        i += current;
+        p += voltage * current;
+    }
+    voltageSum += v;
+    currentSum += i;
+    powerSum += p;
+    sampleCount += count;
+}
+
+void setup() {
+    pinMode(VOLTAGE_PIN, INPUT_ANALOG);
+    pinMode(CURRENT_PIN, INPUT_ANALOG);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    timer.pause();
+    timer.setPeriod(SAMPLE_US);
+    timer_set_master_mode(timer.c_dev(), TIMER_CR2_MMS_UPDATE);
+    timer.refresh();
+
+    adc.setSequence(voltagePin, 1);
+    adc.setDualSequence(currentPin, 1);
+    adc.setSampleRate(ADC_SMPR_28_5);
+    adc.setTrigger(ADC_EXT_EV_TIM3_TRGO);
+    if (!adc.startDual(samples, 2 * HALF, streamHandler)) {
+        SerialUSB.println("FAIL: could not start the dual stream");
+        while (true)
+            ;
+    }
+    timer.resume();
+}
+
+void loop() {
+    delay(1000);
+
+    noInterrupts();
+    uint32 n = sampleCount;
+    uint32 v = voltageSum;
+    uint32 i = currentSum;
+    uint64 p = powerSum;
+    sampleCount = voltageSum = currentSum = 0;
+    powerSum = 0;
+    interrupts();
+
+    if (n == 0) {
+        SerialUSB.println("FAIL: no samples");
+        return;
+    }
+    SerialUSB.print("samples: ");
+    SerialUSB.print(n);
+    SerialUSB.print("\tvoltage: ");
+    SerialUSB.print(v / n);
+    SerialUSB.print("\tcurrent: ");
+    SerialUSB.print(i / n);
+    SerialUSB.print("\tpower: ");
+    SerialUSB.println((uint32)(p / n));
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * ADCFilter test.
+ *
+ * First checks the boxcar, CIC and IIR filters against known inputs
+ * and measures how many CPU cycles each spends per input sample.
+ * Then streams one analog pin at 64 kHz and decimates it with a third
+ * order CIC filter from the DMA callback, printing 16 bit results at
+ * 1 kHz (one per line, ten times a second).
+ *
+ * To test:
+ *
+ *     - Connect a slowly varying voltage between 0 and 3.3V to pin 15
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <ADCFilter/ADCFilter.h>
+
+#define SAMPLE_PIN   15
+#define BENCH_SIZE   4096
+#define STREAM_HALF  1024
+
+uint16 bench[BENCH_SIZE];
+uint16 output[BENCH_SIZE];
+uint32 failures = 0;
+
+HardwareADC adc(1);
+HardwareTimer timer(3);
+uint16 samples[2 * STREAM_HALF];
+CICDecimator streamFilter(1, 3, 6, 16); // 64 kHz / 64 = 1 kHz
+volatile uint16 latest = 0;
+volatile uint32 produced = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void fill(uint16 value) {
+    for (uint32 i = 0; i < BENCH_SIZE; i++) {
+        bench[i] = value;
+    }
+}
+
+// Print cycles per input sample for one call over the bench buffer.
+void report(const char *name, uint32 us) {
+    SerialUSB.print(name);
+    SerialUSB.print(" cycles/sample: ");
+    SerialUSB.println((double)us * CYCLES_PER_MICROSECOND / BENCH_SIZE, 1);
+}
+
+void streamHandler(uint16 *data, uint32 count) {
+    uint32 n = streamFilter.process(data, count, data);
+    latest = data[n - 1];
+    produced += n;
+}
+
+void setup() {
+    pinMode(SAMPLE_PIN, INPUT_ANALOG);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    uint32 n, start;
+
+    // Boxcar: 256 samples for 4 extra bits -> 16 bit output
+    BoxcarDecimator boxcar(1, 4);
+    fill(3000);
+    start = micros();
+    n = boxcar.process(bench, BENCH_SIZE, output);
+    report("boxcar x256", micros() - start);
+    check(n == BENCH_SIZE / 256 && output[0] == 3000 * 16,
+          "boxcar constant input");
+    for (uint32 i = 0; i < 256; i++) {
+        bench[i] = 1000 + (i & 1); // half an LSB of dither
+    }
+    boxcar.process(bench, 256, output);
+    check(output[0] == 1000 * 16 + 8, "boxcar resolves half an LSB");
+
+    // CIC: order 3, ratio 16, split across calls
+    CICDecimator cic(2, 3, 4, 16);
+    fill(2048);
+    start = micros();
+    n = cic.process(bench, BENCH_SIZE, output);
+    report("CIC order 3 x16", micros() - start);
+    check(n == BENCH_SIZE / 16, "CIC output count");
+    check(output[n - 2] == 2048 * 16 && output[n - 1] == 2048 * 16,
+          "CIC settles to the input");
+    n = cic.process(bench, 6, output) + cic.process(bench, 26, output);
+    check(n == 2 && output[0] == 2048 * 16, "CIC spans buffers");
+
+    // IIR: settles to 16 times the input
+    IIRFilter iir(1, 4);
+    fill(4095);
+    start = micros();
+    iir.process(bench, BENCH_SIZE, output);
+    report("IIR k=4", micros() - start);
+    check(output[0] == 4095 && output[BENCH_SIZE - 1] >= 4095 * 16 - 16,
+          "IIR step response");
+
+    // In place, as from a stream callback
+    fill(100);
+    n = cic.process(bench, BENCH_SIZE, bench);
+    check(bench[n - 1] == 100 * 16, "CIC in place");
+
+    SerialUSB.println();
+    SerialUSB.print("Self test finished, failures: ");
+    SerialUSB.println(failures);
+    SerialUSB.println();
+
+    timer.pause();
+    timer.setPrescaleFactor(1);
+    timer.setOverflow(CYCLES_PER_MICROSECOND * 1000000 / 64000);
+    timer_set_master_mode(timer.c_dev(), TIMER_CR2_MMS_UPDATE);
+    timer.refresh();
+
+    const uint8 pin = SAMPLE_PIN;
+    adc.setSequence(&pin, 1);
+    adc.setSampleRate(ADC_SMPR_7_5);
+    adc.setTrigger(ADC_EXT_EV_TIM3_TRGO);
+    adc.start(samples, 2 * STREAM_HALF, streamHandler);
+    timer.resume();
+}
+
+void loop() {
+    delay(100);
+    SerialUSB.print(latest);
+    SerialUSB.print("\toutputs: ");
+    SerialUSB.println(produced);
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Injected ADC conversion test.
+ *
+ * Timer 1 runs a 20 kHz PWM period, and its channel 4 compare event
+ * triggers an injected conversion of two "phase current" pins in the
+ * middle of every period. At the same time, ADC1 streams four slow
+ * housekeeping pins at 1 kHz through its regular sequence. The
+ * injected conversions preempt the regular scan without disturbing
+ * it, which the printed counts confirm once a second.
+ *
+ * To test:
+ *
+ *     - Connect voltages between 0 and 3.3V to the sampled pins
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define PWM_US          50    // 20 kHz
+#define HOUSEKEEPING_US 1000  // 1 kHz
+#define SCANS           10    // per half buffer
+
+const uint8 phasePins[] = {52, 53};
+const uint8 housekeepingPins[] = {7, 8, 9, 10};
+
+HardwareADC adc(1);
+HardwareTimer pwmTimer(1);
+HardwareTimer scanTimer(3);
+uint16 samples[2 * SCANS * 4];
+
+volatile uint32 injectedCount = 0;
+volatile uint16 phaseA = 0;
+volatile uint16 phaseB = 0;
+volatile uint32 scanCount = 0;
+volatile uint16 housekeeping[4];
+
+void injectedHandler(const uint16 *results, uint8 count) {
+    phaseA = results[0];
+    phaseB = results[1];
+    injectedCount++;
+}
+
+void streamHandler(uint16 *data, uint32 count) {
+    for (uint32 i = 0; i < 4; i++) {
+        housekeeping[i] = data[count - 4 + i];
+    }
+    scanCount += count / 4;
+}
+
+void setup() {
+    for (uint32 i = 0; i < 2; i++) {
+        pinMode(phasePins[i], INPUT_ANALOG);
+    }
+    for (uint32 i = 0; i < 4; i++) {
+        pinMode(housekeepingPins[i], INPUT_ANALOG);
+    }
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    // Sample the phase currents in the middle of each PWM period.
+    pwmTimer.pause();
+    uint16 overflow = pwmTimer.setPeriod(PWM_US);
+    pwmTimer.setMode(TIMER_CH4, TIMER_PWM);
+    pwmTimer.setCompare(TIMER_CH4, overflow / 2);
+    pwmTimer.refresh();
+
+    scanTimer.pause();
+    scanTimer.setPeriod(HOUSEKEEPING_US);
+    timer_set_master_mode(scanTimer.c_dev(), TIMER_CR2_MMS_UPDATE);
+    scanTimer.refresh();
+
+    adc.setSampleRate(ADC_SMPR_13_5);
+    adc.setInjectedSequence(phasePins, 2);
+    adc.setSequence(housekeepingPins, 4);
+    adc.setTrigger(ADC_EXT_EV_TIM3_TRGO);
+    if (!adc.startInjected(ADC_JEXT_EV_TIM1_CC4, injectedHandler) ||
+        !adc.start(samples, 2 * SCANS * 4, streamHandler)) {
+        SerialUSB.println("FAIL: could not start conversions");
+        while (true)
+            ;
+    }
+    pwmTimer.resume();
+    scanTimer.resume();
+}
+
+void loop() {
+    delay(1000);
+
+    noInterrupts();
+    uint32 injected = injectedCount;
+    uint32 scans = scanCount;
+    injectedCount = scanCount = 0;
+    interrupts();
+
+    SerialUSB.print("injected/s: ");
+    SerialUSB.print(injected);
+    SerialUSB.print("\tA: ");
+    SerialUSB.print(phaseA);
+    SerialUSB.print("\tB: ");
+    SerialUSB.print(phaseB);
+    SerialUSB.print("\tscans/s: ");
+    SerialUSB.print(scans);
+    for (uint32 i = 0; i < 4; i++) {
+        SerialUSB.print("\t");
+        SerialUSB.print(housekeeping[i]);
+    }
+    SerialUSB.println();
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * ADC streaming test.
+ *
+ * Scans eight analog pins 10,000 times a second. Timer 3 paces the
+ * scans through its TRGO output, and DMA moves every conversion into
+ * a circular buffer, so the CPU only runs once per half buffer. Each
+ * second, the per-pin averages and the number of missed half buffers
+ * are printed.
+ *
+ * To test:
+ *
+ *     - Connect voltages between 0 and 3.3V to the scanned pins
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define SCAN_PINS  8
+#define SCAN_US    100   // 10 kHz
+#define SCANS      50    // per half buffer, i.e. 5 ms
+
+const uint8 pins[SCAN_PINS] = {7, 8, 9, 10, 11, 12, 52, 53};
+
+HardwareADC adc(1);
+HardwareTimer timer(3);
+uint16 samples[2 * SCANS * SCAN_PINS];
+
+volatile uint32 sums[SCAN_PINS];
+volatile uint32 halves = 0;
+volatile bool pending = false;
+volatile uint32 missed = 0;
+
+void streamHandler(uint16 *data, uint32 count) {
+    if (pending) {
+        missed++;
+        return;
+    }
+    for (uint32 i = 0; i < count; i += SCAN_PINS) {
+        for (uint32 pin = 0; pin < SCAN_PINS; pin++) {
+            sums[pin] += data[i + pin];
+        }
+    }
+    if (++halves == 1000000 / (SCAN_US * SCANS)) {
+        pending = true;
+    }
+}
+
+void setup() {
+    for (uint32 i = 0; i < SCAN_PINS; i++) {
+        pinMode(pins[i], INPUT_ANALOG);
+    }
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    // Timer 3 update events become the ADC trigger.
+    timer.pause();
+    timer.setPeriod(SCAN_US);
+    timer_set_master_mode(timer.c_dev(), TIMER_CR2_MMS_UPDATE);
+    timer.refresh();
+
+    adc.setSequence(pins, SCAN_PINS);
+    adc.setSampleRate(ADC_SMPR_13_5);
+    adc.setTrigger(ADC_EXT_EV_TIM3_TRGO);
+    if (!adc.start(samples, 2 * SCANS * SCAN_PINS, streamHandler)) {
+        SerialUSB.println("FAIL: could not start the stream");
+        while (true)
+            ;
+    }
+    timer.resume();
+}
+
+void loop() {
+    if (!pending) {
+        return;
+    }
+    uint32 scans = halves * SCANS;
+    for (uint32 pin = 0; pin < SCAN_PINS; pin++) {
+        SerialUSB.print(sums[pin] / scans);
+        SerialUSB.print("\t");
+        sums[pin] = 0;
+    }
+    SerialUSB.print("missed: ");
+    SerialUSB.println(missed);
+    halves = 0;
+    pending = false;
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * ADC analog watchdog test.
+ *
+ * Scans two analog pins continuously with ADC1 and DMA, and arms the
+ * analog watchdog on the first of them as an over-current trip. When
+ * a conversion of that pin leaves the window, the watchdog interrupt
+ * drives the trip pin low within a few microseconds, without the CPU
+ * ever polling the samples. The handler then disarms itself; send any
+ * key to re-arm it.
+ *
+ * To test:
+ *
+ *     - Connect the current sense signal (0 to 3.3V) to pin 15, and
+ *       any other voltage to pin 16
+ *     - Watch the trip pin (the LED) with an oscilloscope
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *     - Raise pin 15 above about 2.5V
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define CURRENT_PIN  15
+#define OTHER_PIN    16
+#define TRIP_PIN     BOARD_LED_PIN
+#define TRIP_LEVEL   3100   // about 2.5V
+
+const uint8 pins[] = {CURRENT_PIN, OTHER_PIN};
+
+HardwareADC adc(1);
+uint16 samples[2 * 64];
+
+volatile uint32 trips = 0;
+volatile uint32 halves = 0;
+
+void streamHandler(uint16 *data, uint32 count) {
+    halves++;
+}
+
+void tripHandler(void) {
+    digitalWrite(TRIP_PIN, LOW);
+    adc_detach_interrupt(adc.c_dev(), ADC_AWD_INTERRUPT);
+    trips++;
+}
+
+void arm(void) {
+    digitalWrite(TRIP_PIN, HIGH);
+    adc_attach_interrupt(adc.c_dev(), ADC_AWD_INTERRUPT, tripHandler);
+}
+
+void setup() {
+    pinMode(CURRENT_PIN, INPUT_ANALOG);
+    pinMode(OTHER_PIN, INPUT_ANALOG);
+    pinMode(TRIP_PIN, OUTPUT);
+    while (!SerialUSB.available())
+        ;
+    SerialUSB.read();
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    const adc_dev *dev = adc.c_dev();
+    adc_awd_set_thresholds(dev, 0, TRIP_LEVEL);
+    adc_awd_enable_channel(dev, PIN_MAP[CURRENT_PIN].adc_channel,
+                           ADC_CR1_AWDEN);
+    arm();
+
+    adc.setSequence(pins, 2);
+    adc.setSampleRate(ADC_SMPR_13_5);
+    if (!adc.start(samples, sizeof(samples) / sizeof(samples[0]),
+                   streamHandler)) {
+        SerialUSB.println("FAIL: could not start the stream");
+        while (true)
+            ;
+    }
+}
+
+void loop() {
+    delay(500);
+    if (SerialUSB.available()) {
+        SerialUSB.read();
+        SerialUSB.println("re-armed");
+        arm();
+    }
+    SerialUSB.print("current: ");
+    SerialUSB.print(samples[0]);
+    SerialUSB.print("\ttrips: ");
+    SerialUSB.print(trips);
+    SerialUSB.print("\thalf buffers: ");
+    SerialUSB.println(halves);
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * BlockCache test.
+ *
+ * Runs the write-back block cache from the Card library against a RAM
+ * backed block device, and checks write coalescing, LRU replacement and
+ * the hit rate counter.
+ *
+ * To test:
+ *
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <Card/SecureDigital/BlockCache.h>
+#include <string.h>
+
+#define RAM_BLOCKS  16
+#define CACHE_LINES 4
+
+class RamDisk : public BlockDevice {
+  public:
+    uint32 data[RAM_BLOCKS][BLOCK_DEVICE_WORDS];
+    uint32 reads;
+    uint32 writes;
+
+    uint32 read(uint32 block, uint32 *buf, uint32 count) {
+        if (block + count > RAM_BLOCKS) {
+            return 1;
+        }
+        this->reads++;
+        memcpy(buf, this->data[block], count * 512);
+        return 0;
+    }
+
+    uint32 write(uint32 block, const uint32 *buf, uint32 count) {
+        if (block + count > RAM_BLOCKS) {
+            return 1;
+        }
+        this->writes++;
+        memcpy(this->data[block], buf, count * 512);
+        return 0;
+    }
+};
+
+RamDisk disk;
+uint32 cacheLines[CACHE_LINES * BLOCK_DEVICE_WORDS];
+uint32 block[BLOCK_DEVICE_WORDS];
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void fill(uint32 *buf, uint32 value) {
+    for (uint32 i = 0; i < BLOCK_DEVICE_WORDS; i++) {
+        buf[i] = value;
+    }
+}
+
+void setup() {
+    for (uint32 i = 0; i < RAM_BLOCKS; i++) {
+        fill(disk.data[i], i);
+    }
+    disk.reads = 0;
+    disk.writes = 0;
+
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+}
+
+void loop() {
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+
+    // Out of order single block writes stay in the cache...
+    for (uint32 b = 7; b >= 4; b--) {
+        fill(block, 100 + b);
+        cache.write(b, block, 1);
+    }
+    check(disk.writes == 0, "single block writes are held back");
+
+    // ...and go out as one multi-block write
+    check(cache.flush() == 0, "flush succeeds");
+    check(disk.writes == 1, "contiguous dirty blocks coalesce");
+    check(disk.data[4][0] == 104 && disk.data[7][127] == 107,
+          "flushed data reaches the device");
+
+    // Re-reading cached blocks does not touch the device
+    uint32 reads = disk.reads;
+    cache.read(5, block, 1);
+    check(disk.reads == reads && block[0] == 105, "cached read hits");
+
+    // Reading a fifth block evicts the least recently used one (block 7)
+    cache.read(12, block, 1);
+    reads = disk.reads;
+    cache.read(7, block, 1);
+    check(disk.reads == reads + 1, "least recently used block was evicted");
+
+    // Modify in place, then flush
+    uint32 *data;
+    cache.fetch(12, &data, true);
+    data[0] = 0xCAFE;
+    cache.flush();
+    check(disk.data[12][0] == 0xCAFE, "fetched block is written back");
+
+    SerialUSB.print("Hit rate: ");
+    SerialUSB.print(cache.hitRate());
+    SerialUSB.println("%");
+
+    SerialUSB.println();
+    SerialUSB.print("Test finished, failures: ");
+    SerialUSB.println(failures);
+    while (true)
+        ;
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
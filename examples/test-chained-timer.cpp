@@ -0,0 +1,80 @@
+/*
+ * ChainedTimer test.
+ *
+ * Chains timers 2 and 3 into a 32 bit cycle counter, extended to 64
+ * bits. Checks that reads never go backwards (including across the
+ * 32 bit wrap every 59.6 seconds), and once a second prints the cost
+ * of a read, micros64() against micros(), and the number of failures.
+ *
+ * To test:
+ *
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *     - Leave running for a few minutes
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+ChainedTimer counter(2, 3);
+uint32 failures = 0;
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    if (!counter.begin()) {
+        SerialUSB.println("FAIL: timers 2 and 3 can't be chained");
+        while (true)
+            ;
+    }
+}
+
+void loop() {
+    // Tight loop of reads for one second, checking monotonicity.
+    uint32 startMs = millis();
+    uint64 last = counter.cycles64();
+    uint32 reads = 0;
+    while (millis() - startMs < 1000) {
+        uint64 now = counter.cycles64();
+        if (now < last) {
+            failures++;
+        }
+        last = now;
+        reads++;
+    }
+
+    uint32 a = counter.cycles();
+    uint32 b = counter.cycles();
+    uint64 us = counter.micros64();
+    uint32 sys = micros();
+
+    SerialUSB.print("cycles() read: ");
+    SerialUSB.print(b - a);
+    SerialUSB.print(" cycles\tcycles64() reads/s: ");
+    SerialUSB.print(reads);
+    SerialUSB.print("\tmicros64() - micros(): ");
+    SerialUSB.print((int32)((uint32)us - sys));
+    SerialUSB.print("\tepoch: ");
+    SerialUSB.print((uint32)(last >> 32));
+    SerialUSB.print("\tfailures: ");
+    SerialUSB.println(failures);
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * DAC waveform test.
+ *
+ * Plays a fixed 4 kHz sine wave on DAC channel 1 (PA4) at 256,000
+ * samples per second, with no interrupts at all, and a continuously
+ * refilled rising ramp on DAC channel 2 (PA5) at 100,000 samples per
+ * second, whose slope changes every second. Prints the number of
+ * refills each second.
+ *
+ * To test:
+ *
+ *     - Connect an oscilloscope to PA4 and PA5
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define SINE_SAMPLES  64
+#define RAMP_HALF     500    // 5 ms at 100 kHz
+
+HardwareDAC sine(6);
+HardwareDAC ramp(7);
+uint16 sineTable[SINE_SAMPLES];
+uint16 rampBuffer[2 * RAMP_HALF];
+
+volatile uint32 refills = 0;
+volatile uint16 rampLevel = 0;
+volatile uint16 rampStep = 1;
+
+void refill(uint16 *samples, uint32 count) {
+    uint16 level = rampLevel;
+    for (uint32 i = 0; i < count; i++) {
+        samples[i] = level;
+        level = (level + rampStep) & 0xFFF;
+    }
+    rampLevel = level;
+    refills++;
+}
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    for (uint32 i = 0; i < SINE_SAMPLES; i++) {
+        double phase = 2 * PI * i / SINE_SAMPLES;
+        sineTable[i] = (uint16)(2047.5 + 2047.5 * sin(phase));
+    }
+    SerialUSB.print("sine rate: ");
+    SerialUSB.println(sine.setSampleRate(256000));
+    if (!sine.start(1, sineTable, SINE_SAMPLES)) {
+        SerialUSB.println("FAIL: could not start the sine wave");
+    }
+
+    refill(rampBuffer, 2 * RAMP_HALF);
+    SerialUSB.print("ramp rate: ");
+    SerialUSB.println(ramp.setSampleRate(100000));
+    if (!ramp.start(2, rampBuffer, 2 * RAMP_HALF, refill)) {
+        SerialUSB.println("FAIL: could not start the ramp");
+    }
+}
+
+void loop() {
+    delay(1000);
+    rampStep = rampStep % 16 + 1;
+    SerialUSB.print("refills: ");
+    SerialUSB.print(refills);
+    SerialUSB.print("\tposition: ");
+    SerialUSB.println(ramp.position());
+    refills = 0;
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * DataLogger test.
+ *
+ * Logs a 4 kHz stream of ADC samples from a timer interrupt to LOG.BIN on
+ * an SD card for ten seconds, then prints the logger statistics. The
+ * interrupt never waits on the card: buffers are written with
+ * asynchronous multi-block writes from the main loop.
+ *
+ * To test:
+ *
+ *     - Insert a FAT formatted micro SD card into the Maple Native
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *     - Copy LOG.BIN to a PC and decode it with
+ *       support/scripts/decode-datalog.py -f '<IH' LOG.BIN
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <Card/SecureDigital/HardwareSDIO.h>
+#include <Card/SecureDigital/BlockCache.h>
+#include <Card/SecureDigital/DataLogger.h>
+#include <Card/FAT/FatFile.h>
+
+#define SAMPLE_PIN     15
+#define SAMPLE_US      250   // 4 kHz
+#define RUN_SECONDS    10
+#define LOG_BYTES      (1024 * 1024)
+#define BUFFERS        4
+#define BUFFER_BLOCKS  8     // 4 KiB per card write
+
+HardwareSDIO card;
+uint32 cacheLines[2 * BLOCK_DEVICE_WORDS];
+BlockCache cache(&card, cacheLines, 2);
+FatVolume volume;
+FatFile file;
+uint32 logBuffers[BUFFERS * BUFFER_BLOCKS * BLOCK_DEVICE_WORDS];
+DataLogger logger(&card, logBuffers, BUFFERS, BUFFER_BLOCKS);
+HardwareTimer timer(2);
+
+struct sample {
+    uint32 micros;
+    uint16 value;
+} __attribute__((packed));
+
+void sampleHandler(void) {
+    struct sample s;
+    s.micros = micros();
+    s.value = analogRead(SAMPLE_PIN);
+    logger.log(&s, sizeof(s));
+}
+
+void printStat(const char *name, uint32 value) {
+    SerialUSB.print(name);
+    SerialUSB.println(value);
+}
+
+void setup() {
+    pinMode(SAMPLE_PIN, INPUT_ANALOG);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+}
+
+void loop() {
+    uint32 start;
+    card.begin();
+    if (volume.mount(&cache) ||
+        file.open(&volume, "log.bin", FAT_WRITE | FAT_CREATE | FAT_TRUNC) ||
+        file.reserve(LOG_BYTES, &start)) {
+        SerialUSB.println("FAIL: could not reserve LOG.BIN");
+        while (true)
+            ;
+    }
+    file.close();
+    logger.begin(start, LOG_BYTES / 512, millis());
+
+    timer.pause();
+    timer.setPeriod(SAMPLE_US);
+    timer.setMode(TIMER_CH1, TIMER_OUTPUT_COMPARE);
+    timer.setCompare(TIMER_CH1, 1);
+    timer.attachInterrupt(TIMER_CH1, sampleHandler);
+    timer.refresh();
+    timer.resume();
+
+    uint32 end = millis() + RUN_SECONDS * 1000;
+    while ((int32)(millis() - end) < 0) {
+        logger.update();
+    }
+    timer.pause();
+    timer.detachInterrupt(TIMER_CH1);
+    logger.end();
+    card.end();
+
+    printStat("records:     ", logger.stats.records);
+    printStat("dropped:     ", logger.stats.dropped);
+    printStat("blocks:      ", logger.stats.blocks);
+    printStat("errors:      ", logger.stats.errors);
+    printStat("max queued:  ", logger.stats.maxQueued);
+    printStat("max latency: ", logger.stats.maxLatency);
+
+    SerialUSB.println();
+    SerialUSB.println("Test finished.");
+    while (true)
+        ;
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * HardwareEncoder test.
+ *
+ * Drives a simulated quadrature encoder from three output pins, and
+ * counts it with timer 4 in encoder mode. Checks the 32 bit position
+ * after moving forwards and backwards across many 16 bit counter
+ * wraps, then spins the encoder steadily with an index pulse every
+ * 1000 counts and prints the position and velocity estimate.
+ *
+ * To test:
+ *
+ *     - Connect pin 5 to pin 38 (A), pin 6 to pin 39 (B), and pin 7
+ *       to pin 8 (index)
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define OUT_A       5
+#define OUT_B       6
+#define OUT_INDEX   7
+#define IN_A        38
+#define IN_B        39
+#define IN_INDEX    8
+#define PER_INDEX   1000
+
+HardwareEncoder encoder(4);
+int32 simulated = 0;
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+// Move the simulated encoder one count, in Gray code order.
+void step(int32 dir) {
+    static const uint8 phases[4] = {0, 1, 3, 2};
+    simulated += dir;
+    uint8 phase = phases[simulated & 3];
+    digitalWrite(OUT_A, phase & 1);
+    digitalWrite(OUT_B, (phase >> 1) & 1);
+    digitalWrite(OUT_INDEX, simulated % PER_INDEX == 0);
+    delayMicroseconds(1);
+}
+
+void setup() {
+    pinMode(OUT_A, OUTPUT);
+    pinMode(OUT_B, OUTPUT);
+    pinMode(OUT_INDEX, OUTPUT);
+    pinMode(IN_A, INPUT);
+    pinMode(IN_B, INPUT);
+    pinMode(IN_INDEX, INPUT);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    encoder.begin(TIMER_SMCR_SMS_ENCODER3, 2);
+    check(encoder.position() == 0, "starts at 0");
+    for (uint32 i = 0; i < 200000; i++) {
+        step(1);
+    }
+    check(encoder.position() == simulated, "forwards past 3 wraps");
+    for (uint32 i = 0; i < 300000; i++) {
+        step(-1);
+    }
+    check(encoder.position() == simulated, "backwards to negative");
+    encoder.setPosition(0);
+    simulated = 0;
+    check(encoder.position() == 0, "setPosition()");
+
+    SerialUSB.println();
+    SerialUSB.print("Self test finished, failures: ");
+    SerialUSB.println(failures);
+    SerialUSB.println();
+
+    encoder.attachIndex(IN_INDEX);
+}
+
+void loop() {
+    uint32 start = millis();
+    while (millis() - start < 500) {
+        step(1);
+    }
+    SerialUSB.print("position: ");
+    SerialUSB.print(encoder.position());
+    SerialUSB.print("\texpected: ");
+    SerialUSB.print(simulated);
+    SerialUSB.print("\tlast index: ");
+    SerialUSB.print(encoder.indexPosition());
+    SerialUSB.print("\tcounts/s: ");
+    SerialUSB.println(encoder.velocity());
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
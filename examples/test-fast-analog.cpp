@@ -0,0 +1,94 @@
+/*
+ * FastAnalog test.
+ *
+ * Times 10,000 reads of one pin with analogRead() and with FastAnalog
+ * handles at the default and the shortest sample time, and checks
+ * that the results agree. Reads of a second pin are interleaved to
+ * show that the handles still read the right channel.
+ *
+ * To test:
+ *
+ *     - Connect a steady voltage between 0 and 3.3V to pin 15, and a
+ *       different one to pin 16
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define PIN_A  15
+#define PIN_B  16
+#define READS  10000
+
+FastAnalog slowA(PIN_A);
+FastAnalog fastB(PIN_B, ADC_SMPR_1_5);
+
+void time(const char *name, uint32 us, uint32 sum) {
+    SerialUSB.print(name);
+    SerialUSB.print(" ns/read: ");
+    SerialUSB.print(us * 1000 / READS);
+    SerialUSB.print("\tmean: ");
+    SerialUSB.println(sum / READS);
+}
+
+void setup() {
+    pinMode(PIN_A, INPUT_ANALOG);
+    pinMode(PIN_B, INPUT_ANALOG);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+}
+
+void loop() {
+    uint32 start, sum, i;
+
+    sum = 0;
+    start = micros();
+    for (i = 0; i < READS; i++) {
+        sum += analogRead(PIN_A);
+    }
+    time("analogRead A", micros() - start, sum);
+
+    sum = 0;
+    start = micros();
+    for (i = 0; i < READS; i++) {
+        sum += slowA.read();
+    }
+    time("FastAnalog A", micros() - start, sum);
+
+    sum = 0;
+    start = micros();
+    for (i = 0; i < READS; i++) {
+        sum += fastB.read();
+    }
+    time("FastAnalog B, 1.5 cycles", micros() - start, sum);
+
+    uint32 a = 0, b = 0;
+    for (i = 0; i < READS; i++) {
+        a += slowA.read();
+        b += fastB.read();
+    }
+    time("interleaved A", 0, a);
+    time("interleaved B", 0, b);
+
+    SerialUSB.println();
+    delay(1000);
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * FAT filesystem test.
+ *
+ * Mounts the FAT16/FAT32 volume on an SD card through the Card library,
+ * writes a CSV log with small writes, streams a preallocated binary file
+ * with whole-block writes, then reads both back and checks them.
+ *
+ * To test:
+ *
+ *     - Insert a FAT formatted micro SD card into the Maple Native
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *     - Afterwards, LOG.CSV and DATA.BIN can be checked on a PC
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <Card/SecureDigital/HardwareSDIO.h>
+#include <Card/SecureDigital/BlockCache.h>
+#include <Card/FAT/FatFile.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CACHE_LINES  8
+#define LOG_LINES    1000
+#define STREAM_BYTES (256 * 1024)
+
+HardwareSDIO card;
+uint32 cacheLines[CACHE_LINES * BLOCK_DEVICE_WORDS];
+BlockCache cache(&card, cacheLines, CACHE_LINES);
+FatVolume volume;
+FatFile file;
+uint32 chunk[16 * BLOCK_DEVICE_WORDS]; // 8 KiB, word aligned
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+}
+
+void loop() {
+    card.begin();
+    check(volume.mount(&cache) == 0, "mount");
+    SerialUSB.print("FAT");
+    SerialUSB.println(volume.type);
+
+    // CSV log, written a line at a time through the cache
+    char line[40];
+    uint32 total = 0;
+    uint32 start = millis();
+    check(file.open(&volume, "log.csv",
+                    FAT_WRITE | FAT_CREATE | FAT_TRUNC) == 0, "create LOG.CSV");
+    for (uint32 i = 0; i < LOG_LINES; i++) {
+        uint32 len = sprintf(line, "%u,%u\n", (unsigned)i, (unsigned)(i * i));
+        total += file.write(line, len);
+    }
+    check(file.close() == 0, "close LOG.CSV");
+    SerialUSB.print("CSV ms: ");
+    SerialUSB.println(millis() - start);
+
+    check(file.open(&volume, "LOG.CSV", FAT_READ) == 0 && file.size == total,
+          "LOG.CSV size");
+    uint32 len = file.read(line, 12);
+    line[len] = '\0';
+    check(strcmp(line, "0,0\n1,1\n2,4\n") == 0, "LOG.CSV contents");
+    file.close();
+
+    // Binary stream, whole blocks straight from the user buffer
+    start = millis();
+    check(file.open(&volume, "data.bin",
+                    FAT_WRITE | FAT_CREATE | FAT_TRUNC) == 0,
+          "create DATA.BIN");
+    check(file.preallocate(STREAM_BYTES) == 0, "preallocate DATA.BIN");
+    for (uint32 n = 0; n < STREAM_BYTES / sizeof(chunk); n++) {
+        for (uint32 i = 0; i < sizeof(chunk) / sizeof(uint32); i++) {
+            chunk[i] = n * 0x10000 + i;
+        }
+        file.write(chunk, sizeof(chunk));
+    }
+    check(file.close() == 0, "close DATA.BIN");
+    SerialUSB.print("Stream KiB/s: ");
+    SerialUSB.println(STREAM_BYTES / (millis() - start + 1));
+
+    check(file.open(&volume, "DATA.BIN", FAT_READ) == 0 &&
+          file.size == STREAM_BYTES, "DATA.BIN size");
+    file.seek(3 * sizeof(chunk));
+    file.read(chunk, sizeof(chunk));
+    check(chunk[5] == 3 * 0x10000 + 5, "DATA.BIN contents");
+    file.close();
+
+    SerialUSB.print("Cache hit rate: ");
+    SerialUSB.print(cache.hitRate());
+    SerialUSB.println("%");
+    card.end();
+
+    SerialUSB.println();
+    SerialUSB.print("Test finished, failures: ");
+    SerialUSB.println(failures);
+    while (true)
+        ;
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
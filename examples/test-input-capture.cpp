@@ -0,0 +1,102 @@
+/*
+ * Input capture test.
+ *
+ * Generates a 1 kHz, 25% duty cycle PWM signal with timer 8 on pin 13,
+ * then measures it twice: with timer 4 in PWM input mode on pin 38,
+ * and from DMA captured rising edge timestamps with timer 5 on pin
+ * 48. Both results are printed twice a second; try changing the
+ * signal's period with the up and down keys ('+' and '-').
+ *
+ * To test:
+ *
+ *     - Connect pin 13 to pins 38 and 48
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define OUTPUT_PIN  13    // TIMER8_CH1
+#define PWM_PIN     38    // TIMER4_CH1
+#define EDGE_PIN    48    // TIMER5_CH1
+#define RING_SIZE   34    // averages 32 periods
+
+HardwareTimer generator(8);
+HardwareCapture pwm(4);
+HardwareCapture edges(5);
+uint16 ring[RING_SIZE];
+uint32 periodUs = 1000;
+
+void generate(void) {
+    generator.pause();
+    uint16 overflow = generator.setPeriod(periodUs);
+    generator.setCompare(TIMER_CH1, overflow / 4);
+    generator.refresh();
+    generator.resume();
+}
+
+void setup() {
+    pinMode(OUTPUT_PIN, PWM);
+    pinMode(PWM_PIN, INPUT);
+    pinMode(EDGE_PIN, INPUT);
+    while (!SerialUSB.available())
+        ;
+    SerialUSB.read();
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    generate();
+
+    // 1 kHz is 72,000 ticks at full speed; halve the tick rate so
+    // periods up to 1.8 ms fit in 16 bits.
+    pwm.setPrescaleFactor(2);
+    edges.setPrescaleFactor(2);
+    if (!pwm.beginPWM(1)) {
+        SerialUSB.println("FAIL: could not start PWM input");
+    }
+    if (!edges.beginEdges(1, ring, RING_SIZE)) {
+        SerialUSB.println("FAIL: could not start edge capture");
+    }
+}
+
+void loop() {
+    delay(500);
+    if (SerialUSB.available()) {
+        uint8 c = SerialUSB.read();
+        if (c == '+' && periodUs < 1800) {
+            periodUs += 100;
+        } else if (c == '-' && periodUs > 100) {
+            periodUs -= 100;
+        }
+        generate();
+    }
+
+    SerialUSB.print("period us: ");
+    SerialUSB.print(periodUs);
+    SerialUSB.print("\tPWM input: ");
+    SerialUSB.print(pwm.frequency(), 2);
+    SerialUSB.print(" Hz, duty ");
+    SerialUSB.print(pwm.duty() * 100, 1);
+    SerialUSB.print("%\tedges: ");
+    SerialUSB.print(edges.frequency(), 3);
+    SerialUSB.print(" Hz, ");
+    SerialUSB.print(edges.period());
+    SerialUSB.println(" ticks");
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * MultiServo test.
+ *
+ * Drives 16 servos on ordinary GPIO pins from timer 2, sweeping each
+ * back and forth with a different phase. Once a second, measures one
+ * servo's pulse width and frame period with pulseIn()-style polling
+ * on a loopback pin and prints them.
+ *
+ * To test:
+ *
+ *     - Connect servos (or a logic analyzer) to pins 0 through 15
+ *     - Connect pin 0 to pin 20 to measure the first servo's pulses
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <Servo/MultiServo.h>
+
+#define SERVOS      16
+#define MEASURE_PIN 20
+
+MultiServo servos[SERVOS];
+uint32 failures = 0;
+
+// Time the next high pulse on MEASURE_PIN, and the gap to the one after.
+void measure(uint32 *width, uint32 *period) {
+    while (digitalRead(MEASURE_PIN))
+        ;
+    while (!digitalRead(MEASURE_PIN))
+        ;
+    uint32 rise = micros();
+    while (digitalRead(MEASURE_PIN))
+        ;
+    *width = micros() - rise;
+    while (!digitalRead(MEASURE_PIN))
+        ;
+    *period = micros() - rise;
+}
+
+void setup() {
+    pinMode(MEASURE_PIN, INPUT);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    MultiServo::setTimer(2);
+    for (uint8 i = 0; i < SERVOS; i++) {
+        if (!servos[i].attach(i)) {
+            SerialUSB.print("FAIL: could not attach pin ");
+            SerialUSB.println(i);
+            failures++;
+        }
+    }
+}
+
+void loop() {
+    static uint32 phase = 0;
+    static uint32 lastReport = 0;
+
+    for (uint8 i = 0; i < SERVOS; i++) {
+        uint32 p = (phase + i * 20) % 360;
+        servos[i].write(p < 180 ? p : 360 - p);
+    }
+    phase++;
+    delay(20);
+
+    if (millis() - lastReport >= 1000) {
+        lastReport = millis();
+        servos[0].writeMicroseconds(1234);
+        delay(40);
+        uint32 width, period;
+        measure(&width, &period);
+        SerialUSB.print("servo 0 pulse (1234 us written): ");
+        SerialUSB.print(width);
+        SerialUSB.print(" us\tframe: ");
+        SerialUSB.print(period);
+        SerialUSB.print(" us\tattach failures: ");
+        SerialUSB.println(failures);
+    }
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * One pulse mode test.
+ *
+ * Timer 4 produces a 2 us pulse on pin 39 exactly 5 us after each
+ * rising edge on pin 38, with no CPU involvement. Pin 5 makes those
+ * edges, once a millisecond. Timer 8 also produces a 1 us pulse on
+ * pin 13, 10 us after each software trigger, and the test checks
+ * that it stops by itself after each pulse.
+ *
+ * To test:
+ *
+ *     - Connect pin 5 to pin 38
+ *     - Watch pins 5, 39 and 13 with an oscilloscope or logic analyzer
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define EDGE_OUT    5
+#define EDGE_IN     38  // timer 4 channel 1
+#define DELAYED_OUT 39  // timer 4 channel 2
+#define SOFT_OUT    13  // timer 8 channel 1
+
+HardwareTimer delayed(4);
+HardwareTimer soft(8);
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void setup() {
+    pinMode(EDGE_OUT, OUTPUT);
+    pinMode(EDGE_IN, INPUT);
+    pinMode(DELAYED_OUT, PWM);
+    pinMode(SOFT_OUT, PWM);
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    // Ticks of 1/72 us, so delays are exact to 14 ns.
+    soft.setPrescaleFactor(1);
+    soft.setOnePulse(TIMER_CH1, 10 * CYCLES_PER_MICROSECOND,
+                     1 * CYCLES_PER_MICROSECOND);
+    bool stopped = true;
+    for (uint32 i = 0; i < 100; i++) {
+        soft.triggerPulse();
+        delayMicroseconds(20);
+        if (soft.getCount() != 0 ||
+            ((soft.c_dev()->regs).gen->CR1 & TIMER_CR1_CEN)) {
+            stopped = false;
+        }
+    }
+    check(stopped, "software pulses stop by themselves");
+
+    delayed.setPrescaleFactor(1);
+    delayed.setMode(TIMER_CH1, TIMER_INPUT_CAPTURE);
+    delayed.setOnePulse(TIMER_CH2, 5 * CYCLES_PER_MICROSECOND,
+                        2 * CYCLES_PER_MICROSECOND);
+    delayed.setPulseTrigger(TIMER_SMCR_TS_TI1FP1);
+
+    SerialUSB.println();
+    SerialUSB.print("Self test finished, failures: ");
+    SerialUSB.println(failures);
+}
+
+void loop() {
+    // Interrupts only move these edges; the pulses on pin 39 follow
+    // each one by exactly 5 us anyway.
+    digitalWrite(EDGE_OUT, HIGH);
+    delayMicroseconds(100);
+    digitalWrite(EDGE_OUT, LOW);
+    delayMicroseconds(900);
+    soft.triggerPulse();
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * HardwareSDIO block read test.
+ *
+ * Initializes the card, reads block 0 with readBlock() and prints it
+ * with its boot signature, then reads the first blocks again as one
+ * CMD18 run with readBlocks() and checks both reads agree. Nothing is
+ * written to the card.
+ *
+ * To test:
+ *
+ *     - Plug a micro SD card into the Maple Native's slot
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key, once for each run of the test
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <Card/SecureDigital/HardwareSDIO.h>
+
+#define RUN_BLOCKS 8
+
+HardwareSDIO SDMC;
+uint32 blocks[RUN_BLOCKS * SDIO_BLOCK_WORDS];
+uint32 block[SDIO_BLOCK_WORDS];
+
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void dump(const uint32 *buf, uint32 bytes) {
+    const uint8 *data = (const uint8*)buf;
+    for (uint32 i = 0; i < bytes; i++) {
+        if (data[i] < 0x10) {
+            SerialUSB.print('0');
+        }
+        SerialUSB.print(data[i], HEX);
+        SerialUSB.print((i % 16 == 15) ? '\n' : ' ');
+    }
+}
+
+void setup() {
+    pinMode(BOARD_LED_PIN, OUTPUT);
+    digitalWrite(BOARD_LED_PIN, HIGH);
+}
+
+void loop() {
+    while (!SerialUSB.available())
+        ;
+    while (SerialUSB.available()) {
+        SerialUSB.read();
+    }
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+    failures = 0;
+
+    SDMC.begin();
+    SerialUSB.print(SDMC.CSD.capacity == SD_CAP_SDSC ? "SDSC" : "SDHC/SDXC");
+    SerialUSB.print(" card, bus ");
+    SerialUSB.print(SDMC.busWidth == SDIO_BUS_4BIT ? 4 : 1);
+    SerialUSB.print(" bit, CLKDIV ");
+    SerialUSB.println(SDMC.clkFreq);
+
+    check(SDMC.readBlock(0, block) == 0, "readBlock(0)");
+    dump(block, 64);
+    const uint8 *bytes = (const uint8*)block;
+    check(bytes[510] == 0x55 && bytes[511] == 0xAA,
+          "block 0 ends with the 0x55AA boot signature");
+
+    uint32 start = micros();
+    uint32 status = SDMC.readBlocks(0, RUN_BLOCKS, blocks);
+    uint32 elapsed = micros() - start;
+    check(status == 0, "readBlocks(0, RUN_BLOCKS)");
+    bool same = true;
+    for (uint32 i = 0; i < SDIO_BLOCK_WORDS; i++) {
+        same = same && (blocks[i] == block[i]);
+    }
+    check(same, "CMD18 returns the same block 0 as CMD17");
+    SerialUSB.print(RUN_BLOCKS);
+    SerialUSB.print(" blocks in ");
+    SerialUSB.print(elapsed);
+    SerialUSB.println(" us");
+
+    SDMC.end();
+    SerialUSB.println();
+    SerialUSB.print("Test finished, failures: ");
+    SerialUSB.println(failures);
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
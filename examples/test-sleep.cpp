@@ -0,0 +1,129 @@
+/*
+ * Tickless delay test.
+ *
+ * Checks that delay() and sleepUntil() wait for the right time,
+ * while a 10 kHz timer interrupt takes up about a third of the CPU,
+ * and that micros() never runs backwards inside that interrupt while
+ * the main program sleeps.
+ *
+ * To test:
+ *
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define LOAD_US 30
+
+HardwareTimer timer(2);
+volatile uint32 lastMicros = 0;
+volatile uint32 backwards = 0;
+volatile bool load = false;
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void loadHandler(void) {
+    uint32 now = micros();
+    if ((int32)(now - lastMicros) < 0) {
+        backwards++;
+    }
+    lastMicros = now;
+    if (load) {
+        delayMicroseconds(LOAD_US);
+    }
+}
+
+// Time a delay() of ms milliseconds, in microseconds.
+uint32 timeDelay(uint32 ms) {
+    uint32 start = micros();
+    delay(ms);
+    return micros() - start;
+}
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+    SerialUSB.read();
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    uint32 us = timeDelay(1000);
+    SerialUSB.print("delay(1000), idle: ");
+    SerialUSB.println(us);
+    check(us >= 1000000 && us < 1000100, "idle delay");
+
+    us = timeDelay(0);
+    check(us < 20, "delay(0) returns at once");
+
+    timer.pause();
+    timer.setPeriod(100);
+    timer.setMode(TIMER_CH1, TIMER_OUTPUT_COMPARE);
+    timer.setCompare(TIMER_CH1, 1);
+    timer.attachInterrupt(TIMER_CH1, loadHandler);
+    timer.refresh();
+    lastMicros = micros();
+    timer.resume();
+
+    // Idle apart from the timer: the SysTick period is stretched and
+    // shortened around every timer interrupt.
+    uint32 startMillis = millis();
+    us = timeDelay(1000);
+    SerialUSB.print("delay(1000), 10 kHz interrupts: ");
+    SerialUSB.println(us);
+    check(us >= 1000000 && us < 1000100, "delay under interrupts");
+    check(millis() - startMillis == us / 1000 ||
+          millis() - startMillis == us / 1000 + 1, "millis() agrees");
+
+    load = true;
+    us = timeDelay(1000);
+    load = false;
+    SerialUSB.print("delay(1000), 30% interrupt load: ");
+    SerialUSB.println(us);
+    check(us >= 1000000 && us < 1000100, "delay under interrupt load");
+
+    for (uint32 i = 0; i < 1000; i++) {
+        uint32 deadline = micros() + 7 + 13 * i;
+        sleepUntil(deadline);
+        if ((int32)(micros() - deadline) < 0) {
+            failures++;
+            SerialUSB.println("FAIL: sleepUntil() returned early");
+            break;
+        }
+    }
+    check(backwards == 0, "micros() monotonic in interrupts");
+
+    timer.pause();
+    timer.detachInterrupt(TIMER_CH1);
+
+    SerialUSB.println();
+    SerialUSB.print("Test finished, failures: ");
+    SerialUSB.println(failures);
+}
+
+void loop() {
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * ThreePhasePWM test.
+ *
+ * Drives timer 1's three complementary output pairs with 20 kHz
+ * center-aligned PWM and 500 ns of dead time, modulated by a 50 Hz
+ * three phase sine wave, as for a motor inverter. The break input
+ * stops all six outputs; sending any character afterwards restarts
+ * them.
+ *
+ * To test:
+ *
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *     - Look at PA8/PB13, PA9/PB14 and PA10/PB15 with an oscilloscope
+ *       or logic analyzer: each pair should be complementary, with a
+ *       gap of 500 ns between one output falling and the other rising
+ *     - Ground PB12 (BKIN): all six outputs should go low at once
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define PWM_HZ       20000
+#define DEAD_TIME_NS 500
+#define SINE_HZ      50
+#define STEPS        360
+#define STEP_US      (1000000 / (SINE_HZ * STEPS))
+
+ThreePhasePWM pwm(1);
+uint16 sine[STEPS];
+volatile uint32 breaks = 0;
+uint32 failures = 0;
+
+void check(bool ok, const char *what) {
+    SerialUSB.print(ok ? "PASS: " : "FAIL: ");
+    SerialUSB.println(what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void breakHandler(void) {
+    breaks++;
+}
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+    SerialUSB.read();
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    uint16 period = pwm.begin(PWM_HZ, DEAD_TIME_NS);
+    check(period == CYCLES_PER_MICROSECOND * 1000000 / PWM_HZ / 2,
+          "center-aligned period");
+    check(!pwm.enabled(), "outputs start off");
+
+    for (uint32 i = 0; i < STEPS; i++) {
+        sine[i] = (uint16)(period / 2 + (period / 2 - 1) *
+                           sin(2 * PI * i / STEPS));
+    }
+    pwm.write(sine[0], sine[STEPS / 3], sine[2 * STEPS / 3]);
+    pwm.setBreak(true);
+    pwm.attachBreakInterrupt(breakHandler);
+    pwm.enable();
+    check(pwm.enabled(), "outputs enabled");
+
+    SerialUSB.println();
+    SerialUSB.print("Self test finished, failures: ");
+    SerialUSB.println(failures);
+    SerialUSB.println();
+}
+
+void loop() {
+    static uint32 step = 0;
+    static uint32 seen = 0;
+    static uint32 next = micros();
+
+    while ((int32)(micros() - next) < 0)
+        ;
+    next += STEP_US;
+    step = step == STEPS - 1 ? 0 : step + 1;
+    pwm.write(sine[step],
+              sine[(step + STEPS / 3) % STEPS],
+              sine[(step + 2 * STEPS / 3) % STEPS]);
+
+    if (breaks != seen) {
+        seen = breaks;
+        SerialUSB.print("Break! outputs enabled: ");
+        SerialUSB.println(pwm.enabled() ? "yes (FAIL)" : "no");
+    }
+    if (SerialUSB.available()) {
+        SerialUSB.read();
+        pwm.enable();
+        SerialUSB.println(pwm.enabled() ? "Restarted." :
+                                          "Break input still active.");
+    }
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
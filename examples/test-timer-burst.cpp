@@ -0,0 +1,90 @@
+/*
+ * Timer DMA burst test.
+ *
+ * Drives three PWM channels of timer 8 (pins 13, 14 and 15) with
+ * three-phase sine modulation. A table of 64 frames holds the next
+ * compare values of channels 1 to 4, and on each update event a DMA
+ * burst writes one frame into CCR1..CCR4, so the waveform plays with
+ * no CPU involvement at all. The repetition counter makes each frame
+ * last ten 20 kHz PWM periods, for a 31.25 Hz sine.
+ *
+ * Channel 4 (pin 16) gets a slow triangle, as a dimming curve for an
+ * LED.
+ *
+ * To test:
+ *
+ *     - Low-pass filter pins 13, 14 and 15 (e.g. 10 kohm and 100 nF)
+ *       and watch them on an oscilloscope
+ *     - Connect an LED and resistor to pin 16
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define FRAMES      64
+#define CHANNELS    4
+#define PWM_US      50    // 20 kHz
+#define REPEAT      10    // PWM periods per frame
+
+HardwareTimer timer(8);
+uint16 table[FRAMES * CHANNELS];
+
+void setup() {
+    for (uint8 pin = 13; pin <= 16; pin++) {
+        pinMode(pin, PWM);
+    }
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    timer.pause();
+    uint16 overflow = timer.setPeriod(PWM_US);
+    for (uint32 f = 0; f < FRAMES; f++) {
+        for (uint32 phase = 0; phase < 3; phase++) {
+            double angle = 2 * PI * (f / (double)FRAMES + phase / 3.0);
+            table[f * CHANNELS + phase] =
+                (uint16)(overflow * (0.5 + 0.45 * sin(angle)));
+        }
+        uint32 ramp = f < FRAMES / 2 ? f : FRAMES - f;
+        table[f * CHANNELS + 3] = overflow * ramp / (FRAMES / 2);
+    }
+    (timer.c_dev()->regs).adv->RCR = REPEAT - 1;
+    timer.refresh();
+
+    if (!timer_dma_burst_start(timer.c_dev(), TIMER_DMA_BASE_CCR1, CHANNELS,
+                               table, FRAMES, 0)) {
+        SerialUSB.println("FAIL: could not start the DMA burst");
+        return;
+    }
+    timer.resume();
+    SerialUSB.println("Playing; the CPU is idle from now on.");
+}
+
+void loop() {
+    delay(1000);
+    SerialUSB.print("CCR1..4: ");
+    for (int ch = TIMER_CH1; ch <= TIMER_CH4; ch++) {
+        SerialUSB.print(timer.getCompare(ch));
+        SerialUSB.print(" ");
+    }
+    SerialUSB.println();
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
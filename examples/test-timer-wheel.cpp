@@ -0,0 +1,99 @@
+/*
+ * TimerWheel test.
+ *
+ * Runs 100 Tickers with periods from 1 to 100 ms and a chain of
+ * Timeouts, all on one hardware timer, and once a second prints how
+ * many calls each group made against the expected number, and the
+ * worst lateness seen by the Timeout chain.
+ *
+ * To test:
+ *
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#define TICKERS     100
+#define CHAIN_US    2500
+
+Ticker tickers[TICKERS];
+volatile uint32 ticks = 0;
+Timeout chain;
+volatile uint32 chainDue;
+volatile uint32 chainCalls = 0;
+volatile uint32 worstLate = 0;
+
+void tick(void) {
+    ticks++;
+}
+
+void chainStep(void) {
+    uint32 late = Timers.micros() - chainDue;
+    if (late > worstLate) {
+        worstLate = late;
+    }
+    chainCalls++;
+    // A different delay each time, so the chain visits every level.
+    uint32 us = CHAIN_US + (chainCalls % 7) * 1000;
+    chainDue += us;
+    chain.attach(chainStep, chainDue - Timers.micros());
+}
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    Timers.begin(4);
+    for (uint32 i = 0; i < TICKERS; i++) {
+        tickers[i].attach(tick, (i + 1) * 1000);
+    }
+    chainDue = Timers.micros() + CHAIN_US;
+    chain.attach(chainStep, CHAIN_US);
+}
+
+void loop() {
+    static uint32 expected = 0;
+    delay(1000);
+
+    // Calls per second from periods of 1, 2, ... 100 ms
+    if (expected == 0) {
+        for (uint32 i = 1; i <= TICKERS; i++) {
+            expected += 1000 / i;
+        }
+    }
+    noInterrupts();
+    uint32 n = ticks;
+    uint32 c = chainCalls;
+    uint32 late = worstLate;
+    ticks = chainCalls = worstLate = 0;
+    interrupts();
+
+    SerialUSB.print("ticker calls: ");
+    SerialUSB.print(n);
+    SerialUSB.print(" (about ");
+    SerialUSB.print(expected);
+    SerialUSB.print(")\ttimeout calls: ");
+    SerialUSB.print(c);
+    SerialUSB.print("\tworst lateness (us): ");
+    SerialUSB.println(late);
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
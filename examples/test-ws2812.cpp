@@ -0,0 +1,104 @@
+/*
+ * WS2812 test.
+ *
+ * Runs a rainbow along a strip of 300 WS2812 LEDs. The strip is
+ * refreshed by timer PWM and DMA from a 384 byte buffer, so the CPU
+ * is nearly idle during each 9 ms refresh; the time spent in show()
+ * and the number of loop iterations run while the strip was busy are
+ * printed once a second.
+ *
+ * To test:
+ *
+ *     - Connect the strip's data input to pin 13, and power it from
+ *       a separate 5V supply sharing ground with the Maple
+ *     - Connect a serial monitor to SerialUSB
+ *     - Press any key
+ *
+ * This file is released into the public domain.
+ */
+
+#include <wirish/wirish.h>
+
+#include <WS2812/WS2812.h>
+
+#define STRIP_PIN  13    // timer 8 channel 1
+#define PIXELS     300
+
+uint8 pixels[3 * PIXELS];
+WS2812 strip(STRIP_PIN, pixels, PIXELS);
+uint8 hue = 0;
+uint32 frames = 0;
+uint32 idleLoops = 0;
+uint32 showUs = 0;
+uint32 lastReport = 0;
+
+// Map 0..255 onto a colour wheel, at quarter brightness.
+void wheel(uint16 index, uint8 pos) {
+    uint8 third = pos % 85;
+    uint8 up = third, down = 84 - third;
+    switch (pos / 85) {
+    case 0:
+        strip.setPixel(index, down, up, 0);
+        break;
+    case 1:
+        strip.setPixel(index, 0, down, up);
+        break;
+    default:
+        strip.setPixel(index, up, 0, down);
+        break;
+    }
+}
+
+void setup() {
+    while (!SerialUSB.available())
+        ;
+
+    SerialUSB.println("Beginning test.");
+    SerialUSB.println();
+
+    if (!strip.begin()) {
+        SerialUSB.println("FAIL: could not start the strip");
+        while (true)
+            ;
+    }
+}
+
+void loop() {
+    while (strip.busy()) {
+        idleLoops++;
+    }
+    for (uint16 i = 0; i < PIXELS; i++) {
+        wheel(i, (uint8)(hue + i));
+    }
+    hue++;
+
+    uint32 start = micros();
+    strip.show();
+    showUs += micros() - start;
+    frames++;
+
+    if (millis() - lastReport >= 1000) {
+        lastReport = millis();
+        SerialUSB.print("frames: ");
+        SerialUSB.print(frames);
+        SerialUSB.print("\tus in show(): ");
+        SerialUSB.print(showUs / frames);
+        SerialUSB.print("\tidle loops: ");
+        SerialUSB.println(idleLoops);
+        frames = showUs = idleLoops = 0;
+    }
+}
+
+// Force init to be called *first*, i.e. before static object allocation.
+// Otherwise, statically allocated objects that need libmaple may fail.
+__attribute__((constructor)) void premain() {
+    init();
+}
+
+int main(void) {
+    setup();
+    while (true) {
+        loop();
+    }
+    return 0;
+}
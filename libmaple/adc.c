@@ -59,7 +59,11 @@ void adc_set_extsel(const adc_dev *dev, adc_extsel_event event) {
     uint32 cr2 = dev->regs->CR2;
     cr2 &= ~ADC_CR2_EXTSEL;
     cr2 |= event;
-    dev->regs->CR2 = cr2;
+    /* On STM32F1, rewriting CR2 unchanged while the ADC is on starts
+     * a conversion. */
+    if (cr2 != dev->regs->CR2) {
+        dev->regs->CR2 = cr2;
+    }
 }
 
 /**
@@ -88,6 +92,34 @@ void adc_set_sample_rate(const adc_dev *dev, adc_smp_rate smp_rate) {
     dev->regs->SMPR2 = adc_smpr2_val;
 }
 
+/**
+ * @brief Set the sample rate of a single ADC channel.
+ *
+ * Other channels keep their sample rates. Don't call this during
+ * conversion.
+ *
+ * @param dev adc device
+ * @param channel channel to configure
+ * @param smp_rate sample rate to set
+ * @see adc_set_sample_rate()
+ */
+void adc_set_channel_sample_rate(const adc_dev *dev, uint8 channel,
+                                 adc_smp_rate smp_rate) {
+    __io uint32 *smpr;
+    uint32 shift;
+
+    if (channel < 10) {
+        /* ADC_SMPR2 determines sample time for channels [0,9] */
+        smpr = &dev->regs->SMPR2;
+        shift = channel * 3;
+    } else {
+        /* ADC_SMPR1 determines sample time for the rest */
+        smpr = &dev->regs->SMPR1;
+        shift = (channel - 10) * 3;
+    }
+    *smpr = (*smpr & ~(0x7 << shift)) | ((uint32)smp_rate << shift);
+}
+
 /**
  * @brief Perform a single synchronous software triggered conversion on a
  *        channel.
@@ -107,3 +139,155 @@ uint16 adc_read(const adc_dev *dev, uint8 channel) {
 
     return (uint16)(regs->DR & ADC_DR_DATA);
 }
+
+/**
+ * @brief Set the regular channel sequence.
+ *
+ * Programs the channels to convert, in order, into the regular
+ * sequence registers and sets the sequence length. Use with scan
+ * mode to convert several channels per trigger.
+ *
+ * Don't call this during conversion.
+ *
+ * @param dev ADC device
+ * @param channels channels to convert, in conversion order
+ * @param length number of channels, from 1 to 16
+ * @see adc_set_scan()
+ */
+void adc_set_reg_sequence(const adc_dev *dev, const uint8 *channels,
+                          uint8 length) {
+    uint32 sqr[3] = {0, 0, 0}; /* SQR3, SQR2, SQR1 */
+    uint8 i;
+
+    ASSERT(length >= 1 && length <= 16);
+    for (i = 0; i < length; i++) {
+        sqr[i / 6] |= (uint32)(channels[i] & 0x1F) << ((i % 6) * 5);
+    }
+
+    dev->regs->SQR3 = sqr[0];
+    dev->regs->SQR2 = sqr[1];
+    dev->regs->SQR1 = sqr[2] | ((uint32)(length - 1) << 20);
+}
+
+/**
+ * @brief Set the injected channel sequence.
+ *
+ * Injected conversions run when their own trigger fires, suspending
+ * any regular conversion in progress, which resumes afterwards. The
+ * result of the nth channel is available from adc_get_inj_data(dev, n)
+ * once the injected sequence ends. Use scan mode to convert more than
+ * one channel per trigger.
+ *
+ * Don't call this during conversion.
+ *
+ * @param dev ADC device
+ * @param channels channels to convert, in conversion order
+ * @param length number of channels, from 1 to 4
+ * @see adc_set_scan()
+ * @see adc_get_inj_data()
+ */
+void adc_set_inj_sequence(const adc_dev *dev, const uint8 *channels,
+                          uint8 length) {
+    uint32 jsqr = (uint32)(length - 1) << 20;
+    uint8 i;
+
+    ASSERT(length >= 1 && length <= 4);
+    /* A sequence shorter than 4 occupies the last JSQx fields. */
+    for (i = 0; i < length; i++) {
+        jsqr |= (uint32)(channels[i] & 0x1F) << ((4 - length + i) * 5);
+    }
+    dev->regs->JSQR = jsqr;
+}
+
+/* Interrupt enable bits in CR1, by adc_interrupt_id. */
+static const uint8 adc_irq_enable_bits[ADC_NR_INTERRUPTS] = {
+    ADC_CR1_EOCIE_BIT,
+    ADC_CR1_JEOCIE_BIT,
+    ADC_CR1_AWDIE_BIT,
+};
+
+/**
+ * @brief Attach an ADC interrupt handler.
+ *
+ * The interrupt's status flag is cleared before the handler is
+ * called. For ADC_EOC_INTERRUPT, the handler must read the regular
+ * data register.
+ *
+ * ADC_AWD_INTERRUPT fires again for every watched conversion outside
+ * the thresholds. When conversions are fast, a handler which only
+ * needs the first crossing should detach itself (or move the
+ * thresholds) to avoid an interrupt storm.
+ *
+ * @param dev ADC device
+ * @param interrupt Interrupt to handle
+ * @param handler Handler to call when the interrupt fires
+ * @see adc_interrupt_id
+ */
+void adc_attach_interrupt(const adc_dev *dev, adc_interrupt_id interrupt,
+                          voidFuncPtr handler) {
+    dev->handlers[interrupt] = handler;
+    *bb_perip(&dev->regs->CR1, adc_irq_enable_bits[interrupt]) = 1;
+    nvic_irq_enable(dev->irq_num);
+}
+
+/**
+ * @brief Detach an ADC interrupt handler.
+ *
+ * The interrupt is disabled. The NVIC line stays enabled, since it
+ * may be shared with another ADC.
+ *
+ * @param dev ADC device
+ * @param interrupt Interrupt to stop handling
+ */
+void adc_detach_interrupt(const adc_dev *dev, adc_interrupt_id interrupt) {
+    *bb_perip(&dev->regs->CR1, adc_irq_enable_bits[interrupt]) = 0;
+    dev->handlers[interrupt] = NULL;
+}
+
+#define ADC_CR1_AWD_MASK (ADC_CR1_AWDEN | ADC_CR1_JAWDEN | \
+                          ADC_CR1_AWDSGL | ADC_CR1_AWDCH)
+
+/**
+ * @brief Watch all channels with the analog watchdog.
+ *
+ * The watchdog checks each conversion of the selected groups in
+ * hardware, as it completes, so it works with single, continuous and
+ * scan conversions alike. Use adc_attach_interrupt() with
+ * ADC_AWD_INTERRUPT to be told about conversions outside the
+ * thresholds.
+ *
+ * @param dev ADC device
+ * @param groups Conversion groups to watch: ADC_CR1_AWDEN (regular),
+ *               ADC_CR1_JAWDEN (injected), or both.
+ * @see adc_awd_set_thresholds()
+ */
+void adc_awd_enable(const adc_dev *dev, uint32 groups) {
+    uint32 cr1 = dev->regs->CR1;
+    cr1 &= ~ADC_CR1_AWD_MASK;
+    cr1 |= groups & (ADC_CR1_AWDEN | ADC_CR1_JAWDEN);
+    dev->regs->CR1 = cr1;
+}
+
+/**
+ * @brief Watch a single channel with the analog watchdog.
+ * @param dev ADC device
+ * @param channel Channel to watch
+ * @param groups Conversion groups to watch, as for adc_awd_enable().
+ * @see adc_awd_enable()
+ */
+void adc_awd_enable_channel(const adc_dev *dev, uint8 channel,
+                            uint32 groups) {
+    uint32 cr1 = dev->regs->CR1;
+    cr1 &= ~ADC_CR1_AWD_MASK;
+    cr1 |= groups & (ADC_CR1_AWDEN | ADC_CR1_JAWDEN);
+    cr1 |= ADC_CR1_AWDSGL | (channel & ADC_CR1_AWDCH);
+    dev->regs->CR1 = cr1;
+}
+
+/**
+ * @brief Stop the analog watchdog.
+ * @param dev ADC device
+ */
+void adc_awd_disable(const adc_dev *dev) {
+    dev->regs->CR1 &= ~ADC_CR1_AWD_MASK;
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _LIBMAPLE_ADC_PRIVATE_H_
+#define _LIBMAPLE_ADC_PRIVATE_H_
+
+#include <libmaple/adc.h>
+#include <libmaple/libmaple_types.h>
+
+/*
+ * IRQ handling
+ */
+
+static __always_inline void adc_handle_irq(const adc_dev *dev, uint32 sr,
+                                           uint32 flag, uint32 enable,
+                                           adc_interrupt_id interrupt) {
+    if ((sr & flag) && (dev->regs->CR1 & enable)) {
+        void (*handler)(void) = dev->handlers[interrupt];
+        /* Status bits are cleared by writing 0; 1s are ignored. */
+        dev->regs->SR = ~flag;
+        if (handler) {
+            handler();
+        }
+    }
+}
+
+/* Call this from the series ADC IRQ handlers, once per ADC sharing
+ * the IRQ line. */
+static __always_inline void adc_irq_handler(const adc_dev *dev) {
+    uint32 sr = dev->regs->SR;
+    adc_handle_irq(dev, sr, ADC_SR_JEOC, ADC_CR1_JEOCIE, ADC_JEOC_INTERRUPT);
+    adc_handle_irq(dev, sr, ADC_SR_EOC, ADC_CR1_EOCIE, ADC_EOC_INTERRUPT);
+    adc_handle_irq(dev, sr, ADC_SR_AWD, ADC_CR1_AWDIE, ADC_AWD_INTERRUPT);
+}
+
+#endif
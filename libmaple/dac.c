@@ -103,6 +103,59 @@ void dac_enable_channel(const dac_dev *dev, uint8 channel) {
     }
 }
 
+/*
+ * Channel 2's CR bits are channel 1's, shifted left by this amount.
+ */
+#define DAC_CR_CH2_SHIFT 16
+
+/**
+ * @brief Set a DAC channel's conversion trigger
+ * @param dev DAC device
+ * @param channel channel to configure, either 1 or 2
+ * @param trigger trigger event
+ * @see dac_trigger
+ */
+void dac_set_trigger(const dac_dev *dev, uint8 channel, dac_trigger trigger) {
+    uint32 shift = channel == 2 ? DAC_CR_CH2_SHIFT : 0;
+    uint32 cr = dev->regs->CR;
+    cr &= ~((DAC_CR_TSEL1 | DAC_CR_TEN1) << shift);
+    cr |= (((uint32)trigger << 3) | DAC_CR_TEN1) << shift;
+    dev->regs->CR = cr;
+}
+
+/**
+ * @brief Disable a DAC channel's conversion trigger
+ *
+ * Values written to the channel's data holding register reach the
+ * output immediately again.
+ *
+ * @param dev DAC device
+ * @param channel channel to configure, either 1 or 2
+ */
+void dac_disable_trigger(const dac_dev *dev, uint8 channel) {
+    uint32 shift = channel == 2 ? DAC_CR_CH2_SHIFT : 0;
+    dev->regs->CR &= ~((DAC_CR_TSEL1 | DAC_CR_TEN1) << shift);
+}
+
+/**
+ * @brief Enable or disable a DAC channel's DMA requests
+ *
+ * When enabled, the channel requests a DMA transfer on each trigger
+ * event, to refill its data holding register.
+ *
+ * @param dev DAC device
+ * @param channel channel to configure, either 1 or 2
+ * @param enable If 0, disable DMA requests; otherwise, enable them.
+ */
+void dac_set_dma(const dac_dev *dev, uint8 channel, uint8 enable) {
+    uint32 bit = DAC_CR_DMAEN1 << (channel == 2 ? DAC_CR_CH2_SHIFT : 0);
+    if (enable) {
+        dev->regs->CR |= bit;
+    } else {
+        dev->regs->CR &= ~bit;
+    }
+}
+
 /**
  * @brief Disable a DAC channel
  * @param dev DAC device
@@ -42,6 +42,7 @@ extern "C"{
 #include <libmaple/libmaple.h>
 #include <libmaple/bitband.h>
 #include <libmaple/rcc.h>
+#include <libmaple/nvic.h>
 /* We include the series header below, after defining the register map
  * and device structs. */
 
@@ -73,10 +74,28 @@ typedef struct adc_reg_map {
     __io uint32 DR;             ///< Regular data register
 } adc_reg_map;
 
+/**
+ * @brief ADC interrupt type.
+ * @see adc_attach_interrupt()
+ */
+typedef enum adc_interrupt_id {
+    ADC_EOC_INTERRUPT,          /**< End of regular conversion */
+    ADC_JEOC_INTERRUPT,         /**< End of injected conversion */
+    ADC_AWD_INTERRUPT,          /**< Analog watchdog */
+} adc_interrupt_id;
+
+/** Number of ADC interrupt types. */
+#define ADC_NR_INTERRUPTS 3
+
 /** ADC device type. */
 typedef struct adc_dev {
-    adc_reg_map *regs; /**< Register map */
-    rcc_clk_id clk_id; /**< RCC clock information */
+    adc_reg_map *regs;     /**< Register map */
+    rcc_clk_id clk_id;     /**< RCC clock information */
+    nvic_irq_num irq_num;  /**< NVIC interrupt number */
+    voidFuncPtr *handlers; /**<
+                            * Don't touch these. Use these instead:
+                            * @see adc_attach_interrupt()
+                            * @see adc_detach_interrupt() */
 } adc_dev;
 
 /* Pull in the series header (which may need the above struct
@@ -101,6 +120,10 @@ typedef struct adc_dev {
  *   prescaler dividers (e.g. STM32F1 and STM32F2 both divide PCLK2 by
  *   2, 4, 6, or 8) must provide the same tokens as enumerators, for
  *   portability.
+ *
+ * Series which support ADC interrupts must give each adc_dev an
+ * irq_num and an array of ADC_NR_INTERRUPTS handlers, and dispatch
+ * their ADC IRQs with adc_irq_handler() (see adc_private.h).
  */
 #include <series/adc.h>
 
@@ -180,15 +203,15 @@ typedef struct adc_dev {
 
 /* Injected channel data offset register */
 
-#define ADC_JOFR_JOFFSET                0x3FF
+#define ADC_JOFR_JOFFSET                0xFFF
 
 /* Watchdog high threshold register */
 
-#define ADC_HTR_HT                      0x3FF
+#define ADC_HTR_HT                      0xFFF
 
 /* Watchdog low threshold register */
 
-#define ADC_LTR_LT                      0x3FF
+#define ADC_LTR_LT                      0xFFF
 
 /* Regular sequence register 1 */
 
@@ -244,7 +267,19 @@ typedef struct adc_dev {
 void adc_init(const adc_dev *dev);
 void adc_set_extsel(const adc_dev *dev, adc_extsel_event event);
 void adc_set_sample_rate(const adc_dev *dev, adc_smp_rate smp_rate);
+void adc_set_channel_sample_rate(const adc_dev *dev, uint8 channel,
+                                 adc_smp_rate smp_rate);
 uint16 adc_read(const adc_dev *dev, uint8 channel);
+void adc_set_reg_sequence(const adc_dev *dev, const uint8 *channels,
+                          uint8 length);
+void adc_set_inj_sequence(const adc_dev *dev, const uint8 *channels,
+                          uint8 length);
+void adc_attach_interrupt(const adc_dev *dev, adc_interrupt_id interrupt,
+                          voidFuncPtr handler);
+void adc_detach_interrupt(const adc_dev *dev, adc_interrupt_id interrupt);
+void adc_awd_enable(const adc_dev *dev, uint32 groups);
+void adc_awd_enable_channel(const adc_dev *dev, uint8 channel, uint32 groups);
+void adc_awd_disable(const adc_dev *dev);
 
 /**
  * @brief Set the ADC prescaler.
@@ -299,6 +334,50 @@ static inline void adc_set_reg_seqlen(const adc_dev *dev, uint8 length) {
     dev->regs->SQR1 = tmp;
 }
 
+/**
+ * @brief Enable or disable scan mode.
+ *
+ * In scan mode, each trigger converts the whole regular sequence set
+ * up with adc_set_reg_sequence() (or injected sequence set up with
+ * adc_set_inj_sequence()), instead of only its first channel.
+ *
+ * @param dev ADC device.
+ * @param enable If 1, scan mode is enabled; if 0, disabled.
+ * @see adc_set_reg_sequence()
+ * @see adc_set_inj_sequence()
+ */
+static inline void adc_set_scan(const adc_dev *dev, uint8 enable) {
+    *bb_perip(&dev->regs->CR1, ADC_CR1_SCAN_BIT) = !!enable;
+}
+
+/**
+ * @brief Set the analog watchdog thresholds.
+ *
+ * The watchdog flags any watched conversion whose result is below
+ * low or above high. Don't call this during conversion.
+ *
+ * @param dev ADC device.
+ * @param low Low threshold, from 0 to 4095.
+ * @param high High threshold, from 0 to 4095.
+ * @see adc_awd_enable()
+ */
+static inline void adc_awd_set_thresholds(const adc_dev *dev, uint16 low,
+                                          uint16 high) {
+    dev->regs->LTR = low & ADC_LTR_LT;
+    dev->regs->HTR = high & ADC_HTR_HT;
+}
+
+/**
+ * @brief Get the result of an injected conversion.
+ * @param dev ADC device.
+ * @param rank Position of the conversion in the injected sequence,
+ *             from 1 to 4.
+ * @see adc_set_inj_sequence()
+ */
+static inline uint16 adc_get_inj_data(const adc_dev *dev, uint8 rank) {
+    return (uint16)((&dev->regs->JDR1)[rank - 1] & ADC_JDR_JDATA);
+}
+
 /**
  * @brief Enable an adc peripheral
  * @param dev ADC device to enable
@@ -151,6 +151,30 @@ void dac_write_channel(const dac_dev *dev, uint8 channel, uint16 val);
 void dac_enable_channel(const dac_dev *dev, uint8 channel);
 void dac_disable_channel(const dac_dev *dev, uint8 channel);
 
+/**
+ * @brief DAC conversion trigger.
+ *
+ * With a trigger enabled, a value written to a channel's data holding
+ * register only reaches the output on the next trigger event.
+ *
+ * @see dac_set_trigger()
+ */
+typedef enum dac_trigger {
+    DAC_TRIG_TIM6_TRGO = 0,     /**< Timer 6 TRGO */
+    DAC_TRIG_TIM8_TRGO = 1,     /**< Timer 8 TRGO (timer 3 TRGO on
+                                     connectivity line devices) */
+    DAC_TRIG_TIM7_TRGO = 2,     /**< Timer 7 TRGO */
+    DAC_TRIG_TIM5_TRGO = 3,     /**< Timer 5 TRGO */
+    DAC_TRIG_TIM2_TRGO = 4,     /**< Timer 2 TRGO */
+    DAC_TRIG_TIM4_TRGO = 5,     /**< Timer 4 TRGO */
+    DAC_TRIG_EXTI9     = 6,     /**< EXTI line 9 */
+    DAC_TRIG_SWTRIG    = 7,     /**< Software trigger (SWTRIGR) */
+} dac_trigger;
+
+void dac_set_trigger(const dac_dev *dev, uint8 channel, dac_trigger trigger);
+void dac_disable_trigger(const dac_dev *dev, uint8 channel);
+void dac_set_dma(const dac_dev *dev, uint8 channel, uint8 enable);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
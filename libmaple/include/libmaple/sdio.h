@@ -324,6 +324,7 @@ typedef struct sdio_dev {
     sdio_reg_map *regs;         /**< Register map */
     rcc_clk_id clk_id;          /**< RCC clock information */
     nvic_irq_num irq_num;       /**< NVIC interrupt number */
+    voidFuncPtr handler;        /**< User IRQ handler */
 } sdio_dev;
 
 #ifdef STM32_HIGH_DENSITY
@@ -369,7 +370,10 @@ uint32 sdio_is_data_available(void);
 uint32 sdio_check_status(uint32 mask);
 void sdio_clear_interrupt(uint32 flag);
 void sdio_add_interrupt(uint32 mask);
+void sdio_remove_interrupt(uint32 mask);
 void sdio_enable_interrupt(uint32 mask);
+void sdio_attach_interrupt(voidFuncPtr handler);
+void sdio_detach_interrupt(void);
 
 #ifdef __cplusplus
 }
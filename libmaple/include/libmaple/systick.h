@@ -73,6 +73,9 @@ typedef struct systick_reg_map {
 #define SYSTICK_CVR_SKEW                BIT(30)
 #define SYSTICK_CVR_TENMS               0xFFFFFF
 
+/** Longest sleep systick_sleep() can manage, in core clock cycles */
+#define SYSTICK_MAX_SLEEP               0x1000000
+
 /** System elapsed time, in milliseconds */
 extern volatile uint32 systick_uptime_millis;
 
@@ -87,6 +90,7 @@ static inline uint32 systick_uptime(void) {
 void systick_init(uint32 reload_val);
 void systick_disable();
 void systick_enable();
+void systick_sleep(uint32 cycles);
 
 /**
  * @brief Returns the current value of the SysTick counter.
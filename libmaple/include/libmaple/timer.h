@@ -254,7 +254,7 @@ extern timer_dev *TIMER14;
 #define TIMER_SMCR_ETPS_DIV8            (0x3 << 12)
 #define TIMER_SMCR_ETF                  (0xF << 12)
 #define TIMER_SMCR_MSM                  (1U << TIMER_SMCR_MSM_BIT)
-#define TIMER_SMCR_TS                   (0x3 << 4)
+#define TIMER_SMCR_TS                   (0x7 << 4)
 #define TIMER_SMCR_TS_ITR0              (0x0 << 4)
 #define TIMER_SMCR_TS_ITR1              (0x1 << 4)
 #define TIMER_SMCR_TS_ITR2              (0x2 << 4)
@@ -263,7 +263,7 @@ extern timer_dev *TIMER14;
 #define TIMER_SMCR_TS_TI1FP1            (0x5 << 4)
 #define TIMER_SMCR_TS_TI2FP2            (0x6 << 4)
 #define TIMER_SMCR_TS_ETRF              (0x7 << 4)
-#define TIMER_SMCR_SMS                  0x3
+#define TIMER_SMCR_SMS                  0x7
 #define TIMER_SMCR_SMS_DISABLED         0x0
 #define TIMER_SMCR_SMS_ENCODER1         0x1
 #define TIMER_SMCR_SMS_ENCODER2         0x2
@@ -372,7 +372,7 @@ extern timer_dev *TIMER14;
 #define TIMER_CCMR1_OC1FE_BIT           2
 
 #define TIMER_CCMR1_OC2CE               (1U << TIMER_CCMR1_OC2CE_BIT)
-#define TIMER_CCMR1_OC2M                (0x3 << 12)
+#define TIMER_CCMR1_OC2M                (0x7 << 12)
 #define TIMER_CCMR1_IC2F                (0xF << 12)
 #define TIMER_CCMR1_OC2PE               (1U << TIMER_CCMR1_OC2PE_BIT)
 #define TIMER_CCMR1_OC2FE               (1U << TIMER_CCMR1_OC2FE_BIT)
@@ -383,7 +383,7 @@ extern timer_dev *TIMER14;
 #define TIMER_CCMR1_CC2S_INPUT_TI2      (TIMER_CCMR_CCS_INPUT_TI2 << 8)
 #define TIMER_CCMR1_CC2S_INPUT_TRC      (TIMER_CCMR_CCS_INPUT_TRC << 8)
 #define TIMER_CCMR1_OC1CE               (1U << TIMER_CCMR1_OC1CE_BIT)
-#define TIMER_CCMR1_OC1M                (0x3 << 4)
+#define TIMER_CCMR1_OC1M                (0x7 << 4)
 #define TIMER_CCMR1_IC1F                (0xF << 4)
 #define TIMER_CCMR1_OC1PE               (1U << TIMER_CCMR1_OC1PE_BIT)
 #define TIMER_CCMR1_OC1FE               (1U << TIMER_CCMR1_OC1FE_BIT)
@@ -404,7 +404,7 @@ extern timer_dev *TIMER14;
 #define TIMER_CCMR2_OC3FE_BIT           2
 
 #define TIMER_CCMR2_OC4CE               (1U << TIMER_CCMR2_OC4CE_BIT)
-#define TIMER_CCMR2_OC4M                (0x3 << 12)
+#define TIMER_CCMR2_OC4M                (0x7 << 12)
 #define TIMER_CCMR2_IC4F                (0xF << 12)
 #define TIMER_CCMR2_OC4PE               (1U << TIMER_CCMR2_OC4PE_BIT)
 #define TIMER_CCMR2_OC4FE               (1U << TIMER_CCMR2_OC4FE_BIT)
@@ -415,7 +415,7 @@ extern timer_dev *TIMER14;
 #define TIMER_CCMR2_CC4S_INPUT_TI2      (TIMER_CCMR_CCS_INPUT_TI2 << 8)
 #define TIMER_CCMR2_CC4S_INPUT_TRC      (TIMER_CCMR_CCS_INPUT_TRC << 8)
 #define TIMER_CCMR2_OC3CE               (1U << TIMER_CCMR2_OC3CE_BIT)
-#define TIMER_CCMR2_OC3M                (0x3 << 4)
+#define TIMER_CCMR2_OC3M                (0x7 << 4)
 #define TIMER_CCMR2_IC3F                (0xF << 4)
 #define TIMER_CCMR2_OC3PE               (1U << TIMER_CCMR2_OC3PE_BIT)
 #define TIMER_CCMR2_OC3FE               (1U << TIMER_CCMR2_OC3FE_BIT)
@@ -549,11 +549,29 @@ typedef enum timer_mode {
      * values, the corresponding interrupt is fired. */
     TIMER_OUTPUT_COMPARE,
 
-    /* TIMER_INPUT_CAPTURE, TODO: In this mode, the timer can measure the
-     *                            pulse lengths of input signals */
-    /* TIMER_ONE_PULSE, TODO: In this mode, the timer can generate a single
-     *                        pulse on a GPIO pin for a specified amount of
-     *                        time. */
+    /**
+     * The channel's input pin is sampled, and on each rising edge the
+     * counter value is latched into the channel's capture/compare
+     * register, and the corresponding interrupt is fired. Use
+     * timer_cc_set_pol() to capture falling edges instead. */
+    TIMER_INPUT_CAPTURE,
+
+    /**
+     * Channels 1 and 2 are the two inputs of a quadrature encoder,
+     * which counts the timer up or down on each edge of either input.
+     * Setting this mode on either channel makes that channel an
+     * encoder input; use timer_set_encoder() to configure both at
+     * once. */
+    TIMER_ENCODER,
+
+    /**
+     * The timer stops counting at its next update event, so each start
+     * (by timer_resume() or a slave mode trigger) produces one pulse:
+     * the channel's output goes active when the counter reaches the
+     * channel's compare value, and inactive again when it reaches the
+     * reload value. This mode affects the whole timer; use
+     * timer_opm_disable() to leave it. See timer_set_one_pulse(). */
+    TIMER_ONE_PULSE,
 } timer_mode;
 
 /** Timer channel numbers */
@@ -747,6 +765,24 @@ static inline void timer_generate_update(timer_dev *dev) {
     *bb_perip(&(dev->regs).bas->EGR, TIMER_EGR_UG_BIT) = 1;
 }
 
+/**
+ * @brief Select the event a timer sends on its trigger output (TRGO).
+ *
+ * TRGO can start ADC or DAC conversions, or drive other timers in
+ * slave mode.
+ *
+ * @param dev Timer device. Basic timers only support
+ *            TIMER_CR2_MMS_RESET, TIMER_CR2_MMS_ENABLE and
+ *            TIMER_CR2_MMS_UPDATE.
+ * @param mms Master mode selection, one of the TIMER_CR2_MMS_* values.
+ */
+static inline void timer_set_master_mode(timer_dev *dev, uint32 mms) {
+    uint32 cr2 = (dev->regs).bas->CR2;
+    cr2 &= ~TIMER_CR2_MMS;
+    cr2 |= mms;
+    (dev->regs).bas->CR2 = cr2;
+}
+
 /**
  * @brief Enable a timer's trigger DMA request
  * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL
@@ -763,6 +799,22 @@ static inline void timer_dma_disable_trg_req(timer_dev *dev) {
     *bb_perip(&(dev->regs).gen->DIER, TIMER_DIER_TDE_BIT) = 0;
 }
 
+/**
+ * @brief Enable a timer's update DMA request
+ * @param dev Timer device
+ */
+static inline void timer_dma_enable_upd_req(timer_dev *dev) {
+    *bb_perip(&(dev->regs).bas->DIER, TIMER_DIER_UDE_BIT) = 1;
+}
+
+/**
+ * @brief Disable a timer's update DMA request
+ * @param dev Timer device
+ */
+static inline void timer_dma_disable_upd_req(timer_dev *dev) {
+    *bb_perip(&(dev->regs).bas->DIER, TIMER_DIER_UDE_BIT) = 0;
+}
+
 /**
  * @brief Enable a timer channel's DMA request.
  * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL
@@ -862,6 +914,105 @@ static inline void timer_cc_set_pol(timer_dev *dev, uint8 channel, uint8 pol) {
     *bb_perip(&(dev->regs).gen->CCER, 4 * (channel - 1) + 1) = pol;
 }
 
+/*
+ * Advanced timer outputs
+ */
+
+/**
+ * @brief Enable a channel's complementary (CHxN) output.
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ * @param channel Channel whose complementary output to enable, from 1 to 3.
+ * @see timer_set_complementary_pwm()
+ */
+static inline void timer_ccn_enable(timer_dev *dev, uint8 channel) {
+    *bb_perip(&(dev->regs).adv->CCER, 4 * (channel - 1) + 2) = 1;
+}
+
+/**
+ * @brief Disable a channel's complementary (CHxN) output.
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ * @param channel Channel whose complementary output to disable, from 1 to 3.
+ */
+static inline void timer_ccn_disable(timer_dev *dev, uint8 channel) {
+    *bb_perip(&(dev->regs).adv->CCER, 4 * (channel - 1) + 2) = 0;
+}
+
+/**
+ * @brief Set a channel's complementary output polarity.
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ * @param channel Channel, from 1 to 3.
+ * @param pol 0 for active high, 1 for active low.
+ */
+static inline void timer_ccn_set_pol(timer_dev *dev, uint8 channel, uint8 pol) {
+    *bb_perip(&(dev->regs).adv->CCER, 4 * (channel - 1) + 3) = pol;
+}
+
+/**
+ * @brief Enable an advanced timer's outputs (set BDTR MOE).
+ *
+ * The break input clears MOE; call this to resume afterwards, unless
+ * automatic output enable was chosen with timer_set_break().
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ */
+static inline void timer_moe_enable(timer_dev *dev) {
+    *bb_perip(&(dev->regs).adv->BDTR, TIMER_BDTR_MOE_BIT) = 1;
+}
+
+/**
+ * @brief Force an advanced timer's outputs to their idle states.
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ */
+static inline void timer_moe_disable(timer_dev *dev) {
+    *bb_perip(&(dev->regs).adv->BDTR, TIMER_BDTR_MOE_BIT) = 0;
+}
+
+/**
+ * @brief Configure an advanced timer's break input.
+ *
+ * While enabled, the active level on the BKIN pin clears MOE at once,
+ * without CPU involvement, forcing all the timer's outputs to their
+ * idle states, and sets the break interrupt flag
+ * (TIMER_BREAK_INTERRUPT).
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ * @param flags Logical OR of TIMER_BDTR_BKE (enable the break input),
+ *              TIMER_BDTR_BKP (break when BKIN is high, rather than
+ *              low), and TIMER_BDTR_AOE (set MOE again at the next
+ *              update event once BKIN is inactive), or 0 to ignore
+ *              BKIN.
+ */
+static inline void timer_set_break(timer_dev *dev, uint32 flags) {
+    uint32 bdtr = (dev->regs).adv->BDTR;
+    bdtr &= ~(TIMER_BDTR_BKE | TIMER_BDTR_BKP | TIMER_BDTR_AOE);
+    (dev->regs).adv->BDTR = bdtr | flags;
+}
+
+/**
+ * @brief Choose edge-aligned or center-aligned counting.
+ *
+ * In the center-aligned modes, the counter counts up to the reload
+ * value and back down to 0, so a PWM period is twice the reload
+ * value, and PWM outputs are symmetrical about the period's center.
+ * The modes differ in when output compare interrupts fire: counting
+ * down (CENTER1), counting up (CENTER2), or both (CENTER3).
+ *
+ * Only change between edge-aligned and center-aligned counting while
+ * the timer is paused.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param mode One of TIMER_CR1_CKD_CMS_EDGE, TIMER_CR1_CKD_CMS_CENTER1,
+ *             TIMER_CR1_CKD_CMS_CENTER2, or TIMER_CR1_CKD_CMS_CENTER3.
+ */
+static inline void timer_set_center_aligned(timer_dev *dev, uint32 mode) {
+    uint32 cr1 = (dev->regs).gen->CR1;
+    cr1 &= ~TIMER_CR1_CKD_CMS;
+    (dev->regs).gen->CR1 = cr1 | mode;
+}
+
+void timer_set_complementary_pwm(timer_dev *dev, uint8 channel);
+uint32 timer_set_dead_time(timer_dev *dev, uint32 ticks);
+
 /**
  * @brief Get a timer's DMA burst length.
  * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
@@ -1036,6 +1187,89 @@ static inline void timer_oc_set_mode(timer_dev *dev,
     *ccmr = tmp;
 }
 
+/**
+ * Timer input capture input selection.
+ * @see timer_ic_set_mode()
+ */
+typedef enum timer_ic_input_select {
+    /** Channel n captures input TIn (its own pin). */
+    TIMER_IC_INPUT_DIRECT = TIMER_CCMR_CCS_INPUT_TI1,
+    /**
+     * Channel n captures the input of the other channel in its pair:
+     * channel 1 captures TI2, channel 2 captures TI1, and so on. */
+    TIMER_IC_INPUT_INDIRECT = TIMER_CCMR_CCS_INPUT_TI2,
+    /** Channel n captures the slave mode trigger input (TRC). */
+    TIMER_IC_INPUT_TRC = TIMER_CCMR_CCS_INPUT_TRC,
+} timer_ic_input_select;
+
+/**
+ * @brief Configure a channel's input capture mode.
+ *
+ * Captures every edge of the selected polarity (see
+ * timer_cc_set_pol()); the channel must still be enabled with
+ * timer_cc_enable().
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param channel Channel to configure in input capture mode.
+ * @param input Input to capture.
+ * @param filter Input filter, from 0 (none) to 15; see the IC1F field
+ *               of TIMx_CCMR1 in your reference manual.
+ * @see timer_ic_input_select
+ */
+static inline void timer_ic_set_mode(timer_dev *dev,
+                                     uint8 channel,
+                                     timer_ic_input_select input,
+                                     uint8 filter) {
+    /* channel == 1,2 -> CCMR1; channel == 3,4 -> CCMR2 */
+    __io uint32 *ccmr = &(dev->regs).gen->CCMR1 + (((channel - 1) >> 1) & 1);
+    /* channel == 1,3 -> shift = 0, channel == 2,4 -> shift = 8 */
+    uint8 shift = 8 * (1 - (channel & 1));
+
+    uint32 tmp = *ccmr;
+    tmp &= ~(0xFF << shift);
+    tmp |= (((filter & 0xF) << 4) | input) << shift;
+    *ccmr = tmp;
+}
+
+/**
+ * @brief Set a timer's slave mode.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param trigger Trigger selection, one of the TIMER_SMCR_TS_* values.
+ * @param mode Slave mode, one of the TIMER_SMCR_SMS_* values.
+ */
+static inline void timer_set_slave_mode(timer_dev *dev,
+                                        uint32 trigger,
+                                        uint32 mode) {
+    uint32 smcr = (dev->regs).gen->SMCR;
+    smcr &= ~(TIMER_SMCR_TS | TIMER_SMCR_SMS);
+    smcr |= trigger | mode;
+    (dev->regs).gen->SMCR = smcr;
+}
+
+void timer_set_pwm_input(timer_dev *dev, uint8 channel, uint8 filter);
+void timer_set_encoder(timer_dev *dev, uint32 mode, uint8 filter);
+void timer_set_one_pulse(timer_dev *dev, uint8 channel,
+                         uint16 delay, uint16 width);
+
+/**
+ * @brief Make a timer stop counting at its next update event.
+ * @param dev Timer device
+ * @see TIMER_ONE_PULSE
+ */
+static inline void timer_opm_enable(timer_dev *dev) {
+    *bb_perip(&(dev->regs).bas->CR1, TIMER_CR1_OPM_BIT) = 1;
+}
+
+/**
+ * @brief Make a timer count continuously again.
+ * @param dev Timer device
+ * @see TIMER_ONE_PULSE
+ */
+static inline void timer_opm_disable(timer_dev *dev) {
+    *bb_perip(&(dev->regs).bas->CR1, TIMER_CR1_OPM_BIT) = 0;
+}
+
 /*
  * Old, erroneous bit definitions from previous releases, kept for
  * backwards compatibility:
@@ -312,9 +312,27 @@ void sdio_clear_interrupt(uint32 flag) {
 /**
  * @brief Add interrupt flag to generate an interrupt request
  * @param mask Interrupt sources to enable
+ * @note The SDIO IRQ is held off around the read-modify-write, so a handler
+ *       which rewrites the mask cannot race with the caller
  */
-void sdio_add_interrupt(uint32 mask) { //FIXME
+void sdio_add_interrupt(uint32 mask) {
+    nvic_irq_disable(SDIO->irq_num);
     SDIO->regs->MASK |= ~SDIO_MASK_RESERVED & mask;
+    if (SDIO->handler) {
+        nvic_irq_enable(SDIO->irq_num);
+    }
+}
+
+/**
+ * @brief Remove interrupt flag from generating an interrupt request
+ * @param mask Interrupt sources to disable
+ */
+void sdio_remove_interrupt(uint32 mask) {
+    nvic_irq_disable(SDIO->irq_num);
+    SDIO->regs->MASK &= ~mask;
+    if (SDIO->handler) {
+        nvic_irq_enable(SDIO->irq_num);
+    }
 }
 
 /**
@@ -325,8 +343,32 @@ void sdio_enable_interrupt(uint32 mask) {
     SDIO->regs->MASK = ~SDIO_MASK_RESERVED & mask;
 }
 
+/**
+ * @brief Attach an interrupt handler to the SDIO peripheral
+ * @param handler Function to call when an unmasked SDIO interrupt occurs
+ * @note The handler must clear the flags it services, or mask them off
+ */
+void sdio_attach_interrupt(voidFuncPtr handler) {
+    SDIO->handler = handler;
+    nvic_irq_enable(SDIO->irq_num);
+}
+
+/**
+ * @brief Detach the SDIO interrupt handler and mask all interrupt sources
+ */
+void sdio_detach_interrupt(void) {
+    nvic_irq_disable(SDIO->irq_num);
+    SDIO->regs->MASK = 0;
+    SDIO->handler = NULL;
+}
+
 /**
  * @brief IRQ for SDIO peripheral
  */
 void __irq_sdio(void) {
+    if (SDIO->handler) {
+        SDIO->handler();
+    } else {
+        SDIO->regs->MASK = 0; // nobody is listening; keep the IRQ quiet
+    }
 }
\ No newline at end of file
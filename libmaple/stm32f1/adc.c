@@ -34,38 +34,88 @@
 
 #include <libmaple/adc.h>
 #include <libmaple/gpio.h>
+#include "adc_private.h"
 
 /*
  * Devices
  */
 
+static voidFuncPtr adc1_handlers[ADC_NR_INTERRUPTS];
 static adc_dev adc1 = {
-    .regs   = ADC1_BASE,
-    .clk_id = RCC_ADC1,
+    .regs     = ADC1_BASE,
+    .clk_id   = RCC_ADC1,
+    .irq_num  = NVIC_ADC_1_2,
+    .handlers = adc1_handlers,
 };
 /** ADC1 device. */
 const adc_dev *ADC1 = &adc1;
 
+static voidFuncPtr adc2_handlers[ADC_NR_INTERRUPTS];
 static adc_dev adc2 = {
-    .regs   = ADC2_BASE,
-    .clk_id = RCC_ADC2,
+    .regs     = ADC2_BASE,
+    .clk_id   = RCC_ADC2,
+    .irq_num  = NVIC_ADC_1_2,
+    .handlers = adc2_handlers,
 };
 /** ADC2 device. */
 const adc_dev *ADC2 = &adc2;
 
 #if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+static voidFuncPtr adc3_handlers[ADC_NR_INTERRUPTS];
 static adc_dev adc3 = {
-    .regs   = ADC3_BASE,
-    .clk_id = RCC_ADC3,
+    .regs     = ADC3_BASE,
+    .clk_id   = RCC_ADC3,
+    .irq_num  = NVIC_ADC3,
+    .handlers = adc3_handlers,
 };
 /** ADC3 device. */
 const adc_dev *ADC3 = &adc3;
 #endif
 
+/*
+ * IRQ handlers
+ */
+
+#if STM32_F1_LINE == STM32_F1_LINE_VALUE
+/* Value line parts have ADC1 alone, on its own vector. */
+void __irq_adc1(void) {
+    adc_irq_handler(ADC1);
+}
+#else
+void __irq_adc(void) {
+    adc_irq_handler(ADC1);
+    adc_irq_handler(ADC2);
+}
+#endif
+
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+void __irq_adc3(void) {
+    adc_irq_handler(ADC3);
+}
+#endif
+
 /*
  * STM32F1 routines
  */
 
+/**
+ * @brief Set external event select for the injected group
+ *
+ * Availability: STM32F1.
+ *
+ * @param dev ADC device
+ * @param event Event used to trigger the injected sequence.
+ * @see adc_jextsel_event
+ */
+void adc_set_jextsel(const adc_dev *dev, adc_jextsel_event event) {
+    uint32 cr2 = dev->regs->CR2;
+    cr2 &= ~ADC_CR2_JEXTSEL;
+    cr2 |= event;
+    if (cr2 != dev->regs->CR2) {
+        dev->regs->CR2 = cr2;
+    }
+}
+
 /**
  * @brief Calibrate an ADC peripheral
  *
@@ -86,6 +136,31 @@ void adc_calibrate(const adc_dev *dev) {
         ;
 }
 
+/**
+ * @brief Set the dual ADC mode
+ *
+ * In regular simultaneous mode, ADC1 and ADC2 convert their regular
+ * sequences at the same instant, and ADC1's regular data register
+ * holds ADC2's result in its upper half-word. A single ADC1 DMA
+ * transfer of 32 bits then collects both results.
+ *
+ * Both sequences must have the same length, the paired channels
+ * should have the same sample times, and the two ADCs must not
+ * convert the same channel at the same time. Switch back to
+ * ADC_DUAL_INDEPENDENT before changing either ADC's configuration.
+ *
+ * Availability: STM32F1.
+ *
+ * @param mode Dual mode to use.
+ * @see adc_dual_mode
+ */
+void adc_set_dual_mode(adc_dual_mode mode) {
+    uint32 cr1 = ADC1->regs->CR1;
+    cr1 &= ~ADC_CR1_DUALMOD;
+    cr1 |= mode;
+    ADC1->regs->CR1 = cr1;
+}
+
 /*
  * Common routines
  */
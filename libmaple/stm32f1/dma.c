@@ -34,6 +34,7 @@
 
 #include <libmaple/dma.h>
 #include <libmaple/bitband.h>
+#include <libmaple/timer.h>
 
 /* Hack to ensure inlining in dma_irq_handler() */
 #define DMA_GET_HANDLER(dev, tube) (dev->handlers[tube - 1].handler)
@@ -356,6 +357,65 @@ void dma_setup_transfer(dma_dev       *dev,
     channel_regs->CPAR = (uint32)peripheral_address;
 }
 
+/*
+ * Timer DMA requests, by timer and DMA_TIMER_REQ_UP or channel. Zero
+ * means the request has no DMA channel.
+ */
+static const uint16 timer_dma_reqs[][5] = {
+    {DMA_REQ_SRC_TIM1_UP, DMA_REQ_SRC_TIM1_CH1, DMA_REQ_SRC_TIM1_CH2,
+     DMA_REQ_SRC_TIM1_CH3, DMA_REQ_SRC_TIM1_CH4},
+    {DMA_REQ_SRC_TIM2_UP, DMA_REQ_SRC_TIM2_CH1, DMA_REQ_SRC_TIM2_CH2,
+     DMA_REQ_SRC_TIM2_CH3, DMA_REQ_SRC_TIM2_CH4},
+    {DMA_REQ_SRC_TIM3_UP, DMA_REQ_SRC_TIM3_CH1, 0,
+     DMA_REQ_SRC_TIM3_CH3, DMA_REQ_SRC_TIM3_CH4},
+    {DMA_REQ_SRC_TIM4_UP, DMA_REQ_SRC_TIM4_CH1, DMA_REQ_SRC_TIM4_CH2,
+     DMA_REQ_SRC_TIM4_CH3, 0},
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    {DMA_REQ_SRC_TIM5_UP, DMA_REQ_SRC_TIM5_CH1, DMA_REQ_SRC_TIM5_CH2,
+     DMA_REQ_SRC_TIM5_CH3, DMA_REQ_SRC_TIM5_CH4},
+    {DMA_REQ_SRC_TIM6_UP, 0, 0, 0, 0},
+    {DMA_REQ_SRC_TIM7_UP, 0, 0, 0, 0},
+    {DMA_REQ_SRC_TIM8_UP, DMA_REQ_SRC_TIM8_CH1, DMA_REQ_SRC_TIM8_CH2,
+     DMA_REQ_SRC_TIM8_CH3, DMA_REQ_SRC_TIM8_CH4},
+#endif
+};
+
+/**
+ * @brief Find the DMA tube which serves a timer DMA request.
+ *
+ * @param timer Timer device.
+ * @param request DMA_TIMER_REQ_UP for the update event, or a
+ *                capture/compare channel, from 1 to 4.
+ * @param dev Set to the DMA controller serving the request.
+ * @param tube Set to the DMA tube serving the request.
+ * @param src Set to the request source, for struct dma_tube_config.
+ * @return Nonzero if the request can use DMA, zero otherwise (in
+ *         which case the outputs are left unchanged).
+ */
+int dma_timer_req(struct timer_dev *timer, uint8 request,
+                  dma_dev **dev, dma_tube *tube, dma_request_src *src) {
+    uint32 n = timer->clk_id - RCC_TIMER1;
+    uint16 req;
+
+    if (timer->clk_id < RCC_TIMER1 ||
+        n >= sizeof(timer_dma_reqs) / sizeof(timer_dma_reqs[0]) ||
+        request > 4) {
+        return 0;
+    }
+    req = timer_dma_reqs[n][request];
+    if (req == 0) {
+        return 0;
+    }
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    *dev = (rcc_clk_id)(req >> 3) == RCC_DMA2 ? DMA2 : DMA1;
+#else
+    *dev = DMA1;
+#endif
+    *tube = (dma_tube)(req & 0x7);
+    *src = (dma_request_src)req;
+    return 1;
+}
+
 /*
  * IRQ handlers
  */
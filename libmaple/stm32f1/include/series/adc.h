@@ -64,6 +64,12 @@ extern const struct adc_dev *ADC3;
  * Register bit definitions
  */
 
+/* Control register 1 */
+
+/* The dual mode bits only exist in ADC1's CR1; they are reserved in
+ * ADC2 and ADC3. */
+#define ADC_CR1_DUALMOD                 (0xF << 16)
+
 /* Control register 2 */
 
 #define ADC_CR2_ADON_BIT                0
@@ -201,6 +207,49 @@ typedef enum adc_extsel_event {
 /** Deprecated. Use ADC_EXT_EV_SWSTART instead. */
 #define ADC_SWSTART         ADC_EXT_EV_SWSTART
 
+/**
+ * @brief STM32F1 external event selectors for injected group
+ *        conversion.
+ *
+ * As with adc_extsel_event, some events are only available on some
+ * ADCs or MCU densities, as noted.
+ *
+ * @see adc_set_jextsel()
+ */
+typedef enum adc_jextsel_event {
+    /* ADC1 and ADC2 only: */
+    ADC_JEXT_EV_TIM2_TRGO = 0x2000, /**< ADC1, ADC2: Timer 2 TRGO event */
+    ADC_JEXT_EV_TIM2_CC1  = 0x3000, /**< ADC1, ADC2: Timer 2 CC1 event */
+    ADC_JEXT_EV_TIM3_CC4  = 0x4000, /**< ADC1, ADC2: Timer 3 CC4 event */
+    ADC_JEXT_EV_TIM4_TRGO = 0x5000, /**< ADC1, ADC2: Timer 4 TRGO event */
+    ADC_JEXT_EV_EXTI15    = 0x6000, /**< ADC1, ADC2: EXTI15 event */
+
+    /* Common: */
+    ADC_JEXT_EV_TIM1_TRGO = 0x0000, /**< ADC1, ADC2, ADC3: Timer 1 TRGO event */
+    ADC_JEXT_EV_TIM1_CC4  = 0x1000, /**< ADC1, ADC2, ADC3: Timer 1 CC4 event */
+    ADC_JEXT_EV_JSWSTART  = 0x7000, /**< ADC1, ADC2, ADC3: Software start */
+
+    /* HD only: */
+    ADC_JEXT_EV_ADC12_TIM8_CC4 = 0x6000, /**<
+                                     * ADC1, ADC2: Timer 8 CC4 event
+                                     * Availability: high- and XL-density. */
+    ADC_JEXT_EV_TIM4_CC3  = 0x2000, /**<
+                                     * ADC3: Timer 4 CC3 event
+                                     * Availability: high- and XL-density. */
+    ADC_JEXT_EV_TIM8_CC2  = 0x3000, /**<
+                                     * ADC3: Timer 8 CC2 event
+                                     * Availability: high- and XL-density. */
+    ADC_JEXT_EV_ADC3_TIM8_CC4 = 0x4000, /**<
+                                     * ADC3: Timer 8 CC4 event
+                                     * Availability: high- and XL-density. */
+    ADC_JEXT_EV_TIM5_TRGO = 0x5000, /**<
+                                     * ADC3: Timer 5 TRGO event
+                                     * Availability: high- and XL-density. */
+    ADC_JEXT_EV_TIM5_CC4  = 0x6000, /**<
+                                     * ADC3: Timer 5 CC4 event
+                                     * Availability: high- and XL-density. */
+} adc_jextsel_event;
+
 /**
  * @brief STM32F1 sample times, in ADC clock cycles.
  *
@@ -231,11 +280,51 @@ typedef enum adc_prescaler {
     ADC_PRE_PCLK2_DIV_8 = RCC_ADCPRE_PCLK_DIV_8,
 } adc_prescaler;
 
+/**
+ * @brief STM32F1 dual ADC modes.
+ *
+ * In the dual modes, ADC1 is the master and ADC2 the slave. ADC2's
+ * regular conversions are started by ADC1's trigger, so ADC2 should
+ * be set to software start (ADC_EXT_EV_SWSTART) with external
+ * triggering enabled.
+ *
+ * @see adc_set_dual_mode()
+ */
+typedef enum adc_dual_mode {
+    ADC_DUAL_INDEPENDENT        = 0x0 << 16, /**< Independent mode */
+    /** Combined regular simultaneous and injected simultaneous */
+    ADC_DUAL_REG_SIMULT_INJ_SIMULT = 0x1 << 16,
+    /** Combined regular simultaneous and alternate trigger */
+    ADC_DUAL_REG_SIMULT_ALT_TRIG = 0x2 << 16,
+    /** Combined injected simultaneous and fast interleaved */
+    ADC_DUAL_INJ_SIMULT_FAST_INTERL = 0x3 << 16,
+    /** Combined injected simultaneous and slow interleaved */
+    ADC_DUAL_INJ_SIMULT_SLOW_INTERL = 0x4 << 16,
+    ADC_DUAL_INJ_SIMULT         = 0x5 << 16, /**< Injected simultaneous */
+    ADC_DUAL_REG_SIMULT         = 0x6 << 16, /**< Regular simultaneous */
+    ADC_DUAL_FAST_INTERL        = 0x7 << 16, /**< Fast interleaved */
+    ADC_DUAL_SLOW_INTERL        = 0x8 << 16, /**< Slow interleaved */
+    ADC_DUAL_ALT_TRIG           = 0x9 << 16, /**< Alternate trigger */
+} adc_dual_mode;
+
 /*
  * Routines
  */
 
+/* Writing 1 to ADON while it is already set starts a conversion,
+ * unless another CR2 bit changes in the same write. The CR2 bit
+ * setters below therefore skip writes which would change nothing. */
+static inline void adc_cr2_set_bit(const adc_dev *dev, uint32 bit,
+                                   uint8 value) {
+    __io uint32 *bb = bb_perip(&dev->regs->CR2, bit);
+    if (*bb != value) {
+        *bb = value;
+    }
+}
+
 void adc_calibrate(const adc_dev *dev);
+void adc_set_dual_mode(adc_dual_mode mode);
+void adc_set_jextsel(const adc_dev *dev, adc_jextsel_event event);
 
 /**
  * @brief Set external trigger conversion mode event for regular channels
@@ -247,7 +336,52 @@ void adc_calibrate(const adc_dev *dev);
  *               disabled.
  */
 static inline void adc_set_exttrig(const adc_dev *dev, uint8 enable) {
-    *bb_perip(&dev->regs->CR2, ADC_CR2_EXTTRIG_BIT) = !!enable;
+    adc_cr2_set_bit(dev, ADC_CR2_EXTTRIG_BIT, !!enable);
+}
+
+/**
+ * @brief Set external trigger conversion mode event for injected channels
+ *
+ * Availability: STM32F1.
+ *
+ * @param dev    ADC device
+ * @param enable If 1, injected conversion on external events is
+ *               enabled; if 0, disabled.
+ * @see adc_set_jextsel()
+ */
+static inline void adc_set_jexttrig(const adc_dev *dev, uint8 enable) {
+    adc_cr2_set_bit(dev, ADC_CR2_JEXTTRIG_BIT, !!enable);
+}
+
+/**
+ * @brief Enable or disable DMA requests for regular conversions
+ *
+ * When enabled, the ADC issues a DMA request after each regular
+ * conversion. Only ADC1 and ADC3 can generate DMA requests; ADC2
+ * results are available through ADC1 in dual mode.
+ *
+ * Availability: STM32F1.
+ *
+ * @param dev    ADC device
+ * @param enable If 1, DMA requests are enabled; if 0, disabled.
+ */
+static inline void adc_set_dma(const adc_dev *dev, uint8 enable) {
+    adc_cr2_set_bit(dev, ADC_CR2_DMA_BIT, !!enable);
+}
+
+/**
+ * @brief Enable or disable continuous conversion mode
+ *
+ * In continuous mode, the regular sequence restarts as soon as it
+ * completes, instead of waiting for the next trigger.
+ *
+ * Availability: STM32F1.
+ *
+ * @param dev    ADC device
+ * @param enable If 1, continuous mode is enabled; if 0, disabled.
+ */
+static inline void adc_set_continuous(const adc_dev *dev, uint8 enable) {
+    adc_cr2_set_bit(dev, ADC_CR2_CONT_BIT, !!enable);
 }
 
 #endif
@@ -411,6 +411,10 @@ typedef enum dma_request_src {
     DMA_REQ_SRC_TIM1_CH2  = (RCC_DMA1 << 3) | 3,
     DMA_REQ_SRC_TIM3_CH4  = (RCC_DMA1 << 3) | 3,
     DMA_REQ_SRC_TIM3_UP   = (RCC_DMA1 << 3) | 3,
+#if !defined(STM32_HIGH_DENSITY) && !defined(STM32_XL_DENSITY)
+    /* Value line parts without DMA2 */
+    DMA_REQ_SRC_DAC_CH1   = (RCC_DMA1 << 3) | 3,
+#endif
     /**@}*/
 
     /**@{*/
@@ -423,6 +427,10 @@ typedef enum dma_request_src {
     DMA_REQ_SRC_TIM1_TRIG = (RCC_DMA1 << 3) | 4,
     DMA_REQ_SRC_TIM1_COM  = (RCC_DMA1 << 3) | 4,
     DMA_REQ_SRC_TIM4_CH2  = (RCC_DMA1 << 3) | 4,
+#if !defined(STM32_HIGH_DENSITY) && !defined(STM32_XL_DENSITY)
+    /* Value line parts without DMA2 */
+    DMA_REQ_SRC_DAC_CH2   = (RCC_DMA1 << 3) | 4,
+#endif
     /**@}*/
 
     /**@{*/
@@ -462,6 +470,8 @@ typedef enum dma_request_src {
     DMA_REQ_SRC_I2S3_RX   = (RCC_DMA2 << 3) | 1,
     DMA_REQ_SRC_TIM5_CH4  = (RCC_DMA2 << 3) | 1,
     DMA_REQ_SRC_TIM5_TRIG = (RCC_DMA2 << 3) | 1,
+    DMA_REQ_SRC_TIM8_CH3  = (RCC_DMA2 << 3) | 1,
+    DMA_REQ_SRC_TIM8_UP   = (RCC_DMA2 << 3) | 1,
     /**@}*/
 
     /**@{*/
@@ -470,19 +480,29 @@ typedef enum dma_request_src {
     DMA_REQ_SRC_I2S3_TX   = (RCC_DMA2 << 3) | 2,
     DMA_REQ_SRC_TIM5_CH3  = (RCC_DMA2 << 3) | 2,
     DMA_REQ_SRC_TIM5_UP   = (RCC_DMA2 << 3) | 2,
+    DMA_REQ_SRC_TIM8_CH4  = (RCC_DMA2 << 3) | 2,
+    DMA_REQ_SRC_TIM8_TRIG = (RCC_DMA2 << 3) | 2,
+    DMA_REQ_SRC_TIM8_COM  = (RCC_DMA2 << 3) | 2,
     /**@}*/
 
     /**@{*/
     /** (DMA2, tube 3)*/
     DMA_REQ_SRC_UART4_RX  = (RCC_DMA2 << 3) | 3,
     DMA_REQ_SRC_TIM6_UP   = (RCC_DMA2 << 3) | 3,
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
     DMA_REQ_SRC_DAC_CH1   = (RCC_DMA2 << 3) | 3,
+#endif
+    DMA_REQ_SRC_TIM8_CH1  = (RCC_DMA2 << 3) | 3,
     /**@}*/
 
     /**@{*/
     /** (DMA2, tube 4)*/
     DMA_REQ_SRC_SDIO      = (RCC_DMA2 << 3) | 4,
     DMA_REQ_SRC_TIM5_CH2  = (RCC_DMA2 << 3) | 4,
+    DMA_REQ_SRC_TIM7_UP   = (RCC_DMA2 << 3) | 4,
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    DMA_REQ_SRC_DAC_CH2   = (RCC_DMA2 << 3) | 4,
+#endif
     /**@}*/
 
     /**@{*/
@@ -490,9 +510,17 @@ typedef enum dma_request_src {
     DMA_REQ_SRC_ADC3      = (RCC_DMA2 << 3) | 5,
     DMA_REQ_SRC_UART4_TX  = (RCC_DMA2 << 3) | 5,
     DMA_REQ_SRC_TIM5_CH1  = (RCC_DMA2 << 3) | 5,
+    DMA_REQ_SRC_TIM8_CH2  = (RCC_DMA2 << 3) | 5,
     /**@}*/
 } dma_request_src;
 
+/** Timer DMA request number of the update event; see dma_timer_req(). */
+#define DMA_TIMER_REQ_UP 0
+
+struct timer_dev;
+int dma_timer_req(struct timer_dev *timer, uint8 request,
+                  dma_dev **dev, dma_tube *tube, dma_request_src *src);
+
 /*
  * Convenience routines.
  */
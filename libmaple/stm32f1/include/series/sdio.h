@@ -38,7 +38,7 @@
 
 /* SDIO DMA device and channel (constant for STM32F1 line) */
 #define SDIO_DMA_DEVICE  DMA2 //FIXME: fix for multi- family support
-#define SDIO_DMA_CHANNEL DMA_CH6
+#define SDIO_DMA_CHANNEL DMA_CH4
 
 //These gpio values are constant for STM32F103xE chips
 #define BOARD_SDIO_D0_PIN       15
@@ -125,4 +125,12 @@ extern struct timer_dev *TIMER13;
 extern struct timer_dev *TIMER14;
 #endif
 
+/*
+ * Routines
+ */
+
+int timer_dma_burst_start(struct timer_dev *dev, uint8 base, uint8 length,
+                          uint16 *table, uint32 frames, uint32 flags);
+void timer_dma_burst_stop(struct timer_dev *dev);
+
 #endif
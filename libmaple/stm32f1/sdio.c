@@ -46,6 +46,7 @@ static sdio_dev sdio = {
     .regs     = SDIO_BASE,
     .clk_id   = RCC_SDIO,
     .irq_num  = NVIC_SDIO,
+    .handler  = NULL,
 };
 
 sdio_dev *SDIO = &sdio;
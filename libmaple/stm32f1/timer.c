@@ -31,9 +31,100 @@
  */
 
 #include <libmaple/timer.h>
+#include <libmaple/dma.h>
 #include <libmaple/stm32.h>
 #include "timer_private.h"
 
+/*
+ * DMA bursts
+ */
+
+/**
+ * @brief Rewrite a block of timer registers from a table on each update.
+ *
+ * On every update event, DMA copies the next frame of the table (length
+ * half-words) into the timer registers starting at base, through the
+ * DMA burst register (DMAR). The table repeats until
+ * timer_dma_burst_stop().
+ *
+ * For example, with base TIMER_DMA_BASE_CCR1 and length 4, each frame
+ * holds the next compare values of channels 1 to 4. With base
+ * TIMER_DMA_BASE_ARR and length 6, each frame holds the next reload
+ * value, a repetition count (reserved on general purpose timers) and
+ * the four compare values.
+ *
+ * With preload enabled for the compare and reload registers (as in
+ * PWM mode, see timer_set_mode()), the values a burst writes take
+ * effect together at the following update, so the outputs never see
+ * a half-written frame.
+ *
+ * To refill the table while it plays, pass DMA_CFG_HALF_CMPLT_IE and
+ * DMA_CFG_CMPLT_IE in flags and attach a handler to the DMA tube
+ * returned by dma_timer_req() for DMA_TIMER_REQ_UP.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param base First register to write, a TIMER_DMA_BASE_* value.
+ * @param length Registers written per update, from 1 to 18.
+ * @param table Frames of register values, one after the other.
+ * @param frames Number of frames in the table. frames * length must be
+ *               at most 65,535.
+ * @param flags Extra dma_cfg_flags for the DMA tube, or 0.
+ * @return Nonzero on success, zero if the timer's update event has no
+ *         DMA request or the configuration is invalid.
+ */
+int timer_dma_burst_start(timer_dev *dev, uint8 base, uint8 length,
+                          uint16 *table, uint32 frames, uint32 flags) {
+    dma_dev *dma;
+    dma_tube tube;
+    dma_request_src src;
+    dma_tube_config cfg;
+
+    if (length < 1 || length > 18 || frames == 0 ||
+        frames > 65535 / length ||
+        !dma_timer_req(dev, DMA_TIMER_REQ_UP, &dma, &tube, &src)) {
+        return 0;
+    }
+    timer_dma_disable_upd_req(dev);
+
+    cfg.tube_src = table;
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = &(dev->regs).gen->DMAR;
+    cfg.tube_dst_size = DMA_SIZE_16BITS;
+    cfg.tube_nr_xfers = frames * length;
+    cfg.tube_flags = DMA_CFG_SRC_INC | DMA_CFG_CIRC | flags;
+    cfg.target_data = NULL;
+    cfg.tube_req_src = src;
+
+    dma_init(dma);
+    if (dma_tube_cfg(dma, tube, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        return 0;
+    }
+    dma_set_priority(dma, tube, DMA_PRIORITY_HIGH);
+
+    (dev->regs).gen->DCR = ((uint32)(length - 1) << 8) | base;
+    dma_enable(dma, tube);
+    timer_dma_enable_upd_req(dev);
+    return 1;
+}
+
+/**
+ * @brief Stop the DMA burst started by timer_dma_burst_start().
+ *
+ * The registers keep the values of the last frame written.
+ *
+ * @param dev Timer device.
+ */
+void timer_dma_burst_stop(timer_dev *dev) {
+    dma_dev *dma;
+    dma_tube tube;
+    dma_request_src src;
+
+    timer_dma_disable_upd_req(dev);
+    if (dma_timer_req(dev, DMA_TIMER_REQ_UP, &dma, &tube, &src)) {
+        dma_disable(dma, tube);
+    }
+}
+
 /*
  * IRQ handlers
  *
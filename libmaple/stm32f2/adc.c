@@ -31,32 +31,53 @@
 
 #include <libmaple/adc.h>
 #include <libmaple/gpio.h>
+#include "adc_private.h"
 
 /*
  * Devices
  */
 
+static voidFuncPtr adc1_handlers[ADC_NR_INTERRUPTS];
 static adc_dev adc1 = {
-    .regs   = ADC1_BASE,
-    .clk_id = RCC_ADC1,
+    .regs     = ADC1_BASE,
+    .clk_id   = RCC_ADC1,
+    .irq_num  = NVIC_ADC,
+    .handlers = adc1_handlers,
 };
 /** ADC1 device. */
 const adc_dev *ADC1 = &adc1;
 
+static voidFuncPtr adc2_handlers[ADC_NR_INTERRUPTS];
 static adc_dev adc2 = {
-    .regs   = ADC2_BASE,
-    .clk_id = RCC_ADC2,
+    .regs     = ADC2_BASE,
+    .clk_id   = RCC_ADC2,
+    .irq_num  = NVIC_ADC,
+    .handlers = adc2_handlers,
 };
 /** ADC2 device. */
 const adc_dev *ADC2 = &adc2;
 
+static voidFuncPtr adc3_handlers[ADC_NR_INTERRUPTS];
 static adc_dev adc3 = {
-    .regs   = ADC3_BASE,
-    .clk_id = RCC_ADC3,
+    .regs     = ADC3_BASE,
+    .clk_id   = RCC_ADC3,
+    .irq_num  = NVIC_ADC,
+    .handlers = adc3_handlers,
 };
 /** ADC3 device. */
 const adc_dev *ADC3 = &adc3;
 
+/*
+ * IRQ handler
+ */
+
+/* All three ADCs share one IRQ line. */
+void __irq_adc(void) {
+    adc_irq_handler(ADC1);
+    adc_irq_handler(ADC2);
+    adc_irq_handler(ADC3);
+}
+
 /*
  * Common routines
  */
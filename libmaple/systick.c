@@ -31,6 +31,7 @@
  */
 
 #include <libmaple/systick.h>
+#include <libmaple/scb.h>
 
 volatile uint32 systick_uptime_millis;
 static void (*systick_user_callback)(void);
@@ -76,6 +77,130 @@ void systick_attach_callback(void (*callback)(void)) {
     systick_user_callback = callback;
 }
 
+/*
+ * Cycles from the load that samples CNT in systick_restart() to the
+ * store that restarts the counter: LDR, ADD and STR on the Cortex-M3.
+ */
+#define SYSTICK_RESTART_CYCLES          4
+
+/*
+ * systick_sleep() only reprograms the counter at least this many
+ * cycles before a tick, which covers the arithmetic between reading
+ * CNT and systick_restart().
+ */
+#define SYSTICK_SLEEP_MARGIN            128
+
+/*
+ * Restart the counter, without stopping it, for a period of
+ * (CNT + offset + 1) cycles, SYSTICK_RESTART_CYCLES after sampling
+ * CNT. Returns the sampled CNT. RVR must be set back afterwards.
+ */
+static __always_inline uint32 systick_restart(uint32 offset) {
+    uint32 count, reload;
+    asm volatile("ldr %0, [%2, #8]\n\t"      /* CNT */
+                 "add %1, %0, %3\n\t"
+                 "str %1, [%2, #4]\n\t"      /* RVR */
+                 "str %4, [%2, #8]"           /* CNT; reloads from RVR */
+                 : "=&r" (count), "=&r" (reload)
+                 : "r" (SYSTICK_BASE), "r" (offset), "r" (0)
+                 : "memory");
+    return count;
+}
+
+/**
+ * @brief Sleep until an interrupt, without SysTick waking the core at
+ *        each tick in between.
+ *
+ * Executes WFI after reprogramming SysTick so that its next
+ * interrupt comes after at most the given number of core clock
+ * cycles (at most 2^24), then restores the original tick phase and
+ * brings systick_uptime_millis up to date. Any other interrupt ends
+ * the sleep early. Sleeps of fewer than 128 cycles return at once.
+ *
+ * Must be called with interrupts disabled, e.g. with
+ * nvic_globalirq_disable(). The interrupt that ended the sleep runs
+ * when the caller enables interrupts again, and by then
+ * systick_uptime_millis is correct. A callback attached with
+ * systick_attach_callback() needs every tick, so while there is
+ * one, this only sleeps until the next tick.
+ *
+ * The counter keeps running while it is reprogrammed, and the
+ * cycles each reprogramming takes are accounted for, so sleeping
+ * does not slow the uptime down.
+ *
+ * @param cycles Maximum number of cycles to sleep for.
+ */
+void systick_sleep(uint32 cycles) {
+    uint32 csr = SYSTICK_BASE->CSR;
+    uint32 period = SYSTICK_BASE->RVR + 1;
+    uint32 count, offset, length, next, elapsed, ticks, pending;
+
+    if (cycles > SYSTICK_MAX_SLEEP) {
+        cycles = SYSTICK_MAX_SLEEP;
+    }
+    if (cycles < SYSTICK_SLEEP_MARGIN) {
+        return;
+    }
+    if (systick_user_callback || !(csr & SYSTICK_CSR_ENABLE)) {
+        asm volatile("wfi");
+        return;
+    }
+
+    /* Too close to a tick to reprogram the counter first; let the
+     * tick end the sleep. A tick between the two reads shows as
+     * pending. */
+    count = SYSTICK_BASE->CNT;
+    if (count < SYSTICK_SLEEP_MARGIN ||
+        (SCB_BASE->ICSR & SCB_ICSR_PENDSTSET)) {
+        asm volatile("wfi");
+        return;
+    }
+
+    /* Stretch or shorten the current period to end after about the
+     * requested number of cycles. The tick that was due comes next
+     * cycles after the restart. */
+    offset = cycles - 1 - count;
+    count = systick_restart(offset);
+    SYSTICK_BASE->RVR = period - 1;
+    length = count + offset + 1;
+    next = count - SYSTICK_RESTART_CYCLES;
+
+    asm volatile("wfi");
+
+    /* The stretched period is followed by normal ones, so work out
+     * how far through those the counter got, if it got that far. A
+     * wrap between reading ICSR and CNT would be miscounted, and one
+     * just after would race the restart below, so wait for it. */
+    do {
+        pending = SCB_BASE->ICSR & SCB_ICSR_PENDSTSET;
+        count = SYSTICK_BASE->CNT;
+    } while (pending != (SCB_BASE->ICSR & SCB_ICSR_PENDSTSET) ||
+             (!pending && count < SYSTICK_SLEEP_MARGIN));
+    if (pending) {
+        SCB_BASE->ICSR = SCB_ICSR_PENDSTCLR;
+        elapsed = length + period - count;
+    } else {
+        elapsed = length - count;
+    }
+
+    /* Ticks that passed, and cycles from reading CNT until the next. */
+    ticks = 0;
+    if (elapsed >= next) {
+        ticks = 1 + (elapsed - next) / period;
+    }
+    next = next + ticks * period - elapsed;
+    if (next < SYSTICK_SLEEP_MARGIN) {
+        ticks++;
+        next += period;
+    }
+
+    /* The counter has moved on since it was read; shorten the period
+     * to match, so it ends on the tick. */
+    systick_restart(next - count - SYSTICK_RESTART_CYCLES - 1);
+    SYSTICK_BASE->RVR = period - 1;
+    systick_uptime_millis += ticks;
+}
+
 /*
  * SysTick ISR
  */
@@ -37,6 +37,9 @@
 static void disable_channel(timer_dev *dev, uint8 channel);
 static void pwm_mode(timer_dev *dev, uint8 channel);
 static void output_compare_mode(timer_dev *dev, uint8 channel);
+static void input_capture_mode(timer_dev *dev, uint8 channel);
+static void encoder_mode(timer_dev *dev, uint8 channel);
+static void one_pulse_mode(timer_dev *dev, uint8 channel);
 
 static inline void enable_irq(timer_dev *dev, uint8 interrupt);
 
@@ -229,7 +232,185 @@ void timer_set_mode(timer_dev *dev, uint8 channel, timer_mode mode) {
     case TIMER_OUTPUT_COMPARE:
         output_compare_mode(dev, channel);
         break;
+    case TIMER_INPUT_CAPTURE:
+        input_capture_mode(dev, channel);
+        break;
+    case TIMER_ENCODER:
+        encoder_mode(dev, channel);
+        break;
+    case TIMER_ONE_PULSE:
+        one_pulse_mode(dev, channel);
+        break;
+    }
+}
+
+/**
+ * @brief Measure a PWM input signal.
+ *
+ * Configures channels 1 and 2 as a pair that both capture the signal
+ * on one of their pins, and resets the counter on each of its rising
+ * edges. Afterwards, the given channel's capture/compare register
+ * holds the signal's period and the other channel's holds its high
+ * time, both in timer ticks, updated every period with no CPU
+ * involvement.
+ *
+ * Periods longer than the timer's reload value can't be measured, so
+ * set the reload value to 0xFFFF and choose the prescaler to suit.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param channel Channel whose pin carries the signal, 1 or 2.
+ * @param filter Input filter, as for timer_ic_set_mode().
+ */
+void timer_set_pwm_input(timer_dev *dev, uint8 channel, uint8 filter) {
+    uint8 other = channel == 1 ? 2 : 1;
+    ASSERT(channel == 1 || channel == 2);
+
+    timer_cc_disable(dev, 1);
+    timer_cc_disable(dev, 2);
+    timer_ic_set_mode(dev, channel, TIMER_IC_INPUT_DIRECT, filter);
+    timer_ic_set_mode(dev, other, TIMER_IC_INPUT_INDIRECT, filter);
+    timer_cc_set_pol(dev, channel, 0);
+    timer_cc_set_pol(dev, other, 1);
+    timer_set_slave_mode(dev,
+                         (channel == 1 ?
+                          TIMER_SMCR_TS_TI1FP1 : TIMER_SMCR_TS_TI2FP2),
+                         TIMER_SMCR_SMS_RESET);
+    timer_cc_enable(dev, 1);
+    timer_cc_enable(dev, 2);
+}
+
+/**
+ * @brief Count a quadrature encoder in hardware.
+ *
+ * Configures channels 1 and 2 as the encoder's A and B inputs, and
+ * puts the timer in encoder slave mode, so that the counter follows
+ * the encoder's position with no CPU involvement. The counter counts
+ * between 0 and the reload value, wrapping in either direction; the
+ * DIR bit of TIMx_CR1 gives the direction of the last count. Use
+ * timer_cc_set_pol() on channel 1 or 2 to reverse the direction.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param mode TIMER_SMCR_SMS_ENCODER1 to count the edges of input 2
+ *             only, TIMER_SMCR_SMS_ENCODER2 for input 1 only, or
+ *             TIMER_SMCR_SMS_ENCODER3 for all edges (four counts per
+ *             encoder cycle).
+ * @param filter Input filter, as for timer_ic_set_mode().
+ */
+void timer_set_encoder(timer_dev *dev, uint32 mode, uint8 filter) {
+    ASSERT(mode >= TIMER_SMCR_SMS_ENCODER1 &&
+           mode <= TIMER_SMCR_SMS_ENCODER3);
+
+    timer_cc_disable(dev, 1);
+    timer_cc_disable(dev, 2);
+    timer_ic_set_mode(dev, 1, TIMER_IC_INPUT_DIRECT, filter);
+    timer_ic_set_mode(dev, 2, TIMER_IC_INPUT_DIRECT, filter);
+    timer_cc_set_pol(dev, 1, 0);
+    timer_cc_set_pol(dev, 2, 0);
+    timer_set_slave_mode(dev, TIMER_SMCR_TS_ITR0, mode);
+}
+
+/**
+ * @brief Produce single pulses of exact delay and width on a channel.
+ *
+ * Puts the timer in one pulse mode (see TIMER_ONE_PULSE), stopped.
+ * Each time the timer is started afterwards, the channel's output
+ * goes active 'delay' ticks after the start, for 'width' ticks, with
+ * no CPU involvement; the timer then stops, ready for the next start.
+ *
+ * Start it from software with timer_resume(), or from hardware with
+ * timer_set_slave_mode(dev, trigger, TIMER_SMCR_SMS_TRIGGER), where
+ * trigger is TIMER_SMCR_TS_TI1FP1 or TIMER_SMCR_TS_TI2FP2 for an edge
+ * on the pin of channel 1 or 2 (set to TIMER_INPUT_CAPTURE mode; see
+ * timer_cc_set_pol() for falling edges), TIMER_SMCR_TS_ETRF for the
+ * external trigger pin, or one of TIMER_SMCR_TS_ITR0 to ITR3 for
+ * another timer's trigger output.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED or TIMER_GENERAL.
+ * @param channel Output channel.
+ * @param delay Ticks from the start to the pulse, at least 1.
+ * @param width Pulse width in ticks, at least 1. delay + width may
+ *              be at most 65,536.
+ */
+void timer_set_one_pulse(timer_dev *dev, uint8 channel,
+                         uint16 delay, uint16 width) {
+    ASSERT(delay >= 1 && width >= 1 && (uint32)delay + width <= 0x10000);
+
+    timer_pause(dev);
+    one_pulse_mode(dev, channel);
+    timer_set_reload(dev, (uint16)(delay + width - 1));
+    timer_set_compare(dev, channel, delay);
+    /* Load the preloaded registers now, leaving the counter at 0. */
+    timer_generate_update(dev);
+}
+
+/**
+ * @brief Drive a half-bridge from an advanced timer channel.
+ *
+ * Puts the channel in PWM mode with its compare value preloaded, and
+ * enables both its output (CHx, the high side) and its complementary
+ * output (CHxN, the low side), both active high. Use
+ * timer_set_dead_time() so that the two are never active together.
+ *
+ * The outputs are also set to be driven to their inactive levels
+ * whenever they are disabled, including after a break, rather than
+ * left floating.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ * @param channel Channel, from 1 to 3.
+ */
+void timer_set_complementary_pwm(timer_dev *dev, uint8 channel) {
+    ASSERT(dev->type == TIMER_ADVANCED && channel >= 1 && channel <= 3);
+
+    pwm_mode(dev, channel);
+    timer_cc_set_pol(dev, channel, 0);
+    timer_ccn_set_pol(dev, channel, 0);
+    timer_ccn_enable(dev, channel);
+    (dev->regs).adv->BDTR |= TIMER_BDTR_OSSR | TIMER_BDTR_OSSI;
+}
+
+/**
+ * @brief Set an advanced timer's dead time.
+ *
+ * The dead time delays each rising edge of every channel's output and
+ * complementary output, so that a half-bridge's two switches are
+ * never on together.
+ *
+ * @param dev Timer device, must have type TIMER_ADVANCED.
+ * @param ticks Dead time in timer clock cycles (not prescaled). The
+ *              hardware resolution gets coarser above 127 cycles, so
+ *              this is rounded up to the next possible value, up to a
+ *              maximum of 1,008 cycles.
+ * @return The dead time set, in timer clock cycles.
+ */
+uint32 timer_set_dead_time(timer_dev *dev, uint32 ticks) {
+    uint32 dtg, actual;
+    ASSERT(dev->type == TIMER_ADVANCED);
+
+    /* DTG[7:5] selects a step and offset; see TIMx_BDTR in the
+     * reference manual. */
+    if (ticks <= 127) {
+        dtg = ticks;
+        actual = ticks;
+    } else if (ticks <= 2 * 127) {
+        uint32 n = (ticks + 1) / 2;
+        dtg = 0x80 | (n - 64);
+        actual = 2 * n;
+    } else if (ticks <= 8 * 63) {
+        uint32 n = (ticks + 7) / 8;
+        dtg = 0xC0 | (n - 32);
+        actual = 8 * n;
+    } else {
+        uint32 n = (ticks + 15) / 16;
+        if (n > 63) {
+            n = 63;
+        }
+        dtg = 0xE0 | (n - 32);
+        actual = 16 * n;
     }
+
+    uint32 bdtr = (dev->regs).adv->BDTR;
+    (dev->regs).adv->BDTR = (bdtr & ~TIMER_BDTR_DTG) | dtg;
+    return actual;
 }
 
 /**
@@ -312,6 +493,27 @@ static void output_compare_mode(timer_dev *dev, uint8 channel) {
     timer_cc_enable(dev, channel);
 }
 
+static void input_capture_mode(timer_dev *dev, uint8 channel) {
+    timer_cc_disable(dev, channel);
+    timer_ic_set_mode(dev, channel, TIMER_IC_INPUT_DIRECT, 0);
+    timer_cc_set_pol(dev, channel, 0);
+    timer_cc_enable(dev, channel);
+}
+
+static void one_pulse_mode(timer_dev *dev, uint8 channel) {
+    timer_opm_enable(dev);
+    timer_oc_set_mode(dev, channel, TIMER_OC_MODE_PWM_2, TIMER_OC_PE);
+    timer_cc_enable(dev, channel);
+}
+
+static void encoder_mode(timer_dev *dev, uint8 channel) {
+    ASSERT(channel == 1 || channel == 2);
+    timer_cc_disable(dev, channel);
+    timer_ic_set_mode(dev, channel, TIMER_IC_INPUT_DIRECT, 0);
+    timer_cc_set_pol(dev, channel, 0);
+    timer_set_slave_mode(dev, TIMER_SMCR_TS_ITR0, TIMER_SMCR_SMS_ENCODER3);
+}
+
 static void enable_adv_irq(timer_dev *dev, timer_interrupt_id id);
 static void enable_bas_gen_irq(timer_dev *dev);
 
@@ -0,0 +1,296 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libraries/ADCFilter/ADCFilter.cpp
+ * @brief Fixed-point decimation and smoothing filters for ADC streams
+ *
+ * Each filter processes one channel at a time with its state held in
+ * local variables, striding over the interleaved buffer, so the inner
+ * loops stay in registers. The hot loops are unrolled by hand; GCC
+ * does not unroll at -Os.
+ */
+
+#include "ADCFilter.h"
+
+#include <libmaple/util.h>
+
+/*
+ * Helpers
+ */
+
+// Sum n samples spaced stride apart, using two accumulators so
+// consecutive loads and adds can overlap.
+static inline uint32 accumulate(const uint16 *x, uint32 n, uint32 stride) {
+    uint32 a = 0, b = 0;
+    while (n >= 4) {
+        a += x[0];
+        b += x[stride];
+        a += x[2 * stride];
+        b += x[3 * stride];
+        x += 4 * stride;
+        n -= 4;
+    }
+    while (n--) {
+        a += *x;
+        x += stride;
+    }
+    return a + b;
+}
+
+static inline uint8 clamp_channels(uint8 channels) {
+    if (channels == 0) {
+        return 1;
+    }
+    return channels > ADC_FILTER_MAX_CHANNELS ? ADC_FILTER_MAX_CHANNELS
+                                              : channels;
+}
+
+/*
+ * BoxcarDecimator
+ */
+
+BoxcarDecimator::BoxcarDecimator(uint8 channels, uint8 extraBits) {
+    ASSERT(extraBits >= 1 && extraBits <= 4);
+    this->channels = clamp_channels(channels);
+    this->extraBits = extraBits;
+    this->ratio = 1 << (2 * extraBits);
+    this->reset();
+}
+
+void BoxcarDecimator::reset(void) {
+    this->phase = 0;
+    for (uint8 c = 0; c < ADC_FILTER_MAX_CHANNELS; c++) {
+        this->sums[c] = 0;
+    }
+}
+
+uint32 BoxcarDecimator::process(const uint16 *in, uint32 count,
+                                uint16 *out) {
+    uint32 stride = this->channels;
+    uint32 scans = count / stride;
+    uint32 phase = this->phase;
+    uint32 outputs = 0;
+
+    for (uint32 c = 0; c < stride; c++) {
+        const uint16 *x = in + c;
+        uint16 *y = out + c;
+        uint32 sum = this->sums[c];
+        uint32 left = scans;
+        phase = this->phase;
+        outputs = 0;
+        while (left > 0) {
+            uint32 take = this->ratio - phase;
+            if (take > left) {
+                take = left;
+            }
+            sum += accumulate(x, take, stride);
+            x += take * stride;
+            left -= take;
+            phase += take;
+            if (phase == this->ratio) {
+                *y = (uint16)(sum >> this->extraBits);
+                y += stride;
+                outputs++;
+                sum = 0;
+                phase = 0;
+            }
+        }
+        this->sums[c] = sum;
+    }
+    this->phase = phase;
+    return outputs * stride;
+}
+
+/*
+ * CICDecimator
+ */
+
+CICDecimator::CICDecimator(uint8 channels, uint8 order, uint8 log2Ratio,
+                           uint8 outputBits) {
+    ASSERT(order >= 1 && order <= CIC_MAX_ORDER);
+    ASSERT(12 + order * log2Ratio <= 32);
+    uint8 bits = 12 + order * log2Ratio;
+    if (outputBits > 16) {
+        outputBits = 16;
+    }
+    this->channels = clamp_channels(channels);
+    this->order = order;
+    this->shift = bits > outputBits ? bits - outputBits : 0;
+    this->ratio = 1 << log2Ratio;
+    this->reset();
+}
+
+void CICDecimator::reset(void) {
+    this->phase = 0;
+    for (uint8 c = 0; c < ADC_FILTER_MAX_CHANNELS; c++) {
+        for (uint8 k = 0; k < CIC_MAX_ORDER; k++) {
+            this->integrators[c][k] = 0;
+            this->combs[c][k] = 0;
+        }
+    }
+}
+
+uint32 CICDecimator::process(const uint16 *in, uint32 count, uint16 *out) {
+    uint32 stride = this->channels;
+    uint32 scans = count / stride;
+    uint32 phase = this->phase;
+    uint32 outputs = 0;
+
+    for (uint32 c = 0; c < stride; c++) {
+        const uint16 *x = in + c;
+        uint16 *y = out + c;
+        uint32 *comb = this->combs[c];
+        // All stages are always integrated; the unused ones just
+        // wrap. That is cheaper than branching on the order.
+        uint32 i0 = this->integrators[c][0];
+        uint32 i1 = this->integrators[c][1];
+        uint32 i2 = this->integrators[c][2];
+        uint32 i3 = this->integrators[c][3];
+        uint32 left = scans;
+        phase = this->phase;
+        outputs = 0;
+        while (left > 0) {
+            uint32 take = this->ratio - phase;
+            if (take > left) {
+                take = left;
+            }
+            left -= take;
+            phase += take;
+            while (take >= 2) {
+                i0 += x[0];
+                i1 += i0;
+                i2 += i1;
+                i3 += i2;
+                i0 += x[stride];
+                i1 += i0;
+                i2 += i1;
+                i3 += i2;
+                x += 2 * stride;
+                take -= 2;
+            }
+            if (take) {
+                i0 += *x;
+                i1 += i0;
+                i2 += i1;
+                i3 += i2;
+                x += stride;
+            }
+            if (phase == this->ratio) {
+                uint32 v;
+                switch (this->order) {
+                case 1: v = i0; break;
+                case 2: v = i1; break;
+                case 3: v = i2; break;
+                default: v = i3; break;
+                }
+                for (uint8 k = 0; k < this->order; k++) {
+                    uint32 prev = comb[k];
+                    comb[k] = v;
+                    v -= prev;
+                }
+                *y = (uint16)(v >> this->shift);
+                y += stride;
+                outputs++;
+                phase = 0;
+            }
+        }
+        this->integrators[c][0] = i0;
+        this->integrators[c][1] = i1;
+        this->integrators[c][2] = i2;
+        this->integrators[c][3] = i3;
+    }
+    this->phase = phase;
+    return outputs * stride;
+}
+
+/*
+ * IIRFilter
+ */
+
+IIRFilter::IIRFilter(uint8 channels, uint8 shift, uint32 decimation) {
+    ASSERT(shift >= 1 && shift <= 15);
+    this->channels = clamp_channels(channels);
+    this->shift = shift;
+    this->decimation = decimation ? decimation : 1;
+    this->reset();
+}
+
+void IIRFilter::reset(uint16 value) {
+    this->phase = 0;
+    for (uint8 c = 0; c < ADC_FILTER_MAX_CHANNELS; c++) {
+        this->states[c] = ((uint32)value << 4) << this->shift;
+    }
+}
+
+// The state holds the output scaled by 2^shift, so the division by
+// 2^shift never loses the fraction.
+uint32 IIRFilter::process(const uint16 *in, uint32 count, uint16 *out) {
+    uint32 stride = this->channels;
+    uint32 scans = count / stride;
+    uint32 k = this->shift;
+    uint32 phase = this->phase;
+    uint32 outputs = 0;
+
+    for (uint32 c = 0; c < stride; c++) {
+        const uint16 *x = in + c;
+        uint16 *y = out + c;
+        uint32 s = this->states[c];
+        uint32 left = scans;
+        phase = this->phase;
+        outputs = 0;
+        if (this->decimation == 1) {
+            while (left >= 2) {
+                s += ((uint32)x[0] << 4) - (s >> k);
+                y[0] = (uint16)(s >> k);
+                s += ((uint32)x[stride] << 4) - (s >> k);
+                y[stride] = (uint16)(s >> k);
+                x += 2 * stride;
+                y += 2 * stride;
+                left -= 2;
+            }
+            if (left) {
+                s += ((uint32)*x << 4) - (s >> k);
+                *y = (uint16)(s >> k);
+            }
+            outputs = scans;
+        } else {
+            while (left--) {
+                s += ((uint32)*x << 4) - (s >> k);
+                x += stride;
+                if (++phase == this->decimation) {
+                    *y = (uint16)(s >> k);
+                    y += stride;
+                    outputs++;
+                    phase = 0;
+                }
+            }
+        }
+        this->states[c] = s;
+    }
+    this->phase = phase;
+    return outputs * stride;
+}
@@ -0,0 +1,173 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libraries/ADCFilter/ADCFilter.h
+ * @brief Fixed-point decimation and smoothing filters for ADC streams
+ *
+ * The filters work in place on the interleaved buffers delivered by
+ * HardwareADC's stream callbacks, one state per channel, and are
+ * cheap enough to run from the DMA interrupt. They keep their state
+ * between calls, so a decimation period may span several buffers.
+ */
+
+#ifndef _ADCFILTER_H_
+#define _ADCFILTER_H_
+
+#include <libmaple/libmaple_types.h>
+
+/** Most interleaved channels a filter can handle. */
+static const uint8 ADC_FILTER_MAX_CHANNELS = 16;
+
+/** Highest CIC filter order. */
+static const uint8 CIC_MAX_ORDER = 4;
+
+/**
+ * @brief Boxcar oversampling decimator.
+ *
+ * Sums 4^n consecutive samples of each channel and scales the sum
+ * down by 2^n, trading sample rate for n extra bits of resolution.
+ * The input must contain enough noise (at least a few LSBs) for the
+ * extra bits to be meaningful.
+ */
+class BoxcarDecimator {
+public:
+    /**
+     * @param channels Number of interleaved channels, from 1 to
+     *                 ADC_FILTER_MAX_CHANNELS.
+     * @param extraBits Extra bits of resolution, from 1 to 4. The
+     *                  decimation ratio is 4^extraBits, and outputs
+     *                  have 12 + extraBits bits.
+     */
+    BoxcarDecimator(uint8 channels, uint8 extraBits);
+
+    /**
+     * @brief Filter a block of interleaved samples.
+     * @param in Input samples; a whole number of scans.
+     * @param count Number of input samples.
+     * @param out Output samples, interleaved like the input. May be
+     *            the same buffer as in.
+     * @return Number of output samples written.
+     */
+    uint32 process(const uint16 *in, uint32 count, uint16 *out);
+
+    /**
+     * @brief Discard partial sums.
+     */
+    void reset(void);
+
+private:
+    uint8 channels;
+    uint8 extraBits;
+    uint32 ratio;
+    uint32 phase;
+    uint32 sums[ADC_FILTER_MAX_CHANNELS];
+};
+
+/**
+ * @brief Cascaded integrator-comb (CIC) decimator.
+ *
+ * A CIC filter of order N and ratio R is N boxcar filters in series
+ * computed with N integrators at the input rate and N combs at the
+ * output rate, so it costs a handful of additions per sample for any
+ * R. Its stopband attenuation is far better than a single boxcar's.
+ * The first N outputs after a reset are settling and should be
+ * discarded.
+ */
+class CICDecimator {
+public:
+    /**
+     * @param channels Number of interleaved channels, from 1 to
+     *                 ADC_FILTER_MAX_CHANNELS.
+     * @param order Filter order, from 1 to CIC_MAX_ORDER.
+     * @param log2Ratio Base two logarithm of the decimation ratio.
+     *                  12 + order * log2Ratio must not exceed 32.
+     * @param outputBits Output resolution, at most 16 and at most
+     *                   12 + order * log2Ratio.
+     */
+    CICDecimator(uint8 channels, uint8 order, uint8 log2Ratio,
+                 uint8 outputBits);
+
+    /**
+     * @brief Filter a block of interleaved samples.
+     * @see BoxcarDecimator::process()
+     */
+    uint32 process(const uint16 *in, uint32 count, uint16 *out);
+
+    /**
+     * @brief Clear the integrators and combs.
+     */
+    void reset(void);
+
+private:
+    uint8 channels;
+    uint8 order;
+    uint8 shift;
+    uint32 ratio;
+    uint32 phase;
+    uint32 integrators[ADC_FILTER_MAX_CHANNELS][CIC_MAX_ORDER];
+    uint32 combs[ADC_FILTER_MAX_CHANNELS][CIC_MAX_ORDER];
+};
+
+/**
+ * @brief Single-pole IIR low-pass filter.
+ *
+ * Computes y += (x - y) / 2^k for each sample, an exponential moving
+ * average with a time constant of about 2^k samples. Outputs are
+ * scaled to 16 bits (the input times 16), keeping the resolution the
+ * averaging gains.
+ */
+class IIRFilter {
+public:
+    /**
+     * @param channels Number of interleaved channels, from 1 to
+     *                 ADC_FILTER_MAX_CHANNELS.
+     * @param shift Filter constant k, from 1 to 15.
+     * @param decimation Output one scan every decimation inputs.
+     */
+    IIRFilter(uint8 channels, uint8 shift, uint32 decimation = 1);
+
+    /**
+     * @brief Filter a block of interleaved samples.
+     * @see BoxcarDecimator::process()
+     */
+    uint32 process(const uint16 *in, uint32 count, uint16 *out);
+
+    /**
+     * @brief Start again from the given input value.
+     * @param value Input value to settle every channel at.
+     */
+    void reset(uint16 value = 0);
+
+private:
+    uint8 channels;
+    uint8 shift;
+    uint32 decimation;
+    uint32 phase;
+    uint32 states[ADC_FILTER_MAX_CHANNELS];
+};
+
+#endif
@@ -0,0 +1,304 @@
+/*
+ * ADCFilter host test.
+ *
+ * Checks the boxcar, CIC and IIR filters for DC gain and step response,
+ * then that their outputs do not depend on how the stream is split
+ * into buffers, that in-place filtering of interleaved channels gives
+ * each channel what it would get alone, and finally compares them all
+ * against straightforward double precision versions of the same
+ * filters on a noisy sine.
+ *
+ * This file is released into the public domain.
+ */
+
+#include <ADCFilter/ADCFilter.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+
+#define MAX_SAMPLES 4096
+
+static uint16 in[MAX_SAMPLES];
+static uint16 out[MAX_SAMPLES];
+static uint16 ref[MAX_SAMPLES];
+static uint16 alone[MAX_SAMPLES];
+static double wide[MAX_SAMPLES];
+static char what[128];
+
+static uint32 seed = 1;
+
+/* The filters ASSERT on their arguments */
+extern "C" void _fail(const char *file, int line, const char *exp) {
+    fprintf(stderr, "ASSERT failed: %s:%d: %s\n", file, line, exp);
+    abort();
+}
+
+/* Deterministic noise, uniform in [-spread, spread] */
+static int32 noise(int32 spread) {
+    seed = seed * 1664525 + 1013904223;
+    return (int32)((seed >> 8) % (2 * spread + 1)) - spread;
+}
+
+static uint16 clip(int32 value) {
+    return value < 0 ? 0 : (value > 4095 ? 4095 : (uint16)value);
+}
+
+static void constant(uint16 *x, uint32 count, uint16 value) {
+    for (uint32 i = 0; i < count; i++) {
+        x[i] = value;
+    }
+}
+
+/* A sine of the given period with a few LSBs of noise on it */
+static void noisySine(uint16 *x, uint32 count, double period) {
+    for (uint32 i = 0; i < count; i++) {
+        x[i] = clip((int32)(2048 + 1500 * sin(2 * M_PI * i / period)) +
+                    noise(8));
+    }
+}
+
+static bool all(const uint16 *y, uint32 from, uint32 to, uint16 value) {
+    for (uint32 i = from; i < to; i++) {
+        if (y[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Feeds the stream in pieces of the given number of samples */
+template<class Filter>
+static uint32 inPieces(Filter *f, const uint16 *x, uint32 count, uint16 *y,
+                       uint32 piece) {
+    uint32 outputs = 0;
+    for (uint32 i = 0; i < count; i += piece) {
+        uint32 len = count - i < piece ? count - i : piece;
+        outputs += f->process(x + i, len, y + outputs);
+    }
+    return outputs;
+}
+
+/*
+ * Filters interleaved noise with fresh, a filter for the given number
+ * of channels, in one go, in odd-sized pieces and in place, and each
+ * channel on its own with single, the same filter for one channel.
+ */
+template<class Filter>
+static void checkStreams(const char *name, const Filter &fresh,
+                         const Filter &single, uint32 channels) {
+    uint32 count = channels * (MAX_SAMPLES / channels);
+    for (uint32 i = 0; i < count; i++) {
+        in[i] = clip(1000 * (i % channels) + 500 + noise(400));
+    }
+    Filter whole = fresh;
+    uint32 outputs = whole.process(in, count, ref);
+
+    Filter pieces = fresh;
+    uint32 n = inPieces(&pieces, in, count, out, 7 * channels);
+    snprintf(what, sizeof(what),
+             "%s: outputs do not depend on the buffer size", name);
+    check(n == outputs && !memcmp(out, ref, n * sizeof(uint16)), what);
+
+    Filter inPlace = fresh;
+    memcpy(out, in, count * sizeof(uint16));
+    n = inPlace.process(out, count, out);
+    snprintf(what, sizeof(what), "%s: in-place filtering", name);
+    check(n == outputs && !memcmp(out, ref, n * sizeof(uint16)), what);
+
+    bool same = true;
+    for (uint32 c = 0; c < channels; c++) {
+        uint32 scans = count / channels;
+        for (uint32 i = 0; i < scans; i++) {
+            alone[i] = in[i * channels + c];
+        }
+        Filter one = single;
+        n = one.process(alone, scans, alone);
+        same = same && (n * channels == outputs);
+        for (uint32 i = 0; same && i < n; i++) {
+            same = alone[i] == ref[i * channels + c];
+        }
+    }
+    snprintf(what, sizeof(what),
+             "%s: interleaved channels are filtered separately", name);
+    check(same, what);
+}
+
+static void testBoxcar(void) {
+    BoxcarDecimator dc(1, 2);
+    constant(in, 64, 1000);
+    check(dc.process(in, 64, out) == 4 && all(out, 0, 4, 4000),
+          "boxcar: DC gain is 2^extraBits");
+
+    BoxcarDecimator full(1, 4);
+    constant(in, 256, 4095);
+    check(full.process(in, 256, out) == 1 && out[0] == 65520,
+          "boxcar: full scale fits 16 bits");
+
+    BoxcarDecimator step(1, 2);
+    constant(in, 22, 0);
+    constant(in + 22, 26, 400);
+    check(step.process(in, 48, out) == 3 && out[0] == 0 &&
+          out[1] == 10 * 400 / 4 && out[2] == 16 * 400 / 4,
+          "boxcar: step response");
+
+    BoxcarDecimator partial(1, 2);
+    constant(in, 16, 100);
+    check(partial.process(in, 10, out) == 0 &&
+          partial.process(in, 6, out) == 1 && out[0] == 400,
+          "boxcar: a period spans two buffers");
+    partial.process(in, 10, out);
+    partial.reset();
+    check(partial.process(in, 16, out) == 1 && out[0] == 400,
+          "boxcar: reset() drops the partial sum");
+
+    checkStreams("boxcar", BoxcarDecimator(3, 2), BoxcarDecimator(1, 2), 3);
+}
+
+static void testCIC(void) {
+    CICDecimator dc(1, 3, 4, 16);
+    constant(in, 8 * 16, 1000);
+    check(dc.process(in, 8 * 16, out) == 8 && out[0] < out[1] &&
+          out[1] < out[2] && all(out, 3, 8, 16000),
+          "CIC: settles after order outputs to a DC gain of 2^(bits-12)");
+
+    CICDecimator step(1, 3, 4, 16);
+    constant(in, 4 * 16, 0);
+    constant(in + 4 * 16, 6 * 16, 2000);
+    check(step.process(in, 10 * 16, out) == 10 && all(out, 0, 4, 0) &&
+          out[4] > 0 && out[4] < out[5] && out[5] < 32000 &&
+          all(out, 6, 10, 32000),
+          "CIC: step response spans order outputs");
+
+    CICDecimator first(1, 1, 4, 14);
+    BoxcarDecimator boxcar(1, 2);
+    noisySine(in, 1024, 100);
+    uint32 n = first.process(in, 1024, out);
+    check(n == 64 && boxcar.process(in, 1024, ref) == n &&
+          !memcmp(out, ref, n * sizeof(uint16)),
+          "CIC: order 1 is a boxcar");
+
+    CICDecimator wrap(1, 4, 5, 16);
+    constant(in, 64 * 32, 4095);
+    n = wrap.process(in, 64 * 32, out);
+    check(n == 64 && all(out, 4, 64, 4095 * 16),
+          "CIC: 32 bit integrators wrap harmlessly at full scale");
+
+    checkStreams("CIC", CICDecimator(4, 2, 4, 16),
+                 CICDecimator(1, 2, 4, 16), 4);
+}
+
+static void testIIR(void) {
+    IIRFilter dc(1, 4);
+    dc.reset(1000);
+    constant(in, 100, 1000);
+    check(dc.process(in, 100, out) == 100 && all(out, 0, 100, 16000),
+          "IIR: reset() settles, DC gain is 16");
+
+    IIRFilter step(1, 4);
+    constant(in, 400, 1000);
+    step.process(in, 400, out);
+    bool rising = true;
+    for (uint32 i = 1; i < 400; i++) {
+        rising = rising && out[i] >= out[i - 1];
+    }
+    check(rising && fabs(out[15] - 16000 * (1 - pow(1 - 1.0 / 16, 16))) <= 2
+          && out[399] >= 15999, "IIR: step response has a 2^k time constant");
+
+    IIRFilter every(1, 4);
+    IIRFilter fifth(1, 4, 5);
+    noisySine(in, 1000, 150);
+    every.process(in, 1000, ref);
+    bool picked = fifth.process(in, 1000, out) == 200;
+    for (uint32 i = 0; picked && i < 200; i++) {
+        picked = out[i] == ref[5 * i + 4];
+    }
+    check(picked, "IIR: decimation keeps every nth output");
+
+    checkStreams("IIR", IIRFilter(2, 3, 3), IIRFilter(1, 3, 3), 2);
+    checkStreams("IIR undecimated", IIRFilter(5, 6), IIRFilter(1, 6), 5);
+}
+
+/*
+ * The same filters computed directly in double precision, with no
+ * running state to get wrong.
+ */
+static void testReference(void) {
+    uint32 count = MAX_SAMPLES;
+    noisySine(in, count, 700);
+
+    for (uint8 bits = 1; bits <= 4; bits++) {
+        BoxcarDecimator f(1, bits);
+        uint32 ratio = 1 << (2 * bits);
+        uint32 n = f.process(in, count, out);
+        bool same = n == count / ratio;
+        for (uint32 m = 0; same && m < n; m++) {
+            double sum = 0;
+            for (uint32 i = 0; i < ratio; i++) {
+                sum += in[m * ratio + i];
+            }
+            same = out[m] == (uint16)floor(sum / (1 << bits));
+        }
+        snprintf(what, sizeof(what),
+                 "boxcar matches the reference, %u extra bits", bits);
+        check(same, what);
+    }
+
+    // Order N of CIC is N moving sums of R samples, read every R
+    // samples. The integrators start from zero, as if the input had
+    // been zero before, so even the settling outputs must match.
+    for (uint8 order = 1; order <= CIC_MAX_ORDER; order++) {
+        uint8 log2Ratio = 5;
+        uint32 ratio = 1 << log2Ratio;
+        CICDecimator f(1, order, log2Ratio, 16);
+        uint32 n = f.process(in, count, out);
+        for (uint32 i = 0; i < count; i++) {
+            wide[i] = in[i];
+        }
+        for (uint8 k = 0; k < order; k++) {
+            double sum = 0;
+            for (uint32 i = count; i-- > 0; ) {
+                sum = 0;
+                for (uint32 j = 0; j < ratio && j <= i; j++) {
+                    sum += wide[i - j];
+                }
+                wide[i] = sum;
+            }
+        }
+        double scale = pow(2, 12 + order * log2Ratio - 16);
+        bool same = n == count / ratio;
+        for (uint32 m = 0; same && m < n; m++) {
+            same = out[m] == (uint16)floor(wide[(m + 1) * ratio - 1] / scale);
+        }
+        snprintf(what, sizeof(what), "CIC matches the reference, order %u",
+                 order);
+        check(same, what);
+    }
+
+    // The fixed-point state truncates instead of keeping fractions,
+    // which may cost an LSB or two of the 16 bit output.
+    for (uint8 shift = 2; shift <= 14; shift += 4) {
+        IIRFilter f(1, shift);
+        f.process(in, count, out);
+        double y = 0, worst = 0;
+        for (uint32 i = 0; i < count; i++) {
+            y += (16.0 * in[i] - y) / (1 << shift);
+            if (fabs(out[i] - y) > worst) {
+                worst = fabs(out[i] - y);
+            }
+        }
+        snprintf(what, sizeof(what),
+                 "IIR matches the reference within 2 LSBs, k = %u "
+                 "(worst %.2f)", shift, worst);
+        check(worst <= 2, what);
+    }
+}
+
+int main(void) {
+    testBoxcar();
+    testCIC();
+    testIIR();
+    testReference();
+    return finish("ADCFilter test");
+}
@@ -0,0 +1,499 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file FatFile.cpp
+ * @brief File in the root directory of a FatVolume
+ */
+
+#include <Card/FAT/FatFile.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Most clusters counted ahead when looking for contiguous runs */
+static const uint32 FAT_RUN_MAX = 128;
+
+/**
+ * @brief Converts a file name into the space padded 8.3 form used on disk
+ * @retval true if the name is a valid 8.3 name
+ */
+static bool fat_name(const char *path, uint8 *name) {
+    static const char invalid[] = "\"*+,/:;<=>?[\\]|";
+    uint32 i = 0;
+    uint32 limit = 8;
+    memset(name, ' ', 11);
+    if (*path == '/') {
+        path++;
+    }
+    for (; *path; path++) {
+        char c = *path;
+        if (c == '.') {
+            if (limit == 11 || i == 0) {
+                return false;
+            }
+            i = 8;
+            limit = 11;
+            continue;
+        } else if ((c <= ' ') || strchr(invalid, c) || (i >= limit)) {
+            return false;
+        } else if ((c >= 'a') && (c <= 'z')) {
+            c -= 'a' - 'A';
+        }
+        name[i++] = c;
+    }
+    return i > 0;
+}
+
+/**
+ * @brief Constructor for a closed file
+ */
+FatFile::FatFile(void) {
+    this->volume = NULL;
+    this->mode = 0;
+    this->size = 0;
+    this->position = 0;
+    this->firstCluster = 0;
+    this->cluster = 0;
+    this->clusterIndex = 0;
+    this->contiguous = 0;
+    this->dirty = false;
+    this->status = 0;
+}
+
+/**
+ * @brief Opens a file in the root directory
+ * @param vol Mounted volume
+ * @param path 8.3 file name, like "LOG001.CSV"
+ * @param flags FatMode flags, FAT_READ and/or FAT_WRITE at least
+ * @retval 0 on success, otherwise FAT_ERR_ flags or device error flags
+ */
+uint32 FatFile::open(FatVolume *vol, const char *path, uint32 flags) {
+    uint8 name[11];
+    this->close();
+    if (!fat_name(path, name) || !(flags & (FAT_READ | FAT_WRITE))) {
+        return this->status = FAT_ERR_ACCESS;
+    }
+    uint32 status = vol->find(name, &this->index);
+    if ((status == FAT_ERR_NOT_FOUND) &&
+        (flags & FAT_CREATE) && (flags & FAT_WRITE)) {
+        status = vol->create(name, &this->index);
+    }
+    fat_dirent *ent;
+    if (!status) {
+        status = vol->dirent(this->index, &ent, false);
+    }
+    if (status) {
+        return this->status = status;
+    }
+    if ((ent->attr & FAT_ATTR_DIRECTORY) ||
+        ((ent->attr & FAT_ATTR_READ_ONLY) && (flags & FAT_WRITE))) {
+        return this->status = FAT_ERR_ACCESS;
+    }
+    this->volume = vol;
+    this->mode = flags;
+    this->size = ent->fileSize;
+    this->firstCluster = ent->fstClusLO;
+    if (vol->type == FAT_TYPE_32) {
+        this->firstCluster |= (uint32)ent->fstClusHI << 16;
+    }
+    this->position = 0;
+    this->cluster = this->firstCluster;
+    this->clusterIndex = 0;
+    this->contiguous = 0;
+    this->dirty = false;
+    this->status = 0;
+    if ((flags & FAT_TRUNC) && (flags & FAT_WRITE) && this->firstCluster) {
+        this->size = 0;
+        this->status = this->truncate();
+    }
+    if (flags & FAT_APPEND) {
+        this->position = this->size;
+    }
+    return this->status;
+}
+
+/**
+ * @brief Reads from the current position
+ * @param buf Buffer to read into
+ * @param len Number of bytes to read
+ * @retval Number of bytes read, short at the end of file or on error
+ * @note Whole blocks read into a word aligned buf skip the cache
+ */
+uint32 FatFile::read(void *buf, uint32 len) {
+    if (!(this->mode & FAT_READ)) {
+        this->status = FAT_ERR_ACCESS;
+        return 0;
+    }
+    if (this->position >= this->size) {
+        return 0;
+    } else if (len > this->size - this->position) {
+        len = this->size - this->position;
+    }
+    uint8 *dst = (uint8*)buf;
+    uint32 done = 0;
+    while (done < len) {
+        this->status = this->locate(false);
+        if (this->status) {
+            break;
+        }
+        uint32 blk = this->volume->block(this->cluster) +
+                     ((this->position >> 9) &
+                      ((1 << this->volume->clusterShift) - 1));
+        uint32 offset = this->position & 511;
+        uint32 left = len - done;
+        uint32 bytes;
+        if (!offset && (left >= 512) && !((uintptr_t)dst & 0x3)) {
+            uint32 n = this->span(left >> 9);
+            this->status = this->volume->cache->read(blk, (uint32*)dst, n);
+            bytes = n << 9;
+        } else {
+            uint32 *data;
+            this->status = this->volume->cache->fetch(blk, &data, false);
+            bytes = (left < 512 - offset) ? left : 512 - offset;
+            if (!this->status) {
+                memcpy(dst, (uint8*)data + offset, bytes);
+            }
+        }
+        if (this->status) {
+            break;
+        }
+        dst += bytes;
+        done += bytes;
+        this->position += bytes;
+    }
+    return done;
+}
+
+/**
+ * @brief Writes at the current position, growing the file as needed
+ * @param buf Data to write
+ * @param len Number of bytes to write
+ * @retval Number of bytes written, short on error
+ * @note Whole blocks written from a word aligned buf go straight to the
+ *       card with one multi-block write per contiguous run of clusters.
+ *       Use preallocate() to make those runs long.
+ */
+uint32 FatFile::write(const void *buf, uint32 len) {
+    if (!(this->mode & FAT_WRITE)) {
+        this->status = FAT_ERR_ACCESS;
+        return 0;
+    }
+    const uint8 *src = (const uint8*)buf;
+    uint32 done = 0;
+    while (done < len) {
+        this->status = this->locate(true);
+        if (this->status) {
+            break;
+        }
+        uint32 blk = this->volume->block(this->cluster) +
+                     ((this->position >> 9) &
+                      ((1 << this->volume->clusterShift) - 1));
+        uint32 offset = this->position & 511;
+        uint32 left = len - done;
+        uint32 bytes;
+        if (!offset && (left >= 512) && !((uintptr_t)src & 0x3)) {
+            uint32 n = this->span(left >> 9);
+            this->status = this->volume->cache->write(blk, (const uint32*)src, n);
+            bytes = n << 9;
+        } else {
+            uint32 *data;
+            this->status = this->volume->cache->fetch(blk, &data, true);
+            bytes = (left < 512 - offset) ? left : 512 - offset;
+            if (!this->status) {
+                memcpy((uint8*)data + offset, src, bytes);
+            }
+        }
+        if (this->status) {
+            break;
+        }
+        src += bytes;
+        done += bytes;
+        this->position += bytes;
+        if (this->position > this->size) {
+            this->size = this->position;
+        }
+        this->dirty = true;
+    }
+    return done;
+}
+
+/**
+ * @brief Moves the current position
+ * @param pos New position, at most the file size
+ * @retval 0 on success, FAT_ERR_ACCESS past the end of file
+ */
+uint32 FatFile::seek(uint32 pos) {
+    if (!this->mode || (pos > this->size)) {
+        return this->status = FAT_ERR_ACCESS;
+    }
+    this->position = pos;
+    return 0;
+}
+
+/**
+ * @brief Reserves contiguous clusters for a growing file
+ * @param bytes File size to reserve room for
+ * @retval 0 on success, otherwise FAT_ERR_ flags or device error flags
+ * @note The clusters are allocated as one run, so later writes stream
+ *       into them with long multi-block writes. close() frees whatever
+ *       was not used.
+ */
+uint32 FatFile::preallocate(uint32 bytes) {
+    if (!(this->mode & FAT_WRITE)) {
+        return this->status = FAT_ERR_ACCESS;
+    }
+    uint32 shift = this->volume->clusterShift + 9;
+    uint32 need = (uint32)(((uint64)bytes + (1 << shift) - 1) >> shift);
+    uint32 have = 0;
+    uint32 last = 0;
+    if (this->firstCluster) {
+        uint32 value = this->firstCluster;
+        while (!this->volume->isEnd(value)) {
+            if (value < 2) {
+                return this->status = FAT_ERR_CORRUPT;
+            }
+            last = value;
+            have++;
+            this->status = this->volume->next(last, &value);
+            if (this->status) {
+                return this->status;
+            }
+        }
+    }
+    if (have >= need) {
+        return 0;
+    }
+    uint32 first;
+    this->status = this->volume->allocate(last, need - have, &first);
+    if (this->status) {
+        return this->status;
+    }
+    if (!this->firstCluster) {
+        this->firstCluster = first;
+        this->cluster = first;
+        this->clusterIndex = 0;
+        this->dirty = true;
+    }
+    this->contiguous = 0; // the chain after cluster has changed
+    return 0;
+}
+
+/**
+ * @brief Turns an empty file into one contiguous run of blocks
+ * @param bytes File size, rounded up to whole clusters on the card
+ * @param blk Set to the first block of the file
+ * @retval 0 on success, otherwise FAT_ERR_ flags or device error flags
+ * @note The file takes its full size at once, the caller then writes the
+ *       blocks blk onwards directly, for instance from a DataLogger
+ */
+uint32 FatFile::reserve(uint32 bytes, uint32 *blk) {
+    if (!(this->mode & FAT_WRITE) || this->firstCluster || !bytes) {
+        return this->status = FAT_ERR_ACCESS;
+    }
+    if (this->preallocate(bytes)) {
+        return this->status; // one allocate() call, so the run is contiguous
+    }
+    this->size = bytes;
+    this->dirty = true;
+    *blk = this->volume->block(this->firstCluster);
+    return this->sync();
+}
+
+/**
+ * @brief Updates the directory entry and writes all cached blocks
+ * @retval 0 on success, otherwise device error flags
+ */
+uint32 FatFile::sync(void) {
+    if (!this->mode) {
+        return 0;
+    }
+    if (this->dirty) {
+        fat_dirent *ent;
+        this->status = this->volume->dirent(this->index, &ent, true);
+        if (this->status) {
+            return this->status;
+        }
+        ent->fileSize = this->size;
+        ent->fstClusLO = this->firstCluster & 0xFFFF;
+        ent->fstClusHI = this->firstCluster >> 16;
+        ent->wrtDate = ent->lstAccDate = this->volume->date;
+        ent->wrtTime = this->volume->time;
+        ent->attr |= FAT_ATTR_ARCHIVE;
+        this->dirty = false;
+    }
+    return this->status = this->volume->sync();
+}
+
+/**
+ * @brief Frees unused preallocated clusters, syncs and closes the file
+ * @retval 0 on success, otherwise error as in sync()
+ */
+uint32 FatFile::close(void) {
+    if (!this->mode) {
+        return 0;
+    }
+    uint32 status = 0;
+    if (this->mode & FAT_WRITE) {
+        status = this->truncate();
+        uint32 synced = this->sync();
+        if (!status) {
+            status = synced;
+        }
+    }
+    this->mode = 0;
+    return status;
+}
+
+/**
+ * Cluster Chain Functions
+ */
+
+/**
+ * @brief Moves cluster to the cluster holding the current position
+ * @param extend Allocate clusters past the end of the chain
+ * @retval 0 on success, otherwise FAT_ERR_ flags or device error flags
+ * @note Walks forward from the last position, and steps over known
+ *       contiguous runs without reading the FAT
+ */
+uint32 FatFile::locate(bool extend) {
+    FatVolume *vol = this->volume;
+    uint32 want = this->position >> (vol->clusterShift + 9);
+    uint32 status;
+    if (!this->firstCluster) {
+        if (!extend) {
+            return FAT_ERR_CORRUPT;
+        }
+        status = vol->allocate(0, 1, &this->firstCluster);
+        if (status) {
+            return status;
+        }
+        this->cluster = this->firstCluster;
+        this->clusterIndex = 0;
+        this->contiguous = 0;
+        this->dirty = true;
+    }
+    if (want < this->clusterIndex) {
+        this->cluster = this->firstCluster;
+        this->clusterIndex = 0;
+        this->contiguous = 0;
+    }
+    while (this->clusterIndex < want) {
+        if (!this->contiguous) {
+            status = vol->run(this->cluster, FAT_RUN_MAX, &this->contiguous);
+            if (status) {
+                return status;
+            }
+        }
+        if (this->contiguous) {
+            uint32 step = want - this->clusterIndex;
+            if (step > this->contiguous) {
+                step = this->contiguous;
+            }
+            this->cluster += step;
+            this->clusterIndex += step;
+            this->contiguous -= step;
+            continue;
+        }
+        uint32 value;
+        status = vol->next(this->cluster, &value);
+        if (status) {
+            return status;
+        } else if (vol->isEnd(value)) {
+            if (!extend) {
+                return FAT_ERR_CORRUPT;
+            }
+            status = vol->allocate(this->cluster, 1, &value);
+            if (status) {
+                return status;
+            }
+        } else if (value < 2) {
+            return FAT_ERR_CORRUPT;
+        }
+        this->cluster = value;
+        this->clusterIndex++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Counts contiguous blocks from the current position
+ * @param max Most blocks to count
+ * @retval Blocks that can be transferred with one multi-block command
+ */
+uint32 FatFile::span(uint32 max) {
+    uint32 perCluster = 1 << this->volume->clusterShift;
+    uint32 n = perCluster - ((this->position >> 9) & (perCluster - 1));
+    if (!this->contiguous &&
+        this->volume->run(this->cluster, FAT_RUN_MAX, &this->contiguous)) {
+        this->contiguous = 0;
+    }
+    n += this->contiguous << this->volume->clusterShift;
+    return (n < max) ? n : max;
+}
+
+/**
+ * @brief Frees the clusters past the end of the file
+ * @retval 0 on success, otherwise FAT_ERR_ flags or device error flags
+ */
+uint32 FatFile::truncate(void) {
+    FatVolume *vol = this->volume;
+    uint32 shift = vol->clusterShift + 9;
+    uint32 keep = (uint32)(((uint64)this->size + (1 << shift) - 1) >> shift);
+    uint32 status;
+    if (!this->firstCluster) {
+        return 0;
+    }
+    this->cluster = this->firstCluster;
+    this->clusterIndex = 0;
+    this->contiguous = 0;
+    if (!keep) {
+        status = vol->release(this->firstCluster);
+        this->firstCluster = 0;
+        this->cluster = 0;
+        this->dirty = true;
+        return status;
+    }
+    uint32 last = this->firstCluster;
+    uint32 value;
+    for (uint32 i=1; i<keep; i++) {
+        status = vol->next(last, &value);
+        if (status) {
+            return status;
+        } else if (vol->isEnd(value) || (value < 2)) {
+            return FAT_ERR_CORRUPT;
+        }
+        last = value;
+    }
+    status = vol->next(last, &value);
+    if (status || vol->isEnd(value)) {
+        return status;
+    }
+    status = vol->set(last, 0xFFFFFFFF);
+    if (!status) {
+        status = vol->release(value);
+    }
+    return status;
+}
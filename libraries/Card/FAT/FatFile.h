@@ -0,0 +1,79 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file FatFile.h
+ * @brief File in the root directory of a FatVolume
+ */
+
+#ifndef _FATFILE_H_
+#define _FATFILE_H_
+
+#include <Card/FAT/FatVolume.h>
+
+typedef enum FatMode {
+    FAT_READ   = 0x01,
+    FAT_WRITE  = 0x02,
+    FAT_CREATE = 0x04, // create the file if it does not exist
+    FAT_TRUNC  = 0x08, // discard the contents on open
+    FAT_APPEND = 0x10  // start at the end of the file
+} FatMode;
+
+/**
+ * An open file. Names are 8.3, in the root directory. Reads and writes of
+ * whole, word aligned blocks go straight between the caller's buffer and
+ * the card, as one multi-block transfer per contiguous run of clusters.
+ */
+class FatFile {
+  public:
+    FatVolume *volume;
+    uint32 index;         // root directory entry number
+    uint32 mode;          // FatMode flags, 0 when closed
+    uint32 size;
+    uint32 position;
+    uint32 firstCluster;  // 0 for an empty file
+    uint32 cluster;       // cluster holding position, see locate()
+    uint32 clusterIndex;  // position of cluster in the chain
+    uint32 contiguous;    // clusters known to follow cluster directly
+    bool dirty;           // directory entry needs updating
+    uint32 status;        // last error
+
+    FatFile(void);
+    uint32 open(FatVolume*, const char*, uint32);
+    uint32 read(void*, uint32);
+    uint32 write(const void*, uint32);
+    uint32 seek(uint32);
+    uint32 preallocate(uint32);
+    uint32 reserve(uint32, uint32*);
+    uint32 sync(void);
+    uint32 close(void);
+  //private:
+    uint32 locate(bool);
+    uint32 span(uint32);
+    uint32 truncate(void);
+};
+
+#endif
@@ -0,0 +1,464 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file FatVolume.cpp
+ * @brief FAT16 and FAT32 volume on top of a BlockCache
+ */
+
+#include <Card/FAT/FatVolume.h>
+#include <string.h>
+
+/* Cluster numbers at and above these end a chain */
+static const uint32 FAT16_EOC = 0xFFF8;
+static const uint32 FAT32_EOC = 0x0FFFFFF8;
+/* Only the low 28 bits of a FAT32 entry belong to the cluster number */
+static const uint32 FAT32_MASK = 0x0FFFFFFF;
+
+/* Boot sector fields are little endian and not always aligned */
+static inline uint32 le16(const uint8 *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32 le32(const uint8 *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+/**
+ * @brief Checks for a FAT boot sector with 512 byte sectors
+ */
+static bool fat_is_boot(const uint8 *b) {
+    return (b[510] == 0x55) && (b[511] == 0xAA) &&
+           ((b[0] == 0xEB) || (b[0] == 0xE9)) && (le16(b + 11) == 512);
+}
+
+/**
+ * @brief Constructor for an unmounted volume
+ */
+FatVolume::FatVolume(void) {
+    this->cache = NULL;
+    this->type = FAT_TYPE_NONE;
+    this->fsinfo = 0;
+    this->nextFree = 2;
+    this->date = ((2012 - 1980) << 9) | (1 << 5) | 1; // 1 Jan 2012
+    this->time = 0;
+}
+
+/**
+ * @brief Mounts the volume on a card, or its first partition
+ * @param blocks Cache of the card to mount
+ * @retval 0 on success, FAT_ERR_NO_FS or the device error flags
+ */
+uint32 FatVolume::mount(BlockCache *blocks) {
+    uint32 *data;
+    this->cache = blocks;
+    this->type = FAT_TYPE_NONE;
+    uint32 status = this->cache->fetch(0, &data, false);
+    if (status) {
+        return status;
+    }
+    uint8 *b = (uint8*)data;
+    uint32 start = 0;
+    if (!fat_is_boot(b)) { // master boot record, use the first partition
+        if ((b[510] != 0x55) || (b[511] != 0xAA)) {
+            return FAT_ERR_NO_FS;
+        }
+        start = le32(b + 446 + 8);
+        status = this->cache->fetch(start, &data, false);
+        if (status) {
+            return status;
+        }
+        b = (uint8*)data;
+        if (!fat_is_boot(b)) {
+            return FAT_ERR_NO_FS;
+        }
+    }
+    uint32 perCluster = b[13];
+    if (!perCluster || (perCluster & (perCluster - 1))) {
+        return FAT_ERR_NO_FS;
+    }
+    this->clusterShift = __builtin_ctz(perCluster);
+    uint32 total = le16(b + 19) ? le16(b + 19) : le32(b + 32);
+    this->fatSize = le16(b + 22) ? le16(b + 22) : le32(b + 36);
+    this->fatCount = b[16];
+    this->rootEntries = le16(b + 17);
+    this->fatStart = start + le16(b + 14);
+    this->rootStart = this->fatStart + this->fatCount * this->fatSize;
+    this->dataStart = this->rootStart + (this->rootEntries * 32 + 511) / 512;
+    this->clusterCount = (total - (this->dataStart - start)) >>
+                         this->clusterShift;
+    if (this->clusterCount < 4085) {
+        return FAT_ERR_NO_FS; // FAT12
+    } else if (this->clusterCount < 65525) {
+        this->type = FAT_TYPE_16;
+        this->fsinfo = 0;
+    } else {
+        this->type = FAT_TYPE_32;
+        this->rootCluster = le32(b + 44);
+        this->fsinfo = start + le16(b + 48);
+    }
+    this->nextFree = 2;
+    return 0;
+}
+
+/**
+ * @brief Writes all cached FAT, directory and data blocks to the card
+ * @retval 0 on success, otherwise the device error flags
+ */
+uint32 FatVolume::sync(void) {
+    return this->cache->flush();
+}
+
+/**
+ * Cluster Functions
+ */
+
+/**
+ * @brief Gets the first block of a cluster
+ */
+uint32 FatVolume::block(uint32 cluster) {
+    return this->dataStart + ((cluster - 2) << this->clusterShift);
+}
+
+/**
+ * @brief Checks for an end of chain marker
+ */
+bool FatVolume::isEnd(uint32 value) {
+    return value >= ((this->type == FAT_TYPE_16) ? FAT16_EOC : FAT32_EOC);
+}
+
+/**
+ * @brief Reads the FAT entry of a cluster
+ * @param cluster Cluster to look up
+ * @param value Set to the next cluster, 0 if free, see isEnd()
+ * @retval 0 on success, FAT_ERR_CORRUPT or the device error flags
+ */
+uint32 FatVolume::next(uint32 cluster, uint32 *value) {
+    if ((cluster < 2) || (cluster >= this->clusterCount + 2)) {
+        return FAT_ERR_CORRUPT;
+    }
+    uint32 *data;
+    if (this->type == FAT_TYPE_16) {
+        uint32 status = this->cache->fetch(this->fatStart + (cluster >> 8),
+                                           &data, false);
+        if (status) {
+            return status;
+        }
+        *value = ((uint16*)data)[cluster & 0xFF];
+    } else {
+        uint32 status = this->cache->fetch(this->fatStart + (cluster >> 7),
+                                           &data, false);
+        if (status) {
+            return status;
+        }
+        *value = data[cluster & 0x7F] & FAT32_MASK;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the FAT entry of a cluster in every FAT copy
+ * @param cluster Cluster to change
+ * @param value Next cluster, 0 to free, or 0xFFFFFFFF to end the chain
+ * @retval 0 on success, otherwise the device error flags
+ * @note The FAT32 FSInfo free count is invalidated on the first change,
+ *       so hosts recount free space rather than trust a stale hint
+ */
+uint32 FatVolume::set(uint32 cluster, uint32 value) {
+    uint32 *data;
+    uint32 status;
+    if (this->fsinfo) {
+        status = this->cache->fetch(this->fsinfo, &data, true);
+        if (status) {
+            return status;
+        }
+        data[488 / 4] = 0xFFFFFFFF; // FSI_Free_Count
+        data[492 / 4] = 0xFFFFFFFF; // FSI_Nxt_Free
+        this->fsinfo = 0;
+    }
+    for (uint32 i=0; i<this->fatCount; i++) {
+        uint32 fat = this->fatStart + i * this->fatSize;
+        if (this->type == FAT_TYPE_16) {
+            status = this->cache->fetch(fat + (cluster >> 8), &data, true);
+            if (status) {
+                return status;
+            }
+            ((uint16*)data)[cluster & 0xFF] = (uint16)value;
+        } else {
+            status = this->cache->fetch(fat + (cluster >> 7), &data, true);
+            if (status) {
+                return status;
+            }
+            uint32 *entry = &data[cluster & 0x7F];
+            *entry = (*entry & ~FAT32_MASK) | (value & FAT32_MASK);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Counts the clusters that follow a cluster contiguously
+ * @param cluster First cluster of the run
+ * @param max Most clusters to count
+ * @param length Set to the number of contiguous clusters after cluster
+ * @retval 0 on success, otherwise error as in next()
+ */
+uint32 FatVolume::run(uint32 cluster, uint32 max, uint32 *length) {
+    uint32 n = 0;
+    while (n < max) {
+        uint32 value;
+        uint32 status = this->next(cluster + n, &value);
+        if (status) {
+            return status;
+        } else if (value != cluster + n + 1) {
+            break;
+        }
+        n++;
+    }
+    *length = n;
+    return 0;
+}
+
+/**
+ * @brief Allocates contiguous clusters and links them into a chain
+ * @param prev Cluster to append the new clusters to, 0 for a new chain
+ * @param count Number of clusters to allocate
+ * @param first Set to the first new cluster
+ * @retval 0 on success, FAT_ERR_FULL or error as in next()
+ * @note The search starts right after prev, so growing files stay
+ *       contiguous while the card has room
+ */
+uint32 FatVolume::allocate(uint32 prev, uint32 count, uint32 *first) {
+    uint32 end = this->clusterCount + 2;
+    uint32 cluster = prev ? prev + 1 : this->nextFree;
+    if ((cluster < 2) || (cluster >= end)) {
+        cluster = 2;
+    }
+    uint32 found = 0;
+    uint32 length = 0;
+    for (uint32 i=0; (i < this->clusterCount) && (length < count); i++) {
+        uint32 value;
+        uint32 status = this->next(cluster, &value);
+        if (status) {
+            return status;
+        }
+        if (value) {
+            length = 0;
+        } else if (length++ == 0) {
+            found = cluster;
+        }
+        if (++cluster == end) {
+            cluster = 2; // runs do not wrap around
+            if (length < count) {
+                length = 0;
+            }
+        }
+    }
+    if (length < count) {
+        return FAT_ERR_FULL;
+    }
+    for (uint32 i=0; i<count; i++) {
+        uint32 status = this->set(found + i, (i + 1 < count) ? found + i + 1
+                                                             : 0xFFFFFFFF);
+        if (status) {
+            return status;
+        }
+    }
+    if (prev) {
+        uint32 status = this->set(prev, found);
+        if (status) {
+            return status;
+        }
+    }
+    this->nextFree = found + count;
+    *first = found;
+    return 0;
+}
+
+/**
+ * @brief Frees a cluster chain
+ * @param cluster First cluster of the chain
+ * @retval 0 on success, otherwise error as in next()
+ */
+uint32 FatVolume::release(uint32 cluster) {
+    while ((cluster >= 2) && !this->isEnd(cluster)) {
+        uint32 value;
+        uint32 status = this->next(cluster, &value);
+        if (!status) {
+            status = this->set(cluster, 0);
+        }
+        if (status) {
+            return status;
+        }
+        if (cluster < this->nextFree) {
+            this->nextFree = cluster;
+        }
+        cluster = value;
+    }
+    return 0;
+}
+
+/**
+ * @brief Clears every block of a cluster
+ * @retval 0 on success, otherwise the device error flags
+ */
+uint32 FatVolume::zero(uint32 cluster) {
+    uint32 first = this->block(cluster);
+    for (uint32 i=0; i < (1U << this->clusterShift); i++) {
+        uint32 *data;
+        uint32 status = this->cache->fetch(first + i, &data, true);
+        if (status) {
+            return status;
+        }
+        memset(data, 0, 512);
+    }
+    return 0;
+}
+
+/**
+ * Directory Functions
+ */
+
+/**
+ * @brief Finds the block holding a root directory entry
+ * @param index Entry number in the root directory
+ * @param blk Set to the block holding the entry
+ * @param extend Grow a FAT32 root directory to reach the entry
+ * @retval 0 on success, FAT_ERR_FULL past the end, or error as in next()
+ */
+uint32 FatVolume::entry(uint32 index, uint32 *blk, bool extend) {
+    uint32 offset = index >> 4; // 16 entries per block
+    if (this->type == FAT_TYPE_16) {
+        if (index >= this->rootEntries) {
+            return FAT_ERR_FULL;
+        }
+        *blk = this->rootStart + offset;
+        return 0;
+    }
+    uint32 cluster = this->rootCluster;
+    for (uint32 n = offset >> this->clusterShift; n; n--) {
+        uint32 value;
+        uint32 status = this->next(cluster, &value);
+        if (status) {
+            return status;
+        } else if (this->isEnd(value)) {
+            if (!extend) {
+                return FAT_ERR_FULL;
+            }
+            status = this->allocate(cluster, 1, &value);
+            if (!status) {
+                status = this->zero(value);
+            }
+            if (status) {
+                return status;
+            }
+        } else if (value < 2) {
+            return FAT_ERR_CORRUPT;
+        }
+        cluster = value;
+    }
+    *blk = this->block(cluster) + (offset & ((1 << this->clusterShift) - 1));
+    return 0;
+}
+
+/**
+ * @brief Gets a root directory entry in place
+ * @param index Entry number in the root directory
+ * @param ent Set to the cached entry, valid until the next cache call
+ * @param dirty true if the caller is going to modify the entry
+ * @retval 0 on success, otherwise error as in entry()
+ */
+uint32 FatVolume::dirent(uint32 index, fat_dirent **ent, bool dirty) {
+    uint32 blk;
+    uint32 *data;
+    uint32 status = this->entry(index, &blk, dirty);
+    if (!status) {
+        status = this->cache->fetch(blk, &data, dirty);
+    }
+    if (!status) {
+        *ent = (fat_dirent*)data + (index & 0xF);
+    }
+    return status;
+}
+
+/**
+ * @brief Looks up a file in the root directory
+ * @param name 8.3 name, space padded as stored on disk
+ * @param index Set to the entry number of the file
+ * @retval 0 on success, FAT_ERR_NOT_FOUND or error as in entry()
+ */
+uint32 FatVolume::find(const uint8 *name, uint32 *index) {
+    for (uint32 i=0; ; i++) {
+        fat_dirent *ent;
+        uint32 status = this->dirent(i, &ent, false);
+        if (status == FAT_ERR_FULL) {
+            return FAT_ERR_NOT_FOUND;
+        } else if (status) {
+            return status;
+        } else if (ent->name[0] == 0x00) {
+            return FAT_ERR_NOT_FOUND; // end of directory
+        } else if ((ent->name[0] == 0xE5) ||
+                   (ent->attr & FAT_ATTR_VOLUME_ID)) {
+            continue; // deleted, volume label or long name entry
+        } else if (!memcmp(ent->name, name, sizeof(ent->name))) {
+            *index = i;
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Adds an empty file to the root directory
+ * @param name 8.3 name, space padded as stored on disk
+ * @param index Set to the entry number of the new file
+ * @retval 0 on success, FAT_ERR_FULL or error as in entry()
+ */
+uint32 FatVolume::create(const uint8 *name, uint32 *index) {
+    uint32 i;
+    for (i=0; ; i++) {
+        fat_dirent *ent;
+        uint32 status = this->dirent(i, &ent, false);
+        if (status == FAT_ERR_FULL) {
+            break; // past the last cluster, dirent() below extends it
+        } else if (status) {
+            return status;
+        } else if ((ent->name[0] == 0x00) || (ent->name[0] == 0xE5)) {
+            break;
+        }
+    }
+    fat_dirent *ent;
+    uint32 status = this->dirent(i, &ent, true);
+    if (status) {
+        return status;
+    }
+    memset(ent, 0, sizeof(*ent));
+    memcpy(ent->name, name, sizeof(ent->name));
+    ent->attr = FAT_ATTR_ARCHIVE;
+    ent->crtTime = ent->wrtTime = this->time;
+    ent->crtDate = ent->wrtDate = ent->lstAccDate = this->date;
+    *index = i;
+    return 0;
+}
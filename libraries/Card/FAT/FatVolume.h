@@ -0,0 +1,126 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file FatVolume.h
+ * @brief FAT16 and FAT32 volume on top of a BlockCache
+ */
+
+#ifndef _FATVOLUME_H_
+#define _FATVOLUME_H_
+
+#include <Card/SecureDigital/BlockCache.h>
+
+/*
+ * Error codes, device errors are passed through as they are
+ */
+
+static const uint32 FAT_ERR_NO_FS       = 0x1 << 28; // no FAT16/32 volume
+static const uint32 FAT_ERR_NOT_FOUND   = 0x2 << 28; // no such file
+static const uint32 FAT_ERR_FULL        = 0x3 << 28; // no free clusters/entries
+static const uint32 FAT_ERR_CORRUPT     = 0x4 << 28; // broken cluster chain
+static const uint32 FAT_ERR_ACCESS      = 0x5 << 28; // bad name or open mode
+
+/*
+ * FAT Enumerations
+ */
+
+typedef enum FatType {
+    FAT_TYPE_NONE = 0,
+    FAT_TYPE_16   = 16,
+    FAT_TYPE_32   = 32
+} FatType;
+
+typedef enum FatAttribute {
+    FAT_ATTR_READ_ONLY = 0x01,
+    FAT_ATTR_HIDDEN    = 0x02,
+    FAT_ATTR_SYSTEM    = 0x04,
+    FAT_ATTR_VOLUME_ID = 0x08,
+    FAT_ATTR_DIRECTORY = 0x10,
+    FAT_ATTR_ARCHIVE   = 0x20
+} FatAttribute;
+
+/*
+ * FAT Structures
+ */
+
+typedef struct fat_dirent { // on disk, little endian
+    uint8 name[11];          // 8.3 name, space padded
+    uint8 attr;
+    uint8 ntres;
+    uint8 crtTimeTenth;
+    uint16 crtTime;
+    uint16 crtDate;
+    uint16 lstAccDate;
+    uint16 fstClusHI;
+    uint16 wrtTime;
+    uint16 wrtDate;
+    uint16 fstClusLO;
+    uint32 fileSize;
+} __attribute__((packed)) fat_dirent;
+
+/**
+ * A mounted FAT16 or FAT32 volume. FAT, directory and partial data blocks
+ * go through the cache; whole aligned data blocks bypass it.
+ */
+class FatVolume {
+  public:
+    BlockCache *cache;
+    FatType type;
+    uint32 clusterShift;  // log2 of the cluster size in blocks
+    uint32 fatStart;      // first block of the first FAT
+    uint32 fatSize;       // blocks per FAT
+    uint32 fatCount;
+    uint32 rootStart;     // FAT16: first root directory block
+    uint32 rootEntries;   // FAT16: root directory entries
+    uint32 rootCluster;   // FAT32: first root directory cluster
+    uint32 dataStart;     // block of cluster 2
+    uint32 clusterCount;
+    uint32 fsinfo;        // FAT32: FSInfo block, 0 once invalidated
+    uint32 nextFree;      // where to start looking for free clusters
+    uint16 date;          // DOS date stamped on modified files
+    uint16 time;          // DOS time stamped on modified files
+
+    FatVolume(void);
+    uint32 mount(BlockCache*);
+    uint32 sync(void);
+    /*------------------------------------------------ cluster functions */
+    uint32 block(uint32);
+    bool isEnd(uint32);
+    uint32 next(uint32, uint32*);
+    uint32 set(uint32, uint32);
+    uint32 run(uint32, uint32, uint32*);
+    uint32 allocate(uint32, uint32, uint32*);
+    uint32 release(uint32);
+    uint32 zero(uint32);
+    /*---------------------------------------------- directory functions */
+    uint32 entry(uint32, uint32*, bool);
+    uint32 find(const uint8*, uint32*);
+    uint32 create(const uint8*, uint32*);
+    uint32 dirent(uint32, fat_dirent**, bool);
+};
+
+#endif
@@ -0,0 +1,332 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file BlockCache.cpp
+ * @brief Write-back block cache between the filesystem and a BlockDevice
+ */
+
+#include <Card/SecureDigital/BlockCache.h>
+#include <string.h>
+
+/**
+ * @brief Constructor for a block cache
+ * @param dev Device to cache
+ * @param buf Word aligned storage for n blocks, n*BLOCK_DEVICE_WORDS words
+ * @param n Number of cache lines, at most BLOCK_CACHE_MAX_LINES
+ */
+BlockCache::BlockCache(BlockDevice *dev, uint32 *buf, uint32 n) {
+    this->device = dev;
+    this->buffer = buf;
+    this->lines = (n < BLOCK_CACHE_MAX_LINES) ? n : BLOCK_CACHE_MAX_LINES;
+    this->clock = 0;
+    this->hits = 0;
+    this->misses = 0;
+    this->invalidate();
+}
+
+/**
+ * @brief Reads consecutive blocks, from the cache where possible
+ * @param block First block number to read
+ * @param buf Word aligned buffer of at least count*512 bytes
+ * @param count Number of blocks to read
+ * @retval 0 on success, otherwise the device error flags
+ * @note Single block reads are cached, runs of uncached blocks in longer
+ *       reads are read straight into buf without being cached
+ */
+uint32 BlockCache::read(uint32 block, uint32 *buf, uint32 count) {
+    if (count == 1) {
+        uint32 *data;
+        uint32 status = this->fetch(block, &data, false);
+        if (!status) {
+            memcpy(buf, data, 512);
+        }
+        return status;
+    }
+    uint32 i = 0;
+    while (i < count) {
+        int32 n = this->find(block + i);
+        if (n >= 0) {
+            this->hits++;
+            this->touch(n);
+            memcpy(buf + i * BLOCK_DEVICE_WORDS, this->line(n), 512);
+            i++;
+            continue;
+        }
+        uint32 run = 1;
+        while ((i + run < count) && (this->find(block + i + run) < 0)) {
+            run++;
+        }
+        this->misses += run;
+        uint32 status = this->device->read(block + i,
+                                           buf + i * BLOCK_DEVICE_WORDS, run);
+        if (status) {
+            return status;
+        }
+        i += run;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes consecutive blocks
+ * @param block First block number to write
+ * @param buf Word aligned buffer of count*512 bytes
+ * @param count Number of blocks to write
+ * @retval 0 on success, otherwise the device error flags
+ * @note Single block writes are held in the cache until flush(), longer
+ *       writes go straight to the device and refresh any cached copies
+ */
+uint32 BlockCache::write(uint32 block, const uint32 *buf, uint32 count) {
+    if (count == 1) {
+        int32 n = this->find(block);
+        if (n >= 0) {
+            this->hits++;
+        } else {
+            uint32 index;
+            uint32 status = this->allocate(block, &index);
+            if (status) {
+                return status;
+            }
+            this->misses++;
+            n = index;
+        }
+        memcpy(this->line(n), buf, 512);
+        this->tags[n].dirty = 1;
+        this->touch(n);
+        return 0;
+    }
+    uint32 status = this->device->write(block, buf, count);
+    if (status) {
+        return status;
+    }
+    for (uint32 i=0; i<this->lines; i++) {
+        uint32 offset = this->tags[i].block - block;
+        if (this->tags[i].valid && (offset < count)) {
+            memcpy(this->line(i), buf + offset * BLOCK_DEVICE_WORDS, 512);
+            this->tags[i].dirty = 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Gets a block in place, loading it into the cache if needed
+ * @param block Block number to get
+ * @param data Set to the cached block, valid until the next cache call
+ * @param dirty true if the caller is going to modify the block
+ * @retval 0 on success, otherwise the device error flags
+ */
+uint32 BlockCache::fetch(uint32 block, uint32 **data, bool dirty) {
+    int32 n = this->find(block);
+    if (n >= 0) {
+        this->hits++;
+    } else {
+        uint32 index;
+        uint32 status = this->allocate(block, &index);
+        if (status) {
+            return status;
+        }
+        status = this->device->read(block, this->line(index), 1);
+        if (status) {
+            this->tags[index].valid = 0;
+            return status;
+        }
+        this->misses++;
+        n = index;
+    }
+    if (dirty) {
+        this->tags[n].dirty = 1;
+    }
+    this->touch(n);
+    *data = this->line(n);
+    return 0;
+}
+
+/**
+ * @brief Writes all dirty blocks back to the device
+ * @retval 0 on success, otherwise the device error flags
+ * @note Lines are sorted by block number first, so runs of contiguous dirty
+ *       blocks sit next to each other and go out as one multi-block write
+ */
+uint32 BlockCache::flush(void) {
+    this->sort();
+    uint32 i = 0;
+    while (i < this->lines) {
+        if (!this->tags[i].valid || !this->tags[i].dirty) {
+            i++;
+            continue;
+        }
+        uint32 run = 1;
+        while ((i + run < this->lines) &&
+               this->tags[i + run].valid && this->tags[i + run].dirty &&
+               (this->tags[i + run].block == this->tags[i].block + run)) {
+            run++;
+        }
+        uint32 status = this->device->write(this->tags[i].block,
+                                            this->line(i), run);
+        if (status) {
+            return status;
+        }
+        for (uint32 j=i; j<i+run; j++) {
+            this->tags[j].dirty = 0;
+        }
+        i += run;
+    }
+    return 0;
+}
+
+/**
+ * @brief Drops every cached block, including unwritten ones
+ */
+void BlockCache::invalidate(void) {
+    for (uint32 i=0; i<BLOCK_CACHE_MAX_LINES; i++) {
+        this->tags[i].block = 0;
+        this->tags[i].stamp = 0;
+        this->tags[i].valid = 0;
+        this->tags[i].dirty = 0;
+    }
+}
+
+/**
+ * @brief Fraction of block accesses served from the cache
+ * @retval Hit rate in percent, 0 before the first access
+ */
+uint32 BlockCache::hitRate(void) {
+    uint32 total = this->hits + this->misses;
+    if (!total) {
+        return 0;
+    }
+    return (uint32)(((uint64)this->hits * 100) / total);
+}
+
+/**
+ * Cache Line Functions
+ */
+
+/**
+ * @brief Gets the storage of a cache line
+ */
+uint32* BlockCache::line(uint32 n) {
+    return this->buffer + n * BLOCK_DEVICE_WORDS;
+}
+
+/**
+ * @brief Looks up the cache line holding a block
+ * @retval Line index, or -1 if the block is not cached
+ */
+int32 BlockCache::find(uint32 block) {
+    for (uint32 i=0; i<this->lines; i++) {
+        if (this->tags[i].valid && (this->tags[i].block == block)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Picks the line to replace: a free one, else the least recently used
+ */
+uint32 BlockCache::victim(void) {
+    uint32 oldest = 0;
+    for (uint32 i=0; i<this->lines; i++) {
+        if (!this->tags[i].valid) {
+            return i;
+        } else if (this->tags[i].stamp < this->tags[oldest].stamp) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief Claims a line for a block, writing back dirty lines if needed
+ * @param block Block number the line will hold
+ * @param index Set to the claimed line
+ * @retval 0 on success, otherwise the device error flags
+ * @note Evicting a dirty line flushes the whole cache, so neighbouring dirty
+ *       blocks are written together
+ */
+uint32 BlockCache::allocate(uint32 block, uint32 *index) {
+    uint32 n = this->victim();
+    if (this->tags[n].valid && this->tags[n].dirty) {
+        uint32 status = this->flush();
+        if (status) {
+            return status;
+        }
+        n = this->victim(); // flush() reorders the lines
+    }
+    this->tags[n].block = block;
+    this->tags[n].valid = 1;
+    this->tags[n].dirty = 0;
+    this->touch(n);
+    *index = n;
+    return 0;
+}
+
+/**
+ * @brief Marks a line as most recently used
+ */
+void BlockCache::touch(uint32 n) {
+    this->tags[n].stamp = ++this->clock;
+}
+
+/**
+ * @brief Exchanges two cache lines, tags and data
+ */
+void BlockCache::swap(uint32 a, uint32 b) {
+    block_cache_tag tag = this->tags[a];
+    this->tags[a] = this->tags[b];
+    this->tags[b] = tag;
+    uint32 *x = this->line(a);
+    uint32 *y = this->line(b);
+    for (uint32 i=0; i<BLOCK_DEVICE_WORDS; i++) {
+        uint32 word = x[i];
+        x[i] = y[i];
+        y[i] = word;
+    }
+}
+
+/**
+ * @brief Orders valid lines by block number, free lines last
+ * @note Selection sort, at most one swap per line
+ */
+void BlockCache::sort(void) {
+    for (uint32 i=0; i<this->lines; i++) {
+        uint32 min = i;
+        for (uint32 j=i+1; j<this->lines; j++) {
+            if (!this->tags[j].valid) {
+                continue;
+            } else if (!this->tags[min].valid ||
+                       (this->tags[j].block < this->tags[min].block)) {
+                min = j;
+            }
+        }
+        if (min != i) {
+            this->swap(i, min);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file BlockCache.h
+ * @brief Write-back block cache between the filesystem and a BlockDevice
+ */
+
+#ifndef _BLOCKCACHE_H_
+#define _BLOCKCACHE_H_
+
+#include <Card/SecureDigital/BlockDevice.h>
+
+/* Most cache lines a BlockCache can track */
+static const uint32 BLOCK_CACHE_MAX_LINES = 32;
+
+typedef struct block_cache_tag {
+    uint32 block;   // Block number held by this line
+    uint32 stamp;   // Last use, for least recently used replacement
+    uint8 valid;    // Line holds a block
+    uint8 dirty;    // Line is newer than the device
+} block_cache_tag;
+
+/**
+ * N-entry write-back cache of 512 byte blocks. Single block writes stay in
+ * the cache until flush() or eviction, so repeated FAT and directory updates
+ * cost one device write. flush() writes contiguous dirty blocks with one
+ * multi-block write. Multi-block reads and writes of uncached data go
+ * straight to the device.
+ */
+class BlockCache : public BlockDevice {
+  public:
+    BlockDevice *device;
+    uint32 *buffer;
+    uint32 lines;
+    uint32 clock;
+    uint32 hits;
+    uint32 misses;
+    block_cache_tag tags[BLOCK_CACHE_MAX_LINES];
+
+    BlockCache(BlockDevice*, uint32*, uint32);
+    virtual uint32 read(uint32, uint32*, uint32);
+    virtual uint32 write(uint32, const uint32*, uint32);
+    uint32 fetch(uint32, uint32**, bool);
+    uint32 flush(void);
+    void invalidate(void);
+    uint32 hitRate(void);
+  //private:
+    uint32* line(uint32);
+    int32 find(uint32);
+    uint32 victim(void);
+    uint32 allocate(uint32, uint32*);
+    void touch(uint32);
+    void swap(uint32, uint32);
+    void sort(void);
+};
+
+#endif
@@ -0,0 +1,51 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file BlockDevice.h
+ * @brief Abstract 512 byte block device, as seen by the filesystem
+ */
+
+#ifndef _BLOCKDEVICE_H_
+#define _BLOCKDEVICE_H_
+
+#include <libmaple/libmaple_types.h>
+
+/* Number of 32-bit words in one 512 byte block */
+static const uint32 BLOCK_DEVICE_WORDS = 512 / sizeof(uint32);
+
+/**
+ * Low-level block IO for the filesystem, implemented by HardwareSDIO and
+ * anything layered on it, like BlockCache. Buffers are word aligned, and
+ * both calls return 0 on success, otherwise device specific error flags.
+ */
+class BlockDevice {
+  public:
+    virtual uint32 read(uint32 block, uint32 *buf, uint32 count) = 0;
+    virtual uint32 write(uint32 block, const uint32 *buf, uint32 count) = 0;
+};
+
+#endif
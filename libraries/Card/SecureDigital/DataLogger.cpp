@@ -0,0 +1,221 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file DataLogger.cpp
+ * @brief Append-only logger streaming interrupt-time records to an SD card
+ */
+
+#include <Card/SecureDigital/DataLogger.h>
+#include <wirish/wirish_time.h>
+#include <string.h>
+
+/**
+ * @brief Constructor for a data logger
+ * @param sd Initialized card to log to
+ * @param buf Word aligned storage for count*blocks 512 byte blocks
+ * @param count Number of buffers, at least two
+ * @param blocks Blocks per buffer, the length of each card write
+ */
+DataLogger::DataLogger(HardwareSDIO *sd, uint32 *buf, uint32 count,
+                       uint32 blocks) {
+    this->card = sd;
+    this->buffers = buf;
+    this->bufferCount = count;
+    this->bufferBlocks = blocks;
+    this->regionStart = 0;
+    this->regionBlocks = 0;
+    this->session = 0;
+    this->filled = 0;
+    this->written = 0;
+    this->filling = false;
+    this->writing = false;
+    this->status = 0;
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+
+/**
+ * @brief Starts a new run
+ * @param start First block of the region to log to
+ * @param blocks Size of the region in blocks
+ * @param id Session number stamped in every block, to tell runs apart
+ * @note A region can come from FatFile::reserve(). Nothing else may use
+ *       the card until end().
+ */
+void DataLogger::begin(uint32 start, uint32 blocks, uint32 id) {
+    this->regionStart = start;
+    this->regionBlocks = blocks;
+    this->session = id;
+    this->filled = 0;
+    this->written = 0;
+    this->filling = false;
+    this->writing = false;
+    this->status = 0;
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+
+/**
+ * @brief Appends a record, safe to call from one interrupt handler
+ * @param data Record to log
+ * @param len Length of the record, at most DATA_LOGGER_MAX_RECORD
+ * @retval true if the record was buffered, false if it was dropped
+ */
+bool DataLogger::log(const void *data, uint32 len) {
+    if (len > DATA_LOGGER_MAX_RECORD) {
+        return false;
+    }
+    if (!this->filling && !this->open()) {
+        this->stats.dropped++;
+        return false;
+    }
+    if (this->fillOffset + 1 + len > 512) {
+        if (++this->fillBlock < this->bufferBlocks) {
+            this->start();
+        } else {
+            this->publish();
+            if (!this->open()) {
+                this->stats.dropped++;
+                return false;
+            }
+        }
+    }
+    data_logger_header *hdr = this->header(this->filled, this->fillBlock);
+    uint8 *record = (uint8*)hdr + this->fillOffset;
+    record[0] = (uint8)len;
+    memcpy(record + 1, data, len);
+    this->fillOffset += 1 + len;
+    hdr->used = this->fillOffset - sizeof(data_logger_header);
+    hdr->records++;
+    this->stats.records++;
+    return true;
+}
+
+/**
+ * @brief Writes full buffers to the card, call often from the main loop
+ * @note Never waits: a write is started only when the card is idle
+ */
+void DataLogger::update(void) {
+    if (this->card->busy()) {
+        return;
+    }
+    if (this->writing) {
+        uint32 latency = millis() - this->writeStart;
+        if (latency > this->stats.maxLatency) {
+            this->stats.maxLatency = latency;
+        }
+        if (this->card->xferStatus) {
+            this->status = this->card->xferStatus;
+            this->stats.errors++;
+        } else {
+            this->stats.blocks += this->bufferBlocks;
+        }
+        this->writing = false;
+        this->written++; // hands the buffer back to log()
+    }
+    if (this->written != this->filled) {
+        uint32 blk = this->regionStart + this->written * this->bufferBlocks;
+        uint32 *buf = (uint32*)this->header(this->written, 0);
+        if (!this->card->writeAsync(blk, buf, this->bufferBlocks, NULL)) {
+            this->writing = true;
+            this->writeStart = millis();
+        }
+    }
+}
+
+/**
+ * @brief Writes out everything logged so far and ends the run
+ * @retval 0 on success, otherwise the last card error
+ * @note Stop calling log() first
+ */
+uint32 DataLogger::end(void) {
+    if (this->filling) {
+        while (++this->fillBlock < this->bufferBlocks) {
+            this->start(); // empty blocks, skipped by the decoder
+        }
+        this->publish();
+    }
+    while (this->writing || (this->written != this->filled)) {
+        this->update();
+    }
+    return this->status;
+}
+
+/**
+ * Buffer Functions
+ */
+
+/**
+ * @brief Gets a block of a buffer
+ * @param buffer Buffer sequence number, wraps around the buffer ring
+ * @param n Block within the buffer
+ */
+data_logger_header* DataLogger::header(uint32 buffer, uint32 n) {
+    uint32 index = (buffer % this->bufferCount) * this->bufferBlocks + n;
+    return (data_logger_header*)(this->buffers + index * BLOCK_DEVICE_WORDS);
+}
+
+/**
+ * @brief Claims the next buffer for filling
+ * @retval false if every buffer is waiting for the card, or the region
+ *         is full
+ */
+bool DataLogger::open(void) {
+    if (this->filled - this->written >= this->bufferCount) {
+        return false;
+    } else if ((this->filled + 1) * this->bufferBlocks > this->regionBlocks) {
+        return false;
+    }
+    this->filling = true;
+    this->fillBlock = 0;
+    this->start();
+    return true;
+}
+
+/**
+ * @brief Writes the header of the block being filled
+ */
+void DataLogger::start(void) {
+    data_logger_header *hdr = this->header(this->filled, this->fillBlock);
+    hdr->magic = DATA_LOGGER_MAGIC;
+    hdr->session = this->session;
+    hdr->sequence = this->filled * this->bufferBlocks + this->fillBlock;
+    hdr->dropped = this->stats.dropped;
+    hdr->used = 0;
+    hdr->records = 0;
+    this->fillOffset = sizeof(data_logger_header);
+}
+
+/**
+ * @brief Hands the buffer being filled to update()
+ */
+void DataLogger::publish(void) {
+    this->filling = false;
+    this->filled++;
+    uint32 queued = this->filled - this->written;
+    if (queued > this->stats.maxQueued) {
+        this->stats.maxQueued = queued;
+    }
+}
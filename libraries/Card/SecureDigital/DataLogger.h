@@ -0,0 +1,101 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file DataLogger.h
+ * @brief Append-only logger streaming interrupt-time records to an SD card
+ */
+
+#ifndef _DATALOGGER_H_
+#define _DATALOGGER_H_
+
+#include <Card/SecureDigital/HardwareSDIO.h>
+
+/* "MLOG", first word of every logged block */
+static const uint32 DATA_LOGGER_MAGIC = 0x474F4C4D;
+
+typedef struct data_logger_header { // start of every 512 byte block
+    uint32 magic;
+    uint32 session;   // set by begin(), tells runs apart
+    uint32 sequence;  // block number within the run
+    uint32 dropped;   // records dropped before this block was started
+    uint16 used;      // payload bytes used
+    uint16 records;   // records in this block
+} data_logger_header;
+
+/* Payload bytes per block, records never straddle blocks */
+static const uint32 DATA_LOGGER_PAYLOAD = 512 - sizeof(data_logger_header);
+/* Largest record, records are stored as a length byte and the data */
+static const uint32 DATA_LOGGER_MAX_RECORD = 255;
+
+typedef struct data_logger_stats {
+    uint32 records;    // records accepted
+    uint32 dropped;    // records lost: all buffers full, or region full
+    uint32 blocks;     // blocks written to the card
+    uint32 errors;     // failed buffer writes
+    uint32 maxQueued;  // most full buffers waiting for the card at once
+    uint32 maxLatency; // longest buffer write, in milliseconds
+} data_logger_stats;
+
+/**
+ * Records are appended from interrupt context into one of several RAM
+ * buffers. Full buffers are written to a contiguous region of the card
+ * with one asynchronous multi-block write each, so the producer never
+ * waits on the card; while the card stalls the other buffers keep
+ * filling, and only when all of them are full are records dropped.
+ */
+class DataLogger {
+  public:
+    HardwareSDIO *card;
+    uint32 *buffers;
+    uint32 bufferCount;
+    uint32 bufferBlocks;
+    uint32 regionStart;
+    uint32 regionBlocks;
+    uint32 session;
+    volatile uint32 filled;  // buffers handed to the card, producer side
+    volatile uint32 written; // buffers written back, card side
+    bool filling;            // buffer filled % bufferCount is being filled
+    uint32 fillBlock;
+    uint32 fillOffset;
+    bool writing;
+    uint32 writeStart;
+    uint32 status;           // last card error
+    data_logger_stats stats;
+
+    DataLogger(HardwareSDIO*, uint32*, uint32, uint32);
+    void begin(uint32, uint32, uint32);
+    bool log(const void*, uint32);
+    void update(void);
+    uint32 end(void);
+  //private:
+    data_logger_header* header(uint32, uint32);
+    bool open(void);
+    void start(void);
+    void publish(void);
+};
+
+#endif
@@ -38,6 +38,46 @@
 #warning "Unexpected clock speed; SDIO frequency calculation will be incorrect"
 #endif
 
+/*
+ * Transfer interrupt handling
+ */
+
+/* Status flags which end a data transfer */
+static const uint32 SDIO_DATA_FLAGS = SDIO_STA_DATAEND | SDIO_DATA_ERRORS;
+
+/* Status flags which end a command with a short response */
+static const uint32 SDIO_CMD_FLAGS = SDIO_STA_CMDREND | SDIO_CMD_ERRORS;
+
+/* Card whose transfer state machine runs in __irq_sdio() */
+static HardwareSDIO *sdioActive = NULL;
+
+/* Wide width data (SCR, switch status) arrives most significant byte first */
+static inline uint32 swap32(uint32 word) {
+    return __builtin_bswap32(word);
+}
+
+/**
+ * @brief Transfer state machine handler, called from __irq_sdio()
+ */
+static void sdio_transfer_irq(void) {
+    if (sdioActive) {
+        sdioActive->advance();
+    } else {
+        sdio_enable_interrupt(0);
+    }
+}
+
+/**
+ * @brief DMA handler, called once the FIFO has drained after DATAEND
+ */
+static void sdio_dma_irq(void) {
+    if (sdioActive) {
+        sdioActive->drain();
+    } else {
+        dma_get_irq_cause(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL);
+    }
+}
+
 /**
  * @brief Constructor for Wirish SDIO peripheral support
  */
@@ -96,13 +136,25 @@ HardwareSDIO::HardwareSDIO(void) {
     this->CSD.CRC = 0;
     //initialize AppCommand tracker
     this->appCmd = (SDAppCommand)0;
+    //initialize host settings
+    this->clkFreq = SDIO_CLK_INIT;
+    this->blkSize = SDIO_BKSZ_DEFAULT;
+    this->busWidth = SDIO_BUS_1BIT;
+    //initialize transfer state machine
+    this->state = SDIO_STATE_IDLE;
+    this->xferStatus = 0;
+    this->xferDone = NULL;
+    this->xferCount = 0;
+    this->xferRun = 0;
+    this->cardBusy = false;
+    this->busyStart = 0;
 }
 
 /**
  * @brief General startup setting
  */
 void HardwareSDIO::begin(void) {
-    this->begin(SDIO_1_MHZ);
+    this->begin(SDIO_36_MHZ);
 }
 
 /**
@@ -111,10 +163,14 @@ void HardwareSDIO::begin(void) {
 void HardwareSDIO::begin(SDIOClockFrequency freq) {
     sdio_cfg_gpio();
     ASSERT(sdio_card_detect()); //FIXME: use EXTI for checking periodically
+    sdio_init(); // resets the registers, configure them after this
     sdio_set_clkcr(SDIO_CLK_INIT);
     clkFreq = SDIO_CLK_INIT;
     sdio_set_data_timeout(SDIO_DTIMER_DATATIME); //longest wait time
-    sdio_init();
+    dma_init(SDIO_DMA_DEVICE);
+    sdioActive = this;
+    sdio_attach_interrupt(sdio_transfer_irq);
+    dma_attach_interrupt(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL, sdio_dma_irq);
     sdio_power_on();
     sdio_clock_enable();
     delay_us(200);
@@ -128,7 +184,10 @@ void HardwareSDIO::begin(SDIOClockFrequency freq) {
     this->command(ALL_SEND_CID, 0); //CMD2
     this->response(ALL_SEND_CID);
     this->newRCA();
-    this->clockFreq(freq);
+    this->getCSD();
+/* ---------------------------------------------------------- data transfer */
+    this->select(); //CMD7: card stays in transfer state from here on
+    this->optimize(freq);
 }
 
 /**
@@ -136,6 +195,12 @@ void HardwareSDIO::begin(SDIOClockFrequency freq) {
  */
 void HardwareSDIO::end(void) {
   //this->command(GO_INACTIVE_STATE);
+    sdio_detach_interrupt();
+    this->cancel();
+    dma_detach_interrupt(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL);
+    this->state = SDIO_STATE_IDLE;
+    this->cardBusy = false;
+    sdioActive = NULL;
     sdio_reset();
     this->RCA.RCA = 0x0;
     this->CSD.CSD_STRUCTURE = 3;
@@ -170,28 +235,104 @@ void HardwareSDIO::clockFreq(SDIOClockFrequency freq) {
     delay_us(10);
     sdio_cfg_clkcr(SDIO_CLKCR_CLKDIV, (uint32)freq);
     this->clkFreq = freq;
+    sdio_clock_enable(); // commands must not depend on enabling it
 }
 
 /**
  * @brief Change bus width in host and card
  * @param width WIDBUS value to set
+ * @retval 0 on success, otherwise error flags as in check()
  * @note Card bus width can only be changed when card is unlocked
  */
-void HardwareSDIO::busMode(SDIOBusMode width) {
-    this->select();
-    this->command(SET_BUS_WIDTH, width); //ACMD6
-    this->response(SET_BUS_WIDTH);
-    //this->check(0x8FF9FE20);
+uint32 HardwareSDIO::busMode(SDIOBusMode width) {
+    uint32 arg;
+    uint32 widbus;
     switch (width) {
       case SDIO_BUS_1BIT:
-        sdio_cfg_clkcr(SDIO_CLKCR_WIDBUS, SDIO_CLKCR_WIDBUS_DEFAULT);
+        arg = SDIO_SSR_1BIT_WIDTH;
+        widbus = SDIO_CLKCR_WIDBUS_DEFAULT;
         break;
       case SDIO_BUS_4BIT:
-        sdio_cfg_clkcr(SDIO_CLKCR_WIDBUS, SDIO_CLKCR_WIDBUS_4WIDE);
+        arg = SDIO_SSR_4BIT_WIDTH;
+        widbus = SDIO_CLKCR_WIDBUS_4WIDE;
         break;
       default:
         // Unsupported bus mode request
-        return;
+        return SDIO_CARD_ERROR;
+    }
+    this->command(SET_BUS_WIDTH, arg); //ACMD6
+    uint32 status = this->check(SDIO_CSR_ERRORS);
+    if (status) {
+        return status;
+    }
+    sdio_cfg_clkcr(SDIO_CLKCR_WIDBUS, widbus);
+    this->busWidth = width;
+    return 0;
+}
+
+/**
+ * @brief Switches the card into High Speed mode with CMD6
+ * @retval 0 on success, SDIO_CARD_ERROR if the card lacks High Speed mode,
+ *         otherwise the error flags that ended the transfer
+ * @note Only the card is switched, the host clock is left to the caller
+ */
+uint32 HardwareSDIO::highSpeed(void) {
+    uint32 buf[16] = {0}; // 512-bit switch function status
+    uint8 *sfs = (uint8*)buf;
+    if (this->SCR.SD_SPEC == 0) {
+        return SDIO_CARD_ERROR; // CMD6 is new in physical spec 1.10
+    }
+    for (uint32 i=0; i<2; i++) {
+        uint32 status = this->start(SWITCH_FUNC,
+                                    (i == 0) ? SDIO_SWITCH_CHECK
+                                             : SDIO_SWITCH_SET, //CMD6
+                                    buf, 1, SDIO_BKSZ_64, SDIO_DCTRL_DTDIR,
+                                    NULL);
+        if (!status) {
+            status = this->wait();
+        }
+        if (status) {
+            return status;
+        }
+        if ((i == 0) && !(sfs[13] & 0x2)) {
+            return SDIO_CARD_ERROR; // bit 401: High Speed supported
+        }
+    }
+    if ((sfs[16] & 0xF) != 0x1) {
+        return SDIO_CARD_ERROR; // bits 379:376: function group 1 result
+    }
+    return 0;
+}
+
+/**
+ * @brief Switches to the widest bus and fastest clock the card supports
+ * @param freq Fastest clock to try
+ * @note Every step is verified by reading the SCR over the data lines. On
+ *       CRC errors the bus falls back to 1-bit, and the clock is halved
+ *       until transfers are clean again.
+ */
+void HardwareSDIO::optimize(SDIOClockFrequency freq) {
+    if (this->getSCR()) {
+        this->clockFreq(SDIO_400_KHZ);
+        return; // no data transfers at all, leave the card alone
+    }
+    if (this->SCR.SD_BUS_WIDTHS & SDIO_SCR_BUS_WIDTH_4) {
+        if (this->busMode(SDIO_BUS_4BIT) || this->getSCR()) {
+            this->busMode(SDIO_BUS_1BIT);
+        }
+    }
+    if ((freq < SDIO_24_MHZ) && this->highSpeed()) {
+        freq = SDIO_24_MHZ; // Default Speed cards top out at 25 MHz
+    }
+    for (;;) {
+        this->clockFreq(freq);
+        if (!this->getSCR() || (freq >= SDIO_400_KHZ)) {
+            return;
+        }
+        freq = (SDIOClockFrequency)(2 * freq + 2); // half the clock rate
+        if (freq > SDIO_400_KHZ) {
+            freq = SDIO_400_KHZ;
+        }
     }
 }
 
@@ -206,7 +347,6 @@ void HardwareSDIO::blockSize(SDIOBlockSize size) {
     } else if (size == this->blkSize) {
         return;
     }
-    this->select();
     this->command(SET_BLOCKLEN, 0x1 << size);
   //this->check(0x2FF9FE00);
     this->response(SET_BLOCKLEN);
@@ -231,8 +371,8 @@ void HardwareSDIO::blockSize(SDIOBlockSize size) {
  * @param arg Argument to send
  */
 void HardwareSDIO::command(SDCommand cmd, uint32 arg) {
-    sdio_enable_interrupt(0x3FFFFF); //almost all interrupts
-    sdio_clear_interrupt(~SDIO_ICR_RESERVED);
+    sdio_clear_interrupt(SDIO_ICR_CCRCFAILC | SDIO_ICR_CTIMEOUTC |
+                         SDIO_ICR_CMDRENDC | SDIO_ICR_CMDSENTC);
     sdio_load_arg(arg);
     sdio_clock_enable();
     uint32 cmdreg = (cmd & SDIO_CMD_CMDINDEX) | SDIO_CMD_CPSMEN;
@@ -247,24 +387,13 @@ void HardwareSDIO::command(SDCommand cmd, uint32 arg) {
       case ALL_SEND_CID:
         cmdreg |= SDIO_CMD_WAITRESP_LONG;
         break;
-      case READ_SINGLE_BLOCK:
-    //case READ_MULTIPLE_BLOCK:
-        cmdreg |= SDIO_CMD_WAITRESP_SHORT;
-        sdio_set_data_length(0x1 << this->blkSize);
-        break;
-      case WRITE_BLOCK:
-    //case WRITE_MULTIPLE_BLOCK:
-        cmdreg |= SDIO_CMD_WAITRESP_SHORT;
-        sdio_set_data_length(0x1 << this->blkSize);
-        break;
       default:
       case SEND_IF_COND:
         cmdreg |= SDIO_CMD_WAITRESP_SHORT;
         break;
     }
     sdio_send_command(cmdreg);
-    while (SDIO->regs->STA & SDIO_STA_CMDACT) {
-        delay_us(100);
+    while (!sdio_check_status(SDIO_CMD_FLAGS | SDIO_STA_CMDSENT)) {
     }
     ASSERT(SDIO->regs->STA & 0xC5);
 }
@@ -283,12 +412,12 @@ void HardwareSDIO::command(SDAppCommand acmd, uint32 arg) {
             continue;
         } else {
             this->response(APP_CMD); //this->check(0xFF9FC21);
-            if (this->CSR.COM_CRC_ERROR != SDIO_CSR_ERROR) {
+            if (this->CSR.COM_CRC_ERROR == SDIO_CSR_ERROR) {
                 continue;
-            } else if (this->CSR.APP_CMD == SDIO_CSR_ENABLED) {
+            } else if (this->CSR.APP_CMD != SDIO_CSR_ENABLED) {
                 continue;
             } else {
-                break; //success                
+                break; //success
             }
         }
     }
@@ -474,17 +603,29 @@ void HardwareSDIO::getCID(void) {
 
 /**
  * @brief Gets the Sd card Configuration Register (SCR)
+ * @retval 0 on success, otherwise the error flags that ended the transfer
  * @note Data packet format for Wide Width Data is most significant byte first
  */
-void HardwareSDIO::getSCR(void) {
-    this->blockSize(SDIO_BKSZ_8);
-    sdio_set_data_timeout(SDIO_DTIMER_DATATIME);
-    sdio_set_data_length(8); //64-bits or 8-bytes
-    sdio_set_dcr((this->blkSize << SDIO_DCTRL_DBLOCKSIZE_BIT) |
-                 SDIO_DCTRL_DTDIR);
-    this->command(SEND_SCR, 0); //ACMD51
-    this->response(SEND_SCR);
-  //this->transfer(SEND_SCR);
+uint32 HardwareSDIO::getSCR(void) {
+    uint32 buf[2] = {0}; //64-bits or 8-bytes
+    uint32 status = this->start(SEND_SCR, 0, buf, 1, SDIO_BKSZ_8,
+                                SDIO_DCTRL_DTDIR, NULL); //ACMD51
+    if (!status) {
+        status = this->wait();
+    }
+    if (status) {
+        return status;
+    }
+    uint32 temp = swap32(buf[0]);
+    this->SCR.SCR_STRUCTURE         = (0xF0000000 & temp) >> 28;
+    this->SCR.SD_SPEC               =  (0xF000000 & temp) >> 24;
+    this->SCR.DATA_STAT_AFTER_ERASE =   (0x800000 & temp) >> 23;
+    this->SCR.SD_SECURITY           =   (0x700000 & temp) >> 20;
+    this->SCR.SD_BUS_WIDTHS         =    (0xF0000 & temp) >> 16;
+    this->SCR.SD_SPEC3              =     (0x8000 & temp) >> 15;
+    this->SCR.EX_SECURITY           =     (0x7800 & temp) >> 11;
+    this->SCR.CMD_SUPPORT           =        (0x3 & temp);
+    return 0;
 }
 
 /**
@@ -687,11 +828,519 @@ void HardwareSDIO::convert(rca* TEMP) {
     TEMP->AKE_SEQ_ERROR         =        (0x8 & temp) >>  3;
 }
 
+/**
+ * @brief Checks the last command for command path and card status errors
+ * @param mask Card status (R1) bits to treat as errors
+ * @retval 0 on success, otherwise SDIO_CMD_ERRORS flags or SDIO_CARD_ERROR
+ */
+uint32 HardwareSDIO::check(uint32 mask) {
+    uint32 status = sdio_check_status(SDIO_CMD_ERRORS);
+    if (status) {
+        return status;
+    }
+    uint32 resp = SDIO->regs->RESP1;
+    this->convert(&this->CSR, resp);
+    if (resp & mask) {
+        return SDIO_CARD_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * Data Path Functions
+ */
+
+/**
+ * @brief Converts a block number into a data command argument
+ * @param block Block number, in units of 512 bytes
+ * @note SDSC cards are byte addressed, SDHC and SDXC are block addressed
+ */
+uint32 HardwareSDIO::address(uint32 block) {
+    if (this->CSD.capacity == SD_CAP_SDSC) {
+        return block << SDIO_BKSZ_512;
+    }
+    return block;
+}
+
+/**
+ * @brief Loads the data timer with a timeout at the current bus clock
+ * @param ms Timeout in milliseconds
+ */
+void HardwareSDIO::dataTimeout(uint32 ms) {
+    uint32 khz = (CYCLES_PER_MICROSECOND * 1000) / (this->clkFreq + 2);
+    sdio_set_data_timeout(ms * khz);
+}
+
+/**
+ * @brief Arms DMA2 Channel4 and the data path state machine
+ * @param buf Word aligned buffer to transfer to or from
+ * @param length Number of bytes to transfer, a multiple of the block size
+ * @param size Data path block size
+ * @param dir SDIO_DCTRL_DTDIR for card to host, 0 for host to card
+ * @note Reads must be armed before the command is sent, writes after
+ *       the command response has been received
+ */
+void HardwareSDIO::transfer(const uint32 *buf, uint32 length,
+                            SDIOBlockSize size, uint32 dir) {
+    dma_tube_config cfg;
+    // Reads only ever come from readAsync()'s writable buffer
+    uint32 *mem = (uint32*)buf;
+    if (dir & SDIO_DCTRL_DTDIR) {
+        cfg.tube_src   = &SDIO->regs->FIFO;
+        cfg.tube_dst   = mem;
+        cfg.tube_flags = DMA_CFG_DST_INC;
+    } else {
+        cfg.tube_src   = mem;
+        cfg.tube_dst   = &SDIO->regs->FIFO;
+        cfg.tube_flags = DMA_CFG_SRC_INC;
+    }
+    cfg.tube_src_size = DMA_SIZE_32BITS;
+    cfg.tube_dst_size = DMA_SIZE_32BITS;
+    cfg.tube_nr_xfers = length / sizeof(uint32);
+    cfg.target_data   = NULL;
+    cfg.tube_req_src  = DMA_REQ_SRC_SDIO;
+    int status = dma_tube_cfg(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL, &cfg);
+    ASSERT(status == DMA_TUBE_CFG_SUCCESS);
+    dma_set_priority(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL,
+                     DMA_PRIORITY_VERY_HIGH);
+    dma_enable(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL);
+    sdio_clear_interrupt(SDIO_DATA_FLAGS);
+    sdio_set_data_length(length);
+    sdio_set_dcr((size << SDIO_DCTRL_DBLOCKSIZE_BIT) |
+                 (dir & SDIO_DCTRL_DTDIR) |
+                 SDIO_DCTRL_DMAEN | SDIO_DCTRL_DTEN);
+}
+
+/**
+ * @brief Disarms the data path state machine and DMA channel
+ */
+void HardwareSDIO::cancel(void) {
+    sdio_set_dcr(0);
+    dma_disable(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL);
+    dma_clear_isr_bits(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL);
+}
+
+/**
+ * Transfer State Machine
+ */
+
+/**
+ * @brief Starts a data command, driven to completion from __irq_sdio()
+ * @param cmd Data command to send
+ * @param arg Argument of the first data command
+ * @param buf Word aligned buffer of count blocks
+ * @param count Number of blocks to transfer
+ * @param size Data path block size
+ * @param dir SDIO_DCTRL_DTDIR for card to host, 0 for host to card
+ * @param done Called on completion, may be NULL
+ * @retval 0 if the transfer was started, SDIO_BUSY_ERROR if one is pending
+ * @note CMD18 and CMD25 runs are split at SDIO_MAX_DMA_BLOCKS and ended
+ *       with CMD12, CMD25 runs are preceded by ACMD23
+ */
+uint32 HardwareSDIO::start(SDCommand cmd, uint32 arg, const uint32 *buf,
+                           uint32 count, SDIOBlockSize size, uint32 dir,
+                           SDIOCallback done) {
+    ASSERT(count > 0);
+    if (this->busy()) {
+        return SDIO_BUSY_ERROR;
+    }
+    this->xferCmd = cmd;
+    this->xferArg = arg;
+    this->xferBuf = buf;
+    this->xferCount = count;
+    this->xferSize = size;
+    this->xferDir = dir & SDIO_DCTRL_DTDIR;
+    this->xferDone = done;
+    this->xferStatus = 0;
+    sdio_clear_interrupt(SDIO_CMD_FLAGS | SDIO_DATA_FLAGS);
+    sdio_enable_interrupt(SDIO_CMD_FLAGS | SDIO_DATA_FLAGS);
+    this->next();
+    return 0;
+}
+
+/**
+ * @brief Starts an application data command, see start(SDCommand, ...)
+ */
+uint32 HardwareSDIO::start(SDAppCommand acmd, uint32 arg, const uint32 *buf,
+                           uint32 count, SDIOBlockSize size, uint32 dir,
+                           SDIOCallback done) {
+    if (this->busy()) {
+        return SDIO_BUSY_ERROR;
+    }
+    this->appCmd = acmd; //next() sends CMD55 first
+    return this->start((SDCommand)acmd, arg, buf, count, size, dir, done);
+}
+
+/**
+ * @brief Starts the next run of the current transfer
+ * @note Waits for the card to finish programming with CMD13 first
+ */
+void HardwareSDIO::next(void) {
+    if (this->cardBusy) {
+        this->send(SEND_STATUS, (uint32)this->RCA.RCA << 16,
+                   SDIO_STATE_STATUS); //CMD13
+        return;
+    }
+    this->xferRun = this->xferCount;
+    if (this->xferRun > SDIO_MAX_DMA_BLOCKS) {
+        this->xferRun = SDIO_MAX_DMA_BLOCKS;
+    }
+    if (this->appCmd || (this->xferCmd == WRITE_MULTIPLE_BLOCK)) {
+        this->send(APP_CMD, (uint32)this->RCA.RCA << 16,
+                   SDIO_STATE_APP); //CMD55
+    } else {
+        this->issue();
+    }
+}
+
+/**
+ * @brief Sends the data command of the current run
+ * @note Reads are armed before the command is sent, writes after
+ *       the command response has been received
+ */
+void HardwareSDIO::issue(void) {
+    if (this->xferDir) {
+        this->dataTimeout(SDIO_READ_TIMEOUT_MS);
+        this->transfer(this->xferBuf, this->xferRun << this->xferSize,
+                       this->xferSize, this->xferDir);
+    }
+    this->send(this->xferCmd, this->xferArg, SDIO_STATE_COMMAND);
+}
+
+/**
+ * @brief Sends a command with a short response without waiting for it
+ * @param cmd Command index to send
+ * @param arg Argument to send
+ * @param next State to handle the response in
+ */
+void HardwareSDIO::send(SDCommand cmd, uint32 arg, SDIOState next) {
+    this->state = next;
+    sdio_clear_interrupt(SDIO_CMD_FLAGS);
+    sdio_load_arg(arg);
+    sdio_send_command((cmd & SDIO_CMD_CMDINDEX) |
+                      SDIO_CMD_WAITRESP_SHORT | SDIO_CMD_CPSMEN);
+}
+
+/**
+ * @brief Advances the transfer state machine, called from __irq_sdio()
+ */
+void HardwareSDIO::advance(void) {
+    if ((this->state != SDIO_STATE_DATA) &&
+        sdio_check_status(SDIO_CMD_FLAGS)) {
+        this->respond();
+    }
+    if (this->state == SDIO_STATE_DATA) {
+        uint32 status = sdio_check_status(SDIO_DATA_FLAGS);
+        if (status) {
+            sdio_clear_interrupt(SDIO_DATA_FLAGS);
+            this->complete(status);
+        }
+    }
+}
+
+/**
+ * @brief Handles the response to the command sent in the current state
+ */
+void HardwareSDIO::respond(void) {
+    uint32 mask = SDIO_CSR_ERRORS;
+    if (this->state == SDIO_STATE_STOP) {
+        mask &= ~SDIO_CSR_OUT_OF_RANGE;
+    }
+    uint32 status = this->check(mask);
+    sdio_clear_interrupt(SDIO_CMD_FLAGS);
+    if (status) {
+        this->finish(this->xferStatus ? this->xferStatus : status);
+        return;
+    }
+    switch (this->state) {
+      case SDIO_STATE_STATUS:
+        if ((this->CSR.READY_FOR_DATA == SDIO_CSR_READY) &&
+            (this->CSR.CURRENT_STATE == SDIO_CSR_TRAN)) {
+            this->cardBusy = false;
+            sdio_cfg_clkcr(SDIO_CLKCR_CLKDIV, this->clkFreq);
+            this->next();
+        } else if (millis() - this->busyStart > SDIO_WRITE_TIMEOUT_MS) {
+            this->finish(SDIO_STA_DTIMEOUT);
+        } else {
+            // Re-sent at once; the slow clock spaces the polls out
+            if (this->clkFreq < SDIO_BUSY_POLL_CLK) {
+                sdio_cfg_clkcr(SDIO_CLKCR_CLKDIV, SDIO_BUSY_POLL_CLK);
+            }
+            this->send(SEND_STATUS, (uint32)this->RCA.RCA << 16,
+                       SDIO_STATE_STATUS); //CMD13
+        }
+        break;
+      case SDIO_STATE_APP:
+        if (this->xferCmd == WRITE_MULTIPLE_BLOCK) {
+            this->send((SDCommand)SET_WR_BLK_ERASE_COUNT, this->xferRun,
+                       SDIO_STATE_ERASE); //ACMD23
+        } else {
+            this->issue();
+        }
+        break;
+      case SDIO_STATE_ERASE:
+        this->issue();
+        break;
+      case SDIO_STATE_COMMAND:
+        if (!this->xferDir) {
+            this->dataTimeout(SDIO_WRITE_TIMEOUT_MS);
+            this->transfer(this->xferBuf, this->xferRun << this->xferSize,
+                           this->xferSize, this->xferDir);
+        }
+        this->state = SDIO_STATE_DATA;
+        break;
+      case SDIO_STATE_STOP:
+        if (this->xferStatus) {
+            this->finish(this->xferStatus);
+        } else {
+            this->proceed();
+        }
+        break;
+      default:
+        break;
+    }
+}
+
+/**
+ * @brief Handles the end of the data phase of the current run
+ * @param flags SDIO_DATA_FLAGS which ended the data phase
+ * @note The DPSM raises DATAEND once the card is done, the DMA channel
+ *       may still be draining the FIFO on reads. Then the run is settled
+ *       from the DMA transfer complete interrupt instead.
+ */
+void HardwareSDIO::complete(uint32 flags) {
+    uint32 status = flags & SDIO_DATA_ERRORS;
+    dma_tube_reg_map *chregs = dma_tube_regs(SDIO_DMA_DEVICE,
+                                             SDIO_DMA_CHANNEL);
+    if (dma_get_isr_bits(SDIO_DMA_DEVICE, SDIO_DMA_CHANNEL) &
+        DMA_ISR_TEIF1) {
+        status = SDIO_DMA_ERROR;
+    }
+    if (!status && chregs->CNDTR) {
+        // The flags stay set, so this interrupts at once if the
+        // channel finished since CNDTR was read.
+        this->state = SDIO_STATE_DRAIN;
+        chregs->CCR |= DMA_CCR_TCIE | DMA_CCR_TEIE;
+        return;
+    }
+    this->settle(status);
+}
+
+/**
+ * @brief Settles a run whose FIFO was still draining, called from the
+ *        DMA interrupt
+ */
+void HardwareSDIO::drain(void) {
+    dma_irq_cause cause = dma_get_irq_cause(SDIO_DMA_DEVICE,
+                                            SDIO_DMA_CHANNEL);
+    if (this->state != SDIO_STATE_DRAIN) {
+        return;
+    }
+    this->settle((cause == DMA_TRANSFER_ERROR) ? SDIO_DMA_ERROR : 0);
+}
+
+/**
+ * @brief Ends the data phase of the current run, once DMA is done
+ * @param status 0, or the error flags that ended the data phase
+ */
+void HardwareSDIO::settle(uint32 status) {
+    this->cancel();
+    if (!this->xferDir) {
+        this->cardBusy = true;
+        this->busyStart = millis();
+    }
+    if ((this->xferCmd == READ_MULTIPLE_BLOCK) ||
+        (this->xferCmd == WRITE_MULTIPLE_BLOCK)) {
+        this->xferStatus = status;
+        this->send(STOP_TRANSMISSION, 0, SDIO_STATE_STOP); //CMD12
+    } else if (status) {
+        this->finish(status);
+    } else {
+        this->proceed();
+    }
+}
+
+/**
+ * @brief Moves on to the next run, or finishes after the last one
+ */
+void HardwareSDIO::proceed(void) {
+    this->xferCount -= this->xferRun;
+    if (!this->xferCount) {
+        this->finish(0);
+        return;
+    }
+    this->xferBuf += (this->xferRun << this->xferSize) / sizeof(uint32);
+    this->xferArg += this->address(this->xferRun);
+    this->next();
+}
+
+/**
+ * @brief Ends the current transfer and calls the completion callback
+ * @param status 0 on success, otherwise the error flags that ended it
+ */
+void HardwareSDIO::finish(uint32 status) {
+    sdio_enable_interrupt(0);
+    sdio_cfg_clkcr(SDIO_CLKCR_CLKDIV, this->clkFreq); // after a busy poll
+    this->cancel();
+    sdio_clear_interrupt(SDIO_CMD_FLAGS | SDIO_DATA_FLAGS);
+    this->appCmd = (SDAppCommand)0;
+    this->xferStatus = status;
+    this->state = SDIO_STATE_IDLE;
+    if (this->xferDone) {
+        this->xferDone(status);
+    }
+}
+
+/**
+ * @brief Checks for a pending transfer
+ * @retval true until the current transfer has finished
+ */
+bool HardwareSDIO::busy(void) {
+    return this->state != SDIO_STATE_IDLE;
+}
+
+/**
+ * @brief Waits for the current transfer to finish
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ */
+uint32 HardwareSDIO::wait(void) {
+    while (this->busy()) {
+    }
+    return this->xferStatus;
+}
+
+/**
+ * Block Functions
+ */
+
+/**
+ * @brief Starts reading consecutive blocks without waiting for them
+ * @param block First block number to read
+ * @param buf Word aligned buffer of at least count*512 bytes
+ * @param count Number of blocks to read
+ * @param done Called from __irq_sdio() on completion, may be NULL
+ * @retval 0 if the transfer was started, SDIO_BUSY_ERROR if one is pending
+ * @note buf must not be touched until the transfer has finished
+ */
+uint32 HardwareSDIO::readAsync(uint32 block, uint32 *buf, uint32 count,
+                               SDIOCallback done) {
+    if (this->busy()) {
+        return SDIO_BUSY_ERROR;
+    }
+    this->blockSize(SDIO_BKSZ_512);
+    SDCommand cmd = (count == 1) ? READ_SINGLE_BLOCK   //CMD17
+                                 : READ_MULTIPLE_BLOCK; //CMD18
+    return this->start(cmd, this->address(block), buf, count,
+                       SDIO_BKSZ_512, SDIO_DCTRL_DTDIR, done);
+}
+
+/**
+ * @brief Starts writing consecutive blocks without waiting for them
+ * @param block First block number to write
+ * @param buf Word aligned buffer of count*512 bytes
+ * @param count Number of blocks to write
+ * @param done Called from __irq_sdio() on completion, may be NULL
+ * @retval 0 if the transfer was started, SDIO_BUSY_ERROR if one is pending
+ * @note The card may still be programming when done is called, the next
+ *       transfer polls CMD13 before it starts
+ */
+uint32 HardwareSDIO::writeAsync(uint32 block, const uint32 *buf, uint32 count,
+                                SDIOCallback done) {
+    if (this->busy()) {
+        return SDIO_BUSY_ERROR;
+    }
+    this->blockSize(SDIO_BKSZ_512);
+    SDCommand cmd = (count == 1) ? WRITE_BLOCK          //CMD24
+                                 : WRITE_MULTIPLE_BLOCK; //CMD25
+    return this->start(cmd, this->address(block), buf, count,
+                       SDIO_BKSZ_512, 0, done);
+}
+
+/**
+ * @brief Reads one 512 byte block from the card over DMA
+ * @param block Block number to read
+ * @param buf Word aligned buffer of at least 512 bytes
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ */
+uint32 HardwareSDIO::readBlock(uint32 block, uint32 *buf) {
+    return this->read(block, buf, 1);
+}
+
+/**
+ * @brief Writes one 512 byte block to the card over DMA
+ * @param block Block number to write
+ * @param buf Word aligned buffer of 512 bytes
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ */
+uint32 HardwareSDIO::writeBlock(uint32 block, const uint32 *buf) {
+    return this->write(block, buf, 1);
+}
+
+/**
+ * @brief Streams consecutive blocks from the card with CMD18
+ * @param block First block number to read
+ * @param count Number of blocks to read
+ * @param buf Word aligned buffer of at least count*512 bytes
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ */
+uint32 HardwareSDIO::readBlocks(uint32 block, uint32 count, uint32 *buf) {
+    return this->read(block, buf, count);
+}
+
+/**
+ * @brief Streams consecutive blocks to the card with CMD25
+ * @param block First block number to write
+ * @param count Number of blocks to write
+ * @param buf Word aligned buffer of count*512 bytes
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ * @note ACMD23 tells the card how many blocks follow so it can pre-erase
+ *       them, which keeps sustained writes at the card's speed class
+ */
+uint32 HardwareSDIO::writeBlocks(uint32 block, uint32 count,
+                                 const uint32 *buf) {
+    return this->write(block, buf, count);
+}
+
+/**
+ * @brief Reads consecutive blocks from the card
+ * @param block First block number to read
+ * @param buf Word aligned buffer of at least count*512 bytes
+ * @param count Number of blocks to read
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ */
+uint32 HardwareSDIO::read(uint32 block, uint32 *buf, uint32 count) {
+    uint32 status = this->readAsync(block, buf, count, NULL);
+    if (status) {
+        return status;
+    }
+    return this->wait();
+}
+
+/**
+ * @brief Writes consecutive blocks to the card
+ * @param block First block number to write
+ * @param buf Word aligned buffer of count*512 bytes
+ * @param count Number of blocks to write
+ * @retval 0 on success, otherwise the error flags that ended the transfer
+ */
+uint32 HardwareSDIO::write(uint32 block, const uint32 *buf, uint32 count) {
+    uint32 status = this->writeAsync(block, buf, count, NULL);
+    if (status) {
+        return status;
+    }
+    return this->wait();
+}
+
 /**
  * @brief Stops data stream transmission to/from card
+ * @retval 0 on success, otherwise error flags as in check()
+ * @note Disarms the DPSM first, so a transfer can be stopped early
  */
-void HardwareSDIO::stop(void) {
+uint32 HardwareSDIO::stop(void) {
+    if (this->busy()) {
+        this->finish(SDIO_BUSY_ERROR);
+    }
+    this->cancel();
     this->command(STOP_TRANSMISSION, 0); //CMD12
-    //this->check(0xC6F85E00);
-    //FIXME: handle DPSM for stopping read or write early
-}
\ No newline at end of file
+    return this->check(SDIO_CSR_ERRORS & ~SDIO_CSR_OUT_OF_RANGE);
+}
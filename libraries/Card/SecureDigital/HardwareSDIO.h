@@ -31,13 +31,69 @@
  * @note These devices share DMA Channel4: TIM5_CH2 SDIO TIM7_UP/DAC_Channel2
  */
 
+#ifndef _HARDWARESDIO_H_
+#define _HARDWARESDIO_H_
+
 #include <libmaple/libmaple_types.h>
 #include <Card/SecureDigital/commands.h>
 #include <libmaple/sdio.h>
- 
+#include <libmaple/dma.h>
+#include <Card/SecureDigital/BlockDevice.h>
 
-#ifndef _HARDWARESDIO_H_
-#define _HARDWARESDIO_H_
+/*
+ * Data transfer constants
+ */
+
+/* Data path errors reported by transfers, mirrors SDIO_STA */
+static const uint32 SDIO_DATA_ERRORS    = SDIO_STA_DCRCFAIL |
+                                          SDIO_STA_DTIMEOUT |
+                                          SDIO_STA_TXUNDERR |
+                                          SDIO_STA_RXOVERR  |
+                                          SDIO_STA_STBITERR;
+/* Command path errors reported by transfers, mirrors SDIO_STA */
+static const uint32 SDIO_CMD_ERRORS     = SDIO_STA_CCRCFAIL |
+                                          SDIO_STA_CTIMEOUT;
+/* Software error flags, kept in the reserved bits of SDIO_STA */
+static const uint32 SDIO_CARD_ERROR     = 0x1 << 24; // R1 card status error
+static const uint32 SDIO_DMA_ERROR      = 0x1 << 25; // DMA transfer error
+static const uint32 SDIO_BUSY_ERROR     = 0x1 << 26; // transfer still pending
+/* Card status (R1) bits that signal a failed command */
+static const uint32 SDIO_CSR_ERRORS     = 0xFDFFE008;
+/* Expected after CMD12 when a multi-block read ends on the last block */
+static const uint32 SDIO_CSR_OUT_OF_RANGE = 0x1 << 31;
+/* Worst case access times from the physical layer spec */
+static const uint32 SDIO_READ_TIMEOUT_MS  = 100;
+static const uint32 SDIO_WRITE_TIMEOUT_MS = 250;
+static const uint32 SDIO_BLOCK_WORDS      = BLOCK_DEVICE_WORDS;
+/* CMD6 arguments: query or switch function group 1 to High Speed */
+static const uint32 SDIO_SWITCH_CHECK     = 0x00FFFFF1;
+static const uint32 SDIO_SWITCH_SET       = 0x80FFFFF1;
+/* SCR SD_BUS_WIDTHS bit for 4-bit support */
+static const uint32 SDIO_SCR_BUS_WIDTH_4  = 0x4;
+/* Largest multi-block transfer a single DMA channel setup can carry */
+static const uint32 SDIO_MAX_DMA_BLOCKS   = 65535 / SDIO_BLOCK_WORDS;
+
+/*
+ * Asynchronous transfers
+ */
+
+/**
+ * Completion callback for asynchronous transfers. Called from __irq_sdio()
+ * with 0 on success, otherwise the error flags that ended the transfer.
+ * Under FreeRTOS, give a semaphore with xSemaphoreGiveFromISR() here.
+ */
+typedef void (*SDIOCallback)(uint32 status);
+
+typedef enum SDIOState {
+    SDIO_STATE_IDLE    = 0, // no transfer pending
+    SDIO_STATE_STATUS  = 1, // CMD13 sent, card may still be programming
+    SDIO_STATE_APP     = 2, // CMD55 sent ahead of an application command
+    SDIO_STATE_ERASE   = 3, // ACMD23 sent ahead of CMD25
+    SDIO_STATE_COMMAND = 4, // data command sent
+    SDIO_STATE_DATA    = 5, // data path and DMA running
+    SDIO_STATE_STOP    = 6, // CMD12 sent
+    SDIO_STATE_DRAIN   = 7  // data path done, DMA still emptying the FIFO
+} SDIOState;
 
 /*
  * SDIO Enumerations
@@ -50,8 +106,8 @@ typedef enum SDIOBusMode {
 } SDIOBusMode;
 
 typedef enum SDIOClockFrequency {
-  //SDIO_36_MHZ   = 0, // High Speed Mode not yet supported
-    SDIO_24_MHZ   = 1,
+    SDIO_36_MHZ   = 0, // High Speed Mode only, see CMD6
+    SDIO_24_MHZ   = 1, // fastest Default Speed clock
     SDIO_18_MHZ   = 2,
     SDIO_12_MHZ   = 4,
     SDIO_6_MHZ    = 10,
@@ -64,6 +120,10 @@ typedef enum SDIOClockFrequency {
     SDIO_CLK_INIT = SDIO_300_KHZ //254 //281,250 Hz
 } SDIOClockFrequency;
 
+/* Bus clock while CMD13 polls a programming card. A poll and its response
+ * take about 136 clocks, some 270 us at 500 kHz, which paces the poll. */
+static const SDIOClockFrequency SDIO_BUSY_POLL_CLK = SDIO_500_KHZ;
+
 typedef enum SDIOBlockSize {
     SDIO_BKSZ_1       = 0,
     SDIO_BKSZ_2       = 1,
@@ -358,7 +418,7 @@ typedef struct CardInformationStructure {} cis;
 typedef struct CodeStorageArea {} csa;
 */
 
-class HardwareSDIO {
+class HardwareSDIO : public BlockDevice {
   public:
     icr ICR;
     ocr OCR;
@@ -372,6 +432,20 @@ class HardwareSDIO {
     SDAppCommand appCmd;
     SDIOClockFrequency clkFreq;
     SDIOBlockSize blkSize;
+    SDIOBusMode busWidth;
+    /*------------------------------------------ asynchronous transfer state */
+    volatile SDIOState state;
+    volatile uint32 xferStatus;
+    SDIOCallback xferDone;
+    SDCommand xferCmd;
+    uint32 xferArg;
+    const uint32 *xferBuf;
+    uint32 xferCount; // blocks left, including the current run
+    uint32 xferRun;   // blocks in the current run
+    SDIOBlockSize xferSize;
+    uint32 xferDir;
+    bool cardBusy;    // card may still be programming the last write
+    uint32 busyStart; // millis() when the card started programming
 
     HardwareSDIO(void);
     /*----------------------------------------------------- public functions */
@@ -379,9 +453,13 @@ class HardwareSDIO {
     void begin(void);
     void end(void);
   //void read(uint32, uint32*);
-    void read(uint32, uint32*, uint32);
+    virtual uint32 read(uint32, uint32*, uint32);
   //void write(uint32, uint32*);
-    void write(uint32, uint32*, uint32);
+    virtual uint32 write(uint32, const uint32*, uint32);
+    uint32 readAsync(uint32, uint32*, uint32, SDIOCallback);
+    uint32 writeAsync(uint32, const uint32*, uint32, SDIOCallback);
+    bool busy(void);
+    uint32 wait(void);
 //protected:
     /*--------------------------------------- card register access functions */
     void getICR(uint32);
@@ -390,7 +468,7 @@ class HardwareSDIO {
     void getCID(void);
     void getCSD(void);
     void setDSR(void);
-    void getSCR(void);
+    uint32 getSCR(void);
     void getSSR(void);
     void getCSR(void);
     /*----------------------------------------- card register save functions */
@@ -403,21 +481,46 @@ class HardwareSDIO {
     void idle(void);
     void initialization(void);
     void clockFreq(SDIOClockFrequency);
-    void busMode(SDIOBusMode);
+    uint32 busMode(SDIOBusMode);
+    uint32 highSpeed(void);
+    void optimize(SDIOClockFrequency);
     void blockSize(SDIOBlockSize);
     void select(uint16);
     void select(void);
     void deselect(void);
     /*------------------------------------------------- basic data functions */
-    void stop(void);
-    void readBlock(uint32, uint32*);
-    void writeBlock(uint32, uint32*);
+    uint32 stop(void);
+    uint32 readBlock(uint32, uint32*);
+    uint32 writeBlock(uint32, const uint32*);
+    uint32 readBlocks(uint32, uint32, uint32*);
+    uint32 writeBlocks(uint32, uint32, const uint32*);
+    /*-------------------------------------------------- data path functions */
+    uint32 address(uint32);
+    void dataTimeout(uint32);
+    void transfer(const uint32*, uint32, SDIOBlockSize, uint32);
+    void cancel(void);
+    /*----------------------------------------------- transfer state machine */
+    uint32 start(SDCommand, uint32, const uint32*, uint32, SDIOBlockSize,
+                 uint32, SDIOCallback);
+    uint32 start(SDAppCommand, uint32, const uint32*, uint32, SDIOBlockSize,
+                 uint32, SDIOCallback);
+    void next(void);
+    void issue(void);
+    void send(SDCommand, uint32, SDIOState);
+    void advance(void);
+    void respond(void);
+    void complete(uint32);
+    void drain(void);
+    void settle(uint32);
+    void proceed(void);
+    void finish(uint32);
   //private:
     /*---------------------------------------------------- command functions */
     void command(SDCommand, uint32);
     void command(SDAppCommand, uint32);
     void response(SDCommand);
     void response(SDAppCommand);
+    uint32 check(uint32);
 };
 
 #endif
\ No newline at end of file
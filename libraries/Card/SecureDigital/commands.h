@@ -30,6 +30,9 @@
  * @brief SD/MMC command listing
  */
 
+#ifndef _SD_COMMANDS_H_
+#define _SD_COMMANDS_H_
+
 /*  //FIXME temporary, replace these with more general routines
 static const uint32 SDIO_SWITCH_1V8_REQUEST     = 0x1 << 24; //Not allowed
 static const uint32 SDIO_SDXC_POWER_CONTROL     = 0x1 << 28; 
@@ -136,7 +139,7 @@ typedef enum SDCommand {
     /* CMD55 -  */
     APP_CMD                 = 55,
     /* CMD56 -  */
-    GEN_CMD                 = 56
+    GEN_CMD                 = 56,
     /* CMD58 - Reserved */
   //READ_OCR                = 58,
     /* CMD59 - Reserved */
@@ -157,7 +160,7 @@ typedef enum SDCommand {
 
 // Switch Function Commands (class 10)
     /* CMD6 - Checks switchable function and switches card function */
-  //SWITCH_FUNC             = 6,
+    SWITCH_FUNC             = 6
     /* CMD34 -  */
   //CMD34                   = 34,
     /* CMD37 - Reserved of MMC */
@@ -189,4 +192,6 @@ typedef enum SDAppCommand {
     /* ACMD51 -  */
     SEND_SCR                = 51
     /* ACMD52-59 - Reserved */
-} SDAppCommand;
\ No newline at end of file
+} SDAppCommand;
+
+#endif
\ No newline at end of file
@@ -11,7 +11,9 @@ CFLAGS_$(d) := $(WIRISH_INCLUDES) $(LIBMAPLE_INCLUDES)
 cSRCS_$(d) := 
 
 ifeq ($(BOARD),maple_native) # FIXME library only available on maple_native
-cppSRCS_$(d) := HardwareSDIO.cpp
+cppSRCS_$(d) := HardwareSDIO.cpp \
+               BlockCache.cpp \
+               DataLogger.cpp
 endif
 
 cFILES_$(d) := $(cSRCS_$(d):%=$(d)/%)
@@ -0,0 +1,124 @@
+/*
+ * FAT16 and FAT32 images for the Card library host tests.
+ *
+ * Writes just enough of a freshly formatted volume to any block device:
+ * the boot sector, the FSInfo block and partition table for FAT32, and
+ * the reserved head of both FATs. Everything else must read as zeros,
+ * as it does on a new image.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _CARD_TESTS_FATIMAGE_H_
+#define _CARD_TESTS_FATIMAGE_H_
+
+#include <Card/SecureDigital/BlockDevice.h>
+#include <string.h>
+
+/* FAT16 image: 1 reserved block, 2 FATs, 512 root entries, 1 block clusters */
+#define FAT16_CLUSTERS 8000
+#define FAT16_FAT_SIZE 32
+#define FAT16_DATA     (1 + 2 * FAT16_FAT_SIZE + 32)
+#define FAT16_BLOCKS   (FAT16_DATA + FAT16_CLUSTERS)
+
+/* FAT32 image: partition at block 63, 32 reserved blocks, 2 FATs */
+#define FAT32_START    63
+#define FAT32_CLUSTERS 70000
+#define FAT32_FAT_SIZE 547
+#define FAT32_DATA     (32 + 2 * FAT32_FAT_SIZE)
+#define FAT32_BLOCKS   (FAT32_START + FAT32_DATA + FAT32_CLUSTERS)
+
+static uint32 fatImageBlock[BLOCK_DEVICE_WORDS];
+
+static inline void put16(uint8 *p, uint32 value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static inline void put32(uint8 *p, uint32 value) {
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+static inline void bootSector(uint8 *b, uint32 reserved, uint32 rootEntries,
+                       uint32 total, uint32 hidden) {
+    memset(b, 0, 512);
+    b[0] = 0xEB;
+    b[1] = 0x3C;
+    b[2] = 0x90;
+    memcpy(b + 3, "MSWIN4.1", 8);
+    put16(b + 11, 512);
+    b[13] = 1;                  // blocks per cluster
+    put16(b + 14, reserved);
+    b[16] = 2;                  // FATs
+    put16(b + 17, rootEntries);
+    if (total < 0x10000) {
+        put16(b + 19, total);
+    } else {
+        put32(b + 32, total);
+    }
+    b[21] = 0xF8;               // fixed disk
+    put32(b + 28, hidden);
+    b[510] = 0x55;
+    b[511] = 0xAA;
+}
+
+/* Writes the first block of both FATs, clusters 0 and 1 reserved */
+static inline void fatHead(BlockDevice *disk, uint32 fat, uint32 fatSize,
+                    bool fat32) {
+    memset(fatImageBlock, 0, 512);
+    if (fat32) {
+        fatImageBlock[0] = 0x0FFFFFF8;
+        fatImageBlock[1] = 0x0FFFFFFF;
+        fatImageBlock[2] = 0x0FFFFFFF; // root directory, one cluster
+    } else {
+        fatImageBlock[0] = 0xFFFFFFF8;
+    }
+    disk->write(fat, fatImageBlock, 1);
+    disk->write(fat + fatSize, fatImageBlock, 1);
+}
+
+static inline uint32 formatFat16(BlockDevice *disk,
+                          uint32 clusters = FAT16_CLUSTERS) {
+    uint8 *b = (uint8*)fatImageBlock;
+    uint32 total = FAT16_DATA + clusters;
+    bootSector(b, 1, 512, total, 0);
+    b[22] = FAT16_FAT_SIZE;
+    b[38] = 0x29;
+    memcpy(b + 54, "FAT16   ", 8);
+    disk->write(0, fatImageBlock, 1);
+    fatHead(disk, 1, FAT16_FAT_SIZE, false);
+    return total;
+}
+
+static inline void formatFat32(BlockDevice *disk) {
+    uint8 *b = (uint8*)fatImageBlock;
+    memset(b, 0, 512); // master boot record, one FAT32 LBA partition
+    b[446 + 4] = 0x0C;
+    put32(b + 446 + 8, FAT32_START);
+    put32(b + 446 + 12, FAT32_BLOCKS - FAT32_START);
+    b[510] = 0x55;
+    b[511] = 0xAA;
+    disk->write(0, fatImageBlock, 1);
+
+    bootSector(b, 32, 0, FAT32_BLOCKS - FAT32_START, FAT32_START);
+    put32(b + 36, FAT32_FAT_SIZE);
+    put32(b + 44, 2);           // root directory cluster
+    put16(b + 48, 1);           // FSInfo block
+    put16(b + 50, 6);           // backup boot sector
+    b[66] = 0x29;
+    memcpy(b + 82, "FAT32   ", 8);
+    disk->write(FAT32_START, fatImageBlock, 1);
+    disk->write(FAT32_START + 6, fatImageBlock, 1);
+
+    memset(b, 0, 512);
+    put32(b, 0x41615252);
+    put32(b + 484, 0x61417272);
+    put32(b + 488, FAT32_CLUSTERS - 1);
+    put32(b + 492, 3);
+    put32(b + 508, 0xAA550000);
+    disk->write(FAT32_START + 1, fatImageBlock, 1);
+    fatHead(disk, FAT32_START + 32, FAT32_FAT_SIZE, true);
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * File backed block device for the Card library host tests.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _CARD_TESTS_FILEDISK_H_
+#define _CARD_TESTS_FILEDISK_H_
+
+#include <Card/SecureDigital/BlockDevice.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Error flag returned when the image file cannot be read or written */
+static const uint32 FILE_DISK_IO_ERROR = 0x2;
+
+/*
+ * Disk image in a temporary file, sparse until written. Blocks past the
+ * end of the file read as zeros, so an image only needs its metadata
+ * written to be complete.
+ */
+class FileDisk : public BlockDevice {
+  public:
+    FILE *file;
+    uint32 blocks;
+    uint32 reads;       // read() calls
+    uint32 writes;      // write() calls
+    uint32 blocksRead;
+    uint32 blocksWritten;
+
+    FileDisk(uint32 count) {
+        this->file = tmpfile();
+        this->blocks = count;
+        this->reset();
+    }
+
+    ~FileDisk(void) {
+        if (this->file) {
+            fclose(this->file);
+        }
+    }
+
+    void reset(void) {
+        this->reads = 0;
+        this->writes = 0;
+        this->blocksRead = 0;
+        this->blocksWritten = 0;
+    }
+
+    virtual uint32 read(uint32 block, uint32 *buf, uint32 count) {
+        if (!this->file || (block + count > this->blocks) ||
+            fseek(this->file, (long)block * 512, SEEK_SET)) {
+            return FILE_DISK_IO_ERROR;
+        }
+        this->reads++;
+        this->blocksRead += count;
+        size_t got = fread(buf, 1, count * 512, this->file);
+        memset((uint8*)buf + got, 0, count * 512 - got);
+        return 0;
+    }
+
+    virtual uint32 write(uint32 block, const uint32 *buf, uint32 count) {
+        if (!this->file || (block + count > this->blocks) ||
+            fseek(this->file, (long)block * 512, SEEK_SET) ||
+            (fwrite(buf, 512, count, this->file) != count)) {
+            return FILE_DISK_IO_ERROR;
+        }
+        this->writes++;
+        this->blocksWritten += count;
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * RAM backed block device for the Card library host tests.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _CARD_TESTS_RAMDISK_H_
+#define _CARD_TESTS_RAMDISK_H_
+
+#include <Card/SecureDigital/BlockDevice.h>
+#include <string.h>
+
+/* Error flag returned for accesses past the end of the disk */
+static const uint32 RAM_DISK_RANGE_ERROR = 0x1;
+
+template <uint32 BLOCKS>
+class RamDisk : public BlockDevice {
+  public:
+    uint32 data[BLOCKS][BLOCK_DEVICE_WORDS];
+    uint32 reads;       // read() calls
+    uint32 writes;      // write() calls
+    uint32 blocksRead;
+    uint32 blocksWritten;
+
+    RamDisk(void) {
+        memset(this->data, 0, sizeof(this->data));
+        this->reset();
+    }
+
+    void reset(void) {
+        this->reads = 0;
+        this->writes = 0;
+        this->blocksRead = 0;
+        this->blocksWritten = 0;
+    }
+
+    virtual uint32 read(uint32 block, uint32 *buf, uint32 count) {
+        if (block + count > BLOCKS) {
+            return RAM_DISK_RANGE_ERROR;
+        }
+        this->reads++;
+        this->blocksRead += count;
+        memcpy(buf, this->data[block], count * 512);
+        return 0;
+    }
+
+    virtual uint32 write(uint32 block, const uint32 *buf, uint32 count) {
+        if (block + count > BLOCKS) {
+            return RAM_DISK_RANGE_ERROR;
+        }
+        this->writes++;
+        this->blocksWritten += count;
+        memcpy(this->data[block], buf, count * 512);
+        return 0;
+    }
+};
+
+#endif
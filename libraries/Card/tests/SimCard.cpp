@@ -0,0 +1,1160 @@
+/*
+ * Simulated SD card and SDIO peripheral, see SimCard.h.
+ *
+ * This file is released into the public domain.
+ */
+
+#include "SimCard.h"
+
+#include <libmaple/sdio.h>
+#include <libmaple/dma.h>
+#include <libmaple/delay.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* Real time between ticks, and simulated time an idle tick lets pass */
+#define SIM_TICK_US      50
+#define SIM_IDLE_US      100
+/* Idle ticks without a peripheral access before a wait counts as hung */
+#define SIM_HUNG_TICKS   40000
+/* Handler calls in one delivery before flags count as never cleared */
+#define SIM_STORM        100000
+/* SDIOCLK runs from HCLK, 72 MHz on the Maple */
+#define SIM_SDIOCLK_KHZ  72000
+/* Bus clock above which a card needs High Speed mode, and below which
+ * it must run during identification */
+#define SIM_DEFAULT_KHZ  25000
+#define SIM_IDENT_KHZ    400
+/* Bus clocks of a command, its response and the turnaround between */
+#define SIM_CMD_CLOCKS   136
+/* Bus clocks before a read block starts, and around each block */
+#define SIM_NAC_CLOCKS   100
+#define SIM_BLOCK_CLOCKS 20
+
+#define SIM_CH           DMA_CH4
+#define SIM_ISR_SHIFT    ((SIM_CH - 1) * 4)
+
+/* Card status (R1) bits */
+#define R1_OUT_OF_RANGE      (1U << 31)
+#define R1_ADDRESS_ERROR     (1U << 30)
+#define R1_BLOCK_LEN_ERROR   (1U << 29)
+#define R1_ILLEGAL_COMMAND   (1U << 22)
+#define R1_READY_FOR_DATA    (1U << 8)
+#define R1_APP_CMD           (1U << 5)
+
+/* What the card sends or takes in its next data phase */
+typedef enum SimPayload {
+    SIM_NONE,
+    SIM_BLOCKS,
+    SIM_SCR,
+    SIM_SWITCH,
+    SIM_SSR
+} SimPayload;
+
+typedef struct SimResponse {
+    uint32 cmd;       // RESPCMD, 0x3F for R2 and R3
+    uint32 resp[4];
+    bool noCrc;       // R3 has no CRC, the host flags CCRCFAIL
+} SimResponse;
+
+/*
+ * Peripherals
+ */
+
+extern "C" {
+
+volatile uint32 systick_uptime_millis;
+
+static sdio_reg_map sdioRegs;
+static sdio_dev sdioDev = {&sdioRegs, RCC_SDIO, NVIC_SDIO, NULL};
+sdio_dev *SDIO = &sdioDev;
+
+/* dma_reg_map has const members, so it lives in plain words. dma_dev
+ * ends in a flexible array, this has room for channels 1-5. */
+static uint32 dma2Regs[sizeof(dma_reg_map) / sizeof(uint32)];
+static struct {
+    dma_reg_map *regs;
+    rcc_clk_id clk_id;
+    dma_handler_config handlers[5];
+} dma2Dev = {(dma_reg_map*)dma2Regs, RCC_DMA2, {}};
+dma_dev *DMA2 = (dma_dev*)&dma2Dev;
+
+void _fail(const char *file, int line, const char *exp) {
+    fprintf(stderr, "ASSERT failed: %s:%d: %s\n", file, line, exp);
+    abort();
+}
+
+}
+
+/*
+ * Simulator state
+ */
+
+static SimCard *card = NULL;
+static volatile uint64 now = 0;
+static volatile int depth = 0;       // simulator calls in progress
+static volatile int held = 0;        // sim_hold() nesting
+static volatile bool inIsr = false;
+static volatile uint32 idleTicks = 0;
+static bool ticking = false;
+
+/* Host data path state machine */
+static bool dpsmActive = false;
+static uint64 dataAt = 0;            // end of the running data phase
+static uint64 dtimeoutAt = 0;        // data timer expiry, none if 0
+/* DMA2 channel 4; CMAR is 32 bits wide, so the host keeps the pointer */
+static uint32 *dmaMem = NULL;
+static uint64 drainAt = 0;           // end of a DMA lagging behind DATAEND
+
+static void simFail(const char *what) {
+    fprintf(stderr, "SimCard: %s\n", what);
+    abort();
+}
+
+static dma_tube_reg_map* channel(void) {
+    return dma_tube_regs(DMA2, SIM_CH);
+}
+
+static uint32 busKhz(void) {
+    uint32 div = SDIO->regs->CLKCR & SDIO_CLKCR_CLKDIV;
+    return SIM_SDIOCLK_KHZ / (div + 2);
+}
+
+static uint64 clocksUs(uint64 clocks) {
+    return clocks * 1000 / busKhz() + 1;
+}
+
+static uint64 nextEvent(void) {
+    uint64 next = 0;
+    uint64 events[3] = {dataAt, dtimeoutAt, drainAt};
+    for (uint32 i=0; i<3; i++) {
+        if (events[i] && (!next || events[i] < next)) {
+            next = events[i];
+        }
+    }
+    return next;
+}
+
+static void setNow(uint64 t) {
+    if (t > now) {
+        now = t;
+    }
+    systick_uptime_millis = (uint32)(now / 1000);
+}
+
+/*
+ * Card model
+ */
+
+SimCard::SimCard(uint32 count) {
+    this->blocks = count;
+    this->highCapacity = true;
+    this->highSpeedCapable = true;
+    this->powerUpUs = 20000;
+    this->programUs = 500;
+    this->dmaLagWords = 0;
+    this->crcErrorBlock = ~0U;
+    this->clearLog();
+    this->nextRca = 0x1234;
+    this->file = tmpfile();
+    if (!this->file || ftruncate(fileno(this->file), (off_t)count * 512)) {
+        simFail("cannot create the card image");
+    }
+    this->fd = fileno(this->file);
+    this->reset();
+}
+
+SimCard::~SimCard(void) {
+    this->eject();
+    fclose(this->file);
+}
+
+void SimCard::clearLog(void) {
+    this->logCount = 0;
+    this->illegal = 0;
+    this->lastEraseCount = 0;
+    this->blocksRead = 0;
+    this->blocksWritten = 0;
+    this->drained = 0;
+}
+
+uint32 SimCard::count(uint32 cmd) {
+    uint32 n = 0;
+    uint32 first = (this->logCount > SIM_CARD_LOG)
+                   ? this->logCount - SIM_CARD_LOG : 0;
+    for (uint32 i=first; i<this->logCount; i++) {
+        if (this->log[i % SIM_CARD_LOG] == cmd) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void SimCard::insert(void) {
+    card = this;
+    this->reset();
+    sim_start();
+}
+
+void SimCard::eject(void) {
+    if (card == this) {
+        card = NULL;
+    }
+}
+
+/* Backdoor access to the image, not seen by the simulated bus */
+uint32 SimCard::read(uint32 block, uint32 *buf, uint32 count) {
+    idleTicks = 0;
+    if ((block >= this->blocks) || (count > this->blocks - block)) {
+        return 1;
+    }
+    ssize_t len = (ssize_t)count * 512;
+    return (pread(this->fd, buf, len, (off_t)block * 512) == len) ? 0 : 1;
+}
+
+uint32 SimCard::write(uint32 block, const uint32 *buf, uint32 count) {
+    idleTicks = 0;
+    if ((block >= this->blocks) || (count > this->blocks - block)) {
+        return 1;
+    }
+    ssize_t len = (ssize_t)count * 512;
+    return (pwrite(this->fd, buf, len, (off_t)block * 512) == len) ? 0 : 1;
+}
+
+/* Power up state, also reached with CMD0 */
+void SimCard::reset(void) {
+    this->state = SIM_CARD_IDLE;
+    this->rca = 0;
+    this->appCmd = false;
+    this->ready = false;
+    this->highSpeed = false;
+    this->busWidth = 1;
+    this->powerUpStart = 0;
+    this->programDone = 0;
+    this->errors = 0;
+    this->payload = SIM_NONE;
+    this->pastEnd = false;
+}
+
+/* Finishes programming once its busy time is up */
+void SimCard::update(void) {
+    if ((this->state == SIM_CARD_PRG) && (now >= this->programDone)) {
+        this->state = SIM_CARD_TRAN;
+    }
+}
+
+/* R1 card status, clears the error bits it reports */
+uint32 SimCard::r1(bool acmd) {
+    uint32 status = this->errors | ((uint32)this->state << 9);
+    if (this->state != SIM_CARD_PRG) {
+        status |= R1_READY_FOR_DATA;
+    }
+    if (acmd) {
+        status |= R1_APP_CMD;
+    }
+    this->errors = 0;
+    return status;
+}
+
+/* Converts a data command argument into a block number */
+bool SimCard::address(uint32 arg, uint32 *block) {
+    if (!this->highCapacity) {
+        if (arg & 0x1FF) {
+            this->errors |= R1_ADDRESS_ERROR;
+            return false;
+        }
+        arg >>= 9;
+    }
+    if (arg >= this->blocks) {
+        this->errors |= R1_OUT_OF_RANGE;
+        return false;
+    }
+    *block = arg;
+    return true;
+}
+
+static void startData(void);
+
+/*
+ * Answers one command. Returns false when the card stays silent, because
+ * the command was not addressed to it or is illegal in its state.
+ */
+bool SimCard::command(uint32 cmd, uint32 arg, SimResponse *r) {
+    bool acmd = this->appCmd;
+    this->appCmd = false;
+    this->update();
+    this->log[this->logCount % SIM_CARD_LOG] = cmd | (acmd ? SIM_CARD_ACMD
+                                                           : 0);
+    this->logArg[this->logCount % SIM_CARD_LOG] = arg;
+    this->logCount++;
+    SimCardState s = this->state;
+    bool addressed = (arg >> 16) == this->rca;
+    bool legal;
+    memset(r, 0, sizeof(*r));
+    r->cmd = cmd;
+    if (acmd) {
+        switch (cmd) {
+          case 6:
+          case 13:
+          case 23:
+          case 51:
+            legal = (s == SIM_CARD_TRAN);
+            break;
+          case 41: // real cards ignore it once ready, but answering
+          case 55: // keeps the driver's fixed count of polls legal
+            legal = (s == SIM_CARD_IDLE) || (s == SIM_CARD_READY);
+            break;
+          default:
+            acmd = false;
+            break;
+        }
+    }
+    if (!acmd) {
+        switch (cmd) {
+          case 0:
+            legal = true;
+            break;
+          case 2:
+            legal = (s == SIM_CARD_READY);
+            break;
+          case 3:
+            legal = (s == SIM_CARD_IDENT) || (s == SIM_CARD_STBY);
+            break;
+          case 7:
+            legal = (s == SIM_CARD_STBY) || (s == SIM_CARD_TRAN);
+            break;
+          case 8:
+            legal = (s == SIM_CARD_IDLE);
+            break;
+          case 9:
+          case 10:
+            legal = (s == SIM_CARD_STBY);
+            break;
+          case 12:
+            legal = (s == SIM_CARD_DATA) || (s == SIM_CARD_RCV);
+            break;
+          case 13:
+            legal = (s >= SIM_CARD_STBY);
+            break;
+          case 55:
+            legal = (s == SIM_CARD_IDLE) || (s == SIM_CARD_READY) ||
+                    (s >= SIM_CARD_STBY);
+            break;
+          case 6:
+          case 16:
+          case 17:
+          case 18:
+          case 24:
+          case 25:
+            legal = (s == SIM_CARD_TRAN);
+            break;
+          default:
+            legal = false;
+            break;
+        }
+    }
+    if (!legal) {
+        this->illegal++;
+        this->errors |= R1_ILLEGAL_COMMAND;
+        return false;
+    }
+    if (s >= SIM_CARD_STBY) {
+        switch (cmd) {
+          case 7:
+            if (!addressed) {
+                this->state = SIM_CARD_STBY; // deselected, no response
+                return false;
+            }
+            break;
+          case 9:
+          case 10:
+          case 13:
+          case 55:
+            if (!acmd && !addressed) {
+                return false;
+            }
+            break;
+          default:
+            break;
+        }
+    }
+    if (acmd) {
+        switch (cmd) {
+          case 6:
+            if ((arg & 0x3) == 0x2) {
+                this->busWidth = 4;
+            } else if ((arg & 0x3) == 0x0) {
+                this->busWidth = 1;
+            } else {
+                this->errors |= R1_ILLEGAL_COMMAND;
+            }
+            r->resp[0] = this->r1(true);
+            return true;
+          case 13:
+          case 51:
+            r->resp[0] = this->r1(true);
+            this->payload = (cmd == 13) ? SIM_SSR : SIM_SCR;
+            this->state = SIM_CARD_DATA;
+            startData();
+            return true;
+          case 23:
+            this->lastEraseCount = arg & 0x7FFFFF;
+            r->resp[0] = this->r1(true);
+            return true;
+          case 41: {
+            uint32 ocr = 0xFF8000;
+            if (arg) {
+                if (!this->powerUpStart) {
+                    this->powerUpStart = now ? now : 1;
+                }
+                if (now - this->powerUpStart >= this->powerUpUs) {
+                    this->ready = true;
+                }
+            }
+            if (this->ready) {
+                ocr |= 0x80000000;
+                if (this->highCapacity) {
+                    ocr |= 0x40000000;
+                }
+                this->state = SIM_CARD_READY;
+            }
+            r->cmd = 0x3F;
+            r->resp[0] = ocr;
+            r->noCrc = true;
+            return true;
+          }
+        }
+    }
+    switch (cmd) {
+      case 0:
+        this->reset();
+        return false;
+      case 2:
+      case 10:
+        // MID 0x03, OID "SM", PNM "SIMSD", PRV 1.0, PSN, MDT 2012/6
+        r->cmd = 0x3F;
+        r->resp[0] = 0x03534D53;
+        r->resp[1] = 0x494D5344;
+        r->resp[2] = 0x10000000 | (0x00C0FFEE >> 8);
+        r->resp[3] = (0xEEU << 24) | (0x0C6 << 8) | 0x1;
+        if (cmd == 2) {
+            this->state = SIM_CARD_IDENT;
+        }
+        return true;
+      case 3:
+        this->rca = this->nextRca++;
+        this->state = SIM_CARD_STBY;
+        r->resp[0] = ((uint32)this->rca << 16) |
+                     (this->r1(false) & 0x1FFF);
+        return true;
+      case 7:
+        r->resp[0] = this->r1(false);
+        if (s == SIM_CARD_STBY) {
+            this->state = SIM_CARD_TRAN;
+        }
+        return true;
+      case 8:
+        if (((arg >> 8) & 0xF) != 0x1) {
+            return false; // voltage not supported
+        }
+        r->resp[0] = arg & 0xFFF;
+        return true;
+      case 9:
+        r->cmd = 0x3F;
+        if (this->highCapacity) {
+            // CSD 2.0: TAAC 1 ms, TRAN_SPEED 25 MHz, 512 byte blocks
+            uint32 csize = this->blocks / 1024 - 1;
+            r->resp[0] = 0x400E0032;
+            r->resp[1] = 0x5B590000 | (csize >> 16);
+            r->resp[2] = ((csize & 0xFFFF) << 16) | 0x7F80;
+            r->resp[3] = 0x0A400001;
+        } else {
+            // CSD 1.0 with C_SIZE_MULT 7 and 512 byte blocks
+            uint32 csize = this->blocks / 512 - 1;
+            r->resp[0] = 0x002E0032;
+            r->resp[1] = 0x5F590000 | (csize >> 2);
+            r->resp[2] = ((csize & 0x3) << 30) | (0x7 << 15) | 0x7F80;
+            r->resp[3] = 0x0A400001;
+        }
+        return true;
+      case 12:
+        if (this->pastEnd) {
+            this->errors |= R1_OUT_OF_RANGE;
+            this->pastEnd = false;
+        }
+        r->resp[0] = this->r1(false);
+        this->payload = SIM_NONE;
+        if (s == SIM_CARD_RCV) {
+            this->state = SIM_CARD_PRG;
+            this->programDone = now + this->programUs;
+        } else {
+            this->state = SIM_CARD_TRAN;
+        }
+        return true;
+      case 13:
+      case 16:
+        if ((cmd == 16) && ((arg == 0) || (arg > 512))) {
+            this->errors |= R1_BLOCK_LEN_ERROR;
+        }
+        r->resp[0] = this->r1(false);
+        return true;
+      case 55:
+        this->appCmd = true;
+        r->resp[0] = this->r1(true);
+        return true;
+      case 6:
+        r->resp[0] = this->r1(false);
+        if ((arg & 0x80000000) && this->highSpeedCapable) {
+            this->highSpeed = true;
+        }
+        this->switchArg = arg;
+        this->payload = SIM_SWITCH;
+        this->state = SIM_CARD_DATA;
+        startData();
+        return true;
+      case 17:
+      case 18:
+      case 24:
+      case 25: {
+        uint32 block = 0;
+        bool ok = this->address(arg, &block);
+        r->resp[0] = this->r1(false);
+        if (!ok) {
+            return true; // error reported, the card stays in tran
+        }
+        this->dataBlock = block;
+        this->multi = (cmd == 18) || (cmd == 25);
+        this->payload = SIM_BLOCKS;
+        this->state = (cmd < 24) ? SIM_CARD_DATA : SIM_CARD_RCV;
+        startData();
+        return true;
+      }
+    }
+    return false;
+}
+
+/* Fills in the register a data command reads */
+uint32 SimCard::fill(uint8 *reg) {
+    memset(reg, 0, 64);
+    switch (this->payload) {
+      case SIM_SCR:
+        // SD_SPEC 2, CPRM 2.00, 1 and 4 bit bus
+        reg[0] = 0x02;
+        reg[1] = 0x35;
+        return 8;
+      case SIM_SWITCH: {
+        bool set = this->switchArg & 0x80000000;
+        bool hs = this->highSpeedCapable && ((this->switchArg & 0xF) == 1);
+        reg[1] = 100; // 100 mA
+        reg[13] = this->highSpeedCapable ? 0x03 : 0x01;
+        reg[16] = hs ? 0x1 : (set ? 0xF : 0x0);
+        return 64;
+      }
+      case SIM_SSR:
+        reg[0] = (this->busWidth == 4) ? 0x80 : 0x00;
+        return 64;
+      default:
+        return 512;
+    }
+}
+
+/*
+ * Data path
+ */
+
+/* Size of one block of the card's next data phase */
+static uint32 payloadBlock(void) {
+    switch (card->payload) {
+      case SIM_SCR:
+        return 8;
+      case SIM_SWITCH:
+      case SIM_SSR:
+        return 64;
+      default:
+        return 512;
+    }
+}
+
+/* Starts the data phase once both the host and the card are ready */
+static void startData(void) {
+    if (!card || !dpsmActive || dataAt || (card->payload == SIM_NONE)) {
+        return;
+    }
+    bool read = SDIO->regs->DCTRL & SDIO_DCTRL_DTDIR;
+    if (read ? (card->state != SIM_CARD_DATA)
+             : (card->state != SIM_CARD_RCV)) {
+        return;
+    }
+    uint32 bytes = SDIO->regs->DLEN;
+    uint32 width = (SDIO->regs->CLKCR & SDIO_CLKCR_WIDBUS_4WIDE) ? 4 : 1;
+    uint64 clocks = (uint64)bytes * 8 / width +
+                    (bytes / payloadBlock() + 1) * SIM_BLOCK_CLOCKS;
+    if (read) {
+        clocks += SIM_NAC_CLOCKS;
+    }
+    dtimeoutAt = 0;
+    dataAt = now + clocksUs(clocks);
+}
+
+/* Moves words between the image or register and DMA memory */
+static void moveWords(bool read, uint32 offset, const uint8 *reg,
+                      uint32 words) {
+    if (!words) {
+        return;
+    }
+    if (!reg) {
+        off_t pos = (off_t)card->dataBlock * 512 + offset * 4;
+        ssize_t len = (ssize_t)words * 4;
+        if (read ? (pread(card->fd, dmaMem, len, pos) != len)
+                 : (pwrite(card->fd, dmaMem, len, pos) != len)) {
+            simFail("card image I/O failed");
+        }
+    } else if (read) {
+        memcpy(dmaMem, reg + offset * 4, words * 4);
+    }
+    dmaMem += words;
+    channel()->CNDTR -= words;
+}
+
+/* Ends a data phase, with the status the card and DMA setup give it */
+static void finishData(void) {
+    dataAt = 0;
+    dpsmActive = false;
+    dma_tube_reg_map *ch = channel();
+    uint32 dctrl = SDIO->regs->DCTRL;
+    bool read = dctrl & SDIO_DCTRL_DTDIR;
+    uint32 size = 1U << ((dctrl & SDIO_DCTRL_DBLOCKSIZE) >>
+                         SDIO_DCTRL_DBLOCKSIZE_BIT);
+    uint32 words = SDIO->regs->DLEN / 4;
+    uint32 blocks = SDIO->regs->DLEN / payloadBlock();
+    uint32 good = blocks;
+    uint32 flags = 0;
+    uint8 reg[64];
+    bool isReg = card->payload != SIM_BLOCKS;
+    uint32 regBytes = card->fill(reg);
+    uint32 width = (SDIO->regs->CLKCR & SDIO_CLKCR_WIDBUS_4WIDE) ? 4 : 1;
+    if (!(dctrl & SDIO_DCTRL_DMAEN) || !(ch->CCR & DMA_CCR_EN) ||
+        !dmaMem || (ch->CNDTR < words) ||
+        (!(ch->CCR & DMA_CCR_DIR) != read)) {
+        flags = read ? SDIO_STA_RXOVERR : SDIO_STA_TXUNDERR;
+        good = 0;
+    } else if ((size != payloadBlock()) || (width != card->busWidth) ||
+               (isReg && (SDIO->regs->DLEN != regBytes)) ||
+               ((busKhz() > SIM_DEFAULT_KHZ) && !card->highSpeed)) {
+        flags = SDIO_STA_DCRCFAIL;
+        good = 0;
+    } else if (!isReg && read && !card->multi && (blocks != 1)) {
+        flags = SDIO_STA_DTIMEOUT; // CMD17 sends one block only
+        good = 1;
+    } else if (!isReg && (card->dataBlock + blocks > card->blocks)) {
+        flags = SDIO_STA_DTIMEOUT; // the card stops at its last block
+        good = card->blocks - card->dataBlock;
+        card->pastEnd = true;
+    }
+    if (!isReg && (card->crcErrorBlock >= card->dataBlock) &&
+        (card->crcErrorBlock - card->dataBlock < good)) {
+        flags = SDIO_STA_DCRCFAIL;
+        good = card->crcErrorBlock - card->dataBlock;
+        card->crcErrorBlock = ~0U;
+    }
+    if (isReg) {
+        if (!flags) {
+            moveWords(true, 0, reg, words);
+        }
+        card->payload = SIM_NONE;
+        card->state = SIM_CARD_TRAN;
+    } else {
+        uint32 lag = (read && !flags) ? card->dmaLagWords : 0;
+        if (lag > words) {
+            lag = words;
+        }
+        moveWords(read, 0, NULL, good * BLOCK_DEVICE_WORDS - lag);
+        if (read) {
+            card->blocksRead += good;
+        } else {
+            card->blocksWritten += good;
+        }
+        if (lag) {
+            drainAt = now + 1;
+            card->lag = lag;
+            card->lagPos = ((uint64)card->dataBlock + good) * 512 - lag * 4;
+        }
+        if (card->multi) {
+            card->dataBlock += good;
+            if (read) {
+                card->payload = SIM_NONE; // streams on until CMD12
+                if (card->dataBlock >= card->blocks) {
+                    card->pastEnd = true;
+                }
+            }
+        } else if (read || flags) {
+            card->payload = SIM_NONE;
+            card->state = SIM_CARD_TRAN;
+        } else {
+            card->payload = SIM_NONE;
+            card->state = SIM_CARD_PRG;
+            card->programDone = now + card->programUs;
+        }
+    }
+    if (!flags && !ch->CNDTR) {
+        DMA2->regs->ISR |= (DMA_ISR_GIF1 | DMA_ISR_TCIF1) << SIM_ISR_SHIFT;
+    }
+    SDIO->regs->STA |= flags ? flags : (SDIO_STA_DATAEND | SDIO_STA_DBCKEND);
+}
+
+/* Lets a lagging DMA channel catch up with the data path */
+static void finishDrain(void) {
+    drainAt = 0;
+    dma_tube_reg_map *ch = channel();
+    if (!card || !(ch->CCR & DMA_CCR_EN)) {
+        return; // cancelled underneath
+    }
+    uint32 lag = card->lag;
+    card->lag = 0;
+    if (pread(card->fd, dmaMem, lag * 4, card->lagPos) != (ssize_t)lag * 4) {
+        simFail("card image I/O failed");
+    }
+    dmaMem += lag;
+    ch->CNDTR -= lag;
+    card->drained++;
+    DMA2->regs->ISR |= (DMA_ISR_GIF1 | DMA_ISR_TCIF1) << SIM_ISR_SHIFT;
+}
+
+/*
+ * Interrupts
+ */
+
+/* Applies a write to the DMA interrupt flag clear register */
+static void clearDmaFlags(void) {
+    uint32 ifcr = DMA2->regs->IFCR;
+    if (ifcr) {
+        for (uint32 ch=0; ch<7; ch++) {
+            if (ifcr & (DMA_IFCR_CGIF1 << (4 * ch))) {
+                ifcr |= 0xFU << (4 * ch); // CGIF clears the channel
+            }
+        }
+        DMA2->regs->ISR &= ~ifcr;
+        DMA2->regs->IFCR = 0;
+    }
+}
+
+/* Runs the hardware events that have fallen due */
+static void runEvents(void) {
+    clearDmaFlags();
+    if (dataAt && (now >= dataAt)) {
+        finishData();
+    }
+    if (dtimeoutAt && (now >= dtimeoutAt)) {
+        dtimeoutAt = 0;
+        dpsmActive = false;
+        SDIO->regs->STA |= SDIO_STA_DTIMEOUT;
+    }
+    if (drainAt && (now >= drainAt)) {
+        finishDrain();
+    }
+}
+
+/* Calls the pending interrupt handlers, like the NVIC, until none are */
+static void deliver(void) {
+    inIsr = true;
+    for (uint32 calls=0; ; calls++) {
+        if (calls > SIM_STORM) {
+            simFail("interrupt flags never cleared");
+        }
+        runEvents();
+        if (SDIO->handler && (SDIO->regs->STA & SDIO->regs->MASK)) {
+            SDIO->handler();
+            continue;
+        }
+        void (*handler)(void) = dma2Dev.handlers[SIM_CH - 1].handler;
+        uint32 isr = DMA2->regs->ISR >> SIM_ISR_SHIFT;
+        uint32 ccr = channel()->CCR;
+        if (handler && (((isr & DMA_ISR_TCIF1) && (ccr & DMA_CCR_TCIE)) ||
+                        ((isr & DMA_ISR_TEIF1) && (ccr & DMA_CCR_TEIE)))) {
+            handler();
+            dma_clear_isr_bits(DMA2, SIM_CH); // as dma_irq_handler()
+            continue;
+        }
+        break;
+    }
+    inIsr = false;
+}
+
+/* Brackets every peripheral access; interrupts are taken on the way out */
+static void enter(void) {
+    depth++;
+    idleTicks = 0;
+    clearDmaFlags();
+}
+
+static void leave(void) {
+    if (depth == 1) {
+        runEvents();
+    }
+    depth--;
+    if (!depth && !inIsr && !held) {
+        deliver();
+    }
+}
+
+/* Lets simulated time pass up to until, taking interrupts on the way */
+static void advance(uint64 until) {
+    enter();
+    for (;;) {
+        uint64 next = nextEvent();
+        if (!next || (next > until)) {
+            break;
+        }
+        setNow(next);
+        runEvents();
+        if ((depth == 1) && !inIsr && !held) {
+            depth--;
+            deliver();
+            depth++;
+        }
+    }
+    setNow(until);
+    leave();
+}
+
+/* Moves time on while the program runs or spins waiting */
+static void tick(int) {
+    if (depth || inIsr) {
+        return;
+    }
+    depth++;
+    uint64 next = nextEvent();
+    if (!next) {
+        if (++idleTicks > SIM_HUNG_TICKS) {
+            static const char msg[] = "SimCard: waiting on nothing, hung\n";
+            if (write(2, msg, sizeof(msg) - 1)) {
+            }
+            abort();
+        }
+        next = now + SIM_IDLE_US;
+    }
+    setNow(next);
+    runEvents();
+    depth--;
+    if (!held) {
+        deliver();
+    }
+}
+
+void sim_start(void) {
+    if (ticking) {
+        return;
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = tick;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, NULL);
+    struct itimerval tv;
+    tv.it_interval.tv_sec = 0;
+    tv.it_interval.tv_usec = SIM_TICK_US;
+    tv.it_value = tv.it_interval;
+    setitimer(ITIMER_REAL, &tv, NULL);
+    ticking = true;
+}
+
+uint64 sim_micros(void) {
+    return now;
+}
+
+void sim_run(uint32 us) {
+    advance(now + us);
+}
+
+void sim_hold(void) {
+    held++;
+}
+
+void sim_release(void) {
+    if (--held == 0) {
+        enter();
+        leave();
+    }
+}
+
+extern "C" void sim_delay_us(uint32 us) {
+    advance(now + us);
+}
+
+/*
+ * libmaple SDIO
+ */
+
+static void command(void) {
+    uint32 cmd = SDIO->regs->CMD;
+    if (!(cmd & SDIO_CMD_CPSMEN)) {
+        return;
+    }
+    if ((SDIO->regs->POWER != SDIO_POWER_ON) ||
+        !(SDIO->regs->CLKCR & SDIO_CLKCR_CLKEN)) {
+        simFail("command sent with the bus clock stopped");
+    }
+    if (card && (card->state <= SIM_CARD_IDENT) &&
+        (busKhz() > SIM_IDENT_KHZ)) {
+        simFail("identification mode clock above 400 kHz");
+    }
+    setNow(now + clocksUs(SIM_CMD_CLOCKS));
+    uint32 wait = cmd & SDIO_CMD_WAITRESP;
+    SimResponse r;
+    bool answered = card && card->command(cmd & SDIO_CMD_CMDINDEX,
+                                          SDIO->regs->ARG, &r);
+    if ((wait == SDIO_CMD_WAITRESP_NONE) || (wait == (0x2 << SDIO_CMD_WAITRESP_BIT))) {
+        SDIO->regs->STA |= SDIO_STA_CMDSENT;
+    } else if (!answered) {
+        SDIO->regs->STA |= SDIO_STA_CTIMEOUT;
+    } else {
+        SDIO->regs->RESPCMD = r.cmd;
+        SDIO->regs->RESP1 = r.resp[0];
+        SDIO->regs->RESP2 = r.resp[1];
+        SDIO->regs->RESP3 = r.resp[2];
+        SDIO->regs->RESP4 = r.resp[3];
+        SDIO->regs->STA |= r.noCrc ? SDIO_STA_CCRCFAIL : SDIO_STA_CMDREND;
+    }
+}
+
+/* Arms or stops the data path after a DCTRL write */
+static void dataControl(void) {
+    if (!(SDIO->regs->DCTRL & SDIO_DCTRL_DTEN)) {
+        dpsmActive = false;
+        dataAt = 0;
+        dtimeoutAt = 0;
+        return;
+    }
+    if (dpsmActive) {
+        return;
+    }
+    dpsmActive = true;
+    uint64 clocks = SDIO->regs->DTIMER;
+    dtimeoutAt = now + clocksUs(clocks);
+    startData();
+}
+
+void sdio_cfg_gpio(void) {
+}
+
+void sdio_power_on(void) {
+    enter();
+    SDIO->regs->POWER = SDIO_POWER_ON;
+    leave();
+}
+
+void sdio_power_off(void) {
+    enter();
+    SDIO->regs->POWER = SDIO_POWER_OFF;
+    if (card) {
+        card->reset();
+    }
+    leave();
+}
+
+uint32 sdio_card_powered(void) {
+    return SDIO->regs->POWER == SDIO_POWER_ON;
+}
+
+uint32 sdio_card_detect(void) {
+    return card != NULL;
+}
+
+void sdio_init(void) {
+    enter();
+    memset(SDIO->regs, 0, sizeof(sdio_reg_map)); // rcc_reset_dev()
+    dpsmActive = false;
+    dataAt = 0;
+    dtimeoutAt = 0;
+    leave();
+}
+
+void sdio_reset(void) {
+    sdio_init();
+}
+
+void sdio_set_clkcr(uint32 val) {
+    enter();
+    SDIO->regs->CLKCR = ~SDIO_CLKCR_RESERVED & val;
+    leave();
+}
+
+void sdio_cfg_clkcr(uint32 spc, uint32 val) {
+    enter();
+    spc = ~SDIO_CLKCR_RESERVED & spc;
+    SDIO->regs->CLKCR = (SDIO->regs->CLKCR & ~spc) | (spc & val);
+    leave();
+}
+
+void sdio_clock_enable(void) {
+    sdio_cfg_clkcr(SDIO_CLKCR_CLKEN, SDIO_CLKCR_CLKEN);
+}
+
+void sdio_clock_disable(void) {
+    sdio_cfg_clkcr(SDIO_CLKCR_CLKEN, 0);
+}
+
+void sdio_load_arg(uint32 arg) {
+    enter();
+    SDIO->regs->ARG = arg;
+    leave();
+}
+
+void sdio_send_command(uint32 cmd) {
+    enter();
+    SDIO->regs->CMD = (SDIO->regs->CMD & SDIO_CMD_RESERVED) |
+                      (~SDIO_CMD_RESERVED & cmd);
+    command();
+    leave();
+}
+
+void sdio_set_dcr(uint32 val) {
+    enter();
+    SDIO->regs->DCTRL = ~SDIO_DCTRL_RESERVED & val;
+    dataControl();
+    leave();
+}
+
+void sdio_set_data_timeout(uint32 timeout) {
+    enter();
+    SDIO->regs->DTIMER = timeout;
+    leave();
+}
+
+void sdio_set_data_length(uint32 length) {
+    enter();
+    SDIO->regs->DLEN = ~SDIO_DLEN_RESERVED & length;
+    leave();
+}
+
+uint32 sdio_check_status(uint32 mask) {
+    enter();
+    uint32 status = SDIO->regs->STA & mask;
+    leave();
+    return status;
+}
+
+void sdio_clear_interrupt(uint32 flag) {
+    enter();
+    SDIO->regs->STA &= ~(~SDIO_ICR_RESERVED & flag);
+    leave();
+}
+
+void sdio_enable_interrupt(uint32 mask) {
+    enter();
+    SDIO->regs->MASK = ~SDIO_MASK_RESERVED & mask;
+    leave();
+}
+
+void sdio_attach_interrupt(voidFuncPtr handler) {
+    enter();
+    SDIO->handler = handler;
+    leave();
+}
+
+void sdio_detach_interrupt(void) {
+    enter();
+    SDIO->regs->MASK = 0;
+    SDIO->handler = NULL;
+    leave();
+}
+
+/*
+ * libmaple DMA, channel 4 of DMA2 only
+ */
+
+void dma_init(dma_dev *dev) {
+    ASSERT(dev == DMA2);
+}
+
+int dma_tube_cfg(dma_dev *dev, dma_tube tube, dma_tube_config *cfg) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    dma_tube_reg_map *ch = channel();
+    __io void *fifo = &SDIO->regs->FIFO;
+    bool toCard = cfg->tube_dst == fifo;
+    int status = DMA_TUBE_CFG_SUCCESS;
+    if ((toCard ? cfg->tube_src : cfg->tube_dst) == fifo) {
+        status = -DMA_TUBE_CFG_ECFG;
+    } else if (!toCard && (cfg->tube_src != fifo)) {
+        status = -DMA_TUBE_CFG_ECFG; // no other peripheral here
+    } else if ((cfg->tube_src_size != DMA_SIZE_32BITS) ||
+               (cfg->tube_dst_size != DMA_SIZE_32BITS)) {
+        status = -DMA_TUBE_CFG_ESIZE;
+    } else if (cfg->tube_req_src != DMA_REQ_SRC_SDIO) {
+        status = -DMA_TUBE_CFG_EREQ;
+    } else if (cfg->tube_nr_xfers > 65535) {
+        status = -DMA_TUBE_CFG_ENDATA;
+    }
+    if (status == DMA_TUBE_CFG_SUCCESS) {
+        ch->CCR = (DMA_SIZE_32BITS << 10) | (DMA_SIZE_32BITS << 8) |
+                  (cfg->tube_flags & 0xF) | (toCard ? DMA_CCR_DIR : 0) |
+                  ((cfg->tube_flags & (DMA_CFG_SRC_INC | DMA_CFG_DST_INC))
+                   ? DMA_CCR_MINC : 0);
+        ch->CNDTR = cfg->tube_nr_xfers;
+        dmaMem = (uint32*)(toCard ? cfg->tube_src : cfg->tube_dst);
+        DMA2->regs->IFCR = DMA_IFCR_CGIF1 << SIM_ISR_SHIFT;
+    }
+    leave();
+    return status;
+}
+
+void dma_set_priority(dma_dev *dev, dma_tube tube, dma_priority priority) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    ASSERT_FAULT(!(channel()->CCR & DMA_CCR_EN));
+    channel()->CCR = (channel()->CCR & ~DMA_CCR_PL) | (priority << 12);
+    leave();
+}
+
+void dma_enable(dma_dev *dev, dma_tube tube) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    channel()->CCR |= DMA_CCR_EN;
+    leave();
+}
+
+void dma_disable(dma_dev *dev, dma_tube tube) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    channel()->CCR &= ~DMA_CCR_EN;
+    drainAt = 0;
+    leave();
+}
+
+void dma_attach_interrupt(dma_dev *dev, dma_tube tube,
+                          void (*handler)(void)) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    dma2Dev.handlers[tube - 1].handler = handler;
+    leave();
+}
+
+void dma_detach_interrupt(dma_dev *dev, dma_tube tube) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    channel()->CCR &= ~0xF;
+    dma2Dev.handlers[tube - 1].handler = NULL;
+    leave();
+}
+
+dma_irq_cause dma_get_irq_cause(dma_dev *dev, dma_tube tube) {
+    ASSERT((dev == DMA2) && (tube == SIM_CH));
+    enter();
+    uint8 bits = dma_get_isr_bits(dev, tube);
+    dma_clear_isr_bits(dev, tube);
+    leave();
+    ASSERT(bits & 0x1);
+    ASSERT(bits != 0x1);
+    if (bits & 0x8) {
+        return DMA_TRANSFER_ERROR;
+    } else if (bits & 0x2) {
+        return DMA_TRANSFER_COMPLETE;
+    }
+    return DMA_TRANSFER_HALF_COMPLETE;
+}
@@ -0,0 +1,127 @@
+/*
+ * Simulated SD card and SDIO peripheral for the Card library host tests.
+ *
+ * HardwareSDIO is built for the host unchanged and runs against an
+ * emulated sdio_reg_map and DMA2 channel 4. SimCard.cpp stands in for
+ * the libmaple sdio and dma drivers: command register writes are
+ * answered by an SD card state machine whose blocks live in an image
+ * file, data phases move through the emulated DMA channel, and status
+ * flags raise the SDIO and DMA interrupts the way the NVIC would.
+ *
+ * Time is simulated. delay_us() advances it directly, and while the
+ * test waits a SIGALRM tick jumps it to the next card event, so a
+ * 250 ms card stall costs no real time. Interrupt handlers run either
+ * right after the register access that raised them or from the tick,
+ * never nested, just as on the Maple.
+ *
+ * The card answers CMD0, 2, 3, 6, 7, 8, 9, 10, 12, 13, 16, 17, 18, 24,
+ * 25 and 55, and ACMD6, 13, 23, 41 and 51. Commands sent in the wrong
+ * state get no response and are counted in illegal. Data phases check
+ * the host's block size, bus width and clock against the card, and DMA
+ * against the data path, so sequencing mistakes show up as the errors
+ * real hardware would give.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _CARD_TESTS_SIMCARD_H_
+#define _CARD_TESTS_SIMCARD_H_
+
+#include <Card/SecureDigital/BlockDevice.h>
+#include <stdio.h>
+
+/* Commands remembered in SimCard::log */
+#define SIM_CARD_LOG 1024
+/* Set in log entries for application commands */
+#define SIM_CARD_ACMD 0x100
+
+/* SD card states, as reported in the R1 CURRENT_STATE field */
+typedef enum SimCardState {
+    SIM_CARD_IDLE  = 0,
+    SIM_CARD_READY = 1,
+    SIM_CARD_IDENT = 2,
+    SIM_CARD_STBY  = 3,
+    SIM_CARD_TRAN  = 4,
+    SIM_CARD_DATA  = 5,
+    SIM_CARD_RCV   = 6,
+    SIM_CARD_PRG   = 7
+} SimCardState;
+
+struct SimResponse;
+
+/*
+ * The card. Its read() and write() go straight to the image, around
+ * the simulated bus, for preparing and checking card contents.
+ */
+class SimCard : public BlockDevice {
+  public:
+    /*------------------------------------------------------ configuration */
+    uint32 blocks;
+    bool highCapacity;      // SDHC block addressing, else SDSC byte addresses
+    bool highSpeedCapable;  // accepts the CMD6 switch to High Speed
+    uint32 powerUpUs;       // ACMD41 reports busy this long after power up
+    uint32 programUs;       // busy time after each write
+    uint32 dmaLagWords;     // words DMA still owes when a read's DATAEND rises
+    uint32 crcErrorBlock;   // next read or write of this block fails, or ~0
+    /*----------------------------------------------------------- observed */
+    uint32 log[SIM_CARD_LOG];     // command index | SIM_CARD_ACMD
+    uint32 logArg[SIM_CARD_LOG];
+    uint32 logCount;
+    uint32 illegal;         // commands sent in the wrong state
+    uint32 lastEraseCount;  // argument of the last ACMD23
+    uint32 blocksRead;
+    uint32 blocksWritten;
+    uint32 drained;         // reads whose DMA finished after DATAEND
+    /*--------------------------------------------------------- card state */
+    SimCardState state;
+    uint16 rca;
+    uint16 nextRca;
+    bool appCmd;            // last command was CMD55
+    bool ready;             // ACMD41 power up complete
+    bool highSpeed;
+    uint32 busWidth;        // 1 or 4
+    uint64 powerUpStart;
+    uint64 programDone;     // end of the current busy time
+    uint32 errors;          // R1 error bits for the next response
+    uint32 payload;         // what the next data phase carries
+    uint32 switchArg;       // argument of the last CMD6
+    uint32 dataBlock;       // next block of the running data command
+    bool multi;             // CMD18 or CMD25
+    bool pastEnd;           // CMD18 reached the last block
+    uint32 lag;             // words DMA still owes
+    uint64 lagPos;          // image offset of those words
+
+    SimCard(uint32 blocks);
+    ~SimCard(void);
+    void insert(void);
+    void eject(void);
+    virtual uint32 read(uint32, uint32*, uint32);
+    virtual uint32 write(uint32, const uint32*, uint32);
+    uint32 count(uint32 cmd);
+    void clearLog(void);
+    /*--------------------------------- used by the simulated peripherals */
+    FILE *file;
+    int fd;
+    void reset(void);
+    void update(void);
+    uint32 r1(bool);
+    bool address(uint32, uint32*);
+    bool command(uint32, uint32, SimResponse*);
+    uint32 fill(uint8*);
+};
+
+/*
+ * Simulated clock and interrupt control
+ */
+
+/* Starts the tick, done by SimCard::insert() */
+void sim_start(void);
+/* Simulated microseconds since start */
+uint64 sim_micros(void);
+/* Lets simulated time pass, running events and interrupts */
+void sim_run(uint32 us);
+/* Holds off interrupts and ticks, like noInterrupts(); nests */
+void sim_hold(void);
+void sim_release(void);
+
+#endif
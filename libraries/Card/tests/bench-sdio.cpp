@@ -0,0 +1,93 @@
+/*
+ * HardwareSDIO throughput on SimCard.
+ *
+ * Reads and writes runs of 1 to 1022 blocks and reports, for each run
+ * length, blocks per second in simulated time (what the bus and card
+ * model allow) and in host time (what the driver and simulator cost),
+ * and the commands one transfer issues, with the CMD13 busy polls
+ * counted apart. Not part of "make check"; run it with
+ *
+ *     make -C libraries/Card/tests bench
+ *
+ * This file is released into the public domain.
+ */
+
+#include <Card/SecureDigital/HardwareSDIO.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "SimCard.h"
+
+#define CARD_BLOCKS 65536
+/* Blocks moved for each run length */
+#define BENCH_BLOCKS 4088
+#define MAX_RUN      1022
+
+static HardwareSDIO sd;
+static uint32 buf[MAX_RUN * BLOCK_DEVICE_WORDS];
+
+static const uint32 runs[] = {1, 8, 64, 511, 1022};
+
+static uint64 hostMicros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Moves BENCH_BLOCKS in transfers of run blocks, returns false on error */
+static bool bench(SimCard *card, bool write, uint32 run) {
+    uint32 transfers = BENCH_BLOCKS / run;
+    uint32 failed = 0;
+    uint32 cmds = 0;
+    uint32 polls = 0;
+    uint64 simStart = sim_micros();
+    uint64 hostStart = hostMicros();
+    for (uint32 i=0; i<transfers; i++) {
+        card->clearLog(); // counted per transfer, the log is a ring
+        uint32 block = (i * run) % (CARD_BLOCKS - MAX_RUN);
+        uint32 status = write ? sd.write(block, buf, run)
+                              : sd.read(block, buf, run);
+        if (status) {
+            failed = status;
+            break;
+        }
+        polls += card->count(13);
+        cmds += card->logCount;
+    }
+    uint64 simUs = sim_micros() - simStart + 1;
+    uint64 hostUs = hostMicros() - hostStart + 1;
+    if (failed) {
+        printf("%-5s %5u  failed: 0x%08X\n", write ? "write" : "read",
+               (unsigned)run, (unsigned)failed);
+        return false;
+    }
+    uint64 blocks = (uint64)transfers * run;
+    printf("%-5s %5u %10.0f %10.0f %10.2f %10.2f\n",
+           write ? "write" : "read", (unsigned)run,
+           blocks * 1e6 / simUs, blocks * 1e6 / hostUs,
+           (double)(cmds - polls) / transfers,
+           (double)polls / transfers);
+    return true;
+}
+
+int main(void) {
+    SimCard card(CARD_BLOCKS);
+    card.insert();
+    sd.begin();
+    if (card.state != SIM_CARD_TRAN) {
+        printf("bench-sdio: the card did not come up\n");
+        return 1;
+    }
+    for (uint32 i=0; i<MAX_RUN * BLOCK_DEVICE_WORDS; i++) {
+        buf[i] = i * 2654435761U;
+    }
+    printf("%-5s %5s %10s %10s %10s %10s\n", "", "run",
+           "blk/s sim", "blk/s host", "cmds/xfer", "CMD13/xfer");
+    bool ok = true;
+    for (uint32 i=0; i<sizeof(runs) / sizeof(runs[0]); i++) {
+        ok = bench(&card, true, runs[i]) && ok;
+        ok = bench(&card, false, runs[i]) && ok;
+    }
+    sd.end();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * Host replacement for <libmaple/bitband.h>, used by the SDIO simulator.
+ *
+ * There is no bit-band alias region on the host, so the get and set
+ * accessors read-modify-write the bit in place. Registers are plain
+ * memory in the simulator, which makes that equivalent. bb_perip() and
+ * bb_sramp() only exist so that headers using them compile; the alias
+ * addresses they return must not be dereferenced on the host.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _LIBMAPLE_BITBAND_H_
+#define _LIBMAPLE_BITBAND_H_
+
+#include <libmaple/libmaple_types.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BB_SRAM_REF      0x20000000
+#define BB_SRAM_BASE     0x22000000
+#define BB_PERI_REF      0x40000000
+#define BB_PERI_BASE     0x42000000
+
+static inline volatile uint32* bb_sramp(volatile void *address, uint32 bit) {
+    return (volatile uint32*)(BB_SRAM_BASE +
+                              ((uintptr_t)address - BB_SRAM_REF) * 32 +
+                              bit * 4);
+}
+
+static inline volatile uint32* bb_perip(volatile void *address, uint32 bit) {
+    return (volatile uint32*)(BB_PERI_BASE +
+                              ((uintptr_t)address - BB_PERI_REF) * 32 +
+                              bit * 4);
+}
+
+static inline uint8 bb_sram_get_bit(volatile void *address, uint32 bit) {
+    return (*(volatile uint32*)address >> bit) & 1;
+}
+
+static inline void bb_sram_set_bit(volatile void *address,
+                                   uint32 bit,
+                                   uint8 val) {
+    volatile uint32 *word = (volatile uint32*)address;
+    *word = val ? (*word | (1U << bit)) : (*word & ~(1U << bit));
+}
+
+static inline uint8 bb_peri_get_bit(volatile void *address, uint32 bit) {
+    return bb_sram_get_bit(address, bit);
+}
+
+static inline void bb_peri_set_bit(volatile void *address,
+                                   uint32 bit,
+                                   uint8 val) {
+    bb_sram_set_bit(address, bit, val);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
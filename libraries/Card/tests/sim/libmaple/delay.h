@@ -0,0 +1,29 @@
+/*
+ * Host replacement for <libmaple/delay.h>, used by the SDIO simulator.
+ *
+ * delay_us() spins in ARM assembly on the Maple. Here it advances the
+ * simulated clock instead, running any card events that fall due.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _LIBMAPLE_DELAY_H_
+#define _LIBMAPLE_DELAY_H_
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sim_delay_us(uint32 us);
+
+static inline void delay_us(uint32 us) {
+    sim_delay_us(us);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
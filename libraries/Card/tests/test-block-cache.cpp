@@ -0,0 +1,201 @@
+/*
+ * BlockCache host test.
+ *
+ * Runs the write-back block cache against a RAM backed block device:
+ * write coalescing, LRU replacement, dirty evictions, mixed cached and
+ * uncached multi-block transfers, error propagation and the hit rate
+ * counter, then a random workload checked against a plain copy of the
+ * disk.
+ *
+ * This file is released into the public domain.
+ */
+
+#include <Card/SecureDigital/BlockCache.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "RamDisk.h"
+
+#define DISK_BLOCKS 64
+#define CACHE_LINES 4
+
+static RamDisk<DISK_BLOCKS> disk;
+static uint32 cacheLines[BLOCK_CACHE_MAX_LINES * BLOCK_DEVICE_WORDS];
+static uint32 block[4 * BLOCK_DEVICE_WORDS];
+
+static void fill(uint32 *buf, uint32 value, uint32 count = 1) {
+    for (uint32 i = 0; i < count * BLOCK_DEVICE_WORDS; i++) {
+        buf[i] = value + i / BLOCK_DEVICE_WORDS;
+    }
+}
+
+static void format(void) {
+    for (uint32 i = 0; i < DISK_BLOCKS; i++) {
+        fill(disk.data[i], i);
+    }
+    disk.reset();
+}
+
+static void testCoalescing(void) {
+    format();
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+
+    // Out of order single block writes stay in the cache...
+    for (uint32 b = 7; b >= 4; b--) {
+        fill(block, 100 + b);
+        cache.write(b, block, 1);
+    }
+    check(disk.writes == 0 && disk.reads == 0,
+          "single block writes are held back");
+
+    // ...and go out as one multi-block write
+    check(cache.flush() == 0, "flush succeeds");
+    check(disk.writes == 1 && disk.blocksWritten == 4,
+          "contiguous dirty blocks coalesce");
+    check(disk.data[4][0] == 104 && disk.data[7][127] == 107,
+          "flushed data reaches the device");
+    check(cache.flush() == 0 && disk.writes == 1,
+          "clean lines are not written again");
+
+    // Two separate runs make two writes
+    fill(block, 200);
+    cache.write(20, block, 1);
+    cache.write(21, block, 1);
+    cache.write(30, block, 1);
+    disk.reset();
+    cache.flush();
+    check(disk.writes == 2 && disk.blocksWritten == 3,
+          "one write per contiguous run");
+}
+
+static void testReplacement(void) {
+    format();
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+
+    for (uint32 b = 0; b < CACHE_LINES; b++) {
+        cache.read(b, block, 1);
+    }
+    cache.read(0, block, 1); // block 1 is now least recently used
+    disk.reset();
+    cache.read(10, block, 1);
+    check(disk.reads == 1, "miss reads the device");
+    cache.read(0, block, 1);
+    cache.read(2, block, 1);
+    cache.read(3, block, 1);
+    check(disk.reads == 1, "recently used blocks stay cached");
+    cache.read(1, block, 1);
+    check(disk.reads == 2 && block[0] == 1,
+          "least recently used block was evicted");
+
+    // Evicting a dirty line writes it (and its dirty neighbours) first
+    format();
+    cache.invalidate();
+    fill(block, 300);
+    cache.write(40, block, 1);
+    cache.write(41, block, 1);
+    for (uint32 b = 0; b < CACHE_LINES - 2; b++) {
+        cache.read(b, block, 1);
+    }
+    disk.reset();
+    cache.read(50, block, 1);
+    check(disk.writes == 1 && disk.blocksWritten == 2 &&
+          disk.data[40][0] == 300 && disk.data[41][0] == 300,
+          "dirty eviction flushes neighbouring dirty blocks together");
+    check(block[0] == 50, "evicting read returns the right block");
+}
+
+static void testMultiBlock(void) {
+    format();
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+
+    // Cached, dirty block 12 in the middle of an uncached run
+    fill(block, 500);
+    cache.write(12, block, 1);
+    disk.reset();
+    cache.read(10, block, 4);
+    check(block[0] == 10 && block[BLOCK_DEVICE_WORDS] == 11 &&
+          block[2 * BLOCK_DEVICE_WORDS] == 500 &&
+          block[3 * BLOCK_DEVICE_WORDS] == 13,
+          "multi-block read merges cached and device blocks");
+    check(disk.reads == 2 && disk.blocksRead == 3,
+          "uncached runs are read straight from the device");
+
+    // A multi-block write goes straight out and refreshes the copy
+    fill(block, 600, 4);
+    disk.reset();
+    cache.write(11, block, 4);
+    check(disk.writes == 1 && disk.blocksWritten == 4,
+          "multi-block write goes straight to the device");
+    cache.read(12, block, 1);
+    check(block[0] == 601, "cached copy is refreshed");
+    disk.reset();
+    cache.flush();
+    check(disk.writes == 0, "refreshed copy is clean");
+}
+
+static void testFetchAndErrors(void) {
+    format();
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+
+    uint32 *data;
+    check(cache.fetch(9, &data, true) == 0 && data[0] == 9,
+          "fetch loads the block");
+    data[0] = 0xCAFE;
+    cache.flush();
+    check(disk.data[9][0] == 0xCAFE, "fetched block is written back");
+
+    check(cache.fetch(DISK_BLOCKS, &data, false) == RAM_DISK_RANGE_ERROR,
+          "device errors are passed through");
+    check(cache.find(DISK_BLOCKS) < 0, "failed loads are not cached");
+    check(cache.read(DISK_BLOCKS - 1, block, 2) == RAM_DISK_RANGE_ERROR,
+          "multi-block read errors are passed through");
+
+    cache.invalidate();
+    cache.hits = 0;
+    cache.misses = 0;
+    cache.read(1, block, 1);
+    cache.read(1, block, 1);
+    cache.read(1, block, 1);
+    cache.read(2, block, 1);
+    check(cache.hitRate() == 50, "hit rate counts hits and misses");
+}
+
+/* Random single and multi-block traffic, checked against a model */
+static void testRandom(void) {
+    static uint32 model[DISK_BLOCKS][BLOCK_DEVICE_WORDS];
+    format();
+    memcpy(model, disk.data, sizeof(model));
+    BlockCache cache(&disk, cacheLines, 8);
+    srand(1);
+
+    bool ok = true;
+    for (uint32 op = 0; op < 20000 && ok; op++) {
+        uint32 count = (rand() % 8 == 0) ? 1 + rand() % 4 : 1;
+        uint32 b = rand() % (DISK_BLOCKS - count + 1);
+        if (rand() % 2) {
+            fill(block, op << 8, count);
+            cache.write(b, block, count);
+            memcpy(model[b], block, count * 512);
+        } else {
+            cache.read(b, block, count);
+            ok = memcmp(block, model[b], count * 512) == 0;
+        }
+        if (op % 1000 == 999) {
+            cache.flush();
+        }
+    }
+    check(ok, "random reads see every write");
+    cache.flush();
+    check(memcmp(disk.data, model, sizeof(model)) == 0,
+          "device matches after the final flush");
+}
+
+int main(void) {
+    testCoalescing();
+    testReplacement();
+    testMultiBlock();
+    testFetchAndErrors();
+    testRandom();
+    return finish("BlockCache test");
+}
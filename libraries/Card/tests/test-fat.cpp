@@ -0,0 +1,425 @@
+/*
+ * FatVolume and FatFile host test.
+ *
+ * Formats FAT16 and FAT32 images in a temporary file and runs the
+ * filesystem against them through a BlockCache: mounting a bare boot
+ * sector and a partitioned card, cluster chains, contiguous allocation,
+ * multi-block transfers, truncation of preallocated space, reserve()
+ * and a full volume. Results are checked by remounting and by reading
+ * the FATs back from the image.
+ *
+ * This file is released into the public domain.
+ */
+
+#include <Card/FAT/FatFile.h>
+#include <string.h>
+
+#include "check.h"
+#include "FatImage.h"
+#include "FileDisk.h"
+
+#define CACHE_LINES 8
+
+static uint32 cacheLines[CACHE_LINES * BLOCK_DEVICE_WORDS];
+static uint32 block[BLOCK_DEVICE_WORDS];
+static uint32 big[256 * BLOCK_DEVICE_WORDS];
+static uint8 bytes[16384];
+
+/* Reads a FAT entry straight from the image */
+static uint32 rawEntry(FileDisk *disk, FatVolume *vol, uint32 copy,
+                       uint32 cluster) {
+    uint32 fat = vol->fatStart + copy * vol->fatSize;
+    if (vol->type == FAT_TYPE_16) {
+        disk->read(fat + (cluster >> 8), block, 1);
+        return ((uint16*)block)[cluster & 0xFF];
+    }
+    disk->read(fat + (cluster >> 7), block, 1);
+    return block[cluster & 0x7F] & 0x0FFFFFFF;
+}
+
+static bool fatsMatch(FileDisk *disk, FatVolume *vol) {
+    for (uint32 i = 0; i < vol->fatSize; i++) {
+        disk->read(vol->fatStart + i, big, 1);
+        disk->read(vol->fatStart + vol->fatSize + i, block, 1);
+        if (memcmp(big, block, 512)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32 freeClusters(FileDisk *disk, FatVolume *vol) {
+    uint32 n = 0;
+    for (uint32 c = 2; c < vol->clusterCount + 2; c++) {
+        n += !rawEntry(disk, vol, 0, c);
+    }
+    return n;
+}
+
+/* Length of a chain, 0 if it is broken */
+static uint32 chainLength(FatVolume *vol, uint32 cluster,
+                          bool *contiguous = NULL) {
+    uint32 n = 0;
+    if (contiguous) {
+        *contiguous = true;
+    }
+    while (!vol->isEnd(cluster)) {
+        uint32 value;
+        if ((cluster < 2) || vol->next(cluster, &value)) {
+            return 0;
+        }
+        if (contiguous && !vol->isEnd(value) && (value != cluster + 1)) {
+            *contiguous = false;
+        }
+        cluster = value;
+        n++;
+    }
+    return n;
+}
+
+static void pattern(uint8 *buf, uint32 len, uint32 seed) {
+    for (uint32 i = 0; i < len; i++) {
+        buf[i] = (uint8)(i * 7 + (i >> 9) + seed);
+    }
+}
+
+static bool matches(const uint8 *buf, uint32 len, uint32 seed) {
+    for (uint32 i = 0; i < len; i++) {
+        if (buf[i] != (uint8)(i * 7 + (i >> 9) + seed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testMount(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+
+    check(vol.mount(&cache) == FAT_ERR_NO_FS, "blank disk does not mount");
+
+    formatFat16(&disk);
+    cache.invalidate(); // still holds the blank block 0
+    check(vol.mount(&cache) == 0 && vol.type == FAT_TYPE_16,
+          "FAT16 boot sector mounts");
+    check(vol.clusterCount == FAT16_CLUSTERS &&
+          vol.dataStart == FAT16_DATA && vol.rootEntries == 512 &&
+          vol.fatCount == 2 && vol.clusterShift == 0,
+          "FAT16 geometry");
+
+    FileDisk small(FAT16_DATA + 4000);
+    BlockCache smallCache(&small, cacheLines, CACHE_LINES);
+    formatFat16(&small, 4000);
+    check(vol.mount(&smallCache) == FAT_ERR_NO_FS, "FAT12 is rejected");
+
+    FileDisk card(FAT32_BLOCKS);
+    BlockCache cardCache(&card, cacheLines, CACHE_LINES);
+    formatFat32(&card);
+    check(vol.mount(&cardCache) == 0 && vol.type == FAT_TYPE_32,
+          "FAT32 partition mounts through the MBR");
+    check(vol.clusterCount == FAT32_CLUSTERS && vol.rootCluster == 2 &&
+          vol.fatStart == FAT32_START + 32 &&
+          vol.dataStart == FAT32_START + FAT32_DATA &&
+          vol.fsinfo == FAT32_START + 1,
+          "FAT32 geometry");
+}
+
+static void testReadWrite(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile file;
+    formatFat16(&disk);
+    vol.mount(&cache);
+
+    check(file.open(&vol, "missing.txt", FAT_READ) == FAT_ERR_NOT_FOUND,
+          "open without FAT_CREATE needs the file");
+    check(file.open(&vol, "bad*name.txt", FAT_WRITE | FAT_CREATE) ==
+          FAT_ERR_ACCESS, "invalid 8.3 names are refused");
+
+    // Small unaligned writes go through the cache
+    pattern(bytes, 5000, 1);
+    check(file.open(&vol, "data.bin", FAT_WRITE | FAT_CREATE) == 0,
+          "create a file");
+    uint32 done = 0;
+    for (uint32 i = 0; i < 5000; i += 7) {
+        done += file.write(bytes + i, (5000 - i < 7) ? 5000 - i : 7);
+    }
+    check(done == 5000 && file.size == 5000, "small writes grow the file");
+    check(file.close() == 0, "close succeeds");
+
+    FatVolume again;
+    BlockCache fresh(&disk, cacheLines, CACHE_LINES);
+    again.mount(&fresh);
+    memset(bytes, 0, sizeof(bytes));
+    check(file.open(&again, "DATA.BIN", FAT_READ) == 0 && file.size == 5000,
+          "file and size survive a remount");
+    done = 0;
+    for (uint32 n; (n = file.read(bytes + done, 13)); done += n) {
+    }
+    check(done == 5000 && matches(bytes, 5000, 1), "read back matches");
+    bool contiguous;
+    check(chainLength(&again, file.firstCluster, &contiguous) == 10 &&
+          contiguous, "one contiguous chain of 10 clusters");
+    check(file.seek(5001) == FAT_ERR_ACCESS && file.seek(600) == 0 &&
+          file.read(bytes, 4) == 4 && bytes[0] == (uint8)(600 * 7 + 1 + 1),
+          "seek inside the file");
+    file.close();
+    check(fatsMatch(&disk, &again), "both FAT copies agree");
+}
+
+static void testChains(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile a, b;
+    formatFat16(&disk);
+    vol.mount(&cache);
+
+    // Interleaved growth gives fragmented chains
+    a.open(&vol, "a.bin", FAT_READ | FAT_WRITE | FAT_CREATE);
+    b.open(&vol, "b.bin", FAT_READ | FAT_WRITE | FAT_CREATE);
+    pattern((uint8*)big, 4 * 512, 2);
+    for (uint32 i = 0; i < 4; i++) {
+        a.write((uint8*)big + i * 512, 512);
+        b.write((uint8*)big + i * 512, 512);
+    }
+    bool contiguous;
+    check(chainLength(&vol, a.firstCluster, &contiguous) == 4 &&
+          !contiguous, "interleaved files are fragmented");
+    uint32 value;
+    vol.next(a.firstCluster, &value);
+    check(value == a.firstCluster + 2, "chains skip the other file");
+
+    // Whole block reads bypass the cache and stop at each fragment
+    memset(big, 0, 4 * 512);
+    a.sync();
+    cache.invalidate();
+    a.seek(0);
+    disk.reset();
+    check(a.read(big, 4 * 512) == 4 * 512 &&
+          matches((uint8*)big, 4 * 512, 2), "fragmented read matches");
+    check(disk.blocksRead >= 4 && disk.reads == disk.blocksRead,
+          "no transfer crosses a fragment");
+
+    // Appending to a reopened file walks to the end of the chain
+    a.close();
+    b.close();
+    a.open(&vol, "a.bin", FAT_READ | FAT_WRITE | FAT_APPEND);
+    a.write("tail", 4);
+    check(a.size == 4 * 512 + 4 &&
+          chainLength(&vol, a.firstCluster) == 5, "append extends the chain");
+    a.close();
+    check(vol.sync() == 0 && fatsMatch(&disk, &vol), "FAT copies agree");
+}
+
+static void testAllocation(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile file;
+    formatFat16(&disk);
+    vol.mount(&cache);
+
+    file.open(&vol, "stream.bin", FAT_READ | FAT_WRITE | FAT_CREATE);
+    check(file.preallocate(40 * 512) == 0, "preallocate succeeds");
+    bool contiguous;
+    check(chainLength(&vol, file.firstCluster, &contiguous) == 40 &&
+          contiguous, "preallocated clusters are one run");
+
+    // Aligned whole blocks stream out as a single multi-block write
+    file.sync();
+    pattern((uint8*)big, 40 * 512, 3);
+    disk.reset();
+    check(file.write(big, 40 * 512) == 40 * 512, "streaming write");
+    check(disk.writes == 1 && disk.blocksWritten == 40,
+          "one multi-block write for the whole run");
+    check(chainLength(&vol, file.firstCluster) == 40,
+          "no clusters added past the preallocation");
+
+    memset(big, 0, 40 * 512);
+    file.seek(0);
+    disk.reset();
+    check(file.read(big, 40 * 512) == 40 * 512 &&
+          matches((uint8*)big, 40 * 512, 3) && disk.reads == 1,
+          "one multi-block read back");
+    file.close();
+}
+
+static void testTruncate(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile file;
+    formatFat16(&disk);
+    vol.mount(&cache);
+
+    file.open(&vol, "log.csv", FAT_WRITE | FAT_CREATE);
+    file.preallocate(20 * 512);
+    pattern(bytes, 3 * 512 + 10, 4);
+    file.write(bytes, 3 * 512 + 10);
+    check(file.close() == 0, "close succeeds");
+    check(chainLength(&vol, file.firstCluster) == 4 &&
+          freeClusters(&disk, &vol) == FAT16_CLUSTERS - 4,
+          "close frees the unused preallocation");
+
+    check(file.open(&vol, "log.csv", FAT_WRITE | FAT_TRUNC) == 0 &&
+          file.size == 0 && file.firstCluster == 0,
+          "FAT_TRUNC empties the file");
+    file.close();
+    check(freeClusters(&disk, &vol) == FAT16_CLUSTERS,
+          "FAT_TRUNC releases the whole chain");
+
+    fat_dirent *ent;
+    vol.dirent(file.index, &ent, false);
+    check(ent->fileSize == 0 && ent->fstClusLO == 0,
+          "directory entry is emptied");
+    check(fatsMatch(&disk, &vol), "FAT copies agree");
+}
+
+static void testReserve(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile file;
+    formatFat16(&disk);
+    vol.mount(&cache);
+
+    // Something in front, so the reservation does not start at cluster 2
+    file.open(&vol, "first.txt", FAT_WRITE | FAT_CREATE);
+    file.write("x", 1);
+    file.close();
+
+    uint32 blk = 0;
+    check(file.open(&vol, "raw.dat", FAT_READ | FAT_WRITE | FAT_CREATE) == 0 &&
+          file.reserve(10000, &blk) == 0, "reserve succeeds");
+    bool contiguous;
+    check(blk == vol.block(file.firstCluster) && file.size == 10000 &&
+          chainLength(&vol, file.firstCluster, &contiguous) == 20 &&
+          contiguous, "reserved file is one run of the full size");
+    check(file.reserve(512, &blk) == FAT_ERR_ACCESS,
+          "reserve needs an empty file");
+
+    // The blocks belong to the caller, written around the filesystem
+    pattern((uint8*)big, 20 * 512, 5);
+    disk.write(blk, big, 20);
+    file.close();
+
+    BlockCache fresh(&disk, cacheLines, CACHE_LINES);
+    FatVolume again;
+    again.mount(&fresh);
+    memset(big, 0, 20 * 512);
+    check(file.open(&again, "raw.dat", FAT_READ) == 0 &&
+          file.size == 10000 && file.read(big, 10000) == 10000 &&
+          matches((uint8*)big, 10000, 5),
+          "directly written blocks read back through the file");
+    file.close();
+}
+
+static void testFull(void) {
+    FileDisk disk(FAT16_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile file;
+    formatFat16(&disk);
+    vol.mount(&cache);
+
+    file.open(&vol, "huge.bin", FAT_WRITE | FAT_CREATE);
+    check(file.preallocate((FAT16_CLUSTERS + 1) * 512) == FAT_ERR_FULL,
+          "preallocate past the free space fails");
+    check(file.preallocate(FAT16_CLUSTERS * 512) == 0,
+          "the whole volume can be preallocated");
+    file.close();
+    check(freeClusters(&disk, &vol) == FAT16_CLUSTERS,
+          "closing the empty file gives it all back");
+
+    // Fill the root directory
+    char name[] = "F000.TXT";
+    uint32 status = 0;
+    uint32 files;
+    for (files = 0; !status; files++) {
+        name[1] = '0' + files / 100;
+        name[2] = '0' + (files / 10) % 10;
+        name[3] = '0' + files % 10;
+        status = file.open(&vol, name, FAT_WRITE | FAT_CREATE);
+        file.close();
+    }
+    check(status == FAT_ERR_FULL && files == 512, // and HUGE.BIN
+          "FAT16 root directory holds 512 entries");
+}
+
+static void testFat32(void) {
+    FileDisk disk(FAT32_BLOCKS);
+    BlockCache cache(&disk, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    FatFile file;
+    formatFat32(&disk);
+    vol.mount(&cache);
+
+    // A one block root cluster holds 16 entries, then the root grows
+    char name[] = "F00.TXT";
+    uint32 created = 0;
+    for (uint32 i = 0; i < 40; i++) {
+        name[1] = '0' + i / 10;
+        name[2] = '0' + i % 10;
+        created += !file.open(&vol, name, FAT_WRITE | FAT_CREATE);
+        file.close();
+    }
+    check(created == 40 && chainLength(&vol, vol.rootCluster) == 3,
+          "root directory grows by clusters");
+    uint32 index;
+    uint8 last[11];
+    memcpy(last, "F39     TXT", 11);
+    check(vol.find(last, &index) == 0 && index == 39,
+          "entries in the grown root are found");
+
+    disk.read(FAT32_START + 1, block, 1);
+    check(block[488 / 4] == 0xFFFFFFFF,
+          "FSInfo free count is invalidated on the first change");
+
+    // Clusters above 65535 need the high half of the first cluster
+    vol.nextFree = 66000;
+    pattern((uint8*)big, 200 * 512, 6);
+    file.open(&vol, "high.bin", FAT_WRITE | FAT_CREATE);
+    check(file.write(big, 200 * 512) == 200 * 512 &&
+          file.firstCluster == 66000, "file placed above 65535");
+    file.close();
+
+    BlockCache fresh(&disk, cacheLines, CACHE_LINES);
+    FatVolume again;
+    again.mount(&fresh);
+    memset(big, 0, 200 * 512);
+    bool contiguous;
+    check(file.open(&again, "high.bin", FAT_READ) == 0 &&
+          file.firstCluster == 66000 &&
+          chainLength(&again, file.firstCluster, &contiguous) == 200 &&
+          contiguous, "FAT32 chain spans several FAT blocks");
+    check(file.read(big, 200 * 512) == 200 * 512 &&
+          matches((uint8*)big, 200 * 512, 6), "FAT32 data reads back");
+    file.close();
+
+    // The top four bits of FAT32 entries are reserved and kept
+    disk.read(again.fatStart + (66000 >> 7), block, 1);
+    block[66000 & 0x7F] |= 0xF0000000;
+    disk.write(again.fatStart + (66000 >> 7), block, 1);
+    fresh.invalidate();
+    file.open(&again, "high.bin", FAT_WRITE | FAT_TRUNC);
+    file.close();
+    disk.read(again.fatStart + (66000 >> 7), block, 1);
+    check(block[66000 & 0x7F] == 0xF0000000 &&
+          rawEntry(&disk, &again, 1, 66001) == 0,
+          "freeing keeps the reserved bits");
+}
+
+int main(void) {
+    testMount();
+    testReadWrite();
+    testChains();
+    testAllocation();
+    testTruncate();
+    testReserve();
+    testFull();
+    testFat32();
+    return finish("test-fat");
+}
@@ -0,0 +1,323 @@
+/*
+ * HardwareSDIO and DataLogger host test.
+ *
+ * Runs the driver unchanged against SimCard, an emulated SDIO peripheral
+ * and SD card over an image file: card identification and bus setup,
+ * single and multi-block transfers with ACMD23, runs split at the DMA
+ * limit, the CMD13 busy poll and its timeout, asynchronous transfers,
+ * DMA draining after DATAEND, data CRC and address errors, SDSC byte
+ * addressing, end() and a second begin(). The block cache, FAT and
+ * DataLogger then run on top of the driver.
+ *
+ * This file is released into the public domain.
+ */
+
+#include <Card/SecureDigital/HardwareSDIO.h>
+#include <Card/SecureDigital/DataLogger.h>
+#include <Card/FAT/FatFile.h>
+#include <string.h>
+
+#include "check.h"
+#include "FatImage.h"
+#include "SimCard.h"
+
+#define CARD_BLOCKS 65536
+#define CACHE_LINES 8
+
+static HardwareSDIO sd;
+static uint32 cacheLines[CACHE_LINES * BLOCK_DEVICE_WORDS];
+/* More than two runs of SDIO_MAX_DMA_BLOCKS */
+#define LONG_RUN    1030
+
+static uint32 buf[LONG_RUN * BLOCK_DEVICE_WORDS];
+static uint32 img[LONG_RUN * BLOCK_DEVICE_WORDS];
+
+static volatile uint32 doneCalls;
+static volatile uint32 doneStatus;
+
+static void done(uint32 status) {
+    doneCalls++;
+    doneStatus = status;
+}
+
+static void pattern(uint32 *words, uint32 count, uint32 seed) {
+    for (uint32 i=0; i<count; i++) {
+        words[i] = (seed << 20) ^ (i * 2654435761U);
+    }
+}
+
+static bool matches(const uint32 *words, uint32 count, uint32 seed) {
+    for (uint32 i=0; i<count; i++) {
+        if (words[i] != ((seed << 20) ^ (i * 2654435761U))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Commands logged since clearLog(), in order */
+static bool logged(SimCard *card, const uint32 *cmds, uint32 count) {
+    if (card->logCount != count) {
+        return false;
+    }
+    for (uint32 i=0; i<count; i++) {
+        if (card->log[i] != cmds[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testBegin(void) {
+    SimCard card(CARD_BLOCKS);
+    card.insert();
+    sd.begin();
+    check(sd.CSD.capacity == SD_CAP_SDHC && sd.RCA.RCA == card.rca &&
+          sd.CID.MID == 0x03 && !strcmp(sd.CID.PNM, "SIMSD"),
+          "identifies an SDHC card");
+    check(sd.CSD.C_SIZE == CARD_BLOCKS / 1024 - 1,
+          "reads the CSD capacity");
+    check(sd.SCR.SD_SPEC == 2 && sd.busWidth == SDIO_BUS_4BIT &&
+          card.busWidth == 4, "switches the bus to 4 bits");
+    check(card.highSpeed && sd.clkFreq == SDIO_36_MHZ &&
+          (SDIO->regs->CLKCR & SDIO_CLKCR_CLKEN),
+          "runs High Speed at 36 MHz with the clock on");
+    check(card.state == SIM_CARD_TRAN && card.illegal == 0,
+          "leaves the card selected without illegal commands");
+    sd.end();
+
+    SimCard slow(CARD_BLOCKS);
+    slow.highSpeedCapable = false;
+    slow.insert();
+    sd.begin();
+    check(!slow.highSpeed && sd.clkFreq == SDIO_24_MHZ,
+          "Default Speed card runs at 24 MHz");
+    pattern(buf, BLOCK_DEVICE_WORDS, 1);
+    check(sd.write(3, buf, 1) == 0 && sd.read(3, img, 1) == 0 &&
+          matches(img, BLOCK_DEVICE_WORDS, 1),
+          "Default Speed card transfers data");
+    sd.end();
+    check(!sd.busy() && !(SDIO->regs->MASK), "end() leaves the bus quiet");
+}
+
+static void testTransfers(SimCard *card) {
+    pattern(buf, BLOCK_DEVICE_WORDS, 2);
+    card->clearLog();
+    check(sd.write(5, buf, 1) == 0, "single block write");
+    uint32 single[] = {24};
+    check(logged(card, single, 1), "single block write is one CMD24");
+    card->read(5, img, 1);
+    check(matches(img, BLOCK_DEVICE_WORDS, 2), "block reaches the card");
+
+    card->clearLog();
+    memset(img, 0, 512);
+    check(sd.read(5, img, 1) == 0 && matches(img, BLOCK_DEVICE_WORDS, 2),
+          "single block read");
+    check(card->log[0] == 13 && card->log[card->logCount - 1] == 17,
+          "read waits for programming with CMD13");
+
+    pattern(buf, 10 * BLOCK_DEVICE_WORDS, 3);
+    card->clearLog();
+    check(sd.write(100, buf, 10) == 0, "multi-block write");
+    check(card->count(SIM_CARD_ACMD | 23) == 1 &&
+          card->lastEraseCount == 10 && card->count(25) == 1 &&
+          card->count(12) == 1, "ACMD23, CMD25 and CMD12");
+    card->read(100, img, 10);
+    check(matches(img, 10 * BLOCK_DEVICE_WORDS, 3), "blocks reach the card");
+
+    card->clearLog();
+    memset(img, 0, 10 * 512);
+    check(sd.read(100, img, 10) == 0 &&
+          matches(img, 10 * BLOCK_DEVICE_WORDS, 3), "multi-block read");
+    check(card->count(18) == 1 && card->count(12) == 1 &&
+          card->blocksRead == 10, "CMD18 and CMD12");
+
+    pattern(buf, LONG_RUN * BLOCK_DEVICE_WORDS, 4);
+    card->clearLog();
+    check(sd.write(1000, buf, LONG_RUN) == 0, "long write");
+    check(card->count(25) == 3 &&
+          card->lastEraseCount == LONG_RUN - 2 * SDIO_MAX_DMA_BLOCKS,
+          "runs split at the DMA limit");
+    card->read(1000, img, LONG_RUN);
+    check(matches(img, LONG_RUN * BLOCK_DEVICE_WORDS, 4), "every run lands");
+    memset(img, 0, LONG_RUN * 512);
+    check(sd.read(1000, img, LONG_RUN) == 0 && card->count(18) == 3 &&
+          matches(img, LONG_RUN * BLOCK_DEVICE_WORDS, 4), "long read");
+    check(card->illegal == 0, "no illegal commands");
+}
+
+static void testBusy(SimCard *card) {
+    card->programUs = 3000;
+    pattern(buf, BLOCK_DEVICE_WORDS, 5);
+    check(sd.write(7, buf, 1) == 0, "write with a slow card");
+    card->clearLog();
+    uint64 start = sim_micros();
+    check(sd.read(7, img, 1) == 0 && matches(img, BLOCK_DEVICE_WORDS, 5),
+          "read after programming");
+    uint32 polls = card->count(13);
+    // A poll takes 136 clocks of SDIO_BUSY_POLL_CLK, about 270 us
+    check((polls >= 3) && (polls <= 3000 / 270 + 2) &&
+          (sim_micros() - start >= 2500), "CMD13 polls are paced");
+    check((SDIO->regs->CLKCR & SDIO_CLKCR_CLKDIV) == sd.clkFreq,
+          "bus clock is restored after the poll");
+
+    card->programUs = 400000;
+    check(sd.write(7, buf, 1) == 0, "write with a stalled card");
+    check(sd.read(7, img, 1) == SDIO_STA_DTIMEOUT,
+          "stall times out after SDIO_WRITE_TIMEOUT_MS");
+    check((SDIO->regs->CLKCR & SDIO_CLKCR_CLKDIV) == sd.clkFreq,
+          "and restores the bus clock");
+    card->programUs = 500;
+    sim_run(200000);
+    check(sd.read(7, img, 1) == 0, "card recovers after the stall");
+    check(card->illegal == 0, "no data commands while programming");
+}
+
+static void testAsync(SimCard *card) {
+    pattern(buf, 4 * BLOCK_DEVICE_WORDS, 6);
+    doneCalls = 0;
+    sim_hold();
+    check(sd.writeAsync(200, buf, 4, done) == 0 && sd.busy(),
+          "writeAsync() returns at once");
+    check(sd.readAsync(200, img, 4, done) == SDIO_BUSY_ERROR &&
+          sd.write(200, buf, 1) == SDIO_BUSY_ERROR,
+          "transfers are refused while one is pending");
+    sim_release();
+    check(sd.wait() == 0 && doneCalls == 1 && doneStatus == 0,
+          "callback runs once on completion");
+
+    memset(img, 0, 4 * 512);
+    sim_hold();
+    check(sd.readAsync(200, img, 4, done) == 0, "readAsync() starts");
+    sim_run(100000); // interrupts held off, nothing moves on
+    check(sd.busy() && doneCalls == 1, "transfer waits for its interrupt");
+    sim_release();
+    check(sd.wait() == 0 && doneCalls == 2 &&
+          matches(img, 4 * BLOCK_DEVICE_WORDS, 6), "readAsync() completes");
+
+    card->dmaLagWords = 16;
+    card->drained = 0;
+    memset(img, 0, 4 * 512);
+    check(sd.read(200, img, 1) == 0 && sd.read(201, img + 128, 3) == 0 &&
+          matches(img, 4 * BLOCK_DEVICE_WORDS, 6),
+          "reads wait for DMA to drain the FIFO");
+    check(card->drained == 2, "both reads drained after DATAEND");
+    card->dmaLagWords = 0;
+}
+
+static void testErrors(SimCard *card) {
+    card->crcErrorBlock = 9;
+    check(sd.read(9, img, 1) == SDIO_STA_DCRCFAIL, "read CRC error");
+    check(sd.read(9, img, 1) == 0, "read works again");
+
+    pattern(buf, 8 * BLOCK_DEVICE_WORDS, 7);
+    card->crcErrorBlock = 304;
+    check(sd.write(300, buf, 8) == SDIO_STA_DCRCFAIL,
+          "write CRC error in the middle of a run");
+    card->read(300, img, 8);
+    check(matches(img, 4 * BLOCK_DEVICE_WORDS, 7),
+          "blocks before the error are written");
+    check(sd.write(300, buf, 8) == 0 && sd.read(300, img, 8) == 0 &&
+          matches(img, 8 * BLOCK_DEVICE_WORDS, 7), "write works again");
+
+    check(sd.read(CARD_BLOCKS, img, 1) == SDIO_CARD_ERROR &&
+          (sd.CSR.OUT_OF_RANGE == 1), "read past the end is refused");
+    check(sd.write(CARD_BLOCKS + 5, buf, 2) == SDIO_CARD_ERROR,
+          "write past the end is refused");
+    check(sd.read(CARD_BLOCKS - 2, img, 2) == 0,
+          "CMD18 may end on the last block");
+    check(sd.read(CARD_BLOCKS - 1, img, 2) != 0,
+          "CMD18 across the end fails");
+    check(sd.read(0, img, 1) == 0 && card->illegal == 0,
+          "card is usable after the errors");
+}
+
+static void testSdsc(void) {
+    SimCard card(16384);
+    card.highCapacity = false;
+    card.insert();
+    sd.begin();
+    check(sd.CSD.capacity == SD_CAP_SDSC, "identifies an SDSC card");
+    pattern(buf, 3 * BLOCK_DEVICE_WORDS, 8);
+    card.clearLog();
+    check(sd.write(100, buf, 3) == 0 && card.logArg[2] == 100 * 512,
+          "SDSC commands take byte addresses");
+    card.read(100, img, 3);
+    check(matches(img, 3 * BLOCK_DEVICE_WORDS, 8), "SDSC blocks land");
+    sd.end();
+}
+
+static void testFat(SimCard *card) {
+    formatFat16(card);
+    BlockCache cache(&sd, cacheLines, CACHE_LINES);
+    FatVolume vol;
+    check(vol.mount(&cache) == 0 && vol.type == FAT_TYPE_16,
+          "FAT16 mounts over SDIO");
+    FatFile file;
+    pattern(buf, 40 * BLOCK_DEVICE_WORDS, 9);
+    check(file.open(&vol, "sdio.bin", FAT_WRITE | FAT_CREATE) == 0 &&
+          file.write(buf, 40 * 512) == 40 * 512 && file.close() == 0,
+          "file written over SDIO");
+
+    cache.invalidate();
+    FatVolume again;
+    memset(img, 0, 40 * 512);
+    check(again.mount(&cache) == 0 &&
+          file.open(&again, "SDIO.BIN", FAT_READ) == 0 &&
+          file.size == 40 * 512 && file.read(img, 40 * 512) == 40 * 512 &&
+          matches(img, 40 * BLOCK_DEVICE_WORDS, 9),
+          "file reads back after a remount");
+    file.close();
+}
+
+static void testLogger(SimCard *card) {
+    static uint32 buffers[3 * 2 * BLOCK_DEVICE_WORDS];
+    DataLogger logger(&sd, buffers, 3, 2);
+    card->programUs = 2000;
+    logger.begin(5000, 64, 42);
+    uint8 record[40];
+    uint32 accepted = 0;
+    for (uint32 i=0; i<400; i++) {
+        memset(record, (uint8)i, sizeof(record));
+        if (logger.log(record, sizeof(record))) {
+            accepted++;
+        }
+        logger.update();
+        sim_run(100);
+    }
+    check(logger.end() == 0 && logger.stats.errors == 0, "logger ends clean");
+    check(accepted == logger.stats.records && accepted > 0,
+          "records are counted");
+
+    uint32 records = 0;
+    bool headers = true;
+    for (uint32 i=0; i<logger.stats.blocks; i++) {
+        card->read(5000 + i, img, 1);
+        data_logger_header *hdr = (data_logger_header*)img;
+        if ((hdr->magic != DATA_LOGGER_MAGIC) || (hdr->session != 42) ||
+            (hdr->sequence != i)) {
+            headers = false;
+        }
+        records += hdr->records;
+    }
+    check(headers, "every block carries its header");
+    check(records == accepted && logger.stats.blocks % 2 == 0,
+          "every accepted record is on the card");
+    card->programUs = 500;
+}
+
+int main(void) {
+    testBegin();
+    SimCard card(CARD_BLOCKS);
+    card.insert();
+    sd.begin();
+    testTransfers(&card);
+    testBusy(&card);
+    testAsync(&card);
+    testErrors(&card);
+    testFat(&card);
+    testLogger(&card);
+    sd.end();
+    testSdsc();
+    return finish("test-sdio");
+}
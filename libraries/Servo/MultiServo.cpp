@@ -0,0 +1,235 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2010, LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+#include "MultiServo.h"
+
+#include <wirish/boards.h>
+#include <wirish/ext_interrupts.h>
+#include <wirish/io.h>
+#include <wirish/wirish_math.h>
+#include <wirish/HardwareTimer.h>
+
+#define FRAME_US        20000
+#define STAGGER_US      (MULTISERVO_SLOT_US / 4)
+#define MIN_GAP_US      20      // between a pulse's edges and the slot's ends
+
+#define ANGLE_TO_US(a)    ((uint16)(map((a), this->minAngle, this->maxAngle, \
+                                        this->minPW, this->maxPW)))
+#define US_TO_ANGLE(us)   ((int16)(map((us), this->minPW, this->maxPW,  \
+                                       this->minAngle, this->maxAngle)))
+
+/*
+ * Everything the compare interrupts need is precomputed here, so
+ * writeMicroseconds() is a single store to 'fall'.
+ */
+
+typedef struct servo_slot {
+    __io uint32 *bsrr;          // Pin's GPIO BSRR, or idle_bsrr if free
+    uint32 set;                 // BSRR value setting the pin
+    volatile uint16 fall;       // Compare value ending the pulse
+} servo_slot;
+
+static uint32 idle_bsrr;
+static servo_slot slots[4][MULTISERVO_PER_CHANNEL];
+static uint16 starts[4][MULTISERVO_PER_CHANNEL];
+static uint8 current[4];
+static bool pulsing[4];
+static uint8 timer_num = MULTISERVO_DEFAULT_TIMER;
+static timer_dev *timer = NULL;
+
+static inline void channel_irq(uint8 ch) {
+    uint8 k = current[ch];
+    servo_slot *s = &slots[ch][k];
+    if (!pulsing[ch]) {
+        *s->bsrr = s->set;
+        timer_set_compare(timer, ch + 1, s->fall);
+        pulsing[ch] = true;
+    } else {
+        *s->bsrr = s->set << 16;
+        k = (k + 1) % MULTISERVO_PER_CHANNEL;
+        current[ch] = k;
+        timer_set_compare(timer, ch + 1, starts[ch][k]);
+        pulsing[ch] = false;
+    }
+}
+
+static void ch1_irq(void) { channel_irq(0); }
+static void ch2_irq(void) { channel_irq(1); }
+static void ch3_irq(void) { channel_irq(2); }
+static void ch4_irq(void) { channel_irq(3); }
+
+static const voidFuncPtr channel_irqs[4] = {
+    ch1_irq, ch2_irq, ch3_irq, ch4_irq,
+};
+
+static void start_timer(void) {
+    timer = HardwareTimer(timer_num).c_dev();
+    ASSERT(timer->type != TIMER_BASIC);
+    timer_pause(timer);
+    timer_set_prescaler(timer, CYCLES_PER_MICROSECOND - 1);
+    timer_set_reload(timer, FRAME_US - 1);
+    for (uint8 ch = 0; ch < 4; ch++) {
+        for (uint8 k = 0; k < MULTISERVO_PER_CHANNEL; k++) {
+            starts[ch][k] = ((k * MULTISERVO_SLOT_US + ch * STAGGER_US) %
+                             FRAME_US);
+            slots[ch][k].bsrr = &idle_bsrr;
+            slots[ch][k].set = 0;
+            slots[ch][k].fall = (starts[ch][k] + MIN_GAP_US) % FRAME_US;
+        }
+        current[ch] = 0;
+        pulsing[ch] = false;
+        timer_oc_set_mode(timer, ch + 1, TIMER_OC_MODE_FROZEN, 0);
+        timer_set_compare(timer, ch + 1, starts[ch][0]);
+    }
+    timer_generate_update(timer);
+    (timer->regs).gen->SR = 0;
+    for (uint8 ch = 0; ch < 4; ch++) {
+        timer_attach_interrupt(timer,
+                               (timer_interrupt_id)(TIMER_CC1_INTERRUPT + ch),
+                               channel_irqs[ch]);
+    }
+    timer_resume(timer);
+}
+
+/*
+ * MultiServo routines
+ */
+
+MultiServo::MultiServo() {
+    this->resetFields();
+}
+
+void MultiServo::setTimer(uint8 timerNum) {
+    if (timer == NULL) {
+        timer_num = timerNum;
+    }
+}
+
+bool MultiServo::attach(uint8 pin,
+                        uint16 minPW,
+                        uint16 maxPW,
+                        int16 minAngle,
+                        int16 maxAngle) {
+    if (pin >= BOARD_NR_GPIO_PINS) {
+        return false;
+    }
+    if (this->attached()) {
+        this->detach();
+    }
+    if (timer == NULL) {
+        start_timer();
+    }
+
+    // Spread servos across the channels first.
+    int8 slot = -1;
+    noInterrupts();
+    for (uint8 i = 0; i < MULTISERVO_MAX; i++) {
+        servo_slot *s = &slots[i % 4][i / 4];
+        if (s->bsrr == &idle_bsrr) {
+            s->set = BIT(PIN_MAP[pin].gpio_bit);
+            s->bsrr = &PIN_MAP[pin].gpio_device->regs->BSRR;
+            slot = i;
+            break;
+        }
+    }
+    interrupts();
+    if (slot < 0) {
+        return false;
+    }
+
+    this->pin = pin;
+    this->slot = slot;
+    this->minPW = minPW;
+    this->maxPW = maxPW;
+    this->minAngle = minAngle;
+    this->maxAngle = maxAngle;
+
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+    this->writeMicroseconds((minPW + maxPW) / 2);
+    return true;
+}
+
+bool MultiServo::detach() {
+    if (!this->attached()) {
+        return false;
+    }
+
+    servo_slot *s = &slots[this->slot % 4][this->slot / 4];
+    noInterrupts();
+    *s->bsrr = s->set << 16;
+    s->bsrr = &idle_bsrr;
+    s->set = 0;
+    interrupts();
+
+    this->resetFields();
+
+    return true;
+}
+
+void MultiServo::write(int degrees) {
+    degrees = constrain(degrees, this->minAngle, this->maxAngle);
+    this->writeMicroseconds(ANGLE_TO_US(degrees));
+}
+
+int MultiServo::read() const {
+    int a = US_TO_ANGLE(this->readMicroseconds());
+    // As in Servo::read().
+    return a == this->minAngle || a == this->maxAngle ? a : a + 1;
+}
+
+void MultiServo::writeMicroseconds(uint16 pulseWidth) {
+    if (!this->attached()) {
+        ASSERT(0);
+        return;
+    }
+
+    pulseWidth = constrain(pulseWidth, this->minPW, this->maxPW);
+    pulseWidth = constrain(pulseWidth, MIN_GAP_US,
+                           MULTISERVO_SLOT_US - MIN_GAP_US);
+    this->pulseWidth = pulseWidth;
+    uint8 ch = this->slot % 4, k = this->slot / 4;
+    slots[ch][k].fall = (starts[ch][k] + pulseWidth) % FRAME_US;
+}
+
+uint16 MultiServo::readMicroseconds() const {
+    if (!this->attached()) {
+        ASSERT(0);
+        return 0;
+    }
+
+    return this->pulseWidth;
+}
+
+void MultiServo::resetFields(void) {
+    this->pin = NOT_ATTACHED;
+    this->slot = -1;
+    this->minAngle = SERVO_DEFAULT_MIN_ANGLE;
+    this->maxAngle = SERVO_DEFAULT_MAX_ANGLE;
+    this->minPW = SERVO_DEFAULT_MIN_PW;
+    this->maxPW = SERVO_DEFAULT_MAX_PW;
+    this->pulseWidth = 0;
+}
@@ -0,0 +1,142 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2010, LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libraries/Servo/MultiServo.h
+ * @brief Many servos on any pins, multiplexed on one timer
+ */
+
+#ifndef _MULTISERVO_H_
+#define _MULTISERVO_H_
+
+#include <libmaple/libmaple_types.h>
+#include <libmaple/timer.h>
+
+#include "Servo.h"
+
+/*
+ * Each of the timer's four compare channels drives up to
+ * MULTISERVO_PER_CHANNEL servos in turn, one per
+ * MULTISERVO_SLOT_US slot of the 20 ms frame. The channel's compare
+ * interrupt sets a servo's pin at the start of its slot and clears it
+ * at the end of its pulse, using a precomputed GPIO register and
+ * compare value, so an interrupt is a handful of stores and the
+ * pulse edges jitter by little more than the interrupt latency.
+ * Channels are staggered by a quarter slot so their edges seldom
+ * coincide.
+ *
+ * Unlike Servo, MultiServo can use any GPIO pin, so one timer can
+ * drive 32 servos.
+ */
+
+#define MULTISERVO_PER_CHANNEL          8
+#define MULTISERVO_SLOT_US              2500
+#define MULTISERVO_MAX                  (4 * MULTISERVO_PER_CHANNEL)
+
+/** Timer used if MultiServo::setTimer() isn't called first. */
+#ifndef MULTISERVO_DEFAULT_TIMER
+#define MULTISERVO_DEFAULT_TIMER        2
+#endif
+
+/** Class for interfacing with RC servomotors, on any pin. */
+class MultiServo {
+public:
+    /**
+     * @brief Construct a new MultiServo instance.
+     *
+     * The new instance will not be attached to any pin.
+     */
+    MultiServo();
+
+    /**
+     * @brief Choose the timer that drives all MultiServo instances.
+     *
+     * Must be called before the first attach(). The whole timer is
+     * used; none of its channels can be used for anything else.
+     *
+     * @param timerNum Number of a general purpose or advanced timer.
+     */
+    static void setTimer(uint8 timerNum);
+
+    /**
+     * @brief Associate this instance with a servomotor whose input is
+     *        connected to pin.
+     *
+     * Takes the first free slot. Arguments are as for Servo::attach().
+     *
+     * @sideeffect Sets pinMode(pin, OUTPUT).
+     *
+     * @return true if successful, false when all MULTISERVO_MAX slots
+     *         are in use.
+     */
+    bool attach(uint8 pin,
+                uint16 minPulseWidth=SERVO_DEFAULT_MIN_PW,
+                uint16 maxPulseWidth=SERVO_DEFAULT_MAX_PW,
+                int16 minAngle=SERVO_DEFAULT_MIN_ANGLE,
+                int16 maxAngle=SERVO_DEFAULT_MAX_ANGLE);
+
+    /** @see Servo::attached() */
+    bool attached() const { return this->pin != NOT_ATTACHED; }
+
+    /** @see Servo::attachedPin() */
+    int attachedPin() const { return this->pin; }
+
+    /**
+     * @brief Stop driving the servo pulse train, and free its slot.
+     * @return true if this call did anything, false otherwise.
+     */
+    bool detach();
+
+    /** @see Servo::write() */
+    void write(int angle);
+
+    /** @see Servo::read() */
+    int read() const;
+
+    /**
+     * @brief Set the pulse width, in microseconds.
+     *
+     * Takes effect from the servo's next pulse. The pulse width is
+     * clamped to the range specified at attach() time.
+     */
+    void writeMicroseconds(uint16 pulseWidth);
+
+    /** @see Servo::readMicroseconds() */
+    uint16 readMicroseconds() const;
+
+private:
+    int16 pin;
+    int8 slot;
+    uint16 minPW;
+    uint16 maxPW;
+    int16 minAngle;
+    int16 maxAngle;
+    uint16 pulseWidth;
+
+    void resetFields(void);
+};
+
+#endif  /* _MULTISERVO_H_ */
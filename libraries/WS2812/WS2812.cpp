@@ -0,0 +1,246 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libraries/WS2812/WS2812.cpp
+ * @brief WS2812 LED strip driver implementation.
+ */
+
+#include "WS2812.h"
+
+#include <libmaple/util.h>
+#include <wirish/boards.h>
+#include <wirish/io.h>
+
+#define BIT_NS         1250    // 800 kHz
+#define T0H_NS         400
+#define T1H_NS         800
+#define RESET_US       300     // newer parts need more than 50 us
+#define HALF_SLOTS     (WS2812_PIXELS_PER_HALF * 24)
+#define RESET_HALVES   ((RESET_US * 1000 + HALF_SLOTS * BIT_NS - 1) /  \
+                        (HALF_SLOTS * BIT_NS))
+
+/* DMA interrupts carry no argument, so each timer gets a handler
+ * which forwards to the strip using it. */
+
+static WS2812 *strips[9];
+
+#define STRIP_DMA_IRQ(n)                        \
+    static void strip##n##_dma_irq(void) {      \
+        strips[n]->handleDMA();                 \
+    }
+STRIP_DMA_IRQ(1)
+STRIP_DMA_IRQ(2)
+STRIP_DMA_IRQ(3)
+STRIP_DMA_IRQ(4)
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+STRIP_DMA_IRQ(5)
+STRIP_DMA_IRQ(8)
+#endif
+
+static voidFuncPtr strip_dma_irq(timer_dev *dev) {
+    if (dev == TIMER1) return strip1_dma_irq;
+    if (dev == TIMER2) return strip2_dma_irq;
+    if (dev == TIMER3) return strip3_dma_irq;
+    if (dev == TIMER4) return strip4_dma_irq;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    if (dev == TIMER5) return strip5_dma_irq;
+    if (dev == TIMER8) return strip8_dma_irq;
+#endif
+    return NULL;
+}
+
+static uint8 timer_number(timer_dev *dev) {
+    if (dev == TIMER1) return 1;
+    if (dev == TIMER2) return 2;
+    if (dev == TIMER3) return 3;
+    if (dev == TIMER4) return 4;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    if (dev == TIMER5) return 5;
+    if (dev == TIMER8) return 8;
+#endif
+    return 0;
+}
+
+/*
+ * WS2812 routines
+ */
+
+WS2812::WS2812(uint8 pin, uint8 *pixels, uint16 count) {
+    this->pin = pin;
+    this->pixels = pixels;
+    this->count = count;
+    this->dev = NULL;
+    this->channel = 0;
+    this->dmaDev = NULL;
+    this->dmaTube = DMA_CH1;
+    this->nextPixel = 0;
+    this->halvesLeft = 0;
+}
+
+bool WS2812::begin(void) {
+    if (this->pin >= BOARD_NR_GPIO_PINS || this->pixels == NULL) {
+        return false;
+    }
+    timer_dev *dev = PIN_MAP[this->pin].timer_device;
+    uint8 channel = PIN_MAP[this->pin].timer_channel;
+    dma_request_src src;
+    voidFuncPtr handler = dev ? strip_dma_irq(dev) : NULL;
+    if (handler == NULL ||
+        !dma_timer_req(dev, DMA_TIMER_REQ_UP, &this->dmaDev,
+                       &this->dmaTube, &src)) {
+        return false;
+    }
+    this->end();
+    this->dev = dev;
+    this->channel = channel;
+
+    uint32 clock = CYCLES_PER_MICROSECOND * 1000;
+    this->zero = (uint16)((clock * T0H_NS + 500000) / 1000000);
+    this->one = (uint16)((clock * T1H_NS + 500000) / 1000000);
+
+    timer_pause(dev);
+    timer_set_prescaler(dev, 0);
+    timer_set_reload(dev, (uint16)((clock * BIT_NS) / 1000000 - 1));
+    timer_set_compare(dev, channel, 0);
+    timer_set_mode(dev, channel, TIMER_PWM);
+    timer_generate_update(dev);
+    pinMode(this->pin, PWM);
+
+    dma_tube_config cfg;
+    cfg.tube_src = this->slots;
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = &(dev->regs).gen->CCR1 + (channel - 1);
+    cfg.tube_dst_size = DMA_SIZE_16BITS;
+    cfg.tube_nr_xfers = 2 * HALF_SLOTS;
+    cfg.tube_flags = (DMA_CFG_SRC_INC | DMA_CFG_CIRC |
+                      DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE);
+    cfg.target_data = NULL;
+    cfg.tube_req_src = src;
+    dma_init(this->dmaDev);
+    if (dma_tube_cfg(this->dmaDev, this->dmaTube, &cfg) !=
+        DMA_TUBE_CFG_SUCCESS) {
+        this->dev = NULL;
+        return false;
+    }
+    dma_set_priority(this->dmaDev, this->dmaTube, DMA_PRIORITY_VERY_HIGH);
+    strips[timer_number(dev)] = this;
+    dma_attach_interrupt(this->dmaDev, this->dmaTube, handler);
+
+    // Keep the timer running between refreshes: with a zero compare
+    // value the line idles low.
+    timer_resume(dev);
+    return true;
+}
+
+void WS2812::end(void) {
+    if (this->dev == NULL) {
+        return;
+    }
+    while (this->busy())
+        ;
+    dma_detach_interrupt(this->dmaDev, this->dmaTube);
+    timer_pause(this->dev);
+    timer_cc_disable(this->dev, this->channel);
+    strips[timer_number(this->dev)] = NULL;
+    this->dev = NULL;
+}
+
+void WS2812::setPixel(uint16 index, uint8 red, uint8 green, uint8 blue) {
+    if (index >= this->count) {
+        return;
+    }
+    uint8 *p = this->pixels + 3 * index;
+    p[0] = green;
+    p[1] = red;
+    p[2] = blue;
+}
+
+void WS2812::show(void) {
+    if (this->dev == NULL) {
+        return;
+    }
+    while (this->busy())
+        ;
+    uint32 dataHalves = ((this->count + WS2812_PIXELS_PER_HALF - 1) /
+                         WS2812_PIXELS_PER_HALF);
+    // Fill both halves before starting; the interrupts refill each one
+    // while the other is being sent.
+    this->nextPixel = 0;
+    this->encode(this->slots);
+    this->encode(this->slots + HALF_SLOTS);
+    this->halvesLeft = dataHalves + RESET_HALVES;
+
+    dma_set_num_transfers(this->dmaDev, this->dmaTube, 2 * HALF_SLOTS);
+    dma_clear_isr_bits(this->dmaDev, this->dmaTube);
+    dma_enable(this->dmaDev, this->dmaTube);
+    timer_dma_enable_upd_req(this->dev);
+}
+
+void WS2812::handleDMA(void) {
+    uint8 bits = dma_get_isr_bits(this->dmaDev, this->dmaTube);
+    dma_clear_isr_bits(this->dmaDev, this->dmaTube);
+
+    // Each flag means the half it names has just been sent.
+    for (uint32 i = 0; i < 2; i++) {
+        uint8 flag = i == 0 ? DMA_ISR_HTIF1 : DMA_ISR_TCIF1;
+        if (!(bits & flag) || this->halvesLeft == 0) {
+            continue;
+        }
+        if (--this->halvesLeft == 0) {
+            timer_dma_disable_upd_req(this->dev);
+            dma_disable(this->dmaDev, this->dmaTube);
+            timer_set_compare(this->dev, this->channel, 0);
+            return;
+        }
+        this->encode(this->slots + i * HALF_SLOTS);
+    }
+}
+
+/*
+ * Private helpers
+ */
+
+/* Encode the next WS2812_PIXELS_PER_HALF pixels into a half buffer,
+ * padding with zero duty cycles (i.e. reset time) past the end. */
+void WS2812::encode(uint16 *half) {
+    uint32 n = this->count - this->nextPixel;
+    if (n > WS2812_PIXELS_PER_HALF) {
+        n = WS2812_PIXELS_PER_HALF;
+    }
+    const uint8 *p = this->pixels + 3 * this->nextPixel;
+    uint16 *slot = half;
+    for (uint32 i = 0; i < 3 * n; i++) {
+        uint8 byte = p[i];
+        for (uint8 mask = 0x80; mask; mask >>= 1) {
+            *slot++ = (byte & mask) ? this->one : this->zero;
+        }
+    }
+    while (slot < half + HALF_SLOTS) {
+        *slot++ = 0;
+    }
+    this->nextPixel += n;
+}
@@ -0,0 +1,122 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libraries/WS2812/WS2812.h
+ * @brief WS2812 ("NeoPixel") LED strip driver
+ *
+ * Each data bit becomes one 1.25 us timer PWM period, whose duty
+ * cycle encodes the bit. DMA writes the next duty cycle to the
+ * channel's compare register on every update event, from a small
+ * double buffer which the DMA interrupt refills from the pixel data,
+ * so a refresh needs no CPU time apart from the refills.
+ */
+
+#ifndef _WS2812_H_
+#define _WS2812_H_
+
+#include <libmaple/dma.h>
+#include <libmaple/timer.h>
+
+/** Pixels encoded into each half of the DMA buffer. */
+static const uint8 WS2812_PIXELS_PER_HALF = 4;
+
+/**
+ * @brief WS2812 LED strip.
+ *
+ * The strip's data line must be connected to a timer channel pin
+ * whose timer's update event has a DMA request (on STM32F1, timers
+ * 1 to 5 and 8). The timer runs at 800 kHz while a strip is attached,
+ * so its other channels can't be used for ordinary PWM.
+ */
+class WS2812 {
+public:
+    /**
+     * @brief Construct a new strip.
+     * @param pin Timer channel pin driving the strip's data line.
+     * @param pixels Pixel data, three bytes per pixel in the strip's
+     *               green, red, blue order. Only read during show().
+     * @param count Number of pixels.
+     */
+    WS2812(uint8 pin, uint8 *pixels, uint16 count);
+
+    /**
+     * @brief Set up the pin, timer and DMA tube.
+     * @return true on success, false if the pin can't drive a strip.
+     */
+    bool begin(void);
+
+    /**
+     * @brief Stop driving the strip, and release the timer.
+     */
+    void end(void);
+
+    /**
+     * @brief Set a pixel's colour in the pixel data.
+     *
+     * Takes effect at the next show().
+     */
+    void setPixel(uint16 index, uint8 red, uint8 green, uint8 blue);
+
+    /**
+     * @brief Start sending the pixel data to the strip.
+     *
+     * Waits for any refresh in progress to finish first. Returns
+     * as soon as the refresh has started; don't change the pixel data
+     * until busy() returns false.
+     */
+    void show(void);
+
+    /**
+     * @brief Is a refresh in progress?
+     */
+    bool busy(void) { return this->halvesLeft != 0; }
+
+    /**
+     * @brief Handle a DMA interrupt for this strip.
+     *
+     * Called from the DMA interrupt handler; not for users.
+     */
+    void handleDMA(void);
+
+private:
+    uint8 pin;
+    uint8 *pixels;
+    uint16 count;
+    timer_dev *dev;
+    uint8 channel;
+    dma_dev *dmaDev;
+    dma_tube dmaTube;
+    uint16 zero;
+    uint16 one;
+    uint16 nextPixel;
+    volatile uint16 halvesLeft;
+    uint16 slots[2 * WS2812_PIXELS_PER_HALF * 24];
+
+    void encode(uint16 *half);
+};
+
+#endif
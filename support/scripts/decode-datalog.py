@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+
+"""Decode a binary log written by the Card library's DataLogger.
+
+The log is a sequence of 512 byte blocks. Each starts with a header:
+
+    uint32 magic     "MLOG"
+    uint32 session   run number passed to DataLogger::begin()
+    uint32 sequence  block number within the run
+    uint32 dropped   records dropped before the block was started
+    uint16 used      payload bytes used
+    uint16 records   records in the block
+
+followed by records, each a length byte and that many data bytes. The
+log ends at the first block that does not continue the first block's
+session and sequence.
+
+Usage:
+
+    decode-datalog.py LOG.BIN                   # one hex record per line
+    decode-datalog.py -f '<Ihhh' LOG.BIN        # unpack records as CSV
+    decode-datalog.py -s LOG.BIN                # statistics only
+"""
+
+from __future__ import print_function
+
+import optparse
+import struct
+import sys
+
+MAGIC = 0x474F4C4D
+HEADER = struct.Struct('<IIIIHH')
+BLOCK = 512
+
+def blocks(data):
+    """Yield (header, payload) for each block of the first run."""
+    session = None
+    for seq, offset in enumerate(range(0, len(data) - BLOCK + 1, BLOCK)):
+        block = data[offset:offset + BLOCK]
+        magic, sess, sequence, dropped, used, records = \
+            HEADER.unpack_from(block)
+        if magic != MAGIC or sequence != seq:
+            return
+        if session is None:
+            session = sess
+        elif sess != session:
+            return
+        if used > BLOCK - HEADER.size:
+            return
+        yield (sess, sequence, dropped, used, records), \
+            block[HEADER.size:HEADER.size + used]
+
+def records(payload):
+    """Yield each record in a block payload."""
+    offset = 0
+    while offset < len(payload):
+        length = bytearray(payload[offset:offset + 1])[0]
+        yield payload[offset + 1:offset + 1 + length]
+        offset += 1 + length
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] LOGFILE')
+    parser.add_option('-f', '--format', dest='format',
+                      help='struct format of a record, prints CSV rows')
+    parser.add_option('-s', '--stats', dest='stats', action='store_true',
+                      help='print statistics only')
+    options, args = parser.parse_args()
+    if len(args) != 1:
+        parser.error('expected one log file')
+
+    with open(args[0], 'rb') as f:
+        data = f.read()
+    record = struct.Struct(options.format) if options.format else None
+
+    nblocks = nrecords = dropped = 0
+    session = None
+    for (session, sequence, dropped, used, count), payload in blocks(data):
+        nblocks += 1
+        for rec in records(payload):
+            nrecords += 1
+            if options.stats:
+                continue
+            if record is None:
+                print(''.join('%02x' % b for b in bytearray(rec)))
+            elif len(rec) == record.size:
+                print(','.join(str(v) for v in record.unpack(rec)))
+            else:
+                print('# sequence %d: %d byte record does not match format'
+                      % (sequence, len(rec)), file=sys.stderr)
+
+    out = sys.stdout if options.stats else sys.stderr
+    if session is None:
+        print('no log found', file=out)
+        return 1
+    print('session %d: %d blocks, %d records, %d dropped before the last '
+          'block' % (session, nblocks, nrecords, dropped), file=out)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
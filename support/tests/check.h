@@ -0,0 +1,28 @@
+/*
+ * Minimal checks shared by the host tests under libraries/, whose
+ * Makefiles put this directory on the include path.
+ *
+ * This file is released into the public domain.
+ */
+
+#ifndef _SUPPORT_TESTS_CHECK_H_
+#define _SUPPORT_TESTS_CHECK_H_
+
+#include <stdio.h>
+
+static unsigned failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+/* Prints the summary and gives main()'s exit status */
+static int finish(const char *name) {
+    printf("%s finished, failures: %u\n\n", name, failures);
+    return failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/ChainedTimer.cpp
+ * @brief Chained timer timestamp counter implementation.
+ */
+
+#include <wirish/ChainedTimer.h>
+#include <wirish/HardwareTimer.h>
+#include <wirish/ext_interrupts.h> // for noInterrupts(), interrupts()
+#include <board/board.h>           // for CYCLES_PER_MICROSECOND
+
+/*
+ * Internal trigger connections: itr_masters[slave][n] is the number
+ * of the timer whose TRGO drives the slave's ITRn.
+ */
+static const uint8 itr_masters[9][4] = {
+    {0, 0, 0, 0},
+    {5, 2, 3, 4},               // TIM1
+    {1, 8, 3, 4},               // TIM2
+    {1, 2, 5, 4},               // TIM3
+    {1, 2, 3, 8},               // TIM4
+    {2, 3, 4, 8},               // TIM5
+    {0, 0, 0, 0},
+    {0, 0, 0, 0},
+    {1, 2, 4, 5},               // TIM8
+};
+
+static ChainedTimer *running = NULL;
+
+static void chained_overflow(void) {
+    running->overflow();
+}
+
+/*
+ * ChainedTimer routines
+ */
+
+ChainedTimer::ChainedTimer(uint8 masterNum, uint8 slaveNum) {
+    this->masterNum = masterNum;
+    this->slaveNum = slaveNum;
+    this->master = NULL;
+    this->slave = NULL;
+    this->masterRegs = NULL;
+    this->slaveRegs = NULL;
+    this->epoch = 0;
+}
+
+bool ChainedTimer::begin(void) {
+    if (this->slaveNum >= 9) {
+        return false;
+    }
+    uint32 itr;
+    for (itr = 0; itr < 4; itr++) {
+        if (itr_masters[this->slaveNum][itr] == this->masterNum) {
+            break;
+        }
+    }
+    if (itr == 4 || this->masterNum == 0) {
+        return false;
+    }
+    if (running != NULL) {
+        running->end();
+    }
+    timer_dev *master = HardwareTimer(this->masterNum).c_dev();
+    timer_dev *slave = HardwareTimer(this->slaveNum).c_dev();
+
+    timer_pause(master);
+    timer_set_prescaler(master, 0);
+    timer_set_reload(master, 0xFFFF);
+    timer_set_master_mode(master, TIMER_CR2_MMS_UPDATE);
+    timer_generate_update(master);
+
+    timer_pause(slave);
+    timer_set_prescaler(slave, 0);
+    timer_set_reload(slave, 0xFFFF);
+    timer_set_slave_mode(slave, itr << 4, TIMER_SMCR_SMS_EXTERNAL);
+    timer_generate_update(slave);
+    (slave->regs).gen->SR = ~TIMER_SR_UIF;
+
+    this->master = master;
+    this->slave = slave;
+    this->masterRegs = (master->regs).gen;
+    this->slaveRegs = (slave->regs).gen;
+    this->epoch = 0;
+    running = this;
+    timer_attach_interrupt(slave, TIMER_UPDATE_INTERRUPT, chained_overflow);
+    timer_resume(slave);
+    timer_resume(master);
+    return true;
+}
+
+void ChainedTimer::end(void) {
+    if (running != this) {
+        return;
+    }
+    timer_pause(this->master);
+    timer_pause(this->slave);
+    timer_detach_interrupt(this->slave, TIMER_UPDATE_INTERRUPT);
+    timer_set_slave_mode(this->slave, TIMER_SMCR_TS_ITR0,
+                         TIMER_SMCR_SMS_DISABLED);
+    timer_set_master_mode(this->master, TIMER_CR2_MMS_RESET);
+    running = NULL;
+}
+
+uint64 ChainedTimer::cycles64(void) {
+    uint32 epoch, now, sr;
+    do {
+        epoch = this->epoch;
+        now = this->cycles();
+        sr = this->slaveRegs->SR;
+    } while (epoch != this->epoch);
+    // Count an overflow whose interrupt is still pending, if the
+    // counter was read after it.
+    if ((sr & TIMER_SR_UIF) && now < 0x80000000) {
+        epoch++;
+    }
+    return ((uint64)epoch << 32) | now;
+}
+
+uint64 ChainedTimer::micros64(void) {
+    // Long division in 16 bit digits, so each step is a 32 bit
+    // division by a constant, which compiles to a multiply.
+    uint64 cycles = this->cycles64();
+    uint32 high = (uint32)(cycles >> 32);
+    uint32 low = (uint32)cycles;
+    uint32 qHigh = high / CYCLES_PER_MICROSECOND;
+    uint32 rest = (((high % CYCLES_PER_MICROSECOND) << 16) | (low >> 16));
+    uint32 qMid = rest / CYCLES_PER_MICROSECOND;
+    rest = (((rest % CYCLES_PER_MICROSECOND) << 16) | (low & 0xFFFF));
+    uint32 qLow = rest / CYCLES_PER_MICROSECOND;
+    return ((uint64)qHigh << 32) | ((qMid << 16) + qLow);
+}
+
+void ChainedTimer::overflow(void) {
+    // Keep readers preempting us from seeing the flag cleared before
+    // the epoch has advanced.
+    noInterrupts();
+    this->slaveRegs->SR = ~TIMER_SR_UIF;
+    this->epoch++;
+    interrupts();
+}
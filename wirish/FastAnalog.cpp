@@ -0,0 +1,69 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/FastAnalog.cpp
+ * @brief Wirish fast analog read implementation.
+ */
+
+#include <wirish/FastAnalog.h>
+#include <wirish/boards.h>
+
+FastAnalog::FastAnalog(uint8 pin) {
+    this->init(pin);
+}
+
+FastAnalog::FastAnalog(uint8 pin, adc_smp_rate smp_rate) {
+    this->init(pin);
+    this->setSampleRate(smp_rate);
+}
+
+void FastAnalog::setSampleRate(adc_smp_rate smp_rate) {
+    if (this->regs == NULL) {
+        return;
+    }
+    uint32 shift = (this->channel < 10 ?
+                    this->channel * 3 : (this->channel - 10) * 3);
+    this->smprMask = 0x7 << shift;
+    this->smprBits = (uint32)smp_rate << shift;
+    adc_set_channel_sample_rate(this->dev, this->channel, smp_rate);
+}
+
+void FastAnalog::init(uint8 pin) {
+    this->dev = PIN_MAP[pin].adc_device;
+    this->channel = PIN_MAP[pin].adc_channel;
+    // Until a sample time is chosen, read() leaves SMPR alone.
+    this->smprMask = 0;
+    this->smprBits = 0;
+    if (this->dev == NULL) {
+        this->regs = NULL;
+        this->smpr = NULL;
+        return;
+    }
+    this->regs = this->dev->regs;
+    this->smpr = (this->channel < 10 ?
+                  &this->regs->SMPR2 : &this->regs->SMPR1);
+}
@@ -0,0 +1,385 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/HardwareADC.cpp
+ * @brief Wirish ADC streaming implementation.
+ */
+
+#include <wirish/HardwareADC.h>
+
+/* DMA and ADC interrupts carry no argument, so each ADC gets handlers
+ * which forward to the HardwareADC using it. */
+
+static HardwareADC *adc1Stream = NULL;
+static void adc1_dma_irq(void) {
+    adc1Stream->handleDMA();
+}
+
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+static HardwareADC *adc3Stream = NULL;
+static void adc3_dma_irq(void) {
+    adc3Stream->handleDMA();
+}
+#endif
+
+static HardwareADC *adc1Injected = NULL;
+static void adc1_jeoc_irq(void) {
+    adc1Injected->handleInjected();
+}
+
+static HardwareADC *adc2Injected = NULL;
+static void adc2_jeoc_irq(void) {
+    adc2Injected->handleInjected();
+}
+
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+static HardwareADC *adc3Injected = NULL;
+static void adc3_jeoc_irq(void) {
+    adc3Injected->handleInjected();
+}
+#endif
+
+/*
+ * HardwareADC routines
+ */
+
+HardwareADC::HardwareADC(uint8 adcNum) {
+    this->dmaDev = NULL;
+    this->trigger = ADC_EXT_EV_SWSTART;
+    this->length = 0;
+    this->slaveLength = 0;
+    this->injectedLength = 0;
+    this->dual = false;
+    this->injected = false;
+    this->buffer = NULL;
+    this->count = 0;
+    this->callback = NULL;
+    this->dualCallback = NULL;
+    this->injectedCallback = NULL;
+
+    switch (adcNum) {
+    case 1:
+        this->dev = ADC1;
+        this->dmaDev = DMA1;
+        this->dmaTube = DMA_CH1;
+        this->dmaSrc = DMA_REQ_SRC_ADC1;
+        break;
+    case 2:
+        this->dev = ADC2;
+        break;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    case 3:
+        this->dev = ADC3;
+        this->dmaDev = DMA2;
+        this->dmaTube = DMA_CH5;
+        this->dmaSrc = DMA_REQ_SRC_ADC3;
+        break;
+#endif
+    default:
+        this->dev = NULL;
+        break;
+    }
+    ASSERT(this->dev != NULL);
+}
+
+bool HardwareADC::setSequence(const uint8 *pins, uint8 count) {
+    if (count == 0 || count > ADC_MAX_SEQUENCE) {
+        return false;
+    }
+    for (uint8 i = 0; i < count; i++) {
+        if (!this->channel(pins[i], this->dev, &this->channels[i])) {
+            return false;
+        }
+    }
+    this->length = count;
+    return true;
+}
+
+bool HardwareADC::setDualSequence(const uint8 *slavePins, uint8 count) {
+    if (this->dev != ADC1 || count == 0 || count > ADC_MAX_SEQUENCE) {
+        return false;
+    }
+    for (uint8 i = 0; i < count; i++) {
+        if (!this->channel(slavePins[i], ADC2, &this->slaveChannels[i])) {
+            return false;
+        }
+    }
+    this->slaveLength = count;
+    return true;
+}
+
+void HardwareADC::setSampleRate(adc_smp_rate rate) {
+    adc_set_sample_rate(this->dev, rate);
+}
+
+void HardwareADC::setTrigger(adc_extsel_event event) {
+    this->trigger = event;
+}
+
+bool HardwareADC::start(uint16 *buffer, uint32 count, ADCCallback callback) {
+    if (callback == NULL) {
+        return false;
+    }
+    this->stop();
+    this->callback = callback;
+    this->dualCallback = NULL;
+    return this->stream(buffer, count, DMA_SIZE_16BITS);
+}
+
+bool HardwareADC::startDual(uint32 *buffer, uint32 count,
+                            ADCDualCallback callback) {
+    if (this->dev != ADC1 || callback == NULL ||
+        this->slaveLength != this->length) {
+        return false;
+    }
+    this->stop();
+    this->callback = NULL;
+    this->dualCallback = callback;
+
+    // ADC2 follows ADC1's trigger, with matching sample times.
+    adc_set_dual_mode(ADC_DUAL_INDEPENDENT);
+    ADC2->regs->SMPR1 = ADC1->regs->SMPR1;
+    ADC2->regs->SMPR2 = ADC1->regs->SMPR2;
+    this->configure(ADC2, this->slaveChannels);
+    adc_set_extsel(ADC2, ADC_EXT_EV_SWSTART);
+    adc_set_exttrig(ADC2, 1);
+    adc_set_continuous(ADC2, this->trigger == ADC_EXT_EV_SWSTART);
+    adc_set_dual_mode(ADC_DUAL_REG_SIMULT);
+    this->dual = true;
+
+    if (!this->stream(buffer, count, DMA_SIZE_32BITS)) {
+        this->buffer = buffer;
+        this->stop();
+        return false;
+    }
+    return true;
+}
+
+void HardwareADC::stop(void) {
+    if (this->buffer == NULL) {
+        return;
+    }
+    adc_set_continuous(this->dev, 0);
+    adc_set_extsel(this->dev, ADC_EXT_EV_SWSTART);
+    adc_set_dma(this->dev, 0);
+    dma_disable(this->dmaDev, this->dmaTube);
+    dma_detach_interrupt(this->dmaDev, this->dmaTube);
+    adc_set_reg_seqlen(this->dev, 1);
+    (void)this->dev->regs->DR;
+    if (this->dual) {
+        adc_set_dual_mode(ADC_DUAL_INDEPENDENT);
+        adc_set_continuous(ADC2, 0);
+        adc_set_scan(ADC2, 0);
+        adc_set_reg_seqlen(ADC2, 1);
+        this->dual = false;
+    }
+    this->buffer = NULL;
+    this->updateScan();
+}
+
+bool HardwareADC::setInjectedSequence(const uint8 *pins, uint8 count) {
+    if (count == 0 || count > ADC_MAX_INJECTED) {
+        return false;
+    }
+    for (uint8 i = 0; i < count; i++) {
+        if (!this->channel(pins[i], this->dev,
+                           &this->injectedChannels[i])) {
+            return false;
+        }
+    }
+    this->injectedLength = count;
+    return true;
+}
+
+bool HardwareADC::startInjected(adc_jextsel_event event,
+                                ADCInjectedCallback callback) {
+    if (this->injectedLength == 0 || callback == NULL) {
+        return false;
+    }
+    this->stopInjected();
+    this->injectedCallback = callback;
+
+    adc_set_inj_sequence(this->dev, this->injectedChannels,
+                         this->injectedLength);
+    this->injected = true;
+    this->updateScan();
+
+    voidFuncPtr handler = NULL;
+    if (this->dev == ADC1) {
+        adc1Injected = this;
+        handler = adc1_jeoc_irq;
+    } else if (this->dev == ADC2) {
+        adc2Injected = this;
+        handler = adc2_jeoc_irq;
+    }
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    else {
+        adc3Injected = this;
+        handler = adc3_jeoc_irq;
+    }
+#endif
+    adc_attach_interrupt(this->dev, ADC_JEOC_INTERRUPT, handler);
+    adc_set_jextsel(this->dev, event);
+    adc_set_jexttrig(this->dev, 1);
+    return true;
+}
+
+void HardwareADC::stopInjected(void) {
+    if (!this->injected) {
+        return;
+    }
+    adc_set_jexttrig(this->dev, 0);
+    adc_set_jextsel(this->dev, ADC_JEXT_EV_JSWSTART);
+    adc_detach_interrupt(this->dev, ADC_JEOC_INTERRUPT);
+    this->injected = false;
+    this->updateScan();
+}
+
+uint32 HardwareADC::position(void) {
+    if (this->buffer == NULL) {
+        return 0;
+    }
+    uint32 left = dma_tube_regs(this->dmaDev, this->dmaTube)->CNDTR;
+    return (this->count - left) % this->count;
+}
+
+void HardwareADC::handleDMA(void) {
+    uint8 bits = dma_get_isr_bits(this->dmaDev, this->dmaTube);
+    dma_clear_isr_bits(this->dmaDev, this->dmaTube);
+
+    // With a long enough interrupt latency both halves may be ready;
+    // deliver them in order.
+    uint32 half = this->count / 2;
+    if (this->dualCallback) {
+        uint32 *samples = (uint32*)this->buffer;
+        if (bits & DMA_ISR_HTIF1) {
+            this->dualCallback(samples, half);
+        }
+        if (bits & DMA_ISR_TCIF1) {
+            this->dualCallback(samples + half, half);
+        }
+    } else {
+        uint16 *samples = (uint16*)this->buffer;
+        if (bits & DMA_ISR_HTIF1) {
+            this->callback(samples, half);
+        }
+        if (bits & DMA_ISR_TCIF1) {
+            this->callback(samples + half, half);
+        }
+    }
+}
+
+void HardwareADC::handleInjected(void) {
+    uint16 results[ADC_MAX_INJECTED];
+    for (uint8 i = 0; i < this->injectedLength; i++) {
+        results[i] = adc_get_inj_data(this->dev, i + 1);
+    }
+    this->injectedCallback(results, this->injectedLength);
+}
+
+/*
+ * Private helpers
+ */
+
+bool HardwareADC::channel(uint8 pin, const adc_dev *adc, uint8 *channel) {
+    if (pin >= BOARD_NR_GPIO_PINS) {
+        return false;
+    }
+    // ADC1 and ADC2 share their input channels.
+    const adc_dev *pinAdc = PIN_MAP[pin].adc_device;
+    if (pinAdc != adc && !(pinAdc == ADC1 && adc == ADC2)) {
+        return false;
+    }
+    *channel = PIN_MAP[pin].adc_channel;
+    return true;
+}
+
+void HardwareADC::configure(const adc_dev *adc, const uint8 *channels) {
+    adc_set_reg_sequence(adc, channels, this->length);
+    adc_set_scan(adc, this->length > 1);
+}
+
+// Scan mode applies to both the regular and the injected sequence.
+void HardwareADC::updateScan(void) {
+    bool regular = this->buffer != NULL && this->length > 1;
+    bool injected = this->injected && this->injectedLength > 1;
+    adc_set_scan(this->dev, regular || injected);
+}
+
+bool HardwareADC::stream(void *buffer, uint32 count, dma_xfer_size size) {
+    if (this->dmaDev == NULL || this->length == 0 || count == 0 ||
+        count > 65535 || count % (2 * this->length) != 0) {
+        return false;
+    }
+    this->buffer = buffer;
+    this->count = count;
+
+    adc_reg_map *regs = this->dev->regs;
+    adc_set_reg_sequence(this->dev, this->channels, this->length);
+    this->updateScan();
+
+    dma_tube_config cfg;
+    cfg.tube_src = &regs->DR;
+    cfg.tube_src_size = size;
+    cfg.tube_dst = buffer;
+    cfg.tube_dst_size = size;
+    cfg.tube_nr_xfers = count;
+    cfg.tube_flags = (DMA_CFG_DST_INC | DMA_CFG_CIRC |
+                      DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE);
+    cfg.target_data = NULL;
+    cfg.tube_req_src = this->dmaSrc;
+
+    dma_init(this->dmaDev);
+    if (dma_tube_cfg(this->dmaDev, this->dmaTube, &cfg) !=
+        DMA_TUBE_CFG_SUCCESS) {
+        this->buffer = NULL;
+        return false;
+    }
+    dma_set_priority(this->dmaDev, this->dmaTube, DMA_PRIORITY_HIGH);
+    if (this->dev == ADC1) {
+        adc1Stream = this;
+        dma_attach_interrupt(this->dmaDev, this->dmaTube, adc1_dma_irq);
+    }
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    else {
+        adc3Stream = this;
+        dma_attach_interrupt(this->dmaDev, this->dmaTube, adc3_dma_irq);
+    }
+#endif
+    dma_enable(this->dmaDev, this->dmaTube);
+
+    // Drop any stale result, then hand conversions to the DMA.
+    (void)regs->DR;
+    adc_set_dma(this->dev, 1);
+    adc_set_extsel(this->dev, this->trigger);
+    adc_set_exttrig(this->dev, 1);
+    if (this->trigger == ADC_EXT_EV_SWSTART) {
+        adc_set_continuous(this->dev, 1);
+        regs->CR2 |= ADC_CR2_SWSTART;
+    }
+    return true;
+}
@@ -0,0 +1,220 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/HardwareCapture.cpp
+ * @brief Wirish input capture implementation.
+ */
+
+#include <wirish/HardwareCapture.h>
+#include <wirish/HardwareTimer.h>
+#include <board/board.h>           // for CYCLES_PER_MICROSECOND
+
+#define MODE_NONE  0
+#define MODE_PWM   1
+#define MODE_EDGES 2
+
+HardwareCapture::HardwareCapture(uint8 timerNum) {
+    this->dev = HardwareTimer(timerNum).c_dev();
+    ASSERT(this->dev->type != TIMER_BASIC);
+    this->prescaler = 0;
+    this->channel = 0;
+    this->mode = MODE_NONE;
+    this->dmaDev = NULL;
+    this->ring = NULL;
+    this->count = 0;
+}
+
+void HardwareCapture::setPrescaleFactor(uint32 factor) {
+    this->prescaler = (uint16)(factor - 1);
+}
+
+uint32 HardwareCapture::getTickRate(void) {
+    return CYCLES_PER_MICROSECOND * 1000000 / (this->prescaler + 1);
+}
+
+bool HardwareCapture::beginPWM(uint8 channel) {
+    if (channel != 1 && channel != 2) {
+        return false;
+    }
+    this->end();
+    this->start();
+    timer_set_pwm_input(this->dev, channel, 0);
+    this->channel = channel;
+    this->mode = MODE_PWM;
+    timer_resume(this->dev);
+    return true;
+}
+
+bool HardwareCapture::beginEdges(uint8 channel, uint16 *ring, uint32 count,
+                                 bool falling) {
+    dma_dev *dmaDev;
+    dma_tube tube;
+    dma_request_src src;
+    if (ring == NULL || count < 3 || count > 65535 ||
+        !timer_has_cc_channel(this->dev, channel) ||
+        !dma_timer_req(this->dev, channel, &dmaDev, &tube, &src)) {
+        return false;
+    }
+    this->end();
+
+    timer_gen_reg_map *regs = (this->dev->regs).gen;
+    dma_tube_config cfg;
+    cfg.tube_src = &regs->CCR1 + (channel - 1);
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = ring;
+    cfg.tube_dst_size = DMA_SIZE_16BITS;
+    cfg.tube_nr_xfers = count;
+    cfg.tube_flags = DMA_CFG_DST_INC | DMA_CFG_CIRC;
+    cfg.target_data = NULL;
+    cfg.tube_req_src = src;
+
+    dma_init(dmaDev);
+    if (dma_tube_cfg(dmaDev, tube, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        return false;
+    }
+    dma_set_priority(dmaDev, tube, DMA_PRIORITY_HIGH);
+    // The transfer complete flag records that the ring has filled.
+    dma_clear_isr_bits(dmaDev, tube);
+    dma_enable(dmaDev, tube);
+
+    this->start();
+    timer_ic_set_mode(this->dev, channel, TIMER_IC_INPUT_DIRECT, 0);
+    timer_cc_set_pol(this->dev, channel, falling);
+    (void)timer_get_compare(this->dev, channel);
+    timer_dma_enable_req(this->dev, channel);
+    timer_cc_enable(this->dev, channel);
+
+    this->channel = channel;
+    this->mode = MODE_EDGES;
+    this->dmaDev = dmaDev;
+    this->dmaTube = tube;
+    this->ring = ring;
+    this->count = count;
+    timer_resume(this->dev);
+    return true;
+}
+
+void HardwareCapture::end(void) {
+    if (this->mode == MODE_NONE) {
+        return;
+    }
+    timer_pause(this->dev);
+    if (this->mode == MODE_PWM) {
+        timer_set_slave_mode(this->dev, TIMER_SMCR_TS_ITR0,
+                             TIMER_SMCR_SMS_DISABLED);
+        timer_cc_disable(this->dev, 1);
+        timer_cc_disable(this->dev, 2);
+    } else {
+        timer_cc_disable(this->dev, this->channel);
+        timer_dma_disable_req(this->dev, this->channel);
+        dma_disable(this->dmaDev, this->dmaTube);
+    }
+    this->mode = MODE_NONE;
+}
+
+uint32 HardwareCapture::period(void) {
+    if (this->mode == MODE_PWM) {
+        return timer_get_compare(this->dev, this->channel);
+    }
+    uint32 sum;
+    uint32 n = this->intervals(&sum);
+    return n ? (sum + n / 2) / n : 0;
+}
+
+uint32 HardwareCapture::pulseWidth(void) {
+    if (this->mode != MODE_PWM) {
+        return 0;
+    }
+    return timer_get_compare(this->dev, this->channel == 1 ? 2 : 1);
+}
+
+float HardwareCapture::frequency(void) {
+    uint32 sum;
+    uint32 n;
+    if (this->mode == MODE_PWM) {
+        sum = this->period();
+        n = 1;
+    } else {
+        n = this->intervals(&sum);
+    }
+    return sum ? (float)this->getTickRate() * n / sum : 0;
+}
+
+float HardwareCapture::duty(void) {
+    if (this->mode != MODE_PWM) {
+        return 0;
+    }
+    uint32 period = this->period();
+    return period ? (float)this->pulseWidth() / period : 0;
+}
+
+uint32 HardwareCapture::position(void) {
+    if (this->mode != MODE_EDGES) {
+        return 0;
+    }
+    uint32 left = dma_tube_regs(this->dmaDev, this->dmaTube)->CNDTR;
+    return (this->count - left) % this->count;
+}
+
+/*
+ * Private helpers
+ */
+
+// Reset the counter to free running from 0 to 0xFFFF at the current
+// prescaler, paused.
+void HardwareCapture::start(void) {
+    timer_pause(this->dev);
+    timer_set_prescaler(this->dev, this->prescaler);
+    timer_set_reload(this->dev, 0xFFFF);
+    timer_generate_update(this->dev);
+}
+
+// Sum the intervals between the newest timestamps in the ring, and
+// return how many there were. One slot is left alone, as DMA may be
+// about to overwrite it.
+uint32 HardwareCapture::intervals(uint32 *sum) {
+    *sum = 0;
+    if (this->mode != MODE_EDGES) {
+        return 0;
+    }
+    uint32 pos = this->position();
+    bool filled = dma_get_isr_bits(this->dmaDev, this->dmaTube) &
+        DMA_ISR_TCIF1;
+    uint32 valid = filled ? this->count - 1 : pos;
+    if (valid < 2) {
+        return 0;
+    }
+    uint32 i = (pos + this->count - 1) % this->count;
+    uint16 newer = this->ring[i];
+    for (uint32 k = 1; k < valid; k++) {
+        i = (i == 0 ? this->count : i) - 1;
+        uint16 older = this->ring[i];
+        *sum += (uint16)(newer - older);
+        newer = older;
+    }
+    return valid - 1;
+}
@@ -0,0 +1,258 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/HardwareDAC.cpp
+ * @brief Wirish DAC waveform player implementation.
+ */
+
+#include <wirish/HardwareDAC.h>
+
+#if STM32_HAVE_DAC
+
+#include <libmaple/rcc.h>
+#include <libmaple/util.h>
+#include <wirish/boards.h>
+
+/* DMA interrupts carry no argument, so each DAC DMA request gets a
+ * handler which forwards to the HardwareDAC using it. */
+
+static HardwareDAC *dac1Player = NULL;
+static void dac1_dma_irq(void) {
+    dac1Player->handleDMA();
+}
+
+static HardwareDAC *dac2Player = NULL;
+static void dac2_dma_irq(void) {
+    dac2Player->handleDMA();
+}
+
+/*
+ * HardwareDAC routines
+ */
+
+HardwareDAC::HardwareDAC(uint8 timerNum) {
+    if (timerNum == 7) {
+        this->timer = TIMER7;
+        this->trigger = DAC_TRIG_TIM7_TRGO;
+    } else {
+        ASSERT(timerNum == 6);
+        this->timer = TIMER6;
+        this->trigger = DAC_TRIG_TIM6_TRGO;
+    }
+    this->channel = 0;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    this->dmaDev = DMA2;
+#else
+    this->dmaDev = DMA1; // value line parts without DMA2
+#endif
+    this->dmaTube = DMA_CH3;
+    this->buffer = NULL;
+    this->count = 0;
+    this->callback = NULL;
+    this->dualCallback = NULL;
+    this->setSampleRate(44100);
+}
+
+uint32 HardwareDAC::setSampleRate(uint32 hz) {
+    uint32 clock = CYCLES_PER_MICROSECOND * 1000000;
+    if (hz == 0) {
+        hz = 1;
+    }
+    uint32 period = (clock + hz / 2) / hz;
+    if (period < 2) {
+        period = 2;
+    }
+    uint32 prescaler = period / 65536 + 1;
+    uint32 reload = (period + prescaler / 2) / prescaler;
+    this->prescaler = (uint16)(prescaler - 1);
+    this->reload = (uint16)(reload - 1);
+    return clock / (prescaler * reload);
+}
+
+bool HardwareDAC::start(uint8 channel, uint16 *buffer, uint32 count,
+                        DACCallback callback) {
+    __io uint32 *dhr;
+    switch (channel) {
+    case 1:
+        dhr = &DAC->regs->DHR12R1;
+        break;
+    case 2:
+        dhr = &DAC->regs->DHR12R2;
+        break;
+    default:
+        return false;
+    }
+    this->stop();
+    this->callback = callback;
+    this->dualCallback = NULL;
+    return this->play(channel, buffer, count, dhr, DMA_SIZE_16BITS,
+                      callback != NULL);
+}
+
+bool HardwareDAC::startDual(uint32 *buffer, uint32 count,
+                            DACDualCallback callback) {
+    this->stop();
+    this->callback = NULL;
+    this->dualCallback = callback;
+    // Channel 0 means both; channel 1's DMA requests feed DHR12RD.
+    return this->play(0, buffer, count, &DAC->regs->DHR12RD,
+                      DMA_SIZE_32BITS, callback != NULL);
+}
+
+void HardwareDAC::stop(void) {
+    if (this->buffer == NULL) {
+        return;
+    }
+    timer_pause(this->timer);
+    uint8 dmaChannel = this->channel == 0 ? 1 : this->channel;
+    dac_set_dma(DAC, dmaChannel, 0);
+    dma_disable(this->dmaDev, this->dmaTube);
+    dma_detach_interrupt(this->dmaDev, this->dmaTube);
+    // Let dac_write_channel() reach the outputs directly again.
+    if (this->channel == 0) {
+        dac_disable_trigger(DAC, 1);
+        dac_disable_trigger(DAC, 2);
+    } else {
+        dac_disable_trigger(DAC, this->channel);
+    }
+    this->buffer = NULL;
+}
+
+uint32 HardwareDAC::position(void) {
+    if (this->buffer == NULL) {
+        return 0;
+    }
+    uint32 left = dma_tube_regs(this->dmaDev, this->dmaTube)->CNDTR;
+    return (this->count - left) % this->count;
+}
+
+void HardwareDAC::handleDMA(void) {
+    uint8 bits = dma_get_isr_bits(this->dmaDev, this->dmaTube);
+    dma_clear_isr_bits(this->dmaDev, this->dmaTube);
+
+    // With a long enough interrupt latency both halves may be done;
+    // deliver them in order.
+    uint32 half = this->count / 2;
+    if (this->dualCallback) {
+        uint32 *samples = (uint32*)this->buffer;
+        if (bits & DMA_ISR_HTIF1) {
+            this->dualCallback(samples, half);
+        }
+        if (bits & DMA_ISR_TCIF1) {
+            this->dualCallback(samples + half, half);
+        }
+    } else if (this->callback) {
+        uint16 *samples = (uint16*)this->buffer;
+        if (bits & DMA_ISR_HTIF1) {
+            this->callback(samples, half);
+        }
+        if (bits & DMA_ISR_TCIF1) {
+            this->callback(samples + half, half);
+        }
+    }
+}
+
+/*
+ * Private helpers
+ */
+
+bool HardwareDAC::play(uint8 channel, void *buffer, uint32 count,
+                       __io uint32 *dhr, dma_xfer_size size, bool irq) {
+    if (buffer == NULL || count < 2 || count > 65534 || (count & 1)) {
+        return false;
+    }
+
+    // Channel 2 has its own DMA request; dual mode uses channel 1's.
+    uint8 dmaChannel = channel == 0 ? 1 : channel;
+    dma_tube tube = dmaChannel == 1 ? DMA_CH3 : DMA_CH4;
+
+    dma_tube_config cfg;
+    cfg.tube_src = buffer;
+    cfg.tube_src_size = size;
+    cfg.tube_dst = dhr;
+    cfg.tube_dst_size = size;
+    cfg.tube_nr_xfers = count;
+    cfg.tube_flags = DMA_CFG_SRC_INC | DMA_CFG_CIRC;
+    if (irq) {
+        cfg.tube_flags |= DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE;
+    }
+    cfg.target_data = NULL;
+    cfg.tube_req_src = (dmaChannel == 1 ?
+                        DMA_REQ_SRC_DAC_CH1 : DMA_REQ_SRC_DAC_CH2);
+
+    dma_init(this->dmaDev);
+    if (dma_tube_cfg(this->dmaDev, tube, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        return false;
+    }
+    dma_set_priority(this->dmaDev, tube, DMA_PRIORITY_HIGH);
+    if (irq) {
+        if (dmaChannel == 1) {
+            dac1Player = this;
+            dma_attach_interrupt(this->dmaDev, tube, dac1_dma_irq);
+        } else {
+            dac2Player = this;
+            dma_attach_interrupt(this->dmaDev, tube, dac2_dma_irq);
+        }
+    }
+    this->channel = channel;
+    this->dmaTube = tube;
+    this->buffer = buffer;
+    this->count = count;
+
+    // Load the new rate without a trigger reaching the DAC.
+    timer_pause(this->timer);
+    timer_set_master_mode(this->timer, TIMER_CR2_MMS_RESET);
+    timer_set_prescaler(this->timer, this->prescaler);
+    timer_set_reload(this->timer, this->reload);
+    timer_generate_update(this->timer);
+    timer_set_master_mode(this->timer, TIMER_CR2_MMS_UPDATE);
+
+    // Each trigger outputs the holding register, then DMA refills
+    // it. Preload the buffer's last sample so the first trigger
+    // continues the waveform seamlessly.
+    rcc_clk_enable(RCC_DAC);
+    if (size == DMA_SIZE_32BITS) {
+        *dhr = ((uint32*)buffer)[count - 1];
+    } else {
+        *dhr = ((uint16*)buffer)[count - 1];
+    }
+    if (channel == 0) {
+        dac_set_trigger(DAC, 1, this->trigger);
+        dac_set_trigger(DAC, 2, this->trigger);
+        dac_enable_channel(DAC, 1);
+        dac_enable_channel(DAC, 2);
+    } else {
+        dac_set_trigger(DAC, channel, this->trigger);
+        dac_enable_channel(DAC, channel);
+    }
+    dac_set_dma(DAC, dmaChannel, 1);
+    dma_enable(this->dmaDev, tube);
+    timer_resume(this->timer);
+    return true;
+}
+
+#endif
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/HardwareEncoder.cpp
+ * @brief Wirish quadrature encoder implementation.
+ */
+
+#include <wirish/HardwareEncoder.h>
+#include <wirish/HardwareTimer.h>
+#include <wirish/ext_interrupts.h>
+#include <wirish/wirish_time.h>
+
+#define NO_INDEX 0xFF
+
+/* Timer interrupts carry no argument, so each timer gets a handler
+ * which forwards to the encoder using it. */
+
+static HardwareEncoder *encoders[9];
+
+#define ENCODER_IRQ(n)                          \
+    static void encoder##n##_irq(void) {        \
+        encoders[n]->checkpoint();              \
+    }
+ENCODER_IRQ(1)
+ENCODER_IRQ(2)
+ENCODER_IRQ(3)
+ENCODER_IRQ(4)
+ENCODER_IRQ(5)
+ENCODER_IRQ(8)
+
+static const voidFuncPtr encoder_irqs[9] = {
+    NULL, encoder1_irq, encoder2_irq, encoder3_irq, encoder4_irq,
+    encoder5_irq, NULL, NULL, encoder8_irq,
+};
+
+static void encoder_index(void *arg) {
+    ((HardwareEncoder*)arg)->index();
+}
+
+/*
+ * HardwareEncoder routines
+ */
+
+HardwareEncoder::HardwareEncoder(uint8 timerNum) {
+    ASSERT(timerNum < 9 && encoder_irqs[timerNum] != NULL);
+    this->dev = HardwareTimer(timerNum).c_dev();
+    this->timerNum = timerNum;
+    this->indexPin = NO_INDEX;
+    this->base = 0;
+    this->last = 0;
+    this->indexPos = 0;
+    this->indexTime = 0;
+    this->indexCounts = 0;
+    this->indexMicros = 0;
+    this->indexPulses = 0;
+}
+
+void HardwareEncoder::begin(uint32 mode, uint8 filter) {
+    timer_dev *dev = this->dev;
+    timer_pause(dev);
+    HardwareTimer(this->timerNum).setEncoderMode(mode, filter);
+
+    // Checkpoints a third of the counter's range apart, so the
+    // counter never moves 32,768 counts between two of them.
+    timer_oc_set_mode(dev, 3, TIMER_OC_MODE_FROZEN, 0);
+    timer_oc_set_mode(dev, 4, TIMER_OC_MODE_FROZEN, 0);
+    timer_set_compare(dev, 3, 0x5555);
+    timer_set_compare(dev, 4, 0xAAAA);
+    (dev->regs).gen->SR = 0;
+
+    this->base = 0;
+    this->last = 0;
+    this->indexPulses = 0;
+    encoders[this->timerNum] = this;
+    voidFuncPtr handler = encoder_irqs[this->timerNum];
+    timer_attach_interrupt(dev, TIMER_UPDATE_INTERRUPT, handler);
+    timer_attach_interrupt(dev, TIMER_CC3_INTERRUPT, handler);
+    timer_attach_interrupt(dev, TIMER_CC4_INTERRUPT, handler);
+    timer_resume(dev);
+}
+
+void HardwareEncoder::end(void) {
+    this->detachIndex();
+    timer_pause(this->dev);
+    timer_detach_interrupt(this->dev, TIMER_UPDATE_INTERRUPT);
+    timer_detach_interrupt(this->dev, TIMER_CC3_INTERRUPT);
+    timer_detach_interrupt(this->dev, TIMER_CC4_INTERRUPT);
+    timer_set_slave_mode(this->dev, TIMER_SMCR_TS_ITR0,
+                         TIMER_SMCR_SMS_DISABLED);
+    encoders[this->timerNum] = NULL;
+}
+
+void HardwareEncoder::setReverse(bool reverse) {
+    timer_cc_set_pol(this->dev, 1, reverse);
+}
+
+int32 HardwareEncoder::position(void) {
+    int32 base;
+    uint16 last, count;
+    do {
+        base = this->base;
+        last = this->last;
+        count = timer_get_count(this->dev);
+    } while (base != this->base || last != this->last);
+    return base + (int16)(count - last);
+}
+
+void HardwareEncoder::setPosition(int32 position) {
+    noInterrupts();
+    this->base = position;
+    this->last = timer_get_count(this->dev);
+    interrupts();
+}
+
+void HardwareEncoder::attachIndex(uint8 pin) {
+    this->detachIndex();
+    this->indexPulses = 0;
+    this->indexPin = pin;
+    attachInterrupt(pin, encoder_index, this, RISING);
+}
+
+void HardwareEncoder::detachIndex(void) {
+    if (this->indexPin != NO_INDEX) {
+        detachInterrupt(this->indexPin);
+        this->indexPin = NO_INDEX;
+    }
+}
+
+float HardwareEncoder::velocity(void) {
+    noInterrupts();
+    uint32 pulses = this->indexPulses;
+    int32 counts = this->indexCounts;
+    uint32 us = this->indexMicros;
+    int32 pos = this->indexPos;
+    uint32 time = this->indexTime;
+    interrupts();
+
+    if (pulses < 2 || us == 0) {
+        return 0;
+    }
+    uint32 since = micros() - time;
+    if (since > us) {
+        counts = this->position() - pos;
+        us = since;
+    }
+    return (float)counts * 1000000.0f / (float)us;
+}
+
+/*
+ * Interrupt handlers
+ */
+
+void HardwareEncoder::checkpoint(void) {
+    // Readers at a higher priority must not see base and last
+    // half updated.
+    noInterrupts();
+    uint16 count = timer_get_count(this->dev);
+    this->base += (int16)(count - this->last);
+    this->last = count;
+    interrupts();
+}
+
+void HardwareEncoder::index(void) {
+    int32 pos = this->position();
+    uint32 now = micros();
+    if (this->indexPulses > 0) {
+        this->indexCounts = pos - this->indexPos;
+        this->indexMicros = now - this->indexTime;
+    }
+    this->indexPos = pos;
+    this->indexTime = now;
+    this->indexPulses++;
+}
@@ -130,6 +130,26 @@ void HardwareTimer::setCompare(int channel, uint16 val) {
     timer_set_compare(this->dev, (uint8)channel, min(val, ovf));
 }
 
+void HardwareTimer::setPWMInput(int channel) {
+    timer_set_reload(this->dev, 0xFFFF);
+    timer_set_pwm_input(this->dev, (uint8)channel, 0);
+}
+
+void HardwareTimer::setEncoderMode(uint32 mode, uint8 filter) {
+    timer_set_prescaler(this->dev, 0);
+    timer_set_reload(this->dev, 0xFFFF);
+    timer_set_encoder(this->dev, mode, filter);
+    timer_generate_update(this->dev);
+}
+
+void HardwareTimer::setOnePulse(int channel, uint16 delay, uint16 width) {
+    timer_set_one_pulse(this->dev, (uint8)channel, delay, width);
+}
+
+void HardwareTimer::setPulseTrigger(uint32 trigger) {
+    timer_set_slave_mode(this->dev, trigger, TIMER_SMCR_SMS_TRIGGER);
+}
+
 void HardwareTimer::attachInterrupt(int channel, voidFuncPtr handler) {
     timer_attach_interrupt(this->dev, (uint8)channel, handler);
 }
@@ -0,0 +1,165 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/ThreePhasePWM.cpp
+ * @brief Wirish three phase PWM implementation.
+ */
+
+#include <wirish/ThreePhasePWM.h>
+#include <wirish/HardwareTimer.h>
+#include <libmaple/gpio.h>
+#include <board/board.h>
+
+struct phase_pin {
+    gpio_dev* const *dev;
+    uint8 bit;
+};
+
+/* CH1, CH2, CH3, CH1N, CH2N, CH3N, BKIN */
+#define PHASE_PINS 7
+
+static const phase_pin timer1_pins[PHASE_PINS] = {
+    {&GPIOA, 8}, {&GPIOA, 9}, {&GPIOA, 10},
+    {&GPIOB, 13}, {&GPIOB, 14}, {&GPIOB, 15},
+    {&GPIOB, 12},
+};
+
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+static const phase_pin timer8_pins[PHASE_PINS] = {
+    {&GPIOC, 6}, {&GPIOC, 7}, {&GPIOC, 8},
+    {&GPIOA, 7}, {&GPIOB, 0}, {&GPIOB, 1},
+    {&GPIOA, 6},
+};
+#endif
+
+static const phase_pin* phase_pins(uint8 timerNum) {
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    if (timerNum == 8) return timer8_pins;
+#endif
+    return timer1_pins;
+}
+
+/*
+ * ThreePhasePWM routines
+ */
+
+ThreePhasePWM::ThreePhasePWM(uint8 timerNum) {
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    ASSERT(timerNum == 1 || timerNum == 8);
+#else
+    ASSERT(timerNum == 1);
+#endif
+    this->dev = HardwareTimer(timerNum).c_dev();
+    this->timerNum = timerNum;
+    this->ticks = 0;
+}
+
+uint16 ThreePhasePWM::begin(uint32 frequency, uint32 deadTimeNs,
+                            bool centerAligned) {
+    timer_dev *dev = this->dev;
+    timer_pause(dev);
+    timer_moe_disable(dev);
+
+    // A center-aligned period counts up to the reload value and back.
+    uint32 cycles = CYCLES_PER_MICROSECOND * 1000000 / frequency;
+    if (centerAligned) {
+        cycles /= 2;
+    }
+    uint32 prescaler = cycles / 65536 + 1;
+    uint32 top = cycles / prescaler;
+    timer_set_prescaler(dev, (uint16)(prescaler - 1));
+    timer_set_center_aligned(dev, centerAligned ? TIMER_CR1_CKD_CMS_CENTER1 :
+                                                  TIMER_CR1_CKD_CMS_EDGE);
+    this->ticks = top;
+    timer_set_reload(dev, centerAligned ? top : top - 1);
+    (dev->regs).adv->CR1 |= TIMER_CR1_ARPE;
+
+    // The dead time generator runs from the unprescaled clock.
+    timer_set_dead_time(dev, (deadTimeNs * CYCLES_PER_MICROSECOND + 999) /
+                             1000);
+    for (uint8 ch = 1; ch <= 3; ch++) {
+        timer_set_compare(dev, ch, 0);
+        timer_set_complementary_pwm(dev, ch);
+    }
+
+    const phase_pin *pins = phase_pins(this->timerNum);
+    for (uint32 i = 0; i < PHASE_PINS - 1; i++) {
+        gpio_set_mode(*pins[i].dev, pins[i].bit, GPIO_AF_OUTPUT_PP);
+    }
+
+    timer_generate_update(dev);
+    (dev->regs).adv->SR = 0;
+    timer_resume(dev);
+    return this->ticks;
+}
+
+void ThreePhasePWM::end(void) {
+    timer_moe_disable(this->dev);
+    timer_pause(this->dev);
+    this->detachBreakInterrupt();
+    timer_set_break(this->dev, 0);
+    for (uint8 ch = 1; ch <= 3; ch++) {
+        timer_cc_disable(this->dev, ch);
+        timer_ccn_disable(this->dev, ch);
+    }
+}
+
+void ThreePhasePWM::write(uint16 a, uint16 b, uint16 c) {
+    // UDIS holds off the update event, and with it the transfer of
+    // the preloaded compare values, until all three are written.
+    timer_dev *dev = this->dev;
+    *bb_perip(&(dev->regs).adv->CR1, TIMER_CR1_UDIS_BIT) = 1;
+    (dev->regs).adv->CCR1 = a;
+    (dev->regs).adv->CCR2 = b;
+    (dev->regs).adv->CCR3 = c;
+    *bb_perip(&(dev->regs).adv->CR1, TIMER_CR1_UDIS_BIT) = 0;
+}
+
+bool ThreePhasePWM::enabled(void) {
+    return *bb_perip(&(this->dev->regs).adv->BDTR, TIMER_BDTR_MOE_BIT);
+}
+
+void ThreePhasePWM::setBreak(bool enable, bool activeHigh, bool autoRestart) {
+    if (!enable) {
+        timer_set_break(this->dev, 0);
+        return;
+    }
+    const phase_pin *bkin = &phase_pins(this->timerNum)[PHASE_PINS - 1];
+    gpio_set_mode(*bkin->dev, bkin->bit,
+                  activeHigh ? GPIO_INPUT_PD : GPIO_INPUT_PU);
+    timer_set_break(this->dev, (TIMER_BDTR_BKE |
+                                (activeHigh ? TIMER_BDTR_BKP : 0) |
+                                (autoRestart ? TIMER_BDTR_AOE : 0)));
+}
+
+void ThreePhasePWM::attachBreakInterrupt(voidFuncPtr handler) {
+    timer_attach_interrupt(this->dev, TIMER_BREAK_INTERRUPT, handler);
+}
+
+void ThreePhasePWM::detachBreakInterrupt(void) {
+    timer_detach_interrupt(this->dev, TIMER_BREAK_INTERRUPT);
+}
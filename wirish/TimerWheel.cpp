@@ -0,0 +1,310 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/TimerWheel.cpp
+ * @brief Software timer wheel implementation.
+ */
+
+#include <wirish/TimerWheel.h>
+#include <wirish/HardwareTimer.h>
+#include <wirish/ext_interrupts.h> // for noInterrupts(), interrupts()
+#include <board/board.h>           // for CYCLES_PER_MICROSECOND
+
+/* Deadlines closer than this when the compare register is written
+ * are handled at once, rather than risking a missed match. */
+#define MIN_LEAD_US 4
+
+#define SLOT_MASK   (TIMER_WHEEL_SLOTS - 1)
+
+TimerWheel Timers;
+
+static void wheel_compare(void) {
+    Timers.run();
+}
+
+static void wheel_overflow(void) {
+    Timers.overflow();
+}
+
+/*
+ * Timeout and Ticker routines
+ */
+
+Timeout::Timeout(void) {
+    this->next = NULL;
+    this->pprev = NULL;
+    this->fn = NULL;
+    this->deadline = 0;
+    this->period = 0;
+    this->slot = 0;
+}
+
+Timeout::~Timeout(void) {
+    this->detach();
+}
+
+void Timeout::attach(voidFuncPtr fn, uint32 us) {
+    this->schedule(fn, us, 0);
+}
+
+void Timeout::detach(void) {
+    Timers.remove(this);
+}
+
+void Timeout::schedule(voidFuncPtr fn, uint32 us, uint32 period) {
+    Timers.remove(this);
+    this->fn = fn;
+    this->period = period;
+    Timers.add(this, us);
+}
+
+void Ticker::attach(voidFuncPtr fn, uint32 us) {
+    this->schedule(fn, us, us ? us : 1);
+}
+
+/*
+ * TimerWheel routines
+ */
+
+TimerWheel::TimerWheel(void) {
+    this->dev = NULL;
+    this->high = 0;
+    this->base = 0;
+    this->armed = 0;
+    this->armedValid = false;
+    for (uint32 level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        this->occupied[level] = 0;
+        for (uint32 s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+            this->slots[level][s] = NULL;
+        }
+    }
+}
+
+void TimerWheel::begin(uint8 timerNum) {
+    if (this->dev != NULL) {
+        return;
+    }
+    timer_dev *dev = HardwareTimer(timerNum).c_dev();
+    ASSERT(dev->type != TIMER_BASIC);
+
+    // Free-running microsecond counter. Channel 1 is a compare
+    // channel that never drives its pin.
+    timer_pause(dev);
+    timer_set_prescaler(dev, CYCLES_PER_MICROSECOND - 1);
+    timer_set_reload(dev, 0xFFFF);
+    timer_oc_set_mode(dev, 1, TIMER_OC_MODE_FROZEN, 0);
+    timer_generate_update(dev);
+    (dev->regs).gen->SR = ~TIMER_SR_UIF;
+
+    this->high = 0;
+    this->base = 0;
+    this->dev = dev;
+    timer_attach_interrupt(dev, TIMER_UPDATE_INTERRUPT, wheel_overflow);
+    timer_attach_interrupt(dev, TIMER_CC1_INTERRUPT, wheel_compare);
+    timer_resume(dev);
+}
+
+uint32 TimerWheel::micros(void) {
+    timer_gen_reg_map *regs = (this->dev->regs).gen;
+    uint32 high, count, sr;
+    do {
+        high = this->high;
+        count = regs->CNT;
+        sr = regs->SR;
+    } while (high != this->high);
+    // Count an overflow whose interrupt is still pending, if the
+    // counter was read after it.
+    if ((sr & TIMER_SR_UIF) && count < 0x8000) {
+        high += 0x10000;
+    }
+    return high | count;
+}
+
+void TimerWheel::add(Timeout *t, uint32 us) {
+    if (this->dev == NULL) {
+        this->begin(TIMER_WHEEL_DEFAULT_TIMER);
+    }
+    noInterrupts();
+    uint32 now = this->micros();
+    // run() only advances the wheel's time while timers are pending;
+    // after a long idle spell it could be over 2^31 us stale.
+    bool empty = true;
+    for (uint32 level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        empty = empty && this->occupied[level] == 0;
+    }
+    if (empty) {
+        this->base = now;
+    }
+    t->deadline = now + us;
+    this->insert(t);
+    bool earlier = (!this->armedValid ||
+                    (int32)(t->deadline - this->armed) < 0);
+    interrupts();
+    // Let the compare interrupt reprogram the compare register.
+    if (earlier) {
+        (this->dev->regs).gen->EGR = TIMER_EGR_CC1G;
+    }
+}
+
+void TimerWheel::remove(Timeout *t) {
+    noInterrupts();
+    if (t->pprev != NULL) {
+        this->unlink(t);
+    }
+    interrupts();
+}
+
+void TimerWheel::run(void) {
+    noInterrupts();
+    while (true) {
+        uint32 now = this->micros();
+        uint32 when, slot;
+        if (!this->next(&when, &slot)) {
+            this->base = now;
+            this->armedValid = false;
+            break;
+        }
+
+        if ((int32)(when - now) > 0) {
+            // Nothing is due. A deadline more than 65.5 ms away just
+            // causes early matches, which end up here again.
+            this->base = now;
+            timer_set_compare(this->dev, 1, (uint16)when);
+            this->armed = when;
+            this->armedValid = true;
+            if ((int32)(when - this->micros()) > MIN_LEAD_US) {
+                break;
+            }
+            continue;
+        }
+
+        this->base = when;
+        Timeout **head = &this->slots[0][0] + slot;
+        if (slot >= TIMER_WHEEL_SLOTS) {
+            // Entering a higher level slot's span: cascade its timers
+            // down to the levels below.
+            Timeout *t = *head;
+            *head = NULL;
+            this->occupied[slot / TIMER_WHEEL_SLOTS] &=
+                ~(1U << (slot & SLOT_MASK));
+            while (t != NULL) {
+                Timeout *next = t->next;
+                this->insert(t);
+                t = next;
+            }
+            continue;
+        }
+
+        // Every timer in a level 0 slot expires at exactly 'when'.
+        Timeout *t = *head;
+        this->unlink(t);
+        if (t->period) {
+            t->deadline += t->period;
+            this->insert(t);
+        }
+        voidFuncPtr fn = t->fn;
+        interrupts();
+        fn();
+        noInterrupts();
+    }
+    interrupts();
+}
+
+void TimerWheel::overflow(void) {
+    noInterrupts();
+    (this->dev->regs).gen->SR = ~TIMER_SR_UIF;
+    this->high += 0x10000;
+    bool missed = (this->armedValid &&
+                   (int32)(this->armed - this->micros()) <= 0);
+    interrupts();
+    // Recover from a compare match lost while its flag was cleared.
+    if (missed) {
+        (this->dev->regs).gen->EGR = TIMER_EGR_CC1G;
+    }
+}
+
+/*
+ * Private helpers
+ */
+
+/* Place a timer by the highest group of bits in which its deadline
+ * differs from the wheel's time. */
+void TimerWheel::insert(Timeout *t) {
+    if ((int32)(t->deadline - this->base) < 0) {
+        t->deadline = this->base;
+    }
+    uint32 diff = t->deadline ^ this->base;
+    uint32 level = diff ? (31 - __builtin_clz(diff)) / TIMER_WHEEL_BITS : 0;
+    uint32 s = (t->deadline >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+    Timeout **head = &this->slots[level][s];
+    t->next = *head;
+    if (t->next != NULL) {
+        t->next->pprev = &t->next;
+    }
+    t->pprev = head;
+    *head = t;
+    t->slot = (uint16)(level * TIMER_WHEEL_SLOTS + s);
+    this->occupied[level] |= 1U << s;
+}
+
+void TimerWheel::unlink(Timeout *t) {
+    *t->pprev = t->next;
+    if (t->next != NULL) {
+        t->next->pprev = t->pprev;
+    }
+    t->pprev = NULL;
+    if (*(&this->slots[0][0] + t->slot) == NULL) {
+        this->occupied[t->slot / TIMER_WHEEL_SLOTS] &=
+            ~(1U << (t->slot & SLOT_MASK));
+    }
+}
+
+/* Find the earliest occupied slot, and the earliest time any timer in
+ * it can expire. The lowest occupied level always holds the earliest
+ * deadline. Only the top level can hold deadlines past a wraparound,
+ * in slots before the wheel's own. */
+bool TimerWheel::next(uint32 *when, uint32 *slot) {
+    for (uint32 level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32 bits = this->occupied[level];
+        if (bits == 0) {
+            continue;
+        }
+        uint32 shift = level * TIMER_WHEEL_BITS;
+        uint32 span = shift + TIMER_WHEEL_BITS;
+        uint32 index = (this->base >> shift) & SLOT_MASK;
+        uint32 later = bits & (~0U << index);
+        uint32 s = __builtin_ctz(later ? later : bits);
+        uint32 above = span >= 32 ? 0 : ~((1U << span) - 1);
+        *when = (this->base & above) | (s << shift);
+        if (later == 0 && span < 32) {
+            *when += 1U << span;
+        }
+        *slot = level * TIMER_WHEEL_SLOTS + s;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/ChainedTimer.h
+ * @brief 32 and 64 bit timestamp counter built from two 16 bit timers.
+ */
+
+#ifndef _WIRISH_CHAINEDTIMER_H_
+#define _WIRISH_CHAINEDTIMER_H_
+
+#include <libmaple/timer.h>
+
+/**
+ * Master counts below which cycles() rereads the counters, as the
+ * slave only sees the master's overflow after a few clock cycles.
+ */
+#define CHAINED_TIMER_SYNC_TICKS 8
+
+/**
+ * @brief Free-running CPU cycle counter made of two chained timers.
+ *
+ * The master timer counts every timer clock cycle, and its update
+ * event clocks the slave through the internal trigger connection, so
+ * the pair forms a 32 bit counter that wraps every 59.6 seconds at
+ * 72 MHz. An overflow interrupt on the slave extends this to 64 bits.
+ *
+ * Reads take no locks and disable no interrupts, so they are safe
+ * and cheap in interrupt handlers; that makes this suitable for
+ * timestamping events, where micros() costs a division and wraps
+ * every 71.6 minutes.
+ *
+ * Only one ChainedTimer can run at a time. Both timers are taken over
+ * completely.
+ */
+class ChainedTimer {
+public:
+    /**
+     * @brief Construct a counter on a pair of timers.
+     * @param masterNum Number of the timer counting clock cycles.
+     * @param slaveNum Number of the timer counting its overflows.
+     */
+    ChainedTimer(uint8 masterNum, uint8 slaveNum);
+
+    /**
+     * @brief Reset the counter to zero and start it.
+     * @return true on success, false if the slave has no internal
+     *         trigger connection from the master.
+     */
+    bool begin(void);
+
+    /**
+     * @brief Stop the counter.
+     */
+    void end(void);
+
+    /**
+     * @brief Timer clock cycles since begin(), modulo 2^32.
+     */
+    uint32 cycles(void) {
+        uint32 high, low;
+        do {
+            high = this->slaveRegs->CNT;
+            low = this->masterRegs->CNT;
+        } while (high != this->slaveRegs->CNT ||
+                 low < CHAINED_TIMER_SYNC_TICKS);
+        return (high << 16) | low;
+    }
+
+    /**
+     * @brief Timer clock cycles since begin().
+     */
+    uint64 cycles64(void);
+
+    /**
+     * @brief Microseconds since begin().
+     *
+     * Exact, with no 64 bit division.
+     */
+    uint64 micros64(void);
+
+    /* Not for users */
+    void overflow(void);
+
+private:
+    uint8 masterNum;
+    uint8 slaveNum;
+    timer_dev *master;
+    timer_dev *slave;
+    timer_gen_reg_map *masterRegs;
+    timer_gen_reg_map *slaveRegs;
+    volatile uint32 epoch;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/FastAnalog.h
+ * @brief Low overhead repeated analog reads of one pin.
+ */
+
+#ifndef _WIRISH_FASTANALOG_H_
+#define _WIRISH_FASTANALOG_H_
+
+#include <libmaple/adc.h>
+
+/**
+ * @brief Handle for fast analog reads of one pin.
+ *
+ * analogRead() looks the pin up in PIN_MAP and reprograms the ADC's
+ * regular sequence on every call. A FastAnalog looks the pin up once,
+ * and read() only rewrites the sequence and sample time registers
+ * when something else (such as analogRead() of another pin on the
+ * same ADC) has changed them, so reading the same pin in a loop
+ * costs little more than the conversion itself.
+ *
+ * As with analogRead(), the pin's mode must already be INPUT_ANALOG,
+ * and the ADC must not be streaming (see HardwareADC).
+ */
+class FastAnalog {
+public:
+    /**
+     * @brief Set up a handle for a pin.
+     *
+     * The pin uses whatever sample time its channel already has.
+     *
+     * @param pin Pin to read. If it has no ADC channel, read() always
+     *            returns 0.
+     */
+    FastAnalog(uint8 pin);
+
+    /**
+     * @brief Set up a handle for a pin, with its own sample time.
+     *
+     * Short sample times convert faster; long ones suit sources with
+     * a high output impedance. The sample time is per ADC channel, so
+     * it also applies to analogRead() of this pin.
+     *
+     * @param pin Pin to read.
+     * @param smp_rate Sample time to use for this pin.
+     */
+    FastAnalog(uint8 pin, adc_smp_rate smp_rate);
+
+    /**
+     * @brief Change the pin's sample time.
+     * @param smp_rate New sample time.
+     */
+    void setSampleRate(adc_smp_rate smp_rate);
+
+    /**
+     * @brief Convert the pin once and return the result.
+     * @return Conversion result, from 0 to 4095.
+     */
+    uint16 read(void) {
+        adc_reg_map *regs = this->regs;
+        if (regs == NULL) {
+            return 0;
+        }
+        if (regs->SQR3 != this->channel || (regs->SQR1 & ADC_SQR1_L)) {
+            regs->SQR1 &= ~ADC_SQR1_L;
+            regs->SQR3 = this->channel;
+        }
+        if ((*this->smpr & this->smprMask) != this->smprBits) {
+            *this->smpr = (*this->smpr & ~this->smprMask) | this->smprBits;
+        }
+        regs->CR2 |= ADC_CR2_SWSTART;
+        while (!(regs->SR & ADC_SR_EOC))
+            ;
+        return (uint16)(regs->DR & ADC_DR_DATA);
+    }
+
+    /**
+     * @brief Get the ADC device this pin is read with.
+     * @return The pin's ADC, or NULL if it has none.
+     */
+    const adc_dev* c_dev(void) { return this->dev; }
+
+private:
+    const adc_dev *dev;
+    adc_reg_map *regs;
+    uint8 channel;
+    __io uint32 *smpr;
+    uint32 smprMask;
+    uint32 smprBits;
+
+    void init(uint8 pin);
+};
+
+#endif
@@ -0,0 +1,298 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/HardwareADC.h
+ * @brief Wirish ADC streaming interface
+ *
+ * Hardware paced multichannel sampling: a timer event triggers a scan
+ * of a channel sequence, and DMA stores the results in a circular
+ * buffer.
+ */
+
+#ifndef _WIRISH_HARDWAREADC_H_
+#define _WIRISH_HARDWAREADC_H_
+
+#include <libmaple/adc.h>
+#include <libmaple/dma.h>
+
+#include <wirish/boards.h>
+
+/** Longest regular sequence the ADC can scan. */
+static const uint8 ADC_MAX_SEQUENCE = 16;
+
+/** Longest injected sequence the ADC can scan. */
+static const uint8 ADC_MAX_INJECTED = 4;
+
+/**
+ * @brief ADC stream callback.
+ *
+ * Called from the DMA interrupt with the half of the stream buffer
+ * that was just filled, while DMA fills the other half.
+ *
+ * @param samples First sample of the completed half buffer.
+ * @param count Number of samples in the half buffer; always a whole
+ *              number of scans.
+ */
+typedef void (*ADCCallback)(uint16 *samples, uint32 count);
+
+/**
+ * @brief Dual ADC stream callback.
+ *
+ * Like ADCCallback, but each sample holds an ADC1 result in its lower
+ * half-word and the simultaneous ADC2 result in its upper half-word.
+ *
+ * @see HardwareADC::startDual()
+ */
+typedef void (*ADCDualCallback)(uint32 *samples, uint32 count);
+
+/**
+ * @brief Injected conversion callback.
+ *
+ * Called from the ADC interrupt when an injected sequence completes.
+ *
+ * @param results Result of each injected channel, in sequence order.
+ * @param count Number of results.
+ * @see HardwareADC::startInjected()
+ */
+typedef void (*ADCInjectedCallback)(const uint16 *results, uint8 count);
+
+/**
+ * @brief Wirish ADC streaming interface.
+ *
+ * Conversions are started by hardware (usually a timer TRGO or
+ * compare event, see adc_extsel_event), and each conversion is moved
+ * to memory by DMA, so there is no CPU cost per sample. Only ADC1 and
+ * ADC3 can stream; ADC3 is only available on high-density devices.
+ *
+ * ADC1 can also stream in dual regular simultaneous mode, where ADC2
+ * converts a second sequence in lockstep with it.
+ *
+ * Independently of streaming, every ADC can run a short injected
+ * sequence on its own trigger. Injected conversions preempt the
+ * regular sequence, which resumes where it left off, so they suit
+ * measurements which must be taken at a precise instant, e.g. motor
+ * phase currents in the middle of a PWM period.
+ *
+ * While streaming, analogRead() must not be used on the streaming
+ * ADCs.
+ */
+class HardwareADC {
+public:
+    /**
+     * @brief Construct a new HardwareADC instance.
+     * @param adcNum number of the ADC to control, from 1 to 3.
+     */
+    HardwareADC(uint8 adcNum);
+
+    /*
+     * Configuration
+     */
+
+    /**
+     * @brief Set the pins to convert on each trigger.
+     *
+     * The pins must already be in INPUT_ANALOG mode, and be inputs
+     * of this ADC (ADC2 shares the pins of ADC1). The stream
+     * buffer is interleaved: it holds a sample of each pin in turn,
+     * in the order given here.
+     *
+     * @param pins Pins to scan, in conversion order.
+     * @param count Number of pins, from 1 to ADC_MAX_SEQUENCE.
+     * @return true on success, false if a pin is not an input of
+     *         this ADC.
+     */
+    bool setSequence(const uint8 *pins, uint8 count);
+
+    /**
+     * @brief Set the pins ADC2 converts in dual mode.
+     *
+     * In dual regular simultaneous mode, slavePins[i] is sampled by
+     * ADC2 at the same instant ADC1 samples the i-th pin given to
+     * setSequence(). Both sequences must have the same length, and
+     * the same pin must not appear at the same position in both.
+     *
+     * Only valid on ADC1.
+     *
+     * @param slavePins Pins for ADC2, in conversion order.
+     * @param count Number of pins; must match setSequence().
+     * @return true on success, false on an invalid pin or count.
+     * @see HardwareADC::startDual()
+     */
+    bool setDualSequence(const uint8 *slavePins, uint8 count);
+
+    /**
+     * @brief Set the sample time for all channels of this ADC.
+     *
+     * A scan of n channels takes n * (sample time + 12.5) ADC clock
+     * cycles, which bounds the trigger rate.
+     *
+     * @param rate Sample time to use.
+     */
+    void setSampleRate(adc_smp_rate rate);
+
+    /**
+     * @brief Set the event which starts each scan.
+     *
+     * The default, ADC_EXT_EV_SWSTART, converts continuously at the
+     * highest rate allowed by the sample time.
+     *
+     * @param event Trigger event.
+     * @see timer_set_master_mode()
+     */
+    void setTrigger(adc_extsel_event event);
+
+    /*
+     * Streaming
+     */
+
+    /**
+     * @brief Start streaming conversions into a circular buffer.
+     *
+     * @param buffer Buffer to fill.
+     * @param count Buffer length in samples, at most 65,535. It must
+     *              be a multiple of twice the sequence length, so
+     *              that each half holds whole scans.
+     * @param callback Called when each half of the buffer is full.
+     * @return true on success, false if the configuration is invalid.
+     */
+    bool start(uint16 *buffer, uint32 count, ADCCallback callback);
+
+    /**
+     * @brief Start streaming in dual regular simultaneous mode.
+     *
+     * Each trigger scans ADC1's sequence and ADC2's dual sequence in
+     * lockstep, and ADC1's DMA stores both results of each pair in
+     * one word. ADC2 uses ADC1's sample times.
+     *
+     * Only valid on ADC1.
+     *
+     * @param buffer Buffer to fill.
+     * @param count Buffer length in samples; as for start().
+     * @param callback Called when each half of the buffer is full.
+     * @return true on success, false if the configuration is invalid.
+     * @see HardwareADC::setDualSequence()
+     */
+    bool startDual(uint32 *buffer, uint32 count, ADCDualCallback callback);
+
+    /**
+     * @brief Stop streaming, and restore the ADCs for analogRead().
+     */
+    void stop(void);
+
+    /*
+     * Injected conversions
+     */
+
+    /**
+     * @brief Set the pins of the injected sequence.
+     *
+     * The pins must already be in INPUT_ANALOG mode, and be inputs of
+     * this ADC.
+     *
+     * @param pins Pins to convert, in conversion order.
+     * @param count Number of pins, from 1 to ADC_MAX_INJECTED.
+     * @return true on success, false if a pin is not an input of this
+     *         ADC.
+     */
+    bool setInjectedSequence(const uint8 *pins, uint8 count);
+
+    /**
+     * @brief Start converting the injected sequence on each trigger.
+     *
+     * For a timer compare trigger (e.g. ADC_JEXT_EV_TIM1_CC4), set the
+     * channel to an output compare or PWM mode; the compare value
+     * sets the sampling instant within each timer period.
+     *
+     * With ADC_JEXT_EV_JSWSTART, each sequence is started by setting
+     * ADC_CR2_JSWSTART in the ADC's CR2 register.
+     *
+     * @param event Trigger event.
+     * @param callback Called with all results when the sequence ends.
+     * @return true on success, false if no sequence is set.
+     */
+    bool startInjected(adc_jextsel_event event,
+                       ADCInjectedCallback callback);
+
+    /**
+     * @brief Stop injected conversions.
+     */
+    void stopInjected(void);
+
+    /**
+     * @brief Get the index of the next sample DMA will write.
+     */
+    uint32 position(void);
+
+    /**
+     * @brief Handle a DMA interrupt for this stream.
+     *
+     * Called from the DMA interrupt handler; not for users.
+     */
+    void handleDMA(void);
+
+    /**
+     * @brief Handle an end of injected conversion interrupt.
+     *
+     * Called from the ADC interrupt handler; not for users.
+     */
+    void handleInjected(void);
+
+    /* Escape hatch */
+
+    /**
+     * @brief Get a pointer to the underlying libmaple adc_dev for
+     *        this HardwareADC instance.
+     */
+    const adc_dev* c_dev(void) { return this->dev; }
+
+private:
+    const adc_dev *dev;
+    dma_dev *dmaDev;
+    dma_tube dmaTube;
+    dma_request_src dmaSrc;
+    adc_extsel_event trigger;
+    uint8 channels[ADC_MAX_SEQUENCE];
+    uint8 slaveChannels[ADC_MAX_SEQUENCE];
+    uint8 injectedChannels[ADC_MAX_INJECTED];
+    uint8 length;
+    uint8 slaveLength;
+    uint8 injectedLength;
+    bool injected;
+    bool dual;
+    void *buffer;
+    uint32 count;
+    ADCCallback callback;
+    ADCDualCallback dualCallback;
+    ADCInjectedCallback injectedCallback;
+
+    bool channel(uint8 pin, const adc_dev *adc, uint8 *channel);
+    void configure(const adc_dev *adc, const uint8 *channels);
+    void updateScan(void);
+    bool stream(void *buffer, uint32 count, dma_xfer_size size);
+};
+
+#endif
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/HardwareCapture.h
+ * @brief Wirish input capture interface
+ *
+ * Period, pulse width and frequency measurement with a timer's input
+ * capture channels, without per-edge interrupts.
+ */
+
+#ifndef _WIRISH_HARDWARECAPTURE_H_
+#define _WIRISH_HARDWARECAPTURE_H_
+
+#include <libmaple/dma.h>
+#include <libmaple/timer.h>
+
+/**
+ * @brief Wirish input capture interface.
+ *
+ * Two ways of measuring are available:
+ *
+ * - PWM input (beginPWM()): the timer restarts on each rising edge of
+ *   the signal and latches its period and high time, so both are
+ *   always up to date with no CPU involvement. Only channels 1 and 2
+ *   can do this, and the timer is used up.
+ *
+ * - Edge timestamps (beginEdges()): the free running counter value at
+ *   each edge is copied by DMA into a ring buffer, and the average
+ *   period over the ring is computed when asked for. This suits
+ *   tachometers and other signals where averaging reduces jitter.
+ *
+ * All times are in timer ticks; see getTickRate(). Periods must be
+ * shorter than 65,536 ticks, so lower the tick rate with
+ * setPrescaleFactor() for slow signals. When the signal stops, the
+ * last measurements remain.
+ *
+ * The channel's pin must be set to an input mode first.
+ */
+class HardwareCapture {
+public:
+    /**
+     * @brief Construct a new HardwareCapture instance.
+     * @param timerNum number of the timer to use; it must not be a
+     *                 basic timer.
+     */
+    HardwareCapture(uint8 timerNum);
+
+    /**
+     * @brief Set the timer's prescale factor.
+     *
+     * Takes effect at the next beginPWM() or beginEdges().
+     *
+     * @param factor Prescale factor, from 1 (the default) to 65,536.
+     */
+    void setPrescaleFactor(uint32 factor);
+
+    /**
+     * @brief Get the number of timer ticks per second.
+     */
+    uint32 getTickRate(void);
+
+    /**
+     * @brief Start measuring a PWM signal.
+     * @param channel Channel whose pin carries the signal, 1 or 2.
+     * @return true on success, false for an invalid channel.
+     * @see timer_set_pwm_input()
+     */
+    bool beginPWM(uint8 channel);
+
+    /**
+     * @brief Start recording edge timestamps into a ring buffer.
+     *
+     * @param channel Channel whose pin carries the signal, 1 to 4.
+     * @param ring Ring buffer for the timestamps.
+     * @param count Ring length, from 3 to 65,535. The average period
+     *              is taken over the last count - 2 periods.
+     * @param falling If true, capture falling edges, else rising ones.
+     * @return true on success, false if the channel has no DMA
+     *         request or the configuration is invalid.
+     */
+    bool beginEdges(uint8 channel, uint16 *ring, uint32 count,
+                    bool falling = false);
+
+    /**
+     * @brief Stop measuring.
+     */
+    void end(void);
+
+    /**
+     * @brief Get the signal's period, in timer ticks.
+     * @return The last period (PWM input) or the average period (edge
+     *         timestamps), or 0 if none has been seen yet.
+     */
+    uint32 period(void);
+
+    /**
+     * @brief Get the signal's high time, in timer ticks.
+     * @return The last high time, or 0 if not measuring a PWM input.
+     */
+    uint32 pulseWidth(void);
+
+    /**
+     * @brief Get the signal's frequency, in Hz.
+     * @return Frequency, or 0 if no period has been seen yet.
+     */
+    float frequency(void);
+
+    /**
+     * @brief Get the signal's duty cycle.
+     * @return Fraction of each period the signal is high, from 0 to
+     *         1, or 0 if not measuring a PWM input.
+     */
+    float duty(void);
+
+    /**
+     * @brief Get the index of the next timestamp DMA will write.
+     */
+    uint32 position(void);
+
+    /* Escape hatch */
+
+    /**
+     * @brief Get a pointer to the underlying libmaple timer_dev for
+     *        this HardwareCapture instance.
+     */
+    timer_dev* c_dev(void) { return this->dev; }
+
+private:
+    timer_dev *dev;
+    uint16 prescaler;
+    uint8 channel;
+    uint8 mode;
+    dma_dev *dmaDev;
+    dma_tube dmaTube;
+    uint16 *ring;
+    uint32 count;
+
+    void start(void);
+    uint32 intervals(uint32 *sum);
+};
+
+#endif
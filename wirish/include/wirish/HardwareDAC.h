@@ -0,0 +1,179 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/HardwareDAC.h
+ * @brief Wirish DAC waveform player
+ *
+ * A basic timer's update event paces the DAC, and DMA feeds it
+ * samples from a circular buffer.
+ */
+
+#ifndef _WIRISH_HARDWAREDAC_H_
+#define _WIRISH_HARDWAREDAC_H_
+
+#include <libmaple/dac.h>
+#include <libmaple/dma.h>
+#include <libmaple/timer.h>
+
+#if STM32_HAVE_DAC
+
+/**
+ * @brief DAC waveform callback.
+ *
+ * Called from the DMA interrupt with the half of the waveform buffer
+ * that was just played, while DMA plays the other half. Refill it to
+ * play a continuous stream.
+ *
+ * @param samples First sample of the finished half buffer.
+ * @param count Number of samples in the half buffer.
+ */
+typedef void (*DACCallback)(uint16 *samples, uint32 count);
+
+/**
+ * @brief Dual channel DAC waveform callback.
+ *
+ * Like DACCallback, but each sample holds a channel 1 value in its
+ * lower half-word and the channel 2 value in its upper half-word.
+ *
+ * @see HardwareDAC::startDual()
+ */
+typedef void (*DACDualCallback)(uint32 *samples, uint32 count);
+
+/**
+ * @brief Wirish DAC waveform player.
+ *
+ * Each update event of a basic timer (timer 6 or 7) makes the DAC
+ * output the next sample, and DMA moves the following sample into
+ * the DAC's data holding register, so there is no CPU cost per
+ * sample. Sample rates of several hundred kHz are possible.
+ *
+ * Channel 1 outputs on PA4 and channel 2 on PA5. Two players may play
+ * one channel each, on different timers; a single player can also
+ * play both channels in step with startDual().
+ *
+ * Channel 1 samples move on DMA2 channel 3 and channel 2 samples on
+ * DMA2 channel 4. Value line parts without DMA2 use DMA1 channels 3
+ * and 4 instead, which SPI1 TX and USART1 TX also use.
+ */
+class HardwareDAC {
+public:
+    /**
+     * @brief Construct a new HardwareDAC instance.
+     *
+     * The sample rate starts at 44.1 kHz.
+     *
+     * @param timerNum basic timer which paces the samples, 6 or 7.
+     */
+    HardwareDAC(uint8 timerNum = 6);
+
+    /**
+     * @brief Set the sample rate.
+     *
+     * Takes effect at the next start().
+     *
+     * @param hz Samples per second.
+     * @return The closest rate the timer can generate.
+     */
+    uint32 setSampleRate(uint32 hz);
+
+    /**
+     * @brief Start playing a circular buffer on one channel.
+     *
+     * The buffer repeats until stop(). Without a callback, it plays
+     * a fixed waveform with no interrupts at all.
+     *
+     * @param channel DAC channel, 1 or 2.
+     * @param buffer 12-bit right aligned samples.
+     * @param count Buffer length in samples, an even number from 2 to
+     *              65,534.
+     * @param callback Called when each half of the buffer has played,
+     *                 or NULL.
+     * @return true on success, false if the configuration is invalid.
+     */
+    bool start(uint8 channel, uint16 *buffer, uint32 count,
+               DACCallback callback = NULL);
+
+    /**
+     * @brief Start playing a circular buffer on both channels.
+     *
+     * Both channels update on the same timer event, through the dual
+     * channel data holding register.
+     *
+     * @param buffer Samples, channel 2 in the upper half-word.
+     * @param count Buffer length in samples; as for start().
+     * @param callback Called when each half of the buffer has played,
+     *                 or NULL.
+     * @return true on success, false if the configuration is invalid.
+     */
+    bool startDual(uint32 *buffer, uint32 count,
+                   DACDualCallback callback = NULL);
+
+    /**
+     * @brief Stop playing. The outputs hold their last values.
+     */
+    void stop(void);
+
+    /**
+     * @brief Get the index of the next sample DMA will read.
+     */
+    uint32 position(void);
+
+    /**
+     * @brief Handle a DMA interrupt for this player.
+     *
+     * Called from the DMA interrupt handler; not for users.
+     */
+    void handleDMA(void);
+
+    /* Escape hatch */
+
+    /**
+     * @brief Get a pointer to the underlying libmaple timer_dev which
+     *        paces this HardwareDAC instance.
+     */
+    timer_dev* c_timer(void) { return this->timer; }
+
+private:
+    timer_dev *timer;
+    dac_trigger trigger;
+    uint16 prescaler;
+    uint16 reload;
+    uint8 channel;
+    dma_dev *dmaDev;
+    dma_tube dmaTube;
+    void *buffer;
+    uint32 count;
+    DACCallback callback;
+    DACDualCallback dualCallback;
+
+    bool play(uint8 channel, void *buffer, uint32 count,
+              __io uint32 *dhr, dma_xfer_size size, bool irq);
+};
+
+#endif
+
+#endif
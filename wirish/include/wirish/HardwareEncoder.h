@@ -0,0 +1,149 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/HardwareEncoder.h
+ * @brief Wirish quadrature encoder interface
+ *
+ * Counts a quadrature encoder in a timer's encoder mode, extending
+ * its 16 bit counter to a 32 bit position.
+ */
+
+#ifndef _WIRISH_HARDWAREENCODER_H_
+#define _WIRISH_HARDWAREENCODER_H_
+
+#include <libmaple/timer.h>
+
+/**
+ * @brief Wirish quadrature encoder interface.
+ *
+ * The timer counts every edge in hardware, whatever the rate, and
+ * only interrupts the CPU three times per 65,536 counts (when the
+ * counter wraps, and when it passes two compare values on channels 3
+ * and 4), to fold the counter into a 32 bit position. Reading the
+ * position never blocks interrupts.
+ *
+ * An optional index (once per revolution) pulse gives a velocity
+ * estimate: the position is captured on each index pulse, and the
+ * velocity is the distance between the last two captures divided by
+ * the time between them.
+ *
+ * The encoder's A and B outputs go to the pins of the timer's
+ * channels 1 and 2, which must be set to an input mode first. The
+ * timer is used up, including channels 3 and 4.
+ */
+class HardwareEncoder {
+public:
+    /**
+     * @brief Construct a new HardwareEncoder instance.
+     * @param timerNum number of the timer to use; it must be a
+     *                 general purpose or advanced timer.
+     */
+    HardwareEncoder(uint8 timerNum);
+
+    /**
+     * @brief Start counting, from position 0.
+     * @param mode TIMER_SMCR_SMS_ENCODER3 to count every edge of both
+     *             inputs (four counts per encoder cycle), or
+     *             TIMER_SMCR_SMS_ENCODER1 or TIMER_SMCR_SMS_ENCODER2
+     *             to count the edges of one.
+     * @param filter Input filter, from 0 (none) to 15; raise it for
+     *               noisy or bouncing inputs.
+     * @see timer_set_encoder()
+     */
+    void begin(uint32 mode = TIMER_SMCR_SMS_ENCODER3, uint8 filter = 0);
+
+    /**
+     * @brief Stop counting, and detach the index pin if any.
+     */
+    void end(void);
+
+    /**
+     * @brief Swap the counting direction.
+     */
+    void setReverse(bool reverse);
+
+    /**
+     * @brief Current position, in counts.
+     */
+    int32 position(void);
+
+    /**
+     * @brief Set the current position.
+     */
+    void setPosition(int32 position);
+
+    /**
+     * @brief Capture the position on each rising edge of an index pin.
+     *
+     * The pin must be set to an input mode first.
+     */
+    void attachIndex(uint8 pin);
+
+    /**
+     * @brief Stop capturing the position on index pulses.
+     */
+    void detachIndex(void);
+
+    /**
+     * @brief Position at the last index pulse.
+     */
+    int32 indexPosition(void) { return this->indexPos; }
+
+    /**
+     * @brief Velocity estimate, in counts per second.
+     *
+     * Computed from the last two index pulses. If the time since the
+     * last index pulse is already longer than the time between the
+     * last two, the estimate uses the distance travelled since the
+     * last pulse instead, so it falls towards zero when the encoder
+     * stops. Returns 0 until two index pulses have been seen.
+     */
+    float velocity(void);
+
+    /**
+     * @brief Get a pointer to the underlying libmaple timer_dev.
+     */
+    timer_dev* c_dev(void) { return this->dev; }
+
+    /* Not for users */
+    void checkpoint(void);
+    void index(void);
+
+private:
+    timer_dev *dev;
+    uint8 timerNum;
+    uint8 indexPin;
+    volatile int32 base;
+    volatile uint16 last;
+    volatile int32 indexPos;
+    volatile uint32 indexTime;
+    volatile int32 indexCounts;
+    volatile uint32 indexMicros;
+    volatile uint32 indexPulses;
+};
+
+#endif
@@ -167,6 +167,82 @@ public:
      */
     void setCompare(int channel, uint16 compare);
 
+    /**
+     * @brief Measure a PWM signal with channels 1 and 2.
+     *
+     * The signal goes to the pin of the given channel, which must be
+     * an input. The counter restarts on each of its rising edges, and
+     * from then on getCompare(channel) returns its period and
+     * getCompare() of the other channel returns its high time, in
+     * timer ticks, with no CPU time spent per edge.
+     *
+     * Sets the overflow to its maximum; choose the prescale factor so
+     * the longest period to measure fits.
+     *
+     * @param channel Channel whose pin carries the signal, 1 or 2.
+     * @see timer_set_pwm_input()
+     */
+    void setPWMInput(int channel);
+
+    /**
+     * @brief Count a quadrature encoder on channels 1 and 2.
+     *
+     * The encoder's A and B outputs go to the pins of channels 1 and
+     * 2, which must be inputs. The counter then follows the encoder's
+     * position in hardware, wrapping between 0 and 0xFFFF. For a
+     * position beyond 16 bits, see HardwareEncoder.
+     *
+     * Sets the overflow to its maximum and the prescale factor to 1,
+     * and resets the count to 0.
+     *
+     * @param mode TIMER_SMCR_SMS_ENCODER3 to count every edge of both
+     *             inputs, or TIMER_SMCR_SMS_ENCODER1 or
+     *             TIMER_SMCR_SMS_ENCODER2 to count the edges of one.
+     * @param filter Input filter, from 0 (none) to 15.
+     * @see timer_set_encoder()
+     */
+    void setEncoderMode(uint32 mode = TIMER_SMCR_SMS_ENCODER3,
+                        uint8 filter = 0);
+
+    /**
+     * @brief Produce single pulses of exact delay and width.
+     *
+     * Pauses the timer and puts it in one pulse mode. Each later
+     * triggerPulse() (or trigger set with setPulseTrigger()) makes the
+     * channel's pin go high 'delay' ticks afterwards, for 'width'
+     * ticks, timed entirely by the timer. The pin must be in PWM mode.
+     *
+     * Ticks are at the rate set by the prescale factor; delay + width
+     * may be at most 65,536.
+     *
+     * @param channel Output channel.
+     * @param delay Ticks from the trigger to the pulse, at least 1.
+     * @param width Pulse width in ticks, at least 1.
+     * @see timer_set_one_pulse()
+     */
+    void setOnePulse(int channel, uint16 delay, uint16 width);
+
+    /**
+     * @brief Start a pulse set up with setOnePulse().
+     *
+     * Has no effect while a pulse is in progress.
+     */
+    void triggerPulse(void) { this->resume(); }
+
+    /**
+     * @brief Start pulses from a hardware trigger.
+     *
+     * Use TIMER_SMCR_TS_TI1FP1 or TIMER_SMCR_TS_TI2FP2 for rising
+     * edges on the pin of channel 1 or 2, which must be in
+     * TIMER_INPUT_CAPTURE mode; TIMER_SMCR_TS_ETRF for the external
+     * trigger pin; or TIMER_SMCR_TS_ITR0 to ITR3 for another timer's
+     * trigger output (see timer_set_master_mode() and the internal
+     * trigger connection table in your reference manual).
+     *
+     * @param trigger One of the TIMER_SMCR_TS_* values.
+     */
+    void setPulseTrigger(uint32 trigger);
+
     /**
      * @brief Attach an interrupt handler to the given channel.
      *
@@ -0,0 +1,161 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/ThreePhasePWM.h
+ * @brief Wirish three phase PWM interface
+ *
+ * Drives the three half-bridges of a motor inverter from an advanced
+ * timer's complementary outputs, with dead time and a break input.
+ */
+
+#ifndef _WIRISH_THREEPHASEPWM_H_
+#define _WIRISH_THREEPHASEPWM_H_
+
+#include <libmaple/timer.h>
+
+/**
+ * @brief Wirish three phase PWM interface.
+ *
+ * Channels 1 to 3 of timer 1 or 8 each drive one half-bridge: CHx
+ * the high side switch and CHxN the low side switch, with dead time
+ * inserted between them in hardware.
+ *
+ * The duty cycle registers are preloaded, so new duty cycles only
+ * take effect at an update event, and write() holds update events
+ * off while it writes all three, so the phases never run with a mix
+ * of old and new duty cycles.
+ *
+ * The break input (BKIN), when enabled, turns all six outputs off in
+ * hardware as soon as it goes active, e.g. on an overcurrent
+ * comparator output, without waiting for the CPU.
+ *
+ * Timer 1 uses pins PA8, PA9 and PA10 (CH1 to CH3), PB13, PB14 and
+ * PB15 (CH1N to CH3N), and PB12 (BKIN). Timer 8 uses PC6, PC7 and
+ * PC8, PA7, PB0 and PB1, and PA6.
+ */
+class ThreePhasePWM {
+public:
+    /**
+     * @brief Construct a new ThreePhasePWM instance.
+     * @param timerNum number of the advanced timer to use, 1 or 8.
+     */
+    ThreePhasePWM(uint8 timerNum);
+
+    /**
+     * @brief Configure the timer and its pins, with all outputs off.
+     *
+     * Call enable() afterwards to start driving the outputs.
+     *
+     * @param frequency PWM frequency, in Hz.
+     * @param deadTimeNs Dead time, in nanoseconds, rounded up to the
+     *                   hardware's resolution; at most about 14 us.
+     * @param centerAligned true for center-aligned PWM, where the
+     *                      three phases switch symmetrically about
+     *                      the middle of each period; false for
+     *                      edge-aligned PWM.
+     * @return The PWM period, in compare ticks.
+     * @see period()
+     */
+    uint16 begin(uint32 frequency, uint32 deadTimeNs,
+                 bool centerAligned = true);
+
+    /**
+     * @brief Turn all outputs off and stop the timer.
+     */
+    void end(void);
+
+    /**
+     * @brief Set all three duty cycles at once.
+     *
+     * Each is the high side on time, in compare ticks, from 0 (low
+     * side always on) to period() (high side always on).
+     */
+    void write(uint16 a, uint16 b, uint16 c);
+
+    /**
+     * @brief The PWM period, in compare ticks.
+     */
+    uint16 period(void) { return this->ticks; }
+
+    /**
+     * @brief Start driving the outputs (set MOE).
+     *
+     * Also resumes after a break, once the break input is inactive.
+     */
+    void enable(void) { timer_moe_enable(this->dev); }
+
+    /**
+     * @brief Turn all outputs off (clear MOE).
+     *
+     * The timer keeps running, so enable() resumes in phase.
+     */
+    void disable(void) { timer_moe_disable(this->dev); }
+
+    /**
+     * @brief Whether the outputs are being driven.
+     *
+     * Becomes false after disable(), and when the break input
+     * triggers.
+     */
+    bool enabled(void);
+
+    /**
+     * @brief Configure the break input.
+     * @param enable true to turn the outputs off when BKIN is active.
+     * @param activeHigh true if BKIN is active high, false if low.
+     * @param autoRestart true to turn the outputs back on at the
+     *                    next update event once BKIN is inactive
+     *                    again; false to wait for enable().
+     * @see timer_set_break()
+     */
+    void setBreak(bool enable, bool activeHigh = false,
+                  bool autoRestart = false);
+
+    /**
+     * @brief Call a function when the break input triggers.
+     *
+     * The outputs are already off by the time it runs.
+     */
+    void attachBreakInterrupt(voidFuncPtr handler);
+
+    /**
+     * @brief Stop calling a function on break.
+     */
+    void detachBreakInterrupt(void);
+
+    /**
+     * @brief Get a pointer to the underlying libmaple timer_dev.
+     */
+    timer_dev* c_dev(void) { return this->dev; }
+
+private:
+    timer_dev *dev;
+    uint8 timerNum;
+    uint16 ticks;
+};
+
+#endif
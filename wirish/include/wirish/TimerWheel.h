@@ -0,0 +1,181 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Copyright (c) 2012 LeafLabs, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file wirish/include/wirish/TimerWheel.h
+ * @brief Software timers multiplexed on one hardware timer.
+ */
+
+#ifndef _WIRISH_TIMERWHEEL_H_
+#define _WIRISH_TIMERWHEEL_H_
+
+#include <libmaple/timer.h>
+
+/** Bits of the deadline resolved by each level of the wheel. */
+#define TIMER_WHEEL_BITS    5
+/** Slots in each level of the wheel. */
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+/** Levels needed to cover 32 bit deadlines. */
+#define TIMER_WHEEL_LEVELS  ((32 + TIMER_WHEEL_BITS - 1) / TIMER_WHEEL_BITS)
+
+/** Hardware timer used if TimerWheel::begin() isn't called first. */
+#ifndef TIMER_WHEEL_DEFAULT_TIMER
+#define TIMER_WHEEL_DEFAULT_TIMER 4
+#endif
+
+/**
+ * @brief One-shot software timer.
+ *
+ * Calls a function once, a given number of microseconds after
+ * attach(). Callbacks run from the wheel's timer interrupt.
+ *
+ * @see Ticker
+ * @see TimerWheel
+ */
+class Timeout {
+public:
+    Timeout(void);
+    ~Timeout(void);
+
+    /**
+     * @brief Call a function once after a delay.
+     *
+     * Reschedules the timeout if it is already active.
+     *
+     * @param fn Function to call.
+     * @param us Delay in microseconds, less than 2^31.
+     */
+    void attach(voidFuncPtr fn, uint32 us);
+
+    /**
+     * @brief Cancel the timeout, if active.
+     */
+    void detach(void);
+
+    /**
+     * @brief Is a call pending?
+     */
+    bool active(void) { return this->pprev != NULL; }
+
+protected:
+    friend class TimerWheel;
+
+    Timeout *next;
+    Timeout **pprev;
+    voidFuncPtr fn;
+    uint32 deadline;
+    uint32 period;
+    uint16 slot;
+
+    void schedule(voidFuncPtr fn, uint32 us, uint32 period);
+};
+
+/**
+ * @brief Periodic software timer.
+ *
+ * Calls a function every given number of microseconds. Periods are
+ * measured between deadlines rather than between calls, so latency
+ * doesn't accumulate; if a call is so late that the next deadline
+ * has already passed, the next call happens at once.
+ */
+class Ticker : public Timeout {
+public:
+    /**
+     * @brief Call a function periodically.
+     *
+     * Restarts the ticker if it is already active.
+     *
+     * @param fn Function to call.
+     * @param us Period in microseconds, at least 1 and less than 2^31.
+     */
+    void attach(voidFuncPtr fn, uint32 us);
+};
+
+/**
+ * @brief Scheduler for Timeout and Ticker objects.
+ *
+ * A single hardware timer counts microseconds; its channel 1 compare
+ * interrupt is always set to the earliest deadline, so there are no
+ * periodic ticks (apart from the counter's own overflow, every 65.5
+ * ms). Pending timers are kept in a hierarchical timer wheel: each
+ * level sorts deadlines by TIMER_WHEEL_BITS bits, with a bitmap of
+ * occupied slots, so adding or cancelling a timer takes constant
+ * time, and finding the next deadline takes a few count leading
+ * zeros instructions however many timers are pending.
+ *
+ * The timer is taken over completely, so it can't be used for PWM
+ * or anything else.
+ */
+class TimerWheel {
+public:
+    TimerWheel(void);
+
+    /**
+     * @brief Start the wheel on a hardware timer.
+     *
+     * Optional; attaching the first Timeout or Ticker starts the wheel
+     * on TIMER_WHEEL_DEFAULT_TIMER. Calling this afterwards has no
+     * effect.
+     *
+     * @param timerNum Number of a general purpose or advanced timer.
+     */
+    void begin(uint8 timerNum);
+
+    /**
+     * @brief Microseconds since the wheel started.
+     *
+     * Wraps around every 71.6 minutes. Safe to call from interrupt
+     * handlers.
+     */
+    uint32 micros(void);
+
+    /** @brief Get the wheel's timer. */
+    timer_dev* c_dev(void) { return this->dev; }
+
+    /* Not for users */
+    void add(Timeout *t, uint32 us);
+    void remove(Timeout *t);
+    void run(void);
+    void overflow(void);
+
+private:
+    timer_dev *dev;
+    volatile uint32 high;
+    uint32 base;
+    uint32 armed;
+    bool armedValid;
+    uint32 occupied[TIMER_WHEEL_LEVELS];
+    Timeout *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+    void insert(Timeout *t);
+    void unlink(Timeout *t);
+    bool next(uint32 *when, uint32 *slot);
+};
+
+/** The wheel used by all Timeout and Ticker objects. */
+extern TimerWheel Timers;
+
+#endif
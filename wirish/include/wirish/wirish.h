@@ -46,9 +46,17 @@
 #include <wirish/wirish_time.h>
 #if STM32_MCU_SERIES == STM32_SERIES_F1 /* FIXME [0.0.13?] port to F2 */
 #include <wirish/HardwareSPI.h>
+#include <wirish/HardwareADC.h>
+#include <wirish/HardwareDAC.h>
+#include <wirish/HardwareCapture.h>
+#include <wirish/ThreePhasePWM.h>
 #endif
+#include <wirish/FastAnalog.h>
 #include <wirish/HardwareSerial.h>
 #include <wirish/HardwareTimer.h>
+#include <wirish/HardwareEncoder.h>
+#include <wirish/ChainedTimer.h>
+#include <wirish/TimerWheel.h>
 #include <wirish/usb_serial.h>
 #include <wirish/wirish_types.h>
 
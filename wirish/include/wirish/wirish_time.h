@@ -75,11 +75,36 @@ static inline uint32 micros(void) {
  * exceed ms.  However, this function will return no less than ms
  * milliseconds from the time it is called.
  *
+ * The processor sleeps while it waits, waking only for interrupts,
+ * so time spent in interrupt handlers doesn't lengthen the delay.
+ * Inside an interrupt handler, or with interrupts disabled, it
+ * busy-waits instead.
+ *
  * @param ms the number of milliseconds to delay.
  * @see delayMicroseconds()
+ * @see sleepUntil()
  */
 void delay(unsigned long ms);
 
+/**
+ * Sleep until micros() reaches the given deadline.
+ *
+ * The processor sleeps (WFI) until the deadline, waking only to run
+ * interrupt handlers. SysTick is reprogrammed so it does not wake
+ * the processor every millisecond on the way; millis() and micros()
+ * stay correct, including inside interrupt handlers.
+ *
+ * Returns immediately if the deadline has passed, or is more than
+ * 2^31 microseconds (about 35 minutes) away. Inside an interrupt
+ * handler, or with interrupts disabled, micros() is read once and the
+ * remaining time is busy-waited with delayMicroseconds(), as delay()
+ * does there.
+ *
+ * @param deadline value of micros() to sleep until.
+ * @see delay()
+ */
+void sleepUntil(uint32 deadline);
+
 /**
  * Delay for at least the given number of microseconds.
  *
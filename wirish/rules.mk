@@ -23,15 +23,23 @@ cSRCS_$(d) := start_c.c
 cSRCS_$(d) += syscalls.c
 cSRCS_$(d) += $(MCU_SERIES)/util_hooks.c
 cppSRCS_$(d) := boards.cpp
+cppSRCS_$(d) += ChainedTimer.cpp
 cppSRCS_$(d) += cxxabi-compat.cpp
 cppSRCS_$(d) += ext_interrupts.cpp
+cppSRCS_$(d) += FastAnalog.cpp
+cppSRCS_$(d) += HardwareEncoder.cpp
 cppSRCS_$(d) += HardwareSerial.cpp
 cppSRCS_$(d) += HardwareTimer.cpp
 cppSRCS_$(d) += Print.cpp
+cppSRCS_$(d) += TimerWheel.cpp
 cppSRCS_$(d) += pwm.cpp
 ifeq ($(MCU_SERIES), stm32f1)
 cppSRCS_$(d) += usb_serial.cpp	# HACK: this is currently STM32F1 only.
 cppSRCS_$(d) += HardwareSPI.cpp	# FIXME: port to F2 and fix wirish.h
+cppSRCS_$(d) += HardwareADC.cpp	# Uses STM32F1 ADC DMA mapping
+cppSRCS_$(d) += HardwareDAC.cpp	# Uses STM32F1 DAC DMA mapping
+cppSRCS_$(d) += HardwareCapture.cpp	# Uses STM32F1 timer DMA mapping
+cppSRCS_$(d) += ThreePhasePWM.cpp	# Uses STM32F1 pin mapping
 endif
 cppSRCS_$(d) += wirish_analog.cpp
 cppSRCS_$(d) +=	wirish_digital.cpp
@@ -32,11 +32,65 @@
 
 #include <libmaple/libmaple_types.h>
 #include <libmaple/delay.h>
+#include <libmaple/nvic.h>
+
+/* Below this, waking up again costs more than sleeping saves. */
+#define SLEEP_MIN_US 4
+
+/* SysTick can't advance millis() from inside an interrupt handler or
+ * with interrupts disabled, so callers there must busy-wait. */
+static inline bool can_sleep(void) {
+    uint32 ipsr, primask;
+    asm volatile("mrs %0, ipsr" : "=r" (ipsr));
+    asm volatile("mrs %0, primask" : "=r" (primask));
+    return ipsr == 0 && primask == 0;
+}
 
 void delay(unsigned long ms) {
-    uint32 i;
-    for (i = 0; i < ms; i++) {
-        delayMicroseconds(1000);
+    if (!can_sleep()) {
+        for (uint32 i = 0; i < ms; i++) {
+            delayMicroseconds(1000);
+        }
+        return;
+    }
+
+    uint32 deadline = micros();
+    // In steps short enough for a micros() deadline
+    while (ms > 0) {
+        uint32 step = ms < 1000000 ? ms : 1000000;
+        deadline += step * 1000;
+        sleepUntil(deadline);
+        ms -= step;
+    }
+}
+
+void sleepUntil(uint32 deadline) {
+    if (!can_sleep()) {
+        // micros() may stop advancing here, so count the wait out once,
+        // in steps that keep delay_us()'s loop count from overflowing.
+        int32 remaining = (int32)(deadline - micros());
+        while (remaining > 0) {
+            uint32 step = remaining < 1000000 ? remaining : 1000000;
+            delay_us(step);
+            remaining -= step;
+        }
+        return;
+    }
+    while (true) {
+        nvic_globalirq_disable();
+        int32 remaining = (int32)(deadline - micros());
+        if (remaining <= 0) {
+            nvic_globalirq_enable();
+            return;
+        }
+        if (remaining >= SLEEP_MIN_US) {
+            if ((uint32)remaining > SYSTICK_MAX_SLEEP / CYCLES_PER_MICROSECOND) {
+                remaining = SYSTICK_MAX_SLEEP / CYCLES_PER_MICROSECOND;
+            }
+            systick_sleep((remaining - 1) * CYCLES_PER_MICROSECOND);
+        }
+        // Let whatever woke us run.
+        nvic_globalirq_enable();
     }
 }
 